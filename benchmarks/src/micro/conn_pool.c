@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+#include "micro.h"
+
+#include <aerospike/as_conn_pool.h>
+#include <citrusleaf/cf_queue.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/******************************************************************************
+ *	Contention benchmark for the per-node connection pool.  Every thread
+ *	borrows a socket from one shared pool and returns it, as a synchronous
+ *	command does, so all threads fight over the same pool.  The lock-free
+ *	as_conn_pool is compared against the cf_queue it replaced.  No sockets are
+ *	opened; the pools hold plain integers.
+ *
+ *	Usage: conn_pool [max threads]
+ *****************************************************************************/
+
+#define POOL_SIZE 301
+#define ITERATIONS (1000000)
+
+typedef struct pool_ops_s {
+	const char* name;
+	bool (*get)(void* pool, int* fd);
+	bool (*put)(void* pool, int fd);
+} pool_ops;
+
+typedef struct thread_arg_s {
+	const pool_ops* ops;
+	void* pool;
+	pthread_barrier_t* barrier;
+	uint64_t misses;
+} thread_arg;
+
+static bool
+queue_get(void* pool, int* fd)
+{
+	return cf_queue_pop(pool, fd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK;
+}
+
+static bool
+queue_put(void* pool, int fd)
+{
+	return cf_queue_push_limit(pool, &fd, POOL_SIZE);
+}
+
+static bool
+stack_get(void* pool, int* fd)
+{
+	return as_conn_pool_get(pool, fd);
+}
+
+static bool
+stack_put(void* pool, int fd)
+{
+	return as_conn_pool_put(pool, fd);
+}
+
+static const pool_ops g_queue_ops = {"cf_queue", queue_get, queue_put};
+static const pool_ops g_stack_ops = {"as_conn_pool", stack_get, stack_put};
+
+static void*
+worker(void* udata)
+{
+	thread_arg* arg = udata;
+	const pool_ops* ops = arg->ops;
+	void* pool = arg->pool;
+	uint64_t misses = 0;
+
+	pthread_barrier_wait(arg->barrier);
+
+	for (int i = 0; i < ITERATIONS; i++) {
+		int fd;
+
+		if (! ops->get(pool, &fd)) {
+			// Pool was drained by other threads; "create" a socket.
+			fd = i;
+			misses++;
+		}
+		ops->put(pool, fd);
+	}
+	arg->misses = misses;
+	return NULL;
+}
+
+static void
+run(const pool_ops* ops, void* pool, int n_threads)
+{
+	pthread_t threads[n_threads];
+	thread_arg args[n_threads];
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, n_threads + 1);
+
+	for (int i = 0; i < n_threads; i++) {
+		args[i].ops = ops;
+		args[i].pool = pool;
+		args[i].barrier = &barrier;
+		pthread_create(&threads[i], NULL, worker, &args[i]);
+	}
+
+	uint64_t begin = micro_now_ns();
+	pthread_barrier_wait(&barrier);
+
+	uint64_t misses = 0;
+
+	for (int i = 0; i < n_threads; i++) {
+		pthread_join(threads[i], NULL);
+		misses += args[i].misses;
+	}
+
+	uint64_t elapsed = micro_now_ns() - begin;
+	pthread_barrier_destroy(&barrier);
+
+	char name[64];
+	snprintf(name, sizeof(name), "%s %d threads", ops->name, n_threads);
+
+	// Report wall time per get/put pair across all threads.
+	micro_report(name, (uint64_t)ITERATIONS * n_threads, elapsed);
+
+	if (misses) {
+		printf("%-40s %12llu empty pool gets\n", "", (unsigned long long)misses);
+	}
+}
+
+int
+main(int argc, char* argv[])
+{
+	int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+
+	for (int n = 1; n <= max_threads; n *= 4) {
+		cf_queue* queue = cf_queue_create(sizeof(int), true);
+
+		for (int i = 0; i < n; i++) {
+			cf_queue_push(queue, &i);
+		}
+		run(&g_queue_ops, queue, n);
+		cf_queue_destroy(queue);
+
+		as_conn_pool pool;
+		as_conn_pool_init(&pool, POOL_SIZE);
+
+		for (int i = 0; i < n; i++) {
+			as_conn_pool_put(&pool, i);
+		}
+		run(&g_stack_ops, &pool, n);
+
+		// Pool holds integers, not sockets, so don't close them.
+		int fd;
+		while (as_conn_pool_get(&pool, &fd)) {
+		}
+		as_conn_pool_destroy(&pool);
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_command.h>
+#include <aerospike/as_key.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ *	Cost of putting a key into a command: as_command_key_size() followed by
+ *	as_command_write_key(), for a key encoded once by as_key_encode() and for
+ *	a plain key that is encoded by every command.  No server is needed.
+ *
+ *	Usage: key_encode [rounds]
+ *****************************************************************************/
+
+static uint64_t
+bench_write(as_key* key, as_policy_key policy, uint64_t rounds)
+{
+	uint8_t buf[512];
+	uint64_t sink = 0;
+
+	for (uint64_t i = 0; i < rounds; i++) {
+		uint16_t n_fields;
+		size_t size = as_command_key_size(policy, key, &n_fields);
+		uint8_t* end = as_command_write_key(buf, policy, key);
+		sink += size + (end - buf) + buf[i & 63];
+	}
+	return sink;
+}
+
+static void
+bench_run(const char* label, as_key* plain, as_key* encoded, as_policy_key policy, uint64_t rounds)
+{
+	char name[64];
+	uint64_t sink = bench_write(plain, policy, 1000) + bench_write(encoded, policy, 1000);
+
+	uint64_t begin = micro_now_ns();
+	sink += bench_write(plain, policy, rounds);
+	snprintf(name, sizeof(name), "plain key, %s", label);
+	micro_report(name, rounds, micro_now_ns() - begin);
+
+	begin = micro_now_ns();
+	sink += bench_write(encoded, policy, rounds);
+	snprintf(name, sizeof(name), "encoded key, %s", label);
+	micro_report(name, rounds, micro_now_ns() - begin);
+
+	if (sink == 0) {
+		printf("unexpected checksum\n");
+	}
+}
+
+int
+main(int argc, char* argv[])
+{
+	uint64_t rounds = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000000;
+
+	as_namespace ns = "profiles";
+	as_set set = "user_sessions";
+	as_error err;
+
+	as_key plain;
+	as_key encoded;
+	as_key_init_str(&plain, ns, set, "session:4f1c2a9e-user:918273");
+	as_key_init_str(&encoded, ns, set, "session:4f1c2a9e-user:918273");
+	as_key_digest(&plain);
+
+	as_key_encode(&err, &encoded, AS_POLICY_KEY_DIGEST);
+	bench_run("digest", &plain, &encoded, AS_POLICY_KEY_DIGEST, rounds);
+
+	as_key_encode(&err, &encoded, AS_POLICY_KEY_SEND);
+	bench_run("send user key", &plain, &encoded, AS_POLICY_KEY_SEND, rounds);
+
+	as_key_destroy(&plain);
+	as_key_destroy(&encoded);
+	return 0;
+}
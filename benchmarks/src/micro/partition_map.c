@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_b64.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ *	Cost of applying replicas-master/replicas-prole responses on the tend
+ *	thread.  A synthetic cluster of NODES nodes serves NAMESPACES namespaces
+ *	of PARTITIONS partitions.  "steady" re-applies every node's maps after a
+ *	generation change that moved nothing.  "migrate" alternates between two
+ *	layouts that differ in MOVED partitions per namespace.  No server is
+ *	needed.
+ *
+ *	Usage: partition_map [rounds]
+ *****************************************************************************/
+
+#define NODES 60
+#define NAMESPACES 32
+#define PARTITIONS 4096
+#define MOVED 64
+#define BITMAP_SIZE (PARTITIONS / 8)
+
+bool
+as_partition_tables_update(as_cluster* cluster, as_node* node, char* buf, bool master);
+
+typedef struct bench_s {
+	as_cluster cluster;
+	as_node nodes[NODES];
+
+	// Responses for both layouts, indexed [layout][node][master].
+	char* maps[2][NODES][2];
+	size_t maps_len;
+	char* buf;
+} bench;
+
+static uint32_t
+bench_owner(uint32_t layout, uint32_t ns, uint32_t p, bool master)
+{
+	uint32_t owner = (p + ns) % NODES;
+
+	// The second layout moves the first MOVED partitions of each namespace.
+	if (layout == 1 && p < MOVED) {
+		owner = (owner + 7) % NODES;
+	}
+	return master ? owner : (owner + 1) % NODES;
+}
+
+static char*
+bench_map(uint32_t layout, uint32_t node, bool master)
+{
+	size_t b64_len = cf_b64_encoded_len(BITMAP_SIZE);
+	char* map = cf_malloc(NAMESPACES * (b64_len + 16) + 1);
+	char* p = map;
+
+	for (uint32_t ns = 0; ns < NAMESPACES; ns++) {
+		uint8_t bitmap[BITMAP_SIZE];
+		memset(bitmap, 0, sizeof(bitmap));
+
+		for (uint32_t i = 0; i < PARTITIONS; i++) {
+			if (bench_owner(layout, ns, i, master) == node) {
+				bitmap[i >> 3] |= 0x80 >> (i & 7);
+			}
+		}
+		p += sprintf(p, "ns%u:", ns);
+		cf_b64_encode(bitmap, BITMAP_SIZE, p);
+		p += b64_len;
+		*p++ = ';';
+	}
+	*p = 0;
+	return map;
+}
+
+static void
+bench_init(bench* b)
+{
+	memset(b, 0, sizeof(bench));
+	b->cluster.n_partitions = PARTITIONS;
+
+	for (uint32_t i = 0; i < NODES; i++) {
+		b->nodes[i].active = true;
+		b->nodes[i].ref_count = 1u << 30;
+	}
+
+	// Create all tables up front so updates never grow the tables array.
+	as_partition_tables* tables = as_partition_tables_create(NAMESPACES);
+	size_t len = sizeof(as_partition_table) + sizeof(as_partition) * PARTITIONS;
+
+	for (uint32_t ns = 0; ns < NAMESPACES; ns++) {
+		as_partition_table* table = cf_malloc(len);
+		memset(table, 0, len);
+		sprintf(table->ns, "ns%u", ns);
+		table->ns_id = as_namespace_intern(table->ns, strlen(table->ns));
+		table->size = PARTITIONS;
+		tables->array[ns] = table;
+		tables->index[table->ns_id] = table;
+	}
+	tables->size = NAMESPACES;
+	b->cluster.partition_tables = tables;
+
+	for (uint32_t layout = 0; layout < 2; layout++) {
+		for (uint32_t i = 0; i < NODES; i++) {
+			b->maps[layout][i][0] = bench_map(layout, i, false);
+			b->maps[layout][i][1] = bench_map(layout, i, true);
+		}
+	}
+	b->maps_len = strlen(b->maps[0][0][0]) + 1;
+	b->buf = cf_malloc(b->maps_len);
+}
+
+// Apply every node's maps in one layout.  Updates parse destructively, so each
+// response is copied first, as the tend thread would receive a fresh buffer.
+static void
+bench_apply(bench* b, uint32_t layout)
+{
+	for (uint32_t i = 0; i < NODES; i++) {
+		for (uint32_t m = 0; m < 2; m++) {
+			memcpy(b->buf, b->maps[layout][i][m], b->maps_len);
+			as_partition_tables_update(&b->cluster, &b->nodes[i], b->buf, m == 1);
+		}
+	}
+}
+
+static bool
+bench_verify(bench* b, uint32_t layout)
+{
+	as_partition_tables* tables = b->cluster.partition_tables;
+
+	for (uint32_t ns = 0; ns < NAMESPACES; ns++) {
+		as_partition_table* table = tables->array[ns];
+
+		for (uint32_t i = 0; i < PARTITIONS; i++) {
+			as_partition* p = &table->partitions[i];
+
+			if (p->master != &b->nodes[bench_owner(layout, ns, i, true)] ||
+				p->prole != &b->nodes[bench_owner(layout, ns, i, false)]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+	uint32_t rounds = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+
+	bench* b = cf_malloc(sizeof(bench));
+	bench_init(b);
+	bench_apply(b, 0);
+
+	// Copy cost alone, to subtract from the results below.
+	uint64_t begin = micro_now_ns();
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		for (uint32_t i = 0; i < NODES * 2; i++) {
+			memcpy(b->buf, b->maps[0][i / 2][i & 1], b->maps_len);
+		}
+	}
+	micro_report("copy response", (uint64_t)rounds * NODES * 2, micro_now_ns() - begin);
+
+	begin = micro_now_ns();
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		bench_apply(b, 0);
+	}
+	micro_report("steady, per node map", (uint64_t)rounds * NODES * 2, micro_now_ns() - begin);
+	bool ok = bench_verify(b, 0);
+
+	begin = micro_now_ns();
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		bench_apply(b, (r + 1) & 1);
+	}
+	micro_report("migrate, per node map", (uint64_t)rounds * NODES * 2, micro_now_ns() - begin);
+	ok = ok && bench_verify(b, rounds & 1);
+
+	uint8_t bitmap[BITMAP_SIZE + 3];
+	const char* b64 = strchr(b->maps[0][0][1], ':') + 1;
+	uint32_t b64_len = cf_b64_encoded_len(BITMAP_SIZE);
+	begin = micro_now_ns();
+
+	for (uint32_t r = 0; r < rounds * 1000; r++) {
+		cf_b64_decode(b64, b64_len, bitmap, NULL);
+	}
+	micro_report("b64 decode, per bitmap", (uint64_t)rounds * 1000, micro_now_ns() - begin);
+
+	printf("%s\n", ok ? "tables match layout" : "TABLES DO NOT MATCH LAYOUT");
+	return ok ? 0 : 1;
+}
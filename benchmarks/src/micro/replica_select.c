@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_node.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ *	Simulation of AS_POLICY_REPLICA_ANY reads against a cluster with one slow
+ *	node.  Each partition has a random master and prole.  Nodes serve a fixed
+ *	number of commands at once with exponentially distributed service times
+ *	and queue the rest.  Reads either alternate between master and prole, as
+ *	the client did before, or are routed by as_node_choose_replica() using the
+ *	latency and in-flight counts kept on real as_node structs.  Time is
+ *	simulated, so results are deterministic for a given seed.
+ *
+ *	Usage: replica_select [slow factor]
+ *****************************************************************************/
+
+#define NODES 4
+#define SLOTS 8
+#define REQUESTS 1000000
+#define FAST_SERVICE_US 200.0
+#define ARRIVALS_PER_SEC 24000.0
+
+typedef struct event_s {
+	double finish;
+	uint32_t latency_us;
+	int node;
+} event;
+
+typedef struct sim_s {
+	as_node nodes[NODES];
+	double free_at[NODES][SLOTS];
+	double service_us[NODES];
+	event* heap;
+	uint32_t heap_size;
+	uint64_t seed;
+	uint32_t alternate;
+	uint32_t slow_reads;
+} sim;
+
+static inline double
+sim_rand(sim* s)
+{
+	// xorshift64*
+	s->seed ^= s->seed >> 12;
+	s->seed ^= s->seed << 25;
+	s->seed ^= s->seed >> 27;
+	return ((s->seed * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline double
+sim_exp(sim* s, double mean)
+{
+	return -mean * log(1.0 - sim_rand(s));
+}
+
+static void
+heap_push(sim* s, event e)
+{
+	uint32_t i = s->heap_size++;
+
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+
+		if (s->heap[parent].finish <= e.finish) {
+			break;
+		}
+		s->heap[i] = s->heap[parent];
+		i = parent;
+	}
+	s->heap[i] = e;
+}
+
+static event
+heap_pop(sim* s)
+{
+	event top = s->heap[0];
+	event last = s->heap[--s->heap_size];
+	uint32_t i = 0;
+
+	while (true) {
+		uint32_t child = i * 2 + 1;
+
+		if (child >= s->heap_size) {
+			break;
+		}
+
+		if (child + 1 < s->heap_size && s->heap[child + 1].finish < s->heap[child].finish) {
+			child++;
+		}
+
+		if (last.finish <= s->heap[child].finish) {
+			break;
+		}
+		s->heap[i] = s->heap[child];
+		i = child;
+	}
+	s->heap[i] = last;
+	return top;
+}
+
+static int
+compare_u32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+static void
+run(const char* name, double slow_factor, bool choose, uint32_t* latencies)
+{
+	sim* s = calloc(1, sizeof(sim));
+	s->heap = malloc(sizeof(event) * REQUESTS);
+	s->seed = 0x9E3779B97F4A7C15ULL;
+
+	for (int i = 0; i < NODES; i++) {
+		s->service_us[i] = FAST_SERVICE_US;
+	}
+	s->service_us[NODES - 1] = FAST_SERVICE_US * slow_factor;
+
+	double now = 0;
+
+	for (uint32_t r = 0; r < REQUESTS; r++) {
+		now += sim_exp(s, 1000000.0 / ARRIVALS_PER_SEC);
+
+		// Completed commands report their latency before the next choice.
+		while (s->heap_size && s->heap[0].finish <= now) {
+			event e = heap_pop(s);
+			as_node_command_end(&s->nodes[e.node], e.latency_us, false);
+		}
+
+		int master = (int)(sim_rand(s) * NODES);
+		int prole = (master + 1 + (int)(sim_rand(s) * (NODES - 1))) % NODES;
+		int n;
+
+		if (choose) {
+			as_node* node = as_node_choose_replica(&s->nodes[master], &s->nodes[prole]);
+			n = (int)(node - s->nodes);
+		}
+		else {
+			n = (s->alternate++ & 1)? master : prole;
+		}
+
+		// Take the slot that frees up first.
+		int slot = 0;
+
+		for (int i = 1; i < SLOTS; i++) {
+			if (s->free_at[n][i] < s->free_at[n][slot]) {
+				slot = i;
+			}
+		}
+
+		double start = s->free_at[n][slot] > now ? s->free_at[n][slot] : now;
+		double finish = start + sim_exp(s, s->service_us[n]);
+		s->free_at[n][slot] = finish;
+
+		event e = {finish, (uint32_t)(finish - now), n};
+		latencies[r] = e.latency_us;
+		as_node_command_begin(&s->nodes[n]);
+		heap_push(s, e);
+
+		if (n == NODES - 1) {
+			s->slow_reads++;
+		}
+	}
+
+	qsort(latencies, REQUESTS, sizeof(uint32_t), compare_u32);
+
+	double sum = 0;
+
+	for (uint32_t r = 0; r < REQUESTS; r++) {
+		sum += latencies[r];
+	}
+
+	printf("%-24s %8.0f %8u %8u %8u %8u %9.1f%%\n", name, sum / REQUESTS,
+		latencies[REQUESTS / 2], latencies[(uint64_t)REQUESTS * 99 / 100],
+		latencies[(uint64_t)REQUESTS * 999 / 1000], latencies[REQUESTS - 1],
+		100.0 * s->slow_reads / REQUESTS);
+
+	free(s->heap);
+	free(s);
+}
+
+int
+main(int argc, char** argv)
+{
+	double slow_factor = argc > 1 ? atof(argv[1]) : 5.0;
+	uint32_t* latencies = malloc(sizeof(uint32_t) * REQUESTS);
+
+	printf("replica selection: %d nodes, one %.1fx slower, %.0f reads/sec\n",
+		NODES, slow_factor, ARRIVALS_PER_SEC);
+	printf("%-24s %8s %8s %8s %8s %8s %10s\n", "latency (us)", "mean", "p50", "p99",
+		"p99.9", "max", "slow node");
+
+	run("alternate", slow_factor, false, latencies);
+	run("ewma two choices", slow_factor, true, latencies);
+
+	free(latencies);
+	return 0;
+}
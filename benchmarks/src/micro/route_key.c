@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/alloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ *	Cost of routing a key to its master node: the command size computation
+ *	followed by as_node_get() against a cluster with a fully mapped partition
+ *	table per namespace.  Keys are routed either by namespace string, as the
+ *	client did before keys cached an interned namespace id, or by that id.
+ *	No server is needed.
+ *
+ *	Usage: route_key [rounds]
+ *****************************************************************************/
+
+#define NODES 8
+#define PARTITIONS 4096
+#define MAX_NAMESPACES 16
+#define KEYS 4096
+
+typedef struct bench_s {
+	as_cluster cluster;
+	as_node nodes[NODES];
+	as_key keys[KEYS];
+	as_key legacy[KEYS];
+	uint32_t n_namespaces;
+} bench;
+
+static void
+bench_init(bench* b, uint32_t n_namespaces)
+{
+	memset(b, 0, sizeof(bench));
+	b->n_namespaces = n_namespaces;
+	b->cluster.n_partitions = PARTITIONS;
+
+	for (uint32_t i = 0; i < NODES; i++) {
+		b->nodes[i].active = true;
+		b->nodes[i].ref_count = 1u << 30;
+	}
+
+	size_t size = sizeof(as_partition_tables) + sizeof(as_partition_table*) * n_namespaces;
+	as_partition_tables* tables = cf_malloc(size);
+	memset(tables, 0, size);
+	tables->ref_count = 1;
+	tables->size = n_namespaces;
+	srand(42);
+
+	for (uint32_t i = 0; i < n_namespaces; i++) {
+		size_t len = sizeof(as_partition_table) + sizeof(as_partition) * PARTITIONS;
+		as_partition_table* table = cf_malloc(len);
+		memset(table, 0, len);
+		snprintf(table->ns, sizeof(table->ns), "namespace_%u", i);
+		table->ns_id = as_namespace_intern(table->ns, strlen(table->ns));
+		table->size = PARTITIONS;
+
+		for (uint32_t j = 0; j < PARTITIONS; j++) {
+			uint32_t master = rand() % NODES;
+			table->partitions[j].master = &b->nodes[master];
+			table->partitions[j].prole = &b->nodes[(master + 1) % NODES];
+		}
+		tables->array[i] = table;
+		tables->index[table->ns_id] = table;
+	}
+	b->cluster.partition_tables = tables;
+
+	// Keys are spread evenly over namespaces.  Legacy keys look like keys
+	// parsed from a response, which carry no namespace id or lengths.
+	for (uint32_t i = 0; i < KEYS; i++) {
+		as_key_init_int64(&b->keys[i], tables->array[i % n_namespaces]->ns, "demo", i);
+		as_key_digest(&b->keys[i]);
+		b->legacy[i] = b->keys[i];
+		b->legacy[i]._ns_id = 0;
+		b->legacy[i]._ns_len = 0;
+	}
+}
+
+static void
+bench_destroy(bench* b)
+{
+	as_partition_tables* tables = b->cluster.partition_tables;
+
+	for (uint32_t i = 0; i < tables->size; i++) {
+		cf_free(tables->array[i]);
+	}
+	cf_free(tables);
+}
+
+static uint64_t
+bench_route(bench* b, as_key* keys, uint64_t rounds)
+{
+	uint64_t sink = 0;
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+
+	for (uint64_t i = 0; i < rounds; i++) {
+		as_key* key = &keys[i & (KEYS - 1)];
+		uint16_t n_fields;
+		size_t size = as_command_key_size(AS_POLICY_KEY_DIGEST, key, &n_fields);
+		ck_epoch_begin(&as_cluster_epoch, record);
+		as_node* node = as_node_get(&b->cluster, key->ns, key->_ns_id, (const cf_digest*)key->digest.value,
+			true, AS_POLICY_REPLICA_MASTER);
+		sink += size + (uintptr_t)node;
+		ck_epoch_end(&as_cluster_epoch, record);
+	}
+	return sink;
+}
+
+static void
+bench_run(uint32_t n_namespaces, uint64_t rounds)
+{
+	bench* b = cf_malloc(sizeof(bench));
+	bench_init(b, n_namespaces);
+
+	char name[64];
+	uint64_t sink = 0;
+
+	// Warm up.
+	sink += bench_route(b, b->legacy, KEYS);
+	sink += bench_route(b, b->keys, KEYS);
+
+	uint64_t begin = micro_now_ns();
+	sink += bench_route(b, b->legacy, rounds);
+	snprintf(name, sizeof(name), "route by string, %u namespaces", n_namespaces);
+	micro_report(name, rounds, micro_now_ns() - begin);
+
+	begin = micro_now_ns();
+	sink += bench_route(b, b->keys, rounds);
+	snprintf(name, sizeof(name), "route by id, %u namespaces", n_namespaces);
+	micro_report(name, rounds, micro_now_ns() - begin);
+
+	// Key initialization now includes the namespace lookup.
+	begin = micro_now_ns();
+
+	for (uint64_t i = 0; i < rounds; i++) {
+		as_key key;
+		as_key_init_int64(&key, b->keys[i & (KEYS - 1)].ns, "demo", (int64_t)i);
+		sink += key._ns_id;
+	}
+	snprintf(name, sizeof(name), "key init, %u namespaces", n_namespaces);
+	micro_report(name, rounds, micro_now_ns() - begin);
+
+	if (sink == 0) {
+		printf("unexpected checksum\n");
+	}
+	bench_destroy(b);
+	cf_free(b);
+}
+
+int
+main(int argc, char* argv[])
+{
+	uint64_t rounds = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+
+	bench_run(1, rounds);
+	bench_run(4, rounds);
+	bench_run(MAX_NAMESPACES, rounds);
+	return 0;
+}
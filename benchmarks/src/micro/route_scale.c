@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/alloc.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	Scaling of key routing over threads.  Each thread routes keys to master
+ *	nodes of a synthetic cluster, either reference counting the partition
+ *	tables array and reserving the chosen node as the client did before, or
+ *	inside an epoch section through as_node_get(), which writes no shared
+ *	counter.
+ *	Run on a multi-socket host to see the shared counter bounce.  No server is
+ *	needed.
+ *
+ *	Usage: route_scale [max threads] [keys per thread]
+ *****************************************************************************/
+
+#define NODES 8
+#define PARTITIONS 4096
+#define KEYS 4096
+
+typedef struct bench_s {
+	as_cluster cluster;
+	as_node nodes[NODES];
+	as_key keys[KEYS];
+	bool epoch;
+	uint64_t rounds;
+	volatile bool start;
+} bench;
+
+static void
+bench_init(bench* b)
+{
+	memset(b, 0, sizeof(bench));
+	b->cluster.n_partitions = PARTITIONS;
+
+	for (uint32_t i = 0; i < NODES; i++) {
+		b->nodes[i].active = true;
+		b->nodes[i].ref_count = 1u << 30;
+	}
+
+	as_partition_tables* tables = cf_malloc(sizeof(as_partition_tables) + sizeof(as_partition_table*));
+	memset(tables, 0, sizeof(as_partition_tables));
+	tables->ref_count = 1;
+	tables->size = 1;
+
+	size_t len = sizeof(as_partition_table) + sizeof(as_partition) * PARTITIONS;
+	as_partition_table* table = cf_malloc(len);
+	memset(table, 0, len);
+	strcpy(table->ns, "test");
+	table->ns_id = as_namespace_intern(table->ns, strlen(table->ns));
+	table->size = PARTITIONS;
+	srand(42);
+
+	for (uint32_t j = 0; j < PARTITIONS; j++) {
+		table->partitions[j].master = &b->nodes[rand() % NODES];
+	}
+	tables->array[0] = table;
+	tables->index[table->ns_id] = table;
+	b->cluster.partition_tables = tables;
+
+	for (uint32_t i = 0; i < KEYS; i++) {
+		as_key_init_int64(&b->keys[i], "test", "demo", i);
+		as_key_digest(&b->keys[i]);
+	}
+}
+
+static void*
+bench_thread(void* udata)
+{
+	bench* b = udata;
+	as_cluster* cluster = &b->cluster;
+	uint64_t sink = 0;
+	uint32_t offset = (uint32_t)rand();
+
+	while (! b->start) {
+	}
+
+	for (uint64_t i = 0; i < b->rounds; i++) {
+		as_key* key = &b->keys[(i + offset) & (KEYS - 1)];
+		const cf_digest* d = (const cf_digest*)key->digest.value;
+		as_node* node;
+
+		if (b->epoch) {
+			ck_epoch_record_t* record = as_cluster_epoch_record();
+			ck_epoch_begin(&as_cluster_epoch, record);
+			node = as_node_get(cluster, key->ns, key->_ns_id, d, true, AS_POLICY_REPLICA_MASTER);
+			sink += (uintptr_t)node;
+			ck_epoch_end(&as_cluster_epoch, record);
+		}
+		else {
+			as_partition_tables* tables = as_partition_tables_reserve(cluster);
+			as_partition_table* table = as_partition_tables_get_id(tables, key->ns, key->_ns_id);
+			as_partition_tables_release(tables);
+			node = as_partition_table_get_node(cluster, table, d, true, AS_POLICY_REPLICA_MASTER);
+			as_node_reserve(node);
+			sink += (uintptr_t)node;
+			as_node_release(node);
+		}
+	}
+	return (void*)(uintptr_t)sink;
+}
+
+static void
+bench_run(bench* b, bool epoch, uint32_t n_threads)
+{
+	pthread_t threads[n_threads];
+	b->epoch = epoch;
+	b->start = false;
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		pthread_create(&threads[i], NULL, bench_thread, b);
+	}
+
+	uint64_t begin = micro_now_ns();
+	b->start = true;
+
+	for (uint32_t i = 0; i < n_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "%s, %u threads", epoch ? "epoch" : "ref count", n_threads);
+	micro_report(name, b->rounds * n_threads, micro_now_ns() - begin);
+}
+
+int
+main(int argc, char* argv[])
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t max_threads = argc > 1 ? (uint32_t)atoi(argv[1]) : (uint32_t)(cpus > 1 ? cpus : 2);
+
+	bench* b = cf_malloc(sizeof(bench));
+	bench_init(b);
+	b->rounds = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+
+	for (uint32_t n = 1; n <= max_threads; n *= 2) {
+		bench_run(b, false, n);
+		bench_run(b, true, n);
+	}
+
+	as_partition_tables* tables = b->cluster.partition_tables;
+	cf_free(tables->array[0]);
+	cf_free(tables);
+	cf_free(b);
+	return 0;
+}
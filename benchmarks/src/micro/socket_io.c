@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	Measures the cost of as_socket_read_limit() / as_socket_write_limit() over
+ *	a local socket pair.  Build twice (see "make micro") to compare the poll()
+ *	engine against the legacy select() engine.
+ *****************************************************************************/
+
+#if defined(AS_SOCKET_USE_SELECT)
+#define ENGINE "select"
+#else
+#define ENGINE "poll"
+#endif
+
+#define MSG_SIZE 64
+#define HIGH_FD 4000
+
+static uint64_t g_iterations = 500000;
+
+static int
+make_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int
+open_pair(int fds[2], int min_fd)
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		return -1;
+	}
+
+	if (min_fd) {
+		for (int i = 0; i < 2; i++) {
+			int fd = fcntl(fds[i], F_DUPFD, min_fd);
+
+			if (fd < 0) {
+				close(fds[0]);
+				close(fds[1]);
+				return -1;
+			}
+			close(fds[i]);
+			fds[i] = fd;
+		}
+	}
+	make_nonblocking(fds[0]);
+	make_nonblocking(fds[1]);
+	return 0;
+}
+
+// Data is always ready: measures pure per-call overhead.
+static void
+bench_ready(const char* name, int min_fd)
+{
+	int fds[2];
+
+	if (open_pair(fds, min_fd) != 0) {
+		printf("%-40s skipped (cannot open fd >= %d)\n", name, min_fd);
+		return;
+	}
+
+	uint8_t out[MSG_SIZE];
+	uint8_t in[MSG_SIZE];
+	memset(out, 'x', sizeof(out));
+	as_error err;
+	uint64_t deadline = cf_getms() + 600000;
+	uint64_t begin = micro_now_ns();
+
+	for (uint64_t i = 0; i < g_iterations; i++) {
+		if (as_socket_write_limit(&err, fds[0], out, sizeof(out), deadline) ||
+			as_socket_read_limit(&err, fds[1], in, sizeof(in), deadline)) {
+			printf("%s failed: %d %s\n", name, err.code, err.message);
+			break;
+		}
+	}
+	micro_report(name, g_iterations, micro_now_ns() - begin);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void*
+echo_run(void* udata)
+{
+	int fd = *(int*)udata;
+	uint8_t buf[MSG_SIZE];
+	as_error err;
+
+	while (as_socket_read_forever(&err, fd, buf, sizeof(buf)) == AEROSPIKE_OK) {
+		if (as_socket_write_forever(&err, fd, buf, sizeof(buf)) != AEROSPIKE_OK) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+// Round trip through an echo thread: reads usually have to wait.
+static void
+bench_ping_pong(const char* name, int min_fd)
+{
+	int fds[2];
+
+	if (open_pair(fds, min_fd) != 0) {
+		printf("%-40s skipped (cannot open fd >= %d)\n", name, min_fd);
+		return;
+	}
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, echo_run, &fds[1]);
+
+	uint8_t out[MSG_SIZE];
+	uint8_t in[MSG_SIZE];
+	memset(out, 'x', sizeof(out));
+	as_error err;
+	uint64_t iterations = g_iterations / 5;
+	uint64_t deadline = cf_getms() + 600000;
+	uint64_t begin = micro_now_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		if (as_socket_write_limit(&err, fds[0], out, sizeof(out), deadline) ||
+			as_socket_read_limit(&err, fds[0], in, sizeof(in), deadline)) {
+			printf("%s failed: %d %s\n", name, err.code, err.message);
+			break;
+		}
+	}
+	micro_report(name, iterations, micro_now_ns() - begin);
+	shutdown(fds[0], SHUT_RDWR);
+	pthread_join(thread, NULL);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int
+main(int argc, char** argv)
+{
+	if (argc > 1) {
+		g_iterations = strtoull(argv[1], NULL, 10);
+	}
+
+	// Allow high fd numbers so fd_set sizing costs show up.
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < HIGH_FD + 16) {
+		rl.rlim_cur = rl.rlim_max < HIGH_FD + 16 ? rl.rlim_max : HIGH_FD + 16;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	printf("socket engine: %s\n", ENGINE);
+	bench_ready("write+read ready, low fd", 0);
+	bench_ready("write+read ready, fd " "4000", HIGH_FD);
+	bench_ping_pong("ping-pong, low fd", 0);
+	bench_ping_pong("ping-pong, fd " "4000", HIGH_FD);
+	return 0;
+}
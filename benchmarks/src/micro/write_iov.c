@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * Copyright 2008-2014 by Aerospike.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ ******************************************************************************/
+#include "micro.h"
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/cf_clock.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	Measures sending a put command that carries one large blob: copying the
+ *	blob into the command buffer and writing it, versus writing the header and
+ *	the caller's blob in place with as_socket_writev_limit().  A reader thread
+ *	drains the other end of a local socket pair.
+ *****************************************************************************/
+
+#define HEADER_SIZE 100
+
+static uint64_t g_iterations = 2000;
+
+static void*
+drain_run(void* udata)
+{
+	int fd = *(int*)udata;
+	uint8_t buf[64 * 1024];
+
+	while (read(fd, buf, sizeof(buf)) > 0) {
+	}
+	return NULL;
+}
+
+static void
+bench(size_t blob_size, uint64_t iterations)
+{
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		printf("socketpair failed\n");
+		return;
+	}
+	int flags = fcntl(fds[0], F_GETFL, 0);
+	fcntl(fds[0], F_SETFL, flags | O_NONBLOCK);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, drain_run, &fds[1]);
+
+	uint8_t header[HEADER_SIZE];
+	memset(header, 'h', sizeof(header));
+	uint8_t* blob = malloc(blob_size);
+	memset(blob, 'b', blob_size);
+	as_error err;
+	uint64_t deadline = cf_getms() + 600000;
+	char name[64];
+
+	// Copy header and blob into a fresh command buffer, then write it.
+	uint64_t begin = micro_now_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		uint8_t* cmd = malloc(HEADER_SIZE + blob_size);
+		memcpy(cmd, header, HEADER_SIZE);
+		memcpy(cmd + HEADER_SIZE, blob, blob_size);
+
+		if (as_socket_write_limit(&err, fds[0], cmd, HEADER_SIZE + blob_size, deadline)) {
+			printf("copy failed: %d %s\n", err.code, err.message);
+			free(cmd);
+			break;
+		}
+		free(cmd);
+	}
+	snprintf(name, sizeof(name), "copy+write, %zu KB", blob_size / 1024);
+	micro_report(name, iterations, micro_now_ns() - begin);
+
+	// Write header and blob in place.
+	begin = micro_now_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		struct iovec iov[2];
+		iov[0].iov_base = header;
+		iov[0].iov_len = HEADER_SIZE;
+		iov[1].iov_base = blob;
+		iov[1].iov_len = blob_size;
+
+		if (as_socket_writev_limit(&err, fds[0], iov, 2, deadline)) {
+			printf("writev failed: %d %s\n", err.code, err.message);
+			break;
+		}
+	}
+	snprintf(name, sizeof(name), "writev, %zu KB", blob_size / 1024);
+	micro_report(name, iterations, micro_now_ns() - begin);
+
+	shutdown(fds[0], SHUT_RDWR);
+	pthread_join(thread, NULL);
+	close(fds[0]);
+	close(fds[1]);
+	free(blob);
+}
+
+int
+main(int argc, char** argv)
+{
+	if (argc > 1) {
+		g_iterations = strtoull(argv[1], NULL, 10);
+	}
+
+	bench(64 * 1024, g_iterations * 10);
+	bench(1024 * 1024, g_iterations);
+	bench(4 * 1024 * 1024, g_iterations / 4);
+	return 0;
+}
@@ -143,14 +143,12 @@ static inline void cf_signature_compute(const void *data, size_t len, cf_signatu
 static inline cl_partition_id cl_partition_getid(uint32_t n_partitions, const cf_digest *d) {
 #ifndef __hpux
 	uint16_t *d_int = (uint16_t *)&d->digest[0];
-#else
-	uint16_t *d_int = malloc(sizeof(uint16_t));
-	memcpy (d_int,(uint16_t *)&d->digest[0],sizeof(uint16_t));
-#endif
 	cl_partition_id r = *d_int & (n_partitions - 1);
-
-#ifdef __hpux
-	free(d_int);
+#else
+	// Digest bytes may be unaligned.
+	uint16_t d_int;
+	memcpy(&d_int, &d->digest[0], sizeof(uint16_t));
+	cl_partition_id r = d_int & (n_partitions - 1);
 #endif
     return(r);
 }
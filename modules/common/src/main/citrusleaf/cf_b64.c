@@ -133,24 +133,44 @@ cf_b64_encode(const uint8_t* in, uint32_t in_size, char* out)
 void
 cf_b64_decode(const char* in, uint32_t in_len, uint8_t* out, uint32_t* out_size)
 {
-	uint32_t i = 0;
-	uint32_t j = 0;
+	const uint8_t* read = (const uint8_t*)in;
+	const uint8_t* end = read + in_len;
+	uint8_t* write = out;
+
+	// Decode two groups per pass. Each group's four 6-bit values are gathered
+	// into one word so every character is looked up once.
+	while (end - read >= 8) {
+		uint32_t v0 = ((uint32_t)DA[read[0]] << 18) | ((uint32_t)DA[read[1]] << 12) |
+				((uint32_t)DA[read[2]] << 6) | DA[read[3]];
+		uint32_t v1 = ((uint32_t)DA[read[4]] << 18) | ((uint32_t)DA[read[5]] << 12) |
+				((uint32_t)DA[read[6]] << 6) | DA[read[7]];
+
+		write[0] = (uint8_t)(v0 >> 16);
+		write[1] = (uint8_t)(v0 >> 8);
+		write[2] = (uint8_t)v0;
+		write[3] = (uint8_t)(v1 >> 16);
+		write[4] = (uint8_t)(v1 >> 8);
+		write[5] = (uint8_t)v1;
+
+		read += 8;
+		write += 6;
+	}
 
-	while (i < in_len) {
-		uint8_t i0 = (uint8_t)in[i];
-		uint8_t i1 = (uint8_t)in[i + 1];
-		uint8_t i2 = (uint8_t)in[i + 2];
-		uint8_t i3 = (uint8_t)in[i + 3];
+	if (read < end) {
+		uint32_t v = ((uint32_t)DA[read[0]] << 18) | ((uint32_t)DA[read[1]] << 12) |
+				((uint32_t)DA[read[2]] << 6) | DA[read[3]];
 
-		out[j]     = (DA[i0] << 2) | (DA[i1] >> 4);
-		out[j + 1] = (DA[i1] << 4) | (DA[i2] >> 2);
-		out[j + 2] = (DA[i2] << 6) |  DA[i3];
+		write[0] = (uint8_t)(v >> 16);
+		write[1] = (uint8_t)(v >> 8);
+		write[2] = (uint8_t)v;
 
-		i += 4;
-		j += 3;
+		write += 3;
 	}
 
 	if (out_size) {
+		uint32_t i = in_len;
+		uint32_t j = (uint32_t)(write - out);
+
 		if (i != 0) {
 			if (in[i - 1] == '=') {
 				j--;
@@ -18,6 +18,17 @@ TEST_SOURCE = $(wildcard $(addprefix $(SOURCE_TEST)/, $(TEST_AEROSPIKE)))
 
 TEST_OBJECT = $(patsubst %.c,%.o,$(subst $(SOURCE_TEST)/,$(TARGET_TEST)/,$(TEST_SOURCE)))
 
+# Tests which run against an in-process fake server instead of a live cluster.
+TEST_OFFLINE = offline_test.c
+TEST_OFFLINE += aerospike_async/*.c
+TEST_OFFLINE += aerospike_node/*.c
+TEST_OFFLINE += util/fake_client.c
+TEST_OFFLINE += util/fake_server.c
+
+TEST_OFFLINE_SOURCE = $(wildcard $(addprefix $(SOURCE_TEST)/, $(TEST_OFFLINE)))
+
+TEST_OFFLINE_OBJECT = $(patsubst %.c,%.o,$(subst $(SOURCE_TEST)/,$(TARGET_TEST)/,$(TEST_OFFLINE_SOURCE)))
+
 ###############################################################################
 ##  FLAGS                                                                    ##
 ###############################################################################
@@ -47,6 +58,10 @@ AS_ARGS := -h $(AS_HOST) -p $(AS_PORT)
 test: $(TARGET_TEST)/aerospike_test
 	$(TARGET_TEST)/aerospike_test $(AS_ARGS)
 
+.PHONY: test-offline
+test-offline: $(TARGET_TEST)/offline_test
+	$(TARGET_TEST)/offline_test
+
 .PHONY: test-valgrind
 test-valgrind: test-build
 	valgrind $(TEST_VALGRIND) $(TARGET_TEST)/aerospike_test 1>&2 2>client_test-valgrind
@@ -72,3 +87,8 @@ $(TARGET_TEST)/aerospike_test: CFLAGS += $(TEST_CFLAGS)
 $(TARGET_TEST)/aerospike_test: LDFLAGS += $(TEST_LDFLAGS)
 $(TARGET_TEST)/aerospike_test: $(TEST_OBJECT) $(TARGET_TEST)/test.o | build prepare
 	$(executable) $(TARGET_LIB)/libaerospike.a $(TEST_LDFLAGS)
+
+$(TARGET_TEST)/offline_test: CFLAGS += $(TEST_CFLAGS)
+$(TARGET_TEST)/offline_test: LDFLAGS += $(TEST_LDFLAGS)
+$(TARGET_TEST)/offline_test: $(TEST_OFFLINE_OBJECT) $(TARGET_TEST)/test.o | build prepare
+	$(executable) $(TARGET_LIB)/libaerospike.a $(TEST_LDFLAGS)
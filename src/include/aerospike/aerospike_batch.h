@@ -51,8 +51,9 @@ extern "C" {
  *	or aerospike_batch_exists() functions.
  *
  * 	The `results` argument will be an array of `n` as_batch_read entries. The
- * 	`results` argument is on the stack and is only available within the context
- * 	of the callback. To use the data outside of the callback, copy the data.
+ * 	`results` argument and the records' bin values are freed when the callback
+ * 	returns, so they are only available within the context of the callback. To
+ * 	use the data outside of the callback, copy the data.
  *
  *	~~~~~~~~~~{.c}
  *	bool my_callback(const as_batch_read * results, uint32_t n, void * udata) {
@@ -70,6 +71,46 @@ extern "C" {
  */
 typedef bool (* aerospike_batch_read_callback)(const as_batch_read * results, uint32_t n, void * udata);
 
+/**
+ *	This callback will be called for each record returned by
+ *	aerospike_batch_get_stream(), as soon as the record is parsed.
+ *
+ *	The callback runs on batch worker threads, one per node and namespace in the
+ *	batch, so it may be called concurrently and must be thread safe.  `result`
+ *	and its record are only available within the context of the callback.  To
+ *	use the data outside of the callback, copy the data.
+ *
+ *	~~~~~~~~~~{.c}
+ *	bool my_callback(const as_batch_read * result, void * udata) {
+ *		return true;
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param result 		The result for one key of the batch.
+ *	@param udata 		User-data provided to the calling function.
+ *	
+ *	@return `true` to continue.  `false` to stop the batch on all nodes.
+ *
+ *	@ingroup batch_operations
+ */
+typedef bool (* aerospike_batch_stream_callback)(const as_batch_read * result, void * udata);
+
+/**
+ *	This callback will be called by aerospike_batch_get_stream() when a node has
+ *	finished its part of the batch.  A node with keys in several namespaces
+ *	reports each namespace separately.  Like aerospike_batch_stream_callback, it
+ *	runs on batch worker threads.
+ *
+ *	@param node_name	The name of the node.
+ *	@param status		The node's result.  AEROSPIKE_ERR_CLIENT_ABORT if the batch
+ *						was stopped before the node finished.
+ *	@param n_keys		The number of batch keys of one namespace sent to the node.
+ *	@param udata 		User-data provided to the calling function.
+ *
+ *	@ingroup batch_operations
+ */
+typedef void (* aerospike_batch_node_callback)(const char * node_name, as_status status, uint32_t n_keys, void * udata);
+
 /******************************************************************************
  *	FUNCTIONS
  *****************************************************************************/
@@ -77,6 +118,14 @@ typedef bool (* aerospike_batch_read_callback)(const as_batch_read * results, ui
 /**
  *	Look up multiple records by key, then return all bins.
  *
+ *	Keys may be in different namespaces and sets.  Keys are grouped by node and
+ *	namespace, the groups are read concurrently, and results are returned in
+ *	the order of the batch keys.
+ *
+ *	Keys a node did not answer are retried as the policy allows.  If some keys
+ *	still fail, the callback is called anyway and an error is returned.  Each
+ *	failed key's result holds its error, so the other results remain usable.
+ *
  *	~~~~~~~~~~{.c}
  *	as_batch batch;
  *	as_batch_inita(&batch, 3);
@@ -109,6 +158,85 @@ as_status aerospike_batch_get(
 	aerospike_batch_read_callback callback, void * udata
 	);
 
+/**
+ *	Look up multiple records by key, then return specified bins.  Only the
+ *	selected bins are sent by the server.
+ *
+ *	~~~~~~~~~~{.c}
+ *	const char * select[] = {"bin1", "bin2", NULL};
+ *	
+ *	as_batch batch;
+ *	as_batch_inita(&batch, 3);
+ *	
+ *	as_key_init(as_batch_keyat(&batch,0), "ns", "set", "key1");
+ *	as_key_init(as_batch_keyat(&batch,1), "ns", "set", "key2");
+ *	as_key_init(as_batch_keyat(&batch,2), "ns", "set", "key3");
+ *	
+ *	if ( aerospike_batch_select(&as, &err, NULL, &batch, select, callback, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_batch_destroy(&batch);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param bins			The bins to select. A NULL terminated array of NULL terminated strings.
+ *	@param callback 	The callback to invoke for each record read.
+ *	@param udata		The user-data for the callback.
+ *
+ *	@return AEROSPIKE_OK if successful. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status aerospike_batch_select(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_batch * batch, const char * bins[], 
+	aerospike_batch_read_callback callback, void * udata
+	);
+
+/**
+ *	Look up multiple records by key, then return all bins.  Unlike
+ *	aerospike_batch_get(), each record is passed to `callback` as soon as its
+ *	node's response is parsed, so results from fast nodes do not wait for slow
+ *	ones and records are not held until the whole batch is done.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_batch batch;
+ *	as_batch_inita(&batch, 3);
+ *	
+ *	as_key_init(as_batch_keyat(&batch,0), "ns", "set", "key1");
+ *	as_key_init(as_batch_keyat(&batch,1), "ns", "set", "key2");
+ *	as_key_init(as_batch_keyat(&batch,2), "ns", "set", "key3");
+ *	
+ *	if ( aerospike_batch_get_stream(&as, &err, NULL, &batch, callback, NULL, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *
+ *	as_batch_destroy(&batch);
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if an error occurs.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param batch		The batch of keys to read.
+ *	@param callback 	The callback to invoke for each record read.  Returning false stops the batch.
+ *	@param node_callback	The callback to invoke as each node finishes.  May be NULL.
+ *	@param udata		The user-data for the callbacks.
+ *
+ *	@return AEROSPIKE_OK if successful or stopped by the callback. Otherwise an error.
+ *
+ *	@ingroup batch_operations
+ */
+as_status aerospike_batch_get_stream(
+	aerospike * as, as_error * err, const as_policy_batch * policy, 
+	const as_batch * batch, 
+	aerospike_batch_stream_callback callback, aerospike_batch_node_callback node_callback,
+	void * udata
+	);
+
 /**
  *	Test whether multiple records exist in the cluster.
  *
@@ -34,6 +34,7 @@ extern "C" {
 
 #include <aerospike/aerospike.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_list.h>
 #include <aerospike/as_operations.h>
@@ -293,6 +294,117 @@ as_status aerospike_key_apply(
 	as_val ** result
 	);
 
+
+/**
+ *	Asynchronously look up a record by key, then return all bins.
+ *
+ *	The command is queued on a client event loop and this function returns
+ *	immediately.  The listener is called from the event loop thread when the
+ *	command completes.
+ *
+ *	~~~~~~~~~~{.c}
+ *	void my_listener(as_error* err, as_record* rec, void* udata)
+ *	{
+ *		if (err) {
+ *			fprintf(stderr, "error(%d) %s", err->code, err->message);
+ *			return;
+ *		}
+ *		// Process record.  Record is destroyed when listener returns.
+ *	}
+ *
+ *	as_key key;
+ *	as_key_init(&key, "ns", "set", "key");
+ *
+ *	if ( aerospike_key_get_async(&as, &err, NULL, &key, my_listener, NULL) != AEROSPIKE_OK ) {
+ *		fprintf(stderr, "error(%d) %s at [%s:%d]", err.code, err.message, err.file, err.line);
+ *	}
+ *	~~~~~~~~~~
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if the command cannot be queued.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		The function called when the command completes.
+ *	@param udata		User data passed to listener.
+ *
+ *	@return AEROSPIKE_OK if the command was queued. Otherwise an error, and the
+ *	listener will not be called.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_get_async(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	const as_key * key, as_async_record_listener listener, void * udata
+	);
+
+/**
+ *	Asynchronously store a record in the cluster.
+ *
+ *	The record is encoded before this function returns, so rec may be destroyed
+ *	as soon as the call returns.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if the command cannot be queued.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param rec 			The record containing the data to be written.
+ *	@param listener		The function called when the command completes.
+ *	@param udata		User data passed to listener.
+ *
+ *	@return AEROSPIKE_OK if the command was queued. Otherwise an error, and the
+ *	listener will not be called.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_put_async(
+	aerospike * as, as_error * err, const as_policy_write * policy, 
+	const as_key * key, as_record * rec, as_async_write_listener listener, void * udata
+	);
+
+/**
+ *	Asynchronously remove a record from the cluster.  Removing a record that does
+ *	not exist is not an error.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if the command cannot be queued.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param listener		The function called when the command completes.
+ *	@param udata		User data passed to listener.
+ *
+ *	@return AEROSPIKE_OK if the command was queued. Otherwise an error, and the
+ *	listener will not be called.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_remove_async(
+	aerospike * as, as_error * err, const as_policy_remove * policy, 
+	const as_key * key, as_async_write_listener listener, void * udata
+	);
+
+/**
+ *	Asynchronously lookup a record by key, then perform specified operations.
+ *	The listener receives the bins of AS_OPERATOR_READ operations.
+ *
+ *	@param as			The aerospike instance to use for this operation.
+ *	@param err			The as_error to be populated if the command cannot be queued.
+ *	@param policy		The policy to use for this operation. If NULL, then the default policy will be used.
+ *	@param key			The key of the record.
+ *	@param ops			The operations to perform on the record.
+ *	@param listener		The function called when the command completes.
+ *	@param udata		User data passed to listener.
+ *
+ *	@return AEROSPIKE_OK if the command was queued. Otherwise an error, and the
+ *	listener will not be called.
+ *
+ *	@ingroup key_operations
+ */
+as_status aerospike_key_operate_async(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_key * key, const as_operations * ops,
+	as_async_record_listener listener, void * udata
+	);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
@@ -43,6 +43,12 @@ char *stpcpy(char * to, const char * from)
  */
 #define AS_ROLE_SIZE 32
 
+/**
+ *	@private
+ *	Size of the response to an authentication request.
+ */
+#define AS_AUTHENTICATE_RESPONSE_SIZE 24
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -257,6 +263,22 @@ aerospike_query_roles(aerospike* as, as_error* err, const as_policy_admin* polic
 void
 as_roles_destroy(as_role** roles, int roles_size);
 
+/**
+ *	@private
+ *	Write an authentication request into buffer, which must hold at least
+ *	AS_STACK_BUF_SIZE bytes.  Return the request size.
+ */
+uint32_t
+as_authenticate_set(const char* user, const char* credential, uint8_t* buffer);
+
+/**
+ *	@private
+ *	Return the result of an authentication response of
+ *	AS_AUTHENTICATE_RESPONSE_SIZE bytes, setting err if it failed.
+ */
+as_status
+as_authenticate_parse(as_error* err, uint8_t* buffer);
+
 /**
  *	@private
  *	Authenticate user with a server node.  This is done automatically after socket open.
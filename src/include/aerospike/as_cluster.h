@@ -25,6 +25,7 @@ extern "C" {
 #include <aerospike/as_partition.h>
 #include <aerospike/as_policy.h>
 #include <citrusleaf/cf_atomic.h>
+#include "ck_epoch.h"
 #include "ck_pr.h"
 
 /******************************************************************************
@@ -54,6 +55,47 @@ typedef struct as_seed_s {
 	in_port_t port;
 } as_seed;
 
+/**
+ *	Hedged read counters for a cluster.
+ */
+typedef struct as_hedge_stats_s {
+	/**
+	 *	Reads that were also sent to the prole because the master had not answered
+	 *	within as_policy_read.hedge_delay_us.
+	 */
+	uint32_t issued;
+	
+	/**
+	 *	Hedged reads that were answered first by the prole.
+	 */
+	uint32_t won;
+} as_hedge_stats;
+
+/**
+ *	Cluster tend cycle timings.
+ */
+typedef struct as_tend_stats_s {
+	/**
+	 *	Completed tend cycles.
+	 */
+	uint32_t count;
+	
+	/**
+	 *	Duration of the most recent tend cycle in microseconds.
+	 */
+	uint32_t last_us;
+	
+	/**
+	 *	Longest tend cycle in microseconds.
+	 */
+	uint32_t max_us;
+	
+	/**
+	 *	Total time spent in tend cycles in microseconds.
+	 */
+	uint64_t total_us;
+} as_tend_stats;
+
 /**
  *	@private
  *  Reference counted array of server node pointers.
@@ -89,6 +131,12 @@ typedef void (*as_release_fn) (void* value);
  *  Reference counted data to be garbage collected.
  */
 typedef struct as_gc_item_s {
+	/**
+	 *	@private
+	 *	Epoch deferral entry.
+	 */
+	ck_epoch_entry_t entry;
+	
 	/**
 	 *	@private
 	 *  Reference counted data to be garbage collected.
@@ -138,9 +186,10 @@ typedef struct as_cluster_s {
 	
 	/**
 	 *	@private
-	 *	Nodes to be garbage collected.
+	 *	Epoch record of the tend thread.  Data structures replaced by the tend
+	 *	thread are garbage collected through it.  See as_cluster_defer().
 	 */
-	as_vector* /* <as_gc_item> */ gc;
+	ck_epoch_record_t* gc;
 	
 	/**
 	 *	@private
@@ -148,6 +197,12 @@ typedef struct as_cluster_s {
 	 */
 	struct as_shm_info_s* shm_info;
 	
+	/**
+	 *	@private
+	 *	Async command event loops.
+	 */
+	struct as_event_loop_s* event_loops;
+	
 	/**
 	 *	@private
 	 *	User name in UTF-8 encoded bytes.
@@ -216,6 +271,12 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t conn_queue_size;
 	
+	/**
+	 *	@private
+	 *	Number of connections opened when a node is added and kept through idle trimming.
+	 */
+	uint32_t min_conns_per_node;
+	
 	/**
 	 *	@private
 	 *	Initial connection timeout in milliseconds.
@@ -228,12 +289,109 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t max_socket_idle;
 	
+	/**
+	 *	@private
+	 *	Maximum synchronous commands in flight per node.  Zero means no limit.
+	 */
+	uint32_t max_commands_per_node;
+	
+	/**
+	 *	@private
+	 *	Failure percentage that opens a node's circuit breaker.  Zero disables it.
+	 */
+	uint32_t breaker_error_percent;
+	
+	/**
+	 *	@private
+	 *	Commands per tend interval needed before a breaker can open.
+	 */
+	uint32_t breaker_min_commands;
+	
+	/**
+	 *	@private
+	 *	Milliseconds a breaker stays open before a probe.
+	 */
+	uint32_t breaker_open_ms;
+	
+	/**
+	 *	@private
+	 *	Number of threads that send tend info requests.  One or less tends
+	 *	nodes serially on the tend thread.
+	 */
+	uint32_t tend_threads_size;
+	
+	/**
+	 *	@private
+	 *	Tend cycles completed.
+	 */
+	uint32_t tend_count;
+	
+	/**
+	 *	@private
+	 *	Duration of the last tend cycle in microseconds.
+	 */
+	uint32_t tend_last_us;
+	
+	/**
+	 *	@private
+	 *	Longest tend cycle in microseconds.
+	 */
+	uint32_t tend_max_us;
+	
+	/**
+	 *	@private
+	 *	Total tend cycle time in microseconds.
+	 */
+	uint64_t tend_total_us;
+	
+	/**
+	 *	@private
+	 *	Partition map snapshot file.  Null when snapshots are disabled.
+	 */
+	char* snapshot_path;
+	
+	/**
+	 *	@private
+	 *	Signature of the node list and partition generations last written to the snapshot.
+	 */
+	uint64_t snapshot_signature;
+	
+	/**
+	 *	@private
+	 *	Node info fetches waiting for a tend pool thread.
+	 */
+	cf_queue* tend_q;
+	
+	/**
+	 *	@private
+	 *	Node info fetches completed by the tend pool.
+	 */
+	cf_queue* tend_complete_q;
+	
+	/**
+	 *	@private
+	 *	Tend pool threads.
+	 */
+	pthread_t* tend_threads;
+	
 	/**
 	 *	@private
 	 *	Random node index.
 	 */
 	uint32_t node_index;
 	
+	/**
+	 *	@private
+	 *	Reads sent to the prole after the hedge delay.
+	 */
+	uint32_t hedges_issued;
+	
+	/**
+	 *	@private
+	 *	Hedged reads answered first by the prole.
+	 */
+	uint32_t hedges_won;
+	
 	/**
 	 *	@private
 	 *	Batch initialize indicator.
@@ -252,6 +410,24 @@ typedef struct as_cluster_s {
 	 */
 	uint32_t query_initialized;
 	
+	/**
+	 *	@private
+	 *	Number of async command event loops.
+	 */
+	uint32_t event_loops_size;
+	
+	/**
+	 *	@private
+	 *	Round-robin index used to assign async commands to event loops.
+	 */
+	uint32_t event_loop_index;
+	
+	/**
+	 *	@private
+	 *	Async event loops initialize indicator.
+	 */
+	uint32_t event_initialized;
+	
 	/**
 	 *	@private
 	 *	Total number of data partitions used by cluster.
@@ -264,12 +440,30 @@ typedef struct as_cluster_s {
 	 */
 	volatile bool valid;
 	
+	/**
+	 *	@private
+	 *	Pipeline async commands to the same node on one socket.
+	 */
+	bool async_pipeline;
+	
+	/**
+	 *	@private
+	 *	Let threads cache one connection per node.
+	 */
+	bool thread_conn_cache;
+	
 	/**
 	 *	@private
 	 *	Batch transaction lock.
 	 */
 	pthread_mutex_t	batch_init_lock;
 	
+	/**
+	 *	@private
+	 *	Async event loops initialize lock.
+	 */
+	pthread_mutex_t	event_init_lock;
+	
 	/**
 	 *	@private
 	 *	Cluster tend thread.
@@ -323,6 +517,57 @@ as_cluster_is_connected(as_cluster* cluster);
 void
 as_cluster_get_node_names(as_cluster* cluster, int* n_nodes, char** node_names);
 
+/**
+ *	Get hedged read counters for the cluster.
+ */
+void
+as_cluster_get_hedge_stats(as_cluster* cluster, as_hedge_stats* stats);
+
+/**
+ *	Get tend cycle timings for the cluster.
+ */
+void
+as_cluster_get_tend_stats(as_cluster* cluster, as_tend_stats* stats);
+
+/**
+ *	@private
+ *	Read the partition map snapshot at snapshot_path.  On success, set n_partitions and
+ *	the partition tables, append the snapshot's nodes to nodes_to_add and return true.
+ *	Return false and leave the cluster unchanged if there is no usable snapshot.
+ */
+bool
+as_cluster_snapshot_load(as_cluster* cluster, as_vector* /* <as_node*> */ nodes_to_add);
+
+/**
+ *	@private
+ *	Write the node list and partition tables to snapshot_path if they changed since the
+ *	last write.  Called by the tend thread.
+ */
+void
+as_cluster_snapshot_save(as_cluster* cluster);
+
+/**
+ *	@private
+ *	Epoch shared by all clusters.  Threads read cluster data structures that the
+ *	tend thread may replace, such as partition table arrays, inside epoch sections.
+ */
+extern ck_epoch_t as_cluster_epoch;
+
+/**
+ *	@private
+ *	Get the calling thread's epoch record, registering it on first use.
+ */
+ck_epoch_record_t*
+as_cluster_epoch_record();
+
+/**
+ *	@private
+ *	Release data once no thread can still be in an epoch section that saw it.
+ *	Must only be called by the thread that tends the cluster.
+ */
+void
+as_cluster_defer(as_cluster* cluster, void* data, as_release_fn release_fn);
+
 /**
  *	Reserve reference counted access to cluster nodes.
  */
@@ -361,11 +606,20 @@ as_cluster_change_password(as_cluster* cluster, const char* user, const char* pa
 /**
  *	@private
  *	Get random node in the cluster.
- *	as_nodes_release() must be called when done with node.
+ *	as_node_release() must be called when done with node.
  */
 as_node*
 as_node_get_random(as_cluster* cluster);
 
+/**
+ *	@private
+ *	Get random active node in the cluster, or NULL if there is none.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
+ */
+as_node*
+as_node_choose_random(as_cluster* cluster);
+
 /**
  *	@private
  *	Get node given node name.
@@ -404,18 +658,20 @@ as_partition_tables_release(as_partition_tables* tables)
 
 /**
  *	@private
- *	Get partition table given namespace.
+ *	Get partition table given namespace and its interned id.  Zero id resolves
+ *	by namespace string.
  */
 static inline as_partition_table*
-as_cluster_get_partition_table(as_cluster* cluster, const char* ns)
+as_cluster_get_partition_table(as_cluster* cluster, const char* ns, uint32_t ns_id)
 {
-	// Partition tables array size does not currently change after first cluster tend.
-	// Also, there is a one second delayed garbage collection coupled with as_partition_tables_get()
-	// being very fast.  Reference counting the tables array is not currently necessary, but do it
-	// anyway in case the server starts supporting dynamic namespaces.
-	as_partition_tables* tables = as_partition_tables_reserve(cluster);
-	as_partition_table* table = as_partition_tables_get(tables, ns);
-	as_partition_tables_release(tables);
+	// Replaced tables arrays are released through the cluster epoch, so an epoch section
+	// protects the lookup without writing to a counter shared by every command.  Tables
+	// themselves live until the cluster is destroyed.
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_partition_tables* tables = (as_partition_tables *)ck_pr_load_ptr(&cluster->partition_tables);
+	as_partition_table* table = as_partition_tables_get_id(tables, ns, ns_id);
+	ck_epoch_end(&as_cluster_epoch, record);
 	return table;
 }
 
@@ -423,36 +679,119 @@ as_cluster_get_partition_table(as_cluster* cluster, const char* ns)
  *	@private
  *	Get mapped node given digest key and partition table.  If there is no mapped node, a random
  *	node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
  */
 as_node*
 as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const cf_digest* d, bool write, as_policy_replica replica);
 
+/**
+ *	@private
+ *	Get active prole node given digest key and partition table.  Return NULL if the partition has
+ *	no active prole.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
+ */
+as_node*
+as_partition_table_get_prole(as_cluster* cluster, as_partition_table* table, const cf_digest* d);
+
 /**
  *	@private
  *	Get shared memory mapped node given digest key.  If there is no mapped node, a random node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
+ */
+as_node*
+as_shm_node_get(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d, bool write, as_policy_replica replica);
+
+/**
+ *	@private
+ *	Get shared memory mapped active prole node given digest key.  Return NULL if the partition
+ *	has no active prole.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
  */
 as_node*
-as_shm_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool write, as_policy_replica replica);
+as_shm_node_get_prole(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d);
 
 /**
  *	@private
  *	Get mapped node given digest key.  If there is no mapped node, a random node is used instead.
- *	as_nodes_release() must be called when done with node.
+ *	ns_id is the interned id of ns (see as_namespace_intern()) or zero if unknown.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
+ *	Nodes are freed through the epoch, so routing a command costs no shared write.
  */
 static inline as_node*
-as_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool write, as_policy_replica replica)
+as_node_get(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d, bool write, as_policy_replica replica)
 {
 	if (cluster->shm_info) {
-		return as_shm_node_get(cluster, ns, d, write, replica);
+		return as_shm_node_get(cluster, ns, ns_id, d, write, replica);
 	}
 	else {
-		as_partition_table* table = as_cluster_get_partition_table(cluster, ns);
+		as_partition_table* table = as_cluster_get_partition_table(cluster, ns, ns_id);
 		return as_partition_table_get_node(cluster, table, d, write, replica);
 	}
 }
 
+/**
+ *	@private
+ *	Get active prole node given digest key.  Return NULL if the partition has no active prole.
+ *	Must be called inside an as_cluster_epoch section.  The node is not reserved and
+ *	stays valid until the section ends.
+ */
+static inline as_node*
+as_node_get_prole(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d)
+{
+	if (cluster->shm_info) {
+		return as_shm_node_get_prole(cluster, ns, ns_id, d);
+	}
+	else {
+		as_partition_table* table = as_cluster_get_partition_table(cluster, ns, ns_id);
+		return as_partition_table_get_prole(cluster, table, d);
+	}
+}
+
+/**
+ *	@private
+ *	Get and reserve mapped node given digest key, for commands that use the node outside
+ *	the calling thread's epoch section, such as async and batch node commands.
+ *	as_node_release() must be called when done with node.
+ */
+static inline as_node*
+as_node_get_reserved(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d, bool write, as_policy_replica replica)
+{
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_node* node = as_node_get(cluster, ns, ns_id, d, write, replica);
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	ck_epoch_end(&as_cluster_epoch, record);
+	return node;
+}
+
+/**
+ *	@private
+ *	Get and reserve active prole node given digest key.  Return NULL if the partition has no
+ *	active prole.
+ *	as_node_release() must be called when done with node.
+ */
+static inline as_node*
+as_node_get_prole_reserved(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d)
+{
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_node* node = as_node_get_prole(cluster, ns, ns_id, d);
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	ck_epoch_end(&as_cluster_epoch, record);
+	return node;
+}
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
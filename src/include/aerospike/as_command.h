@@ -23,12 +23,14 @@ extern "C" {
 #include <aerospike/as_bin.h>
 #include <aerospike/as_buffer.h>
 #include <aerospike/as_cluster.h>
+#include <aerospike/as_command_buffer.h>
 #include <aerospike/as_key.h>
 #include <aerospike/as_operations.h>
 #include <aerospike/as_proto.h>
 #include <aerospike/as_record.h>
 #include <citrusleaf/cf_byte_order.h>
 #include <citrusleaf/cf_digest.h>
+#include <sys/uio.h>
 
 /******************************************************************************
  *	MACROS
@@ -87,6 +89,14 @@ extern "C" {
 #define AS_MESSAGE_VERSION 2L
 #define AS_MESSAGE_TYPE 3L
 
+/**
+ *	@private
+ *	Largest single record response accepted.  A larger size means the socket is
+ *	out of sync with the server, for example a stale pooled socket holding the
+ *	remains of an earlier response.
+ */
+#define AS_MESSAGE_SIZE_MAX (128 * 1024 * 1024)
+
 // Info message
 #define AS_INFO_MESSAGE_VERSION 2L
 #define AS_INFO_MESSAGE_TYPE 1L
@@ -100,15 +110,22 @@ extern "C" {
 
 /**
  *	@private
- *	Allocate command buffer on stack or heap depending on given size.
+ *	Bin values at least this large are sent straight from the caller's memory by
+ *	as_command_write_bin_iov() instead of being copied into the command buffer.
  */
-#define as_command_init(_sz) (_sz > AS_STACK_BUF_SIZE)? (uint8_t*)cf_malloc(_sz) : (uint8_t*)alloca(_sz)
+#define AS_COMMAND_ZERO_COPY_MIN (1024 * 4)
 
 /**
  *	@private
- *	Free command buffer.
+ *	Get command buffer from the calling thread's command buffer arena.
  */
-#define as_command_free(_buf, _sz) if (_sz > AS_STACK_BUF_SIZE) {cf_free(_buf);}
+#define as_command_init(_sz) as_command_buffer_get(_sz)
+
+/**
+ *	@private
+ *	Return command buffer to the calling thread's command buffer arena.
+ */
+#define as_command_free(_buf, _sz) as_command_buffer_release(_buf)
 
 /******************************************************************************
  *	TYPES
@@ -122,11 +139,50 @@ typedef struct as_command_node_s {
 	as_node* node;
 	as_cluster* cluster;
 	const char* ns;
+	uint32_t ns_id;
 	const cf_digest* digest;
 	as_policy_replica replica;
 	bool write;
+	
+	/**
+	 *	Reads resolved through the partition map are also sent to the prole if
+	 *	the master has not answered within this many microseconds.  Zero disables.
+	 */
+	uint32_t hedge_delay_us;
 } as_command_node;
 
+/**
+ *	@private
+ *	Command made of fragments of the command buffer and of large bin values that
+ *	are referenced in place.  See as_command_write_bin_iov().
+ */
+typedef struct as_command_iov_s {
+	/**
+	 *	Fragments.  Room for two per referenced value plus one is required.
+	 */
+	struct iovec* list;
+	
+	/**
+	 *	Number of fragments.
+	 */
+	uint32_t size;
+	
+	/**
+	 *	Command buffer.
+	 */
+	uint8_t* begin;
+	
+	/**
+	 *	Start of the command buffer fragment being written.
+	 */
+	uint8_t* frag;
+	
+	/**
+	 *	Bytes in completed fragments.
+	 */
+	size_t len;
+} as_command_iov;
+
 /**
  *	@private
  *	Parse results callback used in as_command_execute().
@@ -181,6 +237,15 @@ as_command_bin_size(const as_bin* bin, as_buffer* buffer)
 	return strlen(bin->name) + as_command_value_size((as_val*)bin->valuep, buffer) + 8;
 }
 
+/**
+ *	@private
+ *	Calculate size of bin name and value in the command buffer when written by
+ *	as_command_write_bin_iov().  n_refs is incremented if the value is referenced
+ *	in place.
+ */
+size_t
+as_command_bin_size_iov(const as_bin* bin, as_buffer* buffer, uint32_t* n_refs);
+
 /**
  *	@private
  *	Calculate size of bin name.  Return error is bin name greater than 14 characters.
@@ -375,12 +440,36 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 
 /**
  *	@private
- *	Finish writing command.
+ *	Start command made of fragments.  list must have room for two fragments per
+ *	referenced value plus one.
  */
-static inline size_t
-as_command_write_end(uint8_t* begin, uint8_t* end)
+static inline void
+as_command_iov_init(as_command_iov* iov, struct iovec* list, uint8_t* begin)
+{
+	iov->list = list;
+	iov->size = 0;
+	iov->begin = begin;
+	iov->frag = begin;
+	iov->len = 0;
+}
+
+/**
+ *	@private
+ *	Write bin.  Values of AS_COMMAND_ZERO_COPY_MIN bytes or more are not copied.
+ *	They are added to iov as a reference, so they must stay valid until the
+ *	command has been sent.
+ */
+uint8_t*
+as_command_write_bin_iov(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer,
+	as_command_iov* iov);
+
+/**
+ *	@private
+ *	Write proto header for a command of len bytes.
+ */
+static inline void
+as_command_write_proto(uint8_t* begin, uint64_t len)
 {
-	uint64_t len = end - begin;
 	uint64_t proto = (len - 8) | (AS_MESSAGE_VERSION << 56) | (AS_MESSAGE_TYPE << 48);
 #ifndef __hpux
 	*(uint64_t*)begin = cf_swap_to_be64(proto);
@@ -388,9 +477,52 @@ as_command_write_end(uint8_t* begin, uint8_t* end)
 	proto = cf_swap_to_be64(proto);
 	memcpy((uint64_t*)begin, &proto, sizeof(uint64_t));
 #endif
+}
+
+/**
+ *	@private
+ *	Return whether a proto header, already swapped from big endian, can start a
+ *	single record response.  Check before sizing a buffer from the header, so a
+ *	corrupt or hostile header cannot request a huge allocation.
+ */
+static inline bool
+as_command_valid_proto(const as_proto* proto)
+{
+	size_t total = sizeof(as_proto) + proto->sz;
+	return proto->version == AS_MESSAGE_VERSION && proto->type == AS_MESSAGE_TYPE &&
+		total >= sizeof(as_proto_msg) && total <= AS_MESSAGE_SIZE_MAX;
+}
+
+/**
+ *	@private
+ *	Finish writing command.
+ */
+static inline size_t
+as_command_write_end(uint8_t* begin, uint8_t* end)
+{
+	uint64_t len = end - begin;
+	as_command_write_proto(begin, len);
 	return len;
 }
 
+/**
+ *	@private
+ *	Finish writing command made of fragments.  Return total command size.
+ */
+static inline size_t
+as_command_iov_end(as_command_iov* iov, uint8_t* end)
+{
+	if (end > iov->frag) {
+		struct iovec* frag = &iov->list[iov->size++];
+		frag->iov_base = iov->frag;
+		frag->iov_len = end - iov->frag;
+		iov->len += frag->iov_len;
+		iov->frag = end;
+	}
+	as_command_write_proto(iov->begin, iov->len);
+	return iov->len;
+}
+
 /**
  *	@private
  *	Send command to the server.
@@ -400,6 +532,16 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
    uint32_t timeout_ms, as_policy_retry retry,
    as_parse_results_fn parse_results_fn, void* parse_results_data);
 
+/**
+ *	@private
+ *	Send command made of iovcnt fragments to the server.  The first fragment must
+ *	hold the command header.
+ */
+as_status
+as_command_execute_iov(as_error * err, as_command_node* cn, struct iovec* iov, int iovcnt,
+   uint32_t timeout_ms, as_policy_retry retry,
+   as_parse_results_fn parse_results_fn, void* parse_results_data);
+
 /**
  *	@private
  *	Parse header of server response.
@@ -414,6 +556,23 @@ as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_
 as_status
 as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
 
+/**
+ *	@private
+ *	Parse server record into a response buffer owned by the record.  String and
+ *	bytes bins reference the buffer instead of being copied.  Used for reads
+ *	with as_policy_read.zero_copy.
+ */
+as_status
+as_command_parse_result_zero_copy(as_error* err, int fd, uint64_t deadline_ms, void* user_data);
+
+/**
+ *	@private
+ *	Parse server record that has already been read.  msg must already be swapped
+ *	to host byte order and buf must point to the fields that follow it.
+ */
+as_status
+as_command_parse_record(as_error* err, as_msg* msg, uint8_t* buf, as_record** record);
+
 /**
  *	@private
  *	Parse server success or failure result.
@@ -435,6 +594,15 @@ as_command_parse_success_failure_bins(uint8_t* p, as_error* err, as_msg* msg, as
 uint8_t*
 as_command_parse_bins(as_record* rec, uint8_t* buf, uint32_t n_bins, bool deserialize);
 
+/**
+ *	@private
+ *	Parse bins into the record's preallocated bin entries.  If end is not null,
+ *	string and bytes values reference the message, which ends at end, instead
+ *	of being copied.  The byte past end must be writable.
+ */
+uint8_t*
+as_command_parse_bins_borrow(as_record* rec, uint8_t* buf, uint32_t n_bins, bool deserialize, uint8_t* end);
+
 /**
  *	@private
  *	Skip over fields section in returned data.
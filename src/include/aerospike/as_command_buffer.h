@@ -0,0 +1,83 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Command buffer arena statistics, summed over all threads that have built
+ *	commands, including threads that have since exited.
+ */
+typedef struct as_command_buffer_stats_s {
+	/**
+	 *	Bytes of command buffers served from memory the thread already held.
+	 */
+	uint64_t reused;
+
+	/**
+	 *	Bytes requested from the allocator because no held buffer was large
+	 *	enough or all of the thread's buffers were in use.
+	 */
+	uint64_t allocated;
+
+	/**
+	 *	Bytes given back to the allocator by shrinking buffers to their recent
+	 *	high-water mark.
+	 */
+	uint64_t trimmed;
+} as_command_buffer_stats;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Get a command buffer of at least size bytes from the calling thread's arena.
+ *	The buffer must be released with as_command_buffer_release() on the same
+ *	thread.  Nested requests are served from further arena slots and fall back
+ *	to the heap once all slots are busy.
+ */
+uint8_t*
+as_command_buffer_get(size_t size);
+
+/**
+ *	@private
+ *	Return a buffer obtained from as_command_buffer_get().  A null buffer is
+ *	ignored.
+ */
+void
+as_command_buffer_release(uint8_t* buf);
+
+/**
+ *	Get command buffer arena statistics.
+ */
+void
+as_command_buffer_get_stats(as_command_buffer_stats* stats);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -274,16 +274,76 @@ typedef struct as_config_s {
 	
 	/**
 	 *	Estimate of incoming threads concurrently using synchronous methods in the client instance.
-	 *	This field is used to size the synchronous connection pool for each server node.
+	 *	This field is used to size the synchronous connection pool for each server node when
+	 *	max_conns_per_node is zero.
 	 *	Default: 300
 	 */
 	uint32_t max_threads;
 	
 	/**
-	 *	@private
-	 *	Not currently used.
-	 *	Maximum socket idle in seconds.  Socket connection pools will discard sockets
-	 *	that have been idle longer than the maximum.
+	 *	Minimum number of connections to keep open to each server node.  The pool is filled
+	 *	to this size when a node is added to the cluster, so the first commands after startup
+	 *	do not pay for connect and authentication.  The tend thread does not close idle
+	 *	connections below this number.
+	 *	Default: 0
+	 */
+	uint32_t min_conns_per_node;
+	
+	/**
+	 *	Maximum number of idle connections pooled for each server node.  Connections returned
+	 *	to a full pool are closed.  Zero means max_threads + 1.
+	 *	Default: 0
+	 */
+	uint32_t max_conns_per_node;
+	
+	/**
+	 *	Let each application thread keep one connection per node for itself, in
+	 *	addition to the shared per-node pools.  A thread that issues commands
+	 *	back-to-back to the same node then reuses its own socket without touching
+	 *	the shared pool.  Cached connections are held until the thread exits or
+	 *	the node leaves the cluster, so enable this only when application threads
+	 *	are long lived.
+	 *	Default: false
+	 */
+	bool thread_conn_cache;
+	
+	/**
+	 *	Maximum number of synchronous commands in flight to each server node, counted from
+	 *	the time a command asks for a connection until its response has been read.
+	 *	Commands beyond the limit fail with AEROSPIKE_ERR_MAX_COMMANDS instead of piling
+	 *	onto a slow node, unless they are reads that can be sent to another replica.
+	 *	Zero means no limit.
+	 *	Default: 0
+	 */
+	uint32_t max_commands_per_node;
+	
+	/**
+	 *	Open a node's circuit breaker when at least this percentage of its commands in a
+	 *	tend interval timed out, failed to connect or were rejected as busy.  While open,
+	 *	commands to the node fail with AEROSPIKE_ERR_CIRCUIT_OPEN, or reads are sent to
+	 *	another replica.  Zero disables the breaker.
+	 *	Default: 0
+	 */
+	uint32_t breaker_error_percent;
+	
+	/**
+	 *	Minimum number of commands in a tend interval before the breaker can open.
+	 *	Default: 20
+	 */
+	uint32_t breaker_min_commands;
+	
+	/**
+	 *	Milliseconds a breaker stays open before one probe command is let through.  The
+	 *	breaker closes if the probe succeeds and opens again if it fails.
+	 *	Default: 1000
+	 */
+	uint32_t breaker_open_ms;
+	
+	/**
+	 *	Maximum socket idle in seconds.  The cluster tend thread closes pooled sockets
+	 *	that have been idle longer than the maximum.  Keep this below the server's
+	 *	proto-fd-idle-ms so the client closes idle sockets before the server does.
+	 *	Set to 0 to keep idle sockets open indefinitely.
 	 *	Default: 14
 	 */
 	uint32_t max_socket_idle_sec;
@@ -300,6 +360,37 @@ typedef struct as_config_s {
 	 *	Default: 1000
 	 */
 	uint32_t tender_interval;
+	
+	/**
+	 *	Number of threads the cluster tender uses to send info requests to nodes.
+	 *	The requests of a tend cycle go out concurrently, so one slow or dead node
+	 *	delays the cycle by at most one connection timeout instead of delaying every
+	 *	node tended after it.  Zero or one tends nodes one after another on the
+	 *	tender thread.
+	 *	Default: 4
+	 */
+	uint32_t tend_threads;
+	
+	/**
+	 *	Number of client owned event loop threads that drive asynchronous commands
+	 *	like aerospike_key_get_async().  The loops are started by the first async
+	 *	command.  Zero disables asynchronous commands.
+	 *	Default: 1
+	 */
+	uint32_t event_loops;
+	
+	/**
+	 *	Pipeline async commands.  When true, async commands for the same node that
+	 *	run on the same event loop are written back-to-back on one socket and their
+	 *	responses are matched in order, instead of each command borrowing its own
+	 *	socket.  This cuts connection count and per-command round trips for bulk
+	 *	loads and fan-out reads.  A pipelined command that times out while older
+	 *	commands are still waiting on the same socket is reported to its listener
+	 *	right away; a timeout at the head of the pipe closes the socket and fails
+	 *	the commands queued behind it.
+	 *	Default: false
+	 */
+	bool async_pipeline;
 
 	/**
 	 *	Count of entries in hosts array.
@@ -334,6 +425,19 @@ typedef struct as_config_s {
 	 */
 	bool fail_if_not_connected;
 	
+	/**
+	 *	File where the cluster tender keeps a snapshot of the node list and partition
+	 *	maps.  When the file exists, aerospike_connect() routes from the snapshot right
+	 *	away instead of waiting for the cluster to be discovered, as soon as one of the
+	 *	saved nodes answers.  If none does, the snapshot is dropped and the cluster is
+	 *	discovered from the seeds, so fail_if_not_connected applies as usual.  The first
+	 *	tend checks each node's partition generation against the snapshot and fetches
+	 *	maps that changed, and nodes that no longer answer are removed as usual.  A
+	 *	snapshot that cannot be read is ignored.  Not used with shared memory.
+	 *	Default: empty (no snapshot)
+	 */
+	char snapshot_path[AS_CONFIG_PATH_MAX_SIZE];
+	
 	/**
 	 *	Indicates if shared memory should be used for cluster tending.  Shared memory
 	 *	is useful when operating in single threaded mode with multiple client processes.
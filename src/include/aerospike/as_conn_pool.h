@@ -0,0 +1,161 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ck_cc.h>
+#include <ck_pr.h>
+#include <ck_stack.h>
+
+#if !defined(CK_F_STACK_POP_MPMC)
+#include <citrusleaf/cf_queue.h>
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Pooled socket.  Entries are preallocated and move between the pool's stack of
+ *	idle sockets and its stack of unused entries, so they are never freed while
+ *	the pool is in use.
+ */
+typedef struct as_conn_pool_entry_s {
+	/**
+	 *	@private
+	 *	Stack link.  Must be first.
+	 */
+	ck_stack_entry_t link;
+
+	/**
+	 *	@private
+	 *	Time the socket was last returned to the pool in milliseconds.
+	 */
+	uint64_t last_used;
+	
+	/**
+	 *	@private
+	 *	Socket file descriptor.
+	 */
+	int fd;
+} as_conn_pool_entry;
+
+/**
+ *	@private
+ *	Bounded pool of idle sockets to one node.
+ *
+ *	Where the platform has a double-width compare-and-swap, the pool is a pair of
+ *	lock-free Concurrency Kit stacks and get/put never take a lock.  Elsewhere the
+ *	pool falls back to a locked cf_queue.
+ */
+typedef struct as_conn_pool_s {
+#if defined(CK_F_STACK_POP_MPMC)
+	/**
+	 *	@private
+	 *	Entries holding idle sockets, most recently used first.
+	 */
+	ck_stack_t idle CK_CC_CACHELINE;
+
+	/**
+	 *	@private
+	 *	Entries not holding a socket.
+	 */
+	ck_stack_t unused CK_CC_CACHELINE;
+
+	/**
+	 *	@private
+	 *	Number of idle sockets.  May briefly count a socket still being pushed.
+	 */
+	uint32_t size;
+
+	/**
+	 *	@private
+	 *	Entry storage.
+	 */
+	as_conn_pool_entry* entries;
+#else
+	/**
+	 *	@private
+	 *	Idle sockets as as_conn_pool_entry, oldest first.
+	 */
+	cf_queue* queue;
+#endif
+
+	/**
+	 *	@private
+	 *	Maximum number of idle sockets.
+	 */
+	uint32_t capacity;
+} as_conn_pool;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Initialize empty pool that holds up to capacity sockets.
+ */
+void
+as_conn_pool_init(as_conn_pool* pool, uint32_t capacity);
+
+/**
+ *	@private
+ *	Close all idle sockets and free pool resources.  No other thread may be
+ *	using the pool.
+ */
+void
+as_conn_pool_destroy(as_conn_pool* pool);
+
+/**
+ *	@private
+ *	Pop idle socket.  Sockets last used more than max_idle_ms ago are closed
+ *	instead of returned.  A max_idle_ms of zero returns any socket.  Return false
+ *	if the pool has no socket to return.
+ */
+bool
+as_conn_pool_get(as_conn_pool* pool, uint64_t max_idle_ms, int* fd);
+
+/**
+ *	@private
+ *	Push idle socket and stamp it with the current time.  Return false if the
+ *	pool is full, in which case the caller still owns the socket.
+ */
+bool
+as_conn_pool_put(as_conn_pool* pool, int fd);
+
+/**
+ *	@private
+ *	Close idle sockets last used more than max_idle_ms ago while the pool holds
+ *	more than min_idle sockets, and never the last one.  Stale sockets below
+ *	sockets in recent use are closed too, and the sockets kept stay in order.
+ *	A max_idle_ms of zero closes nothing.
+ *	idle is set to the number of sockets left in the pool.  Return the number of
+ *	sockets closed.
+ */
+uint32_t
+as_conn_pool_trim(as_conn_pool* pool, uint64_t max_idle_ms, uint32_t min_idle, uint32_t* idle);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -0,0 +1,426 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_vector.h>
+#include <citrusleaf/cf_digest.h>
+#include <citrusleaf/cf_queue.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *	MACROS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Async command response types.
+ */
+#define AS_ASYNC_TYPE_RECORD 0
+#define AS_ASYNC_TYPE_WRITE 1
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	Callback for asynchronous commands that return a record.
+ *
+ *	On success, err is NULL and record holds the result.  The record is destroyed
+ *	when the callback returns, so reserve it with as_val_reserve() if it must
+ *	outlive the callback.  On failure, err is populated and record is NULL.
+ *
+ *	The callback runs on a client event loop thread and must not block.
+ */
+typedef void (*as_async_record_listener)(as_error* err, as_record* record, void* udata);
+
+/**
+ *	Callback for asynchronous commands that do not return a record.
+ *
+ *	On success, err is NULL.  On failure, err is populated.
+ *
+ *	The callback runs on a client event loop thread and must not block.
+ */
+typedef void (*as_async_write_listener)(as_error* err, void* udata);
+
+struct as_cluster_s;
+struct as_node_s;
+struct as_event_command_s;
+struct as_event_pipe_s;
+struct as_event_connector_s;
+
+/**
+ *	@private
+ *	Client owned event loop.  Each loop is a thread that multiplexes the sockets
+ *	of its in-flight async commands.
+ */
+typedef struct as_event_loop_s {
+	/**
+	 *	@private
+	 *	Commands submitted by application threads, waiting to be started.
+	 */
+	cf_queue* queue;
+	
+	/**
+	 *	@private
+	 *	In-flight commands.  Only accessed by the event loop thread.
+	 */
+	struct as_event_command_s* head;
+	
+	/**
+	 *	@private
+	 *	Open pipelined connections, one per node with pending commands.
+	 *	Only accessed by the event loop thread.
+	 */
+	as_vector pipes;
+	
+	/**
+	 *	@private
+	 *	New connections being authenticated.  Only accessed by the event loop
+	 *	thread.
+	 */
+	as_vector connectors;
+	
+	/**
+	 *	@private
+	 *	Event loop thread.
+	 */
+	pthread_t thread;
+	
+	/**
+	 *	@private
+	 *	Readiness notification descriptor.
+	 */
+	int poll_fd;
+	
+	/**
+	 *	@private
+	 *	Descriptor used to wake up the loop when commands are queued.
+	 */
+	int wakeup_fd;
+	
+	/**
+	 *	@private
+	 *	Set when the loop should fail outstanding commands and exit, and by the
+	 *	loop itself when it fails.  Commands queued once it is set are failed
+	 *	by the thread that queues them.
+	 */
+	volatile bool closing;
+} as_event_loop;
+
+/**
+ *	@private
+ *	Pipelined connection.  Commands for the same node started on the same event
+ *	loop are written back-to-back on one socket and their responses are read in
+ *	the order the commands were written.  The pipe exists only while it has
+ *	commands queued; the socket is then returned to the node's pool.
+ */
+typedef struct as_event_pipe_s {
+	/**
+	 *	@private
+	 *	Event loop that owns the pipe.
+	 */
+	as_event_loop* event_loop;
+	
+	/**
+	 *	@private
+	 *	Reserved node the socket is connected to.
+	 */
+	struct as_node_s* node;
+	
+	/**
+	 *	@private
+	 *	Commands waiting to be written.  The head may be partially written.
+	 */
+	struct as_event_command_s* writer_head;
+	struct as_event_command_s* writer_tail;
+	
+	/**
+	 *	@private
+	 *	Written commands waiting for their response, oldest first.
+	 */
+	struct as_event_command_s* reader_head;
+	struct as_event_command_s* reader_tail;
+	
+	/**
+	 *	@private
+	 *	Login in progress on fd, or NULL once the socket can carry commands.
+	 */
+	struct as_event_connector_s* connector;
+	
+	/**
+	 *	@private
+	 *	Socket borrowed from the node's connection pool.
+	 */
+	int fd;
+	
+	/**
+	 *	@private
+	 *	Readiness events currently registered for fd.
+	 */
+	uint32_t events;
+} as_event_pipe;
+
+/**
+ *	@private
+ *	Asynchronous command.  The command buffer is written to the socket and then
+ *	reused to hold the response.
+ */
+typedef struct as_event_command_s {
+	/**
+	 *	@private
+	 *	In-flight list links.
+	 */
+	struct as_event_command_s* prev;
+	struct as_event_command_s* next;
+	
+	/**
+	 *	@private
+	 *	Event loop that owns the command once submitted.
+	 */
+	as_event_loop* event_loop;
+	
+	/**
+	 *	@private
+	 *	Cluster the command is routed through.
+	 */
+	struct as_cluster_s* cluster;
+	
+	/**
+	 *	@private
+	 *	Reserved node the command is sent to.
+	 */
+	struct as_node_s* node;
+	
+	/**
+	 *	@private
+	 *	Pipelined connection the command is queued on, or NULL if the command
+	 *	has a socket of its own.
+	 */
+	as_event_pipe* pipe;
+	
+	/**
+	 *	@private
+	 *	Next command in the pipe's writer or reader queue.
+	 */
+	struct as_event_command_s* pipe_next;
+	
+	/**
+	 *	@private
+	 *	Login in progress on the command's new socket, or NULL.
+	 */
+	struct as_event_connector_s* connector;
+	
+	/**
+	 *	@private
+	 *	Command buffer, then response buffer.
+	 */
+	uint8_t* buf;
+	
+	/**
+	 *	@private
+	 *	Allocated size of buf.
+	 */
+	size_t capacity;
+	
+	/**
+	 *	@private
+	 *	Bytes to write, then bytes to read.
+	 */
+	size_t len;
+	
+	/**
+	 *	@private
+	 *	Bytes written or read so far.
+	 */
+	size_t pos;
+	
+	/**
+	 *	@private
+	 *	Command size, kept so the command can be resent on a new connection.
+	 */
+	size_t write_len;
+	
+	/**
+	 *	@private
+	 *	Absolute deadline in milliseconds.  Zero means no deadline.
+	 */
+	uint64_t deadline_ms;
+	
+	/**
+	 *	@private
+	 *	User callback.
+	 */
+	union {
+		as_async_record_listener record;
+		as_async_write_listener write;
+	} listener;
+	
+	/**
+	 *	@private
+	 *	User data passed to callback.
+	 */
+	void* udata;
+	
+	/**
+	 *	@private
+	 *	Socket borrowed from the node's connection pool, or the pipe's socket.
+	 */
+	int fd;
+	
+	/**
+	 *	@private
+	 *	Response type (AS_ASYNC_TYPE_*).
+	 */
+	uint8_t type;
+	
+	/**
+	 *	@private
+	 *	Is command still writing.
+	 */
+	bool writing;
+	
+	/**
+	 *	@private
+	 *	Treat AEROSPIKE_ERR_RECORD_NOT_FOUND as success.
+	 */
+	bool not_found_ok;
+	
+	/**
+	 *	@private
+	 *	Pipelined command whose listener has already been called with a timeout.
+	 *	The response is still read off the pipe, then discarded.
+	 */
+	bool timed_out;
+	
+	/**
+	 *	@private
+	 *	Socket was taken from the connection pool without a liveness check.
+	 */
+	bool reused;
+} as_event_command;
+
+/**
+ *	@private
+ *	Login on a new connection, driven by the event loop so opening a connection
+ *	never blocks it.  The connection belongs to a command or a pipe, which is
+ *	started once the server accepts the login.
+ */
+typedef struct as_event_connector_s {
+	/**
+	 *	@private
+	 *	Event loop that drives the login.
+	 */
+	as_event_loop* event_loop;
+	
+	/**
+	 *	@private
+	 *	Command that owns the connection, or NULL.
+	 */
+	as_event_command* cmd;
+	
+	/**
+	 *	@private
+	 *	Pipe that owns the connection, or NULL.
+	 */
+	as_event_pipe* pipe;
+	
+	/**
+	 *	@private
+	 *	Login request, then login response.
+	 */
+	uint8_t* buf;
+	
+	/**
+	 *	@private
+	 *	Bytes to write, then bytes to read.
+	 */
+	size_t len;
+	
+	/**
+	 *	@private
+	 *	Bytes written or read so far.
+	 */
+	size_t pos;
+	
+	/**
+	 *	@private
+	 *	Absolute deadline in milliseconds for the login.
+	 */
+	uint64_t deadline_ms;
+	
+	/**
+	 *	@private
+	 *	Owner's socket.
+	 */
+	int fd;
+	
+	/**
+	 *	@private
+	 *	Is login request still writing.
+	 */
+	bool writing;
+} as_event_connector;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Allocate an async command with a command buffer of the given size.
+ */
+as_event_command*
+as_event_command_create(struct as_cluster_s* cluster, size_t size, uint32_t timeout_ms);
+
+/**
+ *	@private
+ *	Free async command that was never submitted.
+ */
+void
+as_event_command_destroy(as_event_command* cmd);
+
+/**
+ *	@private
+ *	Route command to a node and queue the command on an event loop, which picks
+ *	its connection.  If an error is returned, the command has been destroyed and
+ *	the listener will not be called.
+ */
+as_status
+as_event_command_execute(as_event_command* cmd, as_error* err, const char* ns,
+	uint32_t ns_id, const cf_digest* digest, as_policy_replica replica, bool write);
+
+/**
+ *	@private
+ *	Stop event loops.  Outstanding commands are failed with AEROSPIKE_ERR_CLIENT.
+ */
+void
+as_event_loops_shutdown(struct as_cluster_s* cluster);
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
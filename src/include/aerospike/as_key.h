@@ -23,6 +23,7 @@ extern "C" {
 #include <aerospike/as_bytes.h>
 #include <aerospike/as_integer.h>
 #include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
 #include <aerospike/as_string.h>
 #include <aerospike/as_status.h>
 
@@ -54,6 +55,15 @@ extern "C" {
  */
 #define AS_SET_MAX_SIZE 64
 
+/**
+ *	The maximum size of the key fields cached by as_key_encode().  Holds the
+ *	namespace, set and digest fields of any key and, for AS_POLICY_KEY_SEND,
+ *	an integer user key or a short string or blob user key.
+ *
+ *	@ingroup as_key_object
+ */
+#define AS_KEY_FIELDS_MAX_SIZE 160
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -231,6 +241,50 @@ typedef struct as_key_s {
 	 */
 	as_digest digest;
 
+	/**
+	 *	@private
+	 *	Interned id of the namespace, used to route the key without namespace
+	 *	string compares.  Zero if unknown.
+	 */
+	uint16_t _ns_id;
+
+	/**
+	 *	@private
+	 *	Length of the namespace.  Zero if unknown.
+	 */
+	uint8_t _ns_len;
+
+	/**
+	 *	@private
+	 *	Length of the set.  Only valid if _ns_len is set.
+	 */
+	uint8_t _set_len;
+
+	/**
+	 *	@private
+	 *	Size of _fields in bytes.  Zero unless set by as_key_encode().
+	 */
+	uint32_t _fields_size;
+
+	/**
+	 *	@private
+	 *	Number of fields in _fields.
+	 */
+	uint16_t _n_fields;
+
+	/**
+	 *	@private
+	 *	Key policy _fields were encoded for.
+	 */
+	uint8_t _fields_policy;
+
+	/**
+	 *	@private
+	 *	Namespace, set, digest and, for AS_POLICY_KEY_SEND, user key fields in
+	 *	wire format.  Held inline so copies of the key need no cleanup.
+	 */
+	uint8_t _fields[AS_KEY_FIELDS_MAX_SIZE];
+
 } as_key;
 
 /******************************************************************************
@@ -675,6 +729,33 @@ as_digest * as_key_digest(as_key * key);
 as_status
 as_key_set_digest(as_error* err, as_key* key);
 
+/**
+ *	Compute the digest and encode the key fields sent with each command, so
+ *	commands using the same key policy copy them instead of encoding them
+ *	again.  Useful for long lived keys that are used for many commands.
+ *
+ *	The key must not be modified afterwards.  The encoded fields are held in
+ *	the key itself, so the key may be copied by value.  Fields larger than
+ *	AS_KEY_FIELDS_MAX_SIZE are not cached and commands encode them as usual.
+ *
+ *	~~~~~~~~~~{.c}
+ *	as_key key;
+ *	as_key_init_int64(&key, "ns", "set", 123);
+ *	as_key_encode(&err, &key, AS_POLICY_KEY_DIGEST);
+ *	~~~~~~~~~~
+ *
+ *	@param err		Error message that is populated on error.
+ *	@param key		The key to encode.
+ *	@param policy	Key policy of the commands the key will be used for.
+ *
+ *	@return Status code.
+ *
+ *	@relates as_key
+ *	@ingroup as_key_object
+ */
+as_status
+as_key_encode(as_error* err, as_key* key, as_policy_key policy);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
@@ -20,6 +20,8 @@
 extern "C" {
 #endif
 
+#include <aerospike/as_conn_pool.h>
+#include <aerospike/as_status.h>
 #include <aerospike/as_vector.h>
 #include <citrusleaf/cf_queue.h>
 #include <netinet/in.h>
@@ -60,7 +62,90 @@ typedef struct as_address_s {
 	char name[INET_ADDRSTRLEN];
 } as_address;
 
+/**
+ *	Connection pool counters for a node.
+ */
+typedef struct as_conn_stats_s {
+	/**
+	 *	Idle connections in the pool as of the last cluster tend.
+	 */
+	uint32_t idle;
+	
+	/**
+	 *	Connections opened since the node was added, including warm-up connections and
+	 *	the tend thread's info connection.
+	 */
+	uint32_t opened;
+	
+	/**
+	 *	Idle connections closed by the cluster tend thread.
+	 */
+	uint32_t trimmed;
+} as_conn_stats;
+
+/**
+ *	State of a node's circuit breaker.
+ */
+typedef enum as_breaker_state_e {
+	/**
+	 *	Commands are sent to the node.
+	 */
+	AS_BREAKER_CLOSED,
+	
+	/**
+	 *	Too many recent commands failed.  Commands fail fast with
+	 *	AEROSPIKE_ERR_CIRCUIT_OPEN, or reads go to another replica, until the
+	 *	open period ends.
+	 */
+	AS_BREAKER_OPEN,
+	
+	/**
+	 *	The open period has ended and one probe command is being sent.  The
+	 *	breaker closes if it succeeds and opens again if it fails.
+	 */
+	AS_BREAKER_HALF_OPEN
+} as_breaker_state;
+
+/**
+ *	Circuit breaker and admission counters for a node.
+ */
+typedef struct as_breaker_stats_s {
+	/**
+	 *	Current breaker state.
+	 */
+	as_breaker_state state;
+	
+	/**
+	 *	Commands currently in flight on the node.  Only counted for replica
+	 *	AS_POLICY_REPLICA_ANY reads or when max_commands_per_node is set.
+	 */
+	uint32_t in_flight;
+	
+	/**
+	 *	Moving average of command latency in microseconds, measured for the
+	 *	same commands as in_flight.
+	 */
+	uint32_t latency_us;
+	
+	/**
+	 *	Times the breaker has opened.
+	 */
+	uint32_t opened;
+	
+	/**
+	 *	Commands failed fast or diverted because the breaker was not closed.
+	 */
+	uint32_t rejected;
+	
+	/**
+	 *	Commands failed fast or diverted because the node was at
+	 *	max_commands_per_node.
+	 */
+	uint32_t throttled;
+} as_breaker_stats;
+
 struct as_cluster_s;
+struct as_partition_bitmap_s;
 
 /**
  *	Server node representation.
@@ -78,6 +163,13 @@ typedef struct as_node_s {
 	 */
 	uint32_t partition_generation;
 	
+	/**
+	 *	@private
+	 *	Partition bitmaps last applied from this node, indexed by namespace id
+	 *	and replica.  Allocated on first use.  Only used by tend thread.
+	 */
+	struct as_partition_bitmap_s** partition_bitmaps;
+	
 	/**
 	 *	The name of the node.
 	 */
@@ -102,7 +194,65 @@ typedef struct as_node_s {
 	 *	@private
 	 *	Pool of current, cached FDs.
 	 */
-	cf_queue* conn_q;
+	as_conn_pool conn_pool;
+	
+	/**
+	 *	@private
+	 *	Connections opened to the node.
+	 */
+	uint32_t conns_opened;
+	
+	/**
+	 *	@private
+	 *	Idle connections closed by the tend thread.
+	 */
+	uint32_t conns_trimmed;
+	
+	/**
+	 *	@private
+	 *	Idle connections in the pool as of the last tend.
+	 */
+	uint32_t conns_idle;
+	
+	/**
+	 *	@private
+	 *	Exponentially weighted moving average of command latency in microseconds.
+	 *	Zero until the first tracked command completes.
+	 */
+	uint32_t latency_us;
+	
+	/**
+	 *	@private
+	 *	Tracked commands currently waiting on the node.
+	 */
+	uint32_t in_flight;
+	
+	/**
+	 *	@private
+	 *	Circuit breaker state, an as_breaker_state.
+	 */
+	uint32_t breaker_state;
+	
+	/**
+	 *	@private
+	 *	Commands completed and failed since the tend thread last reset the window.
+	 */
+	uint32_t breaker_commands;
+	uint32_t breaker_errors;
+	
+	/**
+	 *	@private
+	 *	Breaker counters reported by as_node_get_breaker_stats().
+	 */
+	uint32_t breaker_opened;
+	uint32_t breaker_rejected;
+	uint32_t commands_throttled;
+	
+	/**
+	 *	@private
+	 *	Time in milliseconds when an open breaker lets a probe command through.
+	 */
+	uint64_t breaker_open_until;
 	
 	/**
 	 *	@private
@@ -171,6 +321,43 @@ typedef struct as_friend_s {
 	in_port_t port;
 } as_friend;
 
+/**
+ *	@private
+ *	Info responses fetched from a node during one tend cycle.  The fetch may
+ *	run on a tend pool thread; the results are applied on the tend thread.
+ */
+typedef struct as_node_info_s {
+	/**
+	 *	@private
+	 *	Node the responses came from.
+	 */
+	as_node* node;
+	
+	/**
+	 *	@private
+	 *	Response to the node, partition-generation and services request.
+	 */
+	char* check;
+	
+	/**
+	 *	@private
+	 *	Replica map response.  Only fetched when the partition generation changed.
+	 */
+	char* replicas;
+	
+	/**
+	 *	@private
+	 *	Name/value pairs parsed in place from check.
+	 */
+	as_vector /* <as_name_value> */ values;
+	
+	/**
+	 *	@private
+	 *	All requests succeeded.
+	 */
+	bool ok;
+} as_node_info;
+
 /******************************************************************************
  * FUNCTIONS
  ******************************************************************************/
@@ -228,6 +415,58 @@ as_node_release(as_node* node)
 	}
 }
 
+/**
+ *	@private
+ *	Admit a command to the node.  Fail with AEROSPIKE_ERR_CIRCUIT_OPEN when the
+ *	node's breaker is open, or with AEROSPIKE_ERR_MAX_COMMANDS when the node is
+ *	at the cluster's max_commands_per_node.  Only tracked commands count as in
+ *	flight or are limited.  An admitted command must be ended with
+ *	as_node_command_end() with the same track flag.
+ */
+as_status
+as_node_command_admit(as_node* node, bool track);
+
+/**
+ *	@private
+ *	Mark the start of a command on the node without admission checks.
+ */
+static inline void
+as_node_command_begin(as_node* node)
+{
+	ck_pr_inc_32(&node->in_flight);
+}
+
+/**
+ *	@private
+ *	Mark the end of a command on the node.  The latency of a tracked command is
+ *	folded into the node's moving average with a weight of 1/8; failed commands
+ *	may only raise the average.  Failures count toward opening the node's
+ *	circuit breaker.
+ */
+void
+as_node_command_end(as_node* node, bool track, uint32_t latency_us, bool failed);
+
+/**
+ *	@private
+ *	Start a new breaker error window.  Called by the tend thread.
+ */
+static inline void
+as_node_breaker_roll(as_node* node)
+{
+	ck_pr_store_32(&node->breaker_commands, 0);
+	ck_pr_store_32(&node->breaker_errors, 0);
+}
+
+/**
+ *	@private
+ *	Choose which of two replicas a read should try first.  The replica with the
+ *	lower expected wait (average latency times commands in flight) wins, with
+ *	ties alternating per thread.  A small share of reads goes to the other
+ *	replica regardless, so a node that has recovered is noticed.
+ */
+as_node*
+as_node_choose_replica(as_node* master, as_node* prole);
+
 /**
  *	@private
  *	Add socket address to node addresses.
@@ -257,10 +496,37 @@ as_node_get_address_full(as_node* node)
 
 /**
  *	@private
- *	Get a connection to the given node from pool and validate.  Return 0 on success.
+ *	Get a connection to the given node from pool, or open a new one if the pool is
+ *	empty.  Pooled sockets are not checked for liveness, so reused is set to true
+ *	when the socket came from the pool and the caller should retry on a connection
+ *	from as_node_create_connection() if it fails.  Return 0 on success.
+ */
+int
+as_node_get_connection(as_node* node, int* fd, bool* reused);
+
+/**
+ *	@private
+ *	Take an idle connection to the given node from the calling thread's cache or
+ *	the pool.  Return false if there is none.  Never blocks.
+ */
+bool
+as_node_get_idle_connection(as_node* node, int* fd);
+
+/**
+ *	@private
+ *	Open a new connection to the given node, bypassing the pool.  Return 0 on success.
  */
 int
-as_node_get_connection(as_node* node, int* fd);
+as_node_create_connection(as_node* node, int* fd);
+
+/**
+ *	@private
+ *	Start a non-blocking connect to the given node, bypassing the pool.  The
+ *	connection is not authenticated, so it can only be used as is if the cluster
+ *	has no user.  Return 0 on success.
+ */
+int
+as_node_connect(as_node* node, int* fd);
 
 /**
  *	@private
@@ -269,6 +535,50 @@ as_node_get_connection(as_node* node, int* fd);
 void
 as_node_put_connection(as_node* node, int fd);
 
+/**
+ *	@private
+ *	Close pooled connections that have been idle longer than the cluster's
+ *	max_socket_idle, keeping at least min_conns_per_node.  Called by the tend thread.
+ */
+void
+as_node_close_idle_connections(as_node* node);
+
+/**
+ *	@private
+ *	Open up to count connections to the node and put them in the pool.
+ */
+void
+as_node_warm_connections(as_node* node, uint32_t count);
+
+/**
+ *	@private
+ *	Send the tend info requests to the node and keep the responses in info.
+ *	Only touches the node's info socket, so fetches for different nodes may
+ *	run concurrently.
+ */
+void
+as_node_refresh_fetch(struct as_cluster_s* cluster, as_node_info* info);
+
+/**
+ *	@private
+ *	Apply responses from as_node_refresh_fetch() and free them.  Must be called
+ *	from the tend thread.  Returns true if the node responded as expected.
+ */
+bool
+as_node_refresh_apply(struct as_cluster_s* cluster, as_node_info* info, as_vector* /* <as_friend> */ friends);
+
+/**
+ *	Get connection pool counters for the node.
+ */
+void
+as_node_get_conn_stats(as_node* node, as_conn_stats* stats);
+
+/**
+ *	Get circuit breaker and admission counters for the node.
+ */
+void
+as_node_get_breaker_stats(as_node* node, as_breaker_stats* stats);
+
 #ifdef __cplusplus
 } // end extern "C"
 #endif
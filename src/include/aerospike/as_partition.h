@@ -32,6 +32,13 @@ extern "C" {
  */
 #define AS_MAX_NAMESPACE_SIZE 32
 
+/**
+ *	@private
+ *	Number of interned namespace ids, including the reserved zero id.  Namespaces
+ *	beyond this limit are still routed, but by namespace string compares.
+ */
+#define AS_NAMESPACE_IDS 256
+
 /******************************************************************************
  *	TYPES
  *****************************************************************************/
@@ -66,6 +73,12 @@ typedef struct as_partition_table_s {
 	 */
 	char ns[AS_MAX_NAMESPACE_SIZE];
 	
+	/**
+	 *	@private
+	 *	Interned namespace id.  Zero if the namespace could not be interned.
+	 */
+	uint32_t ns_id;
+	
 	/**
 	 *	@private
 	 *  Fixed length of partition array.
@@ -96,6 +109,12 @@ typedef struct as_partition_tables_s {
 	 */
 	uint32_t size;
 
+	/**
+	 *	@private
+	 *	Partition tables indexed by interned namespace id.
+	 */
+	as_partition_table* index[AS_NAMESPACE_IDS];
+
 	/**
 	 *	@private
 	 *  Partition table array.
@@ -103,6 +122,31 @@ typedef struct as_partition_tables_s {
 	as_partition_table* array[];
 } as_partition_tables;
 
+/**
+ *	@private
+ *	Replica map bitmap applied to the partition tables from one node.
+ */
+typedef struct as_partition_bitmap_s {
+	/**
+	 *	@private
+	 *	Bitmap size in bytes.
+	 */
+	uint32_t size;
+	
+	/**
+	 *	@private
+	 *	Bits have been applied in full at least once.
+	 */
+	bool applied;
+	
+	/**
+	 *	@private
+	 *	One bit per partition, most significant bit first.  A bit is cleared
+	 *	when another node takes the partition over.
+	 */
+	uint8_t bits[];
+} as_partition_bitmap;
+
 /******************************************************************************
  * FUNCTIONS
  ******************************************************************************/
@@ -114,6 +158,13 @@ typedef struct as_partition_tables_s {
 as_partition_tables*
 as_partition_tables_create(uint32_t capacity);
 
+/**
+ *	@private
+ *	Create partition table for namespace with capacity partitions, all unowned.
+ */
+as_partition_table*
+as_partition_table_create(const char* ns, uint32_t capacity);
+
 /**
  *	@private
  *	Destroy and release memory for partition table.
@@ -128,6 +179,36 @@ as_partition_table_destroy(as_partition_table* table);
 as_partition_table*
 as_partition_tables_get(as_partition_tables* tables, const char* ns);
 
+/**
+ *	@private
+ *	Get partition table given interned namespace id.  Fall back to namespace
+ *	string compares if the namespace was not interned.
+ */
+static inline as_partition_table*
+as_partition_tables_get_id(as_partition_tables* tables, const char* ns, uint32_t ns_id)
+{
+	if (ns_id) {
+		return tables->index[ns_id];
+	}
+	return as_partition_tables_get(tables, ns);
+}
+
+/**
+ *	@private
+ *	Return id for namespace of given length, registering the namespace on first
+ *	use.  Ids are process wide, stable and start at one.  Return zero if the
+ *	registry is full or the namespace is invalid.
+ */
+uint32_t
+as_namespace_intern(const char* ns, size_t len);
+
+/**
+ *	@private
+ *	Free partition bitmaps applied from node.
+ */
+void
+as_partition_bitmaps_destroy(as_node* node);
+
 /**
  *	@private
  *	Is node referenced in any partition table.
@@ -379,6 +379,12 @@ typedef struct as_policy_read_s {
 	 */
 	uint32_t timeout;
 
+	/**
+	 *	Specifies the behavior for failed operations.  Retries of a read
+	 *	alternate between the master and the prole.
+	 */
+	as_policy_retry retry;
+
 	/**
 	 *	Specifies the behavior for the key.
 	 */
@@ -395,6 +401,25 @@ typedef struct as_policy_read_s {
 	 */
 	as_policy_consistency_level consistency_level;
 
+	/**
+	 *	If true, string and bytes bins of the returned record reference a
+	 *	response buffer owned by the record instead of being copied one by one.
+	 *	The buffer is freed by as_record_destroy().  Use as_record_copy_borrowed()
+	 *	before keeping a value past the life of the record.
+	 *
+	 *	Default: false
+	 */
+	bool zero_copy;
+
+	/**
+	 *	If the master has not answered a read within this many microseconds, send
+	 *	the same read to the partition's prole and use whichever response arrives
+	 *	first.  The slower connection is closed.  Zero disables hedging.
+	 *
+	 *	Default: 0
+	 */
+	uint32_t hedge_delay_us;
+
 } as_policy_read;
 
 /**
@@ -613,6 +638,23 @@ typedef struct as_policy_batch_s {
 	 */
 	uint32_t timeout;
 
+	/**
+	 *	Specifies the behavior for failed operations.  Keys a node did not
+	 *	answer are routed again through the current partition map and resent,
+	 *	within the timeout.
+	 */
+	as_policy_retry retry;
+
+	/**
+	 *	Maximum time in milliseconds to wait for one node command.  A node
+	 *	which does not answer in time fails the attempt, and its keys are
+	 *	retried while the timeout allows.  Zero lets each attempt use all of
+	 *	the time left.
+	 *
+	 *	Default: 0
+	 */
+	uint32_t socket_timeout;
+
 } as_policy_batch;
 
 /**
@@ -780,9 +822,12 @@ static inline as_policy_read*
 as_policy_read_init(as_policy_read* p)
 {
 	p->timeout = AS_POLICY_TIMEOUT_DEFAULT;
+	p->retry = AS_POLICY_RETRY_DEFAULT;
 	p->key = AS_POLICY_KEY_DEFAULT;
 	p->replica = AS_POLICY_REPLICA_DEFAULT;
 	p->consistency_level = AS_POLICY_CONSISTENCY_LEVEL_DEFAULT;
+	p->zero_copy = false;
+	p->hedge_delay_us = 0;
 	return p;
 }
 
@@ -798,9 +843,12 @@ static inline void
 as_policy_read_copy(as_policy_read* src, as_policy_read* trg)
 {
 	trg->timeout = src->timeout;
+	trg->retry = src->retry;
 	trg->key = src->key;
 	trg->replica = src->replica;
 	trg->consistency_level = src->consistency_level;
+	trg->zero_copy = src->zero_copy;
+	trg->hedge_delay_us = src->hedge_delay_us;
 }
 
 /**
@@ -1000,6 +1048,8 @@ static inline as_policy_batch*
 as_policy_batch_init(as_policy_batch* p)
 {
 	p->timeout = AS_POLICY_TIMEOUT_DEFAULT;
+	p->retry = AS_POLICY_RETRY_DEFAULT;
+	p->socket_timeout = 0;
 	return p;
 }
 
@@ -1015,6 +1065,8 @@ static inline void
 as_policy_batch_copy(as_policy_batch* src, as_policy_batch* trg)
 {
 	trg->timeout = src->timeout;
+	trg->retry = src->retry;
+	trg->socket_timeout = src->socket_timeout;
 }
 
 /**
@@ -156,6 +156,17 @@ extern "C" {
  *	- as_record_foreach() — Calls a function for each bin traversed.
  *	- as_record_iterator — Uses an iterator pattern to traverse bins.
  *
+ *	## Zero-Copy Reads
+ *
+ *	When a record is read with `as_policy_read.zero_copy` set, string and bytes
+ *	bins point into a response buffer owned by the record instead of holding
+ *	their own copies.  The buffer is freed by `as_record_destroy()`, so values
+ *	must not be kept past the life of the record.  Call
+ *	`as_record_copy_borrowed()` first to give every bin its own copy.
+ *
+ *	Passing the same record to successive reads reuses its buffer.  Bins from
+ *	the previous read are released before the new response is parsed.
+ *
  *	@extends as_rec
  *	@ingroup client_objects
  */
@@ -198,6 +209,19 @@ typedef struct as_record_s {
 	 */
 	as_bins bins;
 
+	/**
+	 *	@private
+	 *	Response buffer referenced by bins of a zero-copy read.
+	 *	Freed by as_record_destroy().
+	 */
+	uint8_t * _buffer;
+
+	/**
+	 *	@private
+	 *	Allocated size of _buffer.
+	 */
+	size_t _buffer_capacity;
+
 } as_record;
 
 /**
@@ -299,6 +323,18 @@ as_record * as_record_init(as_record * rec, uint16_t nbins);
  */
 void as_record_destroy(as_record * rec);
 
+/**
+ *	Copy bin values that reference the record's zero-copy response buffer into
+ *	their own allocations, then free the buffer.  Call this before keeping any
+ *	value past as_record_destroy().  Records that were not read with
+ *	`as_policy_read.zero_copy` are left unchanged.
+ *
+ *	@param rec The record holding borrowed values.
+ *
+ *	@relates as_record
+ */
+void as_record_copy_borrowed(as_record * rec);
+
 /**
  *	Get the number of bins in the record.
  *
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+#include <aerospike/as_status.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	How a failed attempt should be retried.
+ */
+typedef enum as_retry_class_e {
+	/**
+	 *	Not retryable.  The error is returned to the caller.
+	 */
+	AS_RETRY_CLASS_NONE,
+
+	/**
+	 *	The client or the server gave up waiting.  The attempt has already used
+	 *	its share of the deadline, so it is retried without backing off.
+	 */
+	AS_RETRY_CLASS_TIMEOUT,
+
+	/**
+	 *	A connection could not be opened, written or read.
+	 */
+	AS_RETRY_CLASS_CONNECTION,
+
+	/**
+	 *	The server is overloaded or the record is locked by another command.
+	 */
+	AS_RETRY_CLASS_BUSY,
+
+	/**
+	 *	No node owns the partition yet, typically before the first tend has
+	 *	completed or while a node is leaving the cluster.
+	 */
+	AS_RETRY_CLASS_NO_NODE,
+
+	AS_RETRY_CLASS_MAX
+} as_retry_class;
+
+/**
+ *	@private
+ *	Exponential backoff schedule for one retry class.  The n-th retry of the
+ *	class waits between half and all of min(base_ms * 2^(n-1), max_ms).
+ */
+typedef struct as_retry_backoff_s {
+	uint32_t base_ms;
+	uint32_t max_ms;
+} as_retry_backoff;
+
+/**
+ *	@private
+ *	Backoff schedules indexed by as_retry_class.
+ */
+typedef struct as_retry_schedule_s {
+	as_retry_backoff backoff[AS_RETRY_CLASS_MAX];
+} as_retry_schedule;
+
+/**
+ *	@private
+ *	State of one command's retries.  The engine does not sleep or read the
+ *	clock itself; callers pass the current time and sleep for the returned
+ *	delay, which keeps the policy deterministic for a given seed.
+ */
+typedef struct as_retry_s {
+	const as_retry_schedule* schedule;
+	uint64_t deadline_ms;
+	uint32_t max_retries;
+	uint32_t attempt;
+	uint32_t seed;
+	uint32_t counts[AS_RETRY_CLASS_MAX];
+} as_retry;
+
+/******************************************************************************
+ *	GLOBAL VARIABLES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Schedule used when none is given to as_retry_init().
+ */
+extern const as_retry_schedule as_retry_schedule_default;
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Initialize retry state.  A deadline_ms of zero means no deadline.  A null
+ *	schedule selects as_retry_schedule_default.  A seed of zero is replaced by
+ *	one derived from the clock when the first jittered delay is drawn.
+ */
+void
+as_retry_init(as_retry* retry, const as_retry_schedule* schedule, uint64_t deadline_ms,
+	uint32_t max_retries, uint32_t seed);
+
+/**
+ *	@private
+ *	Map the status of a failed attempt to its retry class.
+ */
+as_retry_class
+as_retry_classify(as_status status);
+
+/**
+ *	@private
+ *	Account for a failed attempt of the given class at time now_ms.  Returns the
+ *	number of milliseconds to wait before the next attempt, or -1 when the
+ *	command should give up because the class is not retryable, the retries are
+ *	exhausted or the deadline leaves no time for another attempt.  The delay
+ *	is always shorter than the time left before the deadline.
+ */
+int
+as_retry_next(as_retry* retry, as_retry_class klass, uint64_t now_ms);
+
+/**
+ *	@private
+ *	Milliseconds left before the deadline at time now_ms, or zero if there is
+ *	no deadline or it has passed.
+ */
+static inline uint32_t
+as_retry_remaining_ms(const as_retry* retry, uint64_t now_ms)
+{
+	return retry->deadline_ms > now_ms ? (uint32_t)(retry->deadline_ms - now_ms) : 0;
+}
+
+/**
+ *	@private
+ *	Whether the current attempt of a read should go to the prole.  Reads
+ *	alternate between master and prole, starting with the master.
+ */
+static inline bool
+as_retry_use_prole(const as_retry* retry)
+{
+	return retry->attempt & 1;
+}
+
+#ifdef __cplusplus
+} // end extern "C"
+#endif
@@ -222,6 +222,13 @@ typedef struct as_shm_info_s {
 	 */
 	as_node** local_nodes;
 	
+	/**
+	 *	@private
+	 *	Shared memory partition tables indexed by interned namespace id, filled in
+	 *	on first lookup.  Shared memory tables are only appended, so they never move.
+	 */
+	as_partition_table_shm** ns_tables;
+	
 	/**
 	 *	@private
 	 *	Shared memory identifier.
@@ -287,7 +294,7 @@ as_shm_update_partitions(as_shm_info* shm_info, const char* ns, char* bitmap_b64
  *	used instead.  as_nodes_release() must be called when done with node.
  */
 as_node*
-as_shm_node_get(struct as_cluster_s* cluster, const char* ns, const cf_digest* d, bool write, as_policy_replica replica);
+as_shm_node_get(struct as_cluster_s* cluster, const char* ns, uint32_t ns_id, const cf_digest* d, bool write, as_policy_replica replica);
 
 /**
  *	@private
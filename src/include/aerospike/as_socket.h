@@ -34,6 +34,7 @@ extern "C" {
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 // Windows send() and recv() parameter types are different.
 #define as_socket_data_t void
@@ -49,6 +50,12 @@ extern "C" {
 #define MSG_DONTWAIT    0x40
 #endif
 
+// Writes to a socket closed by the server fail with EPIPE instead of raising
+// SIGPIPE where the platform supports it.
+#if !defined(MSG_NOSIGNAL) && !defined(CF_WINDOWS)
+#define MSG_NOSIGNAL	0
+#endif
+
 #if defined(CF_WINDOWS)
 #include <WinSock2.h>
 #include <Ws2tcpip.h>
@@ -143,6 +150,34 @@ as_socket_write_timeout(as_error* err, int fd, uint8_t *buf, size_t buf_len, uin
 	}
 }
 
+/**
+ *	@private
+ *	Write socket data gathered from iovcnt fragments with future deadline in
+ *	milliseconds.  Do not adjust for zero deadline.
+ */
+as_status
+as_socket_writev_limit(as_error* err, int fd, const struct iovec* iov, int iovcnt, uint64_t deadline);
+
+/**
+ *	@private
+ *	Write socket data gathered from iovcnt fragments with future deadline in
+ *	milliseconds.  If deadline is zero, wait as long as as_socket_write_forever().
+ */
+static inline as_status
+as_socket_writev_deadline(as_error* err, int fd, const struct iovec* iov, int iovcnt, uint64_t deadline)
+{
+	return as_socket_writev_limit(err, fd, iov, iovcnt, deadline ? deadline : cf_getms() + 60000);
+}
+
+/**
+ *	@private
+ *	Wait up to timeout_us microseconds for any of n_fds sockets to become readable
+ *	or fail.  Return the index of the first ready socket, or -1 on timeout.
+ *	Resolution is one millisecond unless sockets use select().
+ */
+int
+as_socket_wait_readable(const int* fds, int n_fds, uint64_t timeout_us);
+
 /**
  *	@private
  *	Read socket data without timeouts.
@@ -190,6 +225,17 @@ as_socket_read_timeout(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint
 	}
 }
 
+/**
+ *	@private
+ *	Read at least min_len bytes and at most buf_len bytes, taking whatever is
+ *	already available in as few reads as possible.  The number of bytes read is
+ *	returned in read_len.  Returns AEROSPIKE_ERR_NO_RESPONSE if the server closed
+ *	or reset the socket before sending anything.  If deadline is zero, do not
+ *	set deadline.
+ */
+as_status
+as_socket_read_atleast(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t buf_len, uint64_t deadline, size_t* read_len);
+
 /**
  *	@private
  *	Convert socket address to a string.
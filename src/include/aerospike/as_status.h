@@ -33,6 +33,32 @@ typedef enum as_status_e {
 	 *	Client Errors
 	 **************************************************************************/
 	
+	/**
+	 *	@private
+	 *	Server closed the socket before sending any part of the response.
+	 *	Single record commands resend on a new socket or report
+	 *	AEROSPIKE_ERR_CLIENT instead, so applications do not see this code.
+	 */
+	AEROSPIKE_ERR_NO_RESPONSE = -7,
+	
+	/**
+	 *	A callback returned false to stop a multi-record command.  The command's
+	 *	open sockets are closed.
+	 */
+	AEROSPIKE_ERR_CLIENT_ABORT = -6,
+	
+	/**
+	 *	Node has as many commands in flight as as_config.max_commands_per_node
+	 *	allows.  The command was not sent.
+	 */
+	AEROSPIKE_ERR_MAX_COMMANDS = -5,
+	
+	/**
+	 *	Node's circuit breaker is open after too many recent failures.  The
+	 *	command was not sent.
+	 */
+	AEROSPIKE_ERR_CIRCUIT_OPEN = -4,
+	
 	/**
 	 *	No more records available when parsing batch, scan or query records.
 	 */
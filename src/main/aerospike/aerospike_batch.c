@@ -24,6 +24,7 @@
 #include <aerospike/as_operations.h>
 #include <aerospike/as_policy.h>
 #include <aerospike/as_record.h>
+#include <aerospike/as_retry.h>
 #include <aerospike/as_socket.h>
 #include <aerospike/as_status.h>
 #include <aerospike/as_val.h>
@@ -35,7 +36,10 @@
 
 typedef struct as_batch_node_s {
 	as_node* node;
+	const char* ns;
+	uint32_t ns_id;
 	as_vector offsets;
+	as_vector buffers;
 } as_batch_node;
 
 typedef struct as_batch_task_s {
@@ -47,11 +51,21 @@ typedef struct as_batch_task_s {
 	as_error* err;
 	cf_queue* complete_q;
 	as_batch_read* results;
+	as_vector* buffers;
+	aerospike_batch_stream_callback stream;
+	aerospike_batch_node_callback node_callback;
+	void* udata;
 	uint32_t* error_mutex;
+	uint32_t* abort;
 	as_key* keys;
+	const char** bins;
+	uint64_t deadline_ms;
 	
 	uint32_t n_keys;
+	uint32_t n_bins;
+	uint32_t bins_size;
 	uint32_t timeout_ms;
+	uint32_t socket_timeout_ms;
 	uint32_t index;
 	as_policy_retry retry;
 	uint8_t read_attr;
@@ -88,13 +102,95 @@ as_batch_parse_fields(uint8_t* p, uint32_t n_fields, uint8_t** digest)
 	return p;
 }
 
+static inline uint32_t
+as_batch_get_size(uint8_t* p)
+{
+	uint32_t size;
+	memcpy(&size, p, sizeof(uint32_t));
+	return cf_swap_from_be32(size);
+}
+
+/**
+ *	Count the bins of all records in a group, so the group and its records' bins
+ *	fit in one allocation.  Also clear each message's header size, which is not
+ *	used when parsing, so a string value which ends right before the next message
+ *	can be terminated in place.
+ */
+static uint32_t
+as_batch_count_bins(uint8_t* buf, size_t size)
+{
+	uint8_t* p = buf;
+	uint8_t* end = buf + size;
+	uint32_t n_bins = 0;
+	
+	while (p + sizeof(as_msg) <= end) {
+		as_msg msg;
+		memcpy(&msg, p, sizeof(as_msg));
+		as_msg_swap_header_from_be(&msg);
+		*p = 0;
+		
+		if (msg.info3 & AS_MSG_INFO3_LAST) {
+			break;
+		}
+		p += sizeof(as_msg);
+		
+		for (uint32_t i = 0; i < msg.n_fields && p < end; i++) {
+			p += 4 + as_batch_get_size(p);
+		}
+		
+		for (uint32_t i = 0; i < msg.n_ops && p < end; i++) {
+			p += 4 + as_batch_get_size(p);
+		}
+		n_bins += msg.n_ops;
+	}
+	return n_bins;
+}
+
+static uint8_t*
+as_batch_parse_record(uint8_t* p, as_msg* msg, as_record* rec, as_bin** bins, uint8_t* end)
+{
+	// Bin entries are carved from the group's buffer and values reference it.
+	as_record_init(rec, 0);
+	rec->bins.entries = *bins;
+	rec->bins.capacity = msg->n_ops;
+	*bins += msg->n_ops;
+	rec->gen = msg->generation;
+	rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
+	return as_command_parse_bins_borrow(rec, p, msg->n_ops, true, end);
+}
+
+static uint8_t*
+as_batch_stream_record(uint8_t* p, as_msg* msg, as_bin** bins, uint8_t* end, as_batch_task* task,
+	uint32_t offset, bool* proceed)
+{
+	as_batch_read result;
+	result.key = &task->keys[offset];
+	result.result = msg->result_code;
+	
+	if (msg->result_code == AEROSPIKE_OK) {
+		p = as_batch_parse_record(p, msg, &result.record, bins, end);
+	}
+	else {
+		as_record_init(&result.record, 0);
+	}
+	
+	*proceed = task->stream(&result, task->udata);
+	as_record_destroy(&result.record);
+	return p;
+}
+
 static as_status
-as_batch_parse_records(uint8_t* buf, size_t size, as_batch_task* task)
+as_batch_parse_records(uint8_t* buf, size_t size, as_bin* bins, as_batch_task* task)
 {
 	uint8_t* p = buf;
 	uint8_t* end = buf + size;
 	
 	while (p < end) {
+		// Stop when any node's stream callback asked to.
+		if (task->abort && ck_pr_load_32(task->abort)) {
+			return AEROSPIKE_ERR_CLIENT_ABORT;
+		}
+		
 		as_msg* msg = (as_msg*)p;
 		as_msg_swap_header_from_be(msg);
 		
@@ -113,15 +209,22 @@ as_batch_parse_records(uint8_t* buf, size_t size, as_batch_task* task)
 		p = as_batch_parse_fields(p, msg->n_fields, &digest);
 		
 		if (digest && memcmp(digest, task->keys[offset].digest.value, AS_DIGEST_VALUE_SIZE) == 0) {
+			if (task->stream) {
+				bool proceed;
+				p = as_batch_stream_record(p, msg, &bins, end, task, offset, &proceed);
+				
+				if (! proceed) {
+					ck_pr_store_32(task->abort, 1);
+					return AEROSPIKE_ERR_CLIENT_ABORT;
+				}
+				continue;
+			}
+			
 			as_batch_read* result = &task->results[offset];
 			result->result = msg->result_code;
 			
 			if (msg->result_code == AEROSPIKE_OK) {
-				as_record* rec = &result->record;
-				as_record_init(rec, msg->n_ops);
-				rec->gen = msg->generation;
-				rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
-				p = as_command_parse_bins(rec, p, msg->n_ops, true);
+				p = as_batch_parse_record(p, msg, &result->record, &bins, end);
 			}
 		}
 		else {
@@ -153,11 +256,12 @@ as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 		size_t size = proto.sz;
 		
 		if (size > 0) {
-			// Prepare buffer
-			if (size > capacity) {
-				as_command_free(buf, capacity);
-				capacity = size;
-				buf = as_command_init(capacity);
+			// Prepare buffer, with a spare byte to terminate a string value
+			// which ends the group.
+			if (size + 1 > capacity) {
+				cf_free(buf);
+				capacity = size + 1;
+				buf = cf_malloc(capacity);
 			}
 			
 			// Read remaining message bytes in group
@@ -167,7 +271,25 @@ as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 				break;
 			}
 			
-			status = as_batch_parse_records(buf, size, task);
+			// Append bin entries for the group's records.  Nothing references
+			// the buffer yet, so it can still move.
+			uint32_t n_bins = as_batch_count_bins(buf, size);
+			size_t offset = (size + 1 + 7) & ~(size_t)7;
+			size_t needed = offset + sizeof(as_bin) * n_bins;
+			
+			if (needed > capacity) {
+				capacity = needed;
+				buf = cf_realloc(buf, capacity);
+			}
+			
+			status = as_batch_parse_records(buf, size, (as_bin*)(buf + offset), task);
+			
+			if (task->buffers) {
+				// Results reference the group until the batch callback returns.
+				as_vector_append(task->buffers, &buf);
+				buf = 0;
+				capacity = 0;
+			}
 			
 			if (status != AEROSPIKE_OK) {
 				if (status == AEROSPIKE_NO_MORE_RECORDS) {
@@ -184,12 +306,12 @@ as_batch_parse(as_error* err, int fd, uint64_t deadline_ms, void* udata)
 			break;
 		}
 	}
-	as_command_free(buf, capacity);
+	cf_free(buf);
 	return status;
 }
 
 static as_status
-as_batch_command_execute(as_batch_task* task)
+as_batch_command_send(as_batch_task* task, as_error* err)
 {
 	size_t size = AS_HEADER_SIZE;
 	size += as_command_string_field_size(task->ns);
@@ -197,11 +319,10 @@ as_batch_command_execute(as_batch_task* task)
 	uint32_t n_offsets = task->offsets.size;
 	uint32_t byte_size = n_offsets * AS_DIGEST_VALUE_SIZE;
 	size += as_command_field_size(byte_size);
-	
-	// TODO: support bin name filters.
+	size += task->bins_size;
 	
 	uint8_t* cmd = as_command_init(size);
-	uint8_t* p = as_command_write_header_read(cmd, task->read_attr, AS_POLICY_CONSISTENCY_LEVEL_ONE, task->timeout_ms, 2, 0);
+	uint8_t* p = as_command_write_header_read(cmd, task->read_attr, AS_POLICY_CONSISTENCY_LEVEL_ONE, task->timeout_ms, 2, task->n_bins);
 	p = as_command_write_field_string(p, AS_FIELD_NAMESPACE, task->ns);
 	p = as_command_write_field_header(p, AS_FIELD_DIGEST_ARRAY, byte_size);
 	
@@ -211,22 +332,252 @@ as_batch_command_execute(as_batch_task* task)
 		memcpy(p, key->digest.value, AS_DIGEST_VALUE_SIZE);
 		p += AS_DIGEST_VALUE_SIZE;
 	}
+	
+	// Bin names follow the fields, in the same form as a single record select.
+	for (uint32_t i = 0; i < task->n_bins; i++) {
+		p = as_command_write_bin_name(p, task->bins[i]);
+	}
 	size = as_command_write_end(cmd, p);
 
 	as_command_node cn;
 	cn.node = task->node;
 
-	as_error err;
-	as_status status = as_command_execute(&err, &cn, cmd, size, task->timeout_ms, task->retry, as_batch_parse, task);
+	// Resending the whole command would deliver answered keys twice, so
+	// retries are left to as_batch_retry().
+	as_status status = as_command_execute(err, &cn, cmd, size, task->timeout_ms, AS_POLICY_RETRY_NONE, as_batch_parse, task);
 	
 	as_command_free(cmd, size);
+	return status;
+}
+
+static as_batch_node*
+as_batch_node_find(as_batch_node* batch_nodes, uint32_t n_batch_nodes, as_node* node, as_key* key)
+{
+	as_batch_node* batch_node = batch_nodes;
+	
+	for (uint32_t i = 0; i < n_batch_nodes; i++) {
+		// Each command reads one namespace.  Interned ids are equal only for
+		// equal namespaces.
+		if (batch_node->node == node &&
+			((batch_node->ns_id && key->_ns_id) ? batch_node->ns_id == key->_ns_id : strcmp(batch_node->ns, key->ns) == 0)) {
+			return batch_node;
+		}
+		batch_node++;
+	}
+	return 0;
+}
+
+static void
+as_batch_append_unanswered(as_batch_task* task, as_vector* pending)
+{
+	// Keys are answered in the order they were sent.
+	for (uint32_t i = task->index; i < task->offsets.size; i++) {
+		as_vector_append(pending, as_vector_get(&task->offsets, i));
+	}
+}
+
+/**
+ *	Time allowed for one node command given the time left before the batch
+ *	deadline, where zero means no deadline.  The socket timeout caps each
+ *	attempt so a slow node leaves time to retry its keys.
+ */
+static inline uint32_t
+as_batch_attempt_timeout(as_batch_task* task, uint32_t remaining_ms)
+{
+	if (task->socket_timeout_ms && (remaining_ms == 0 || task->socket_timeout_ms < remaining_ms)) {
+		return task->socket_timeout_ms;
+	}
+	return remaining_ms;
+}
+
+/**
+ *	Resend the keys of a failed command which were not answered.  Each round
+ *	routes the keys through the current partition map, so partitions which
+ *	migrated are read from their new node, and sends each node's keys as one
+ *	command within the batch deadline and socket timeout.  Keys still not
+ *	answered are left in pending.
+ */
+static as_status
+as_batch_retry(as_batch_task* task, as_status status, as_error* err, as_vector* pending)
+{
+	as_retry rt;
+	as_retry_init(&rt, NULL, task->deadline_ms, task->retry, 0);
+	
+	while (pending->size > 0) {
+		int delay_ms = as_retry_next(&rt, as_retry_classify(status), cf_getms());
+		
+		if (delay_ms < 0) {
+			break;
+		}
+		
+		if (delay_ms > 0) {
+			usleep(delay_ms * 1000);
+		}
+		
+		uint32_t timeout_ms = 0;
+		
+		if (rt.deadline_ms > 0) {
+			timeout_ms = as_retry_remaining_ms(&rt, cf_getms());
+			
+			if (timeout_ms == 0) {
+				break;
+			}
+		}
+		timeout_ms = as_batch_attempt_timeout(task, timeout_ms);
+		
+		// Group keys by node.  Reads alternate between master and prole on
+		// retry, as single record reads do.
+		uint32_t n_pending = pending->size;
+		uint32_t groups_capacity = 4;
+		as_batch_node* groups = cf_malloc(sizeof(as_batch_node) * groups_capacity);
+		uint32_t n_groups = 0;
+		as_vector unrouted;
+		as_vector_init(&unrouted, sizeof(uint32_t), 8);
+		
+		// Only nodes that get a group are reserved.
+		ck_epoch_record_t* record = as_cluster_epoch_record();
+		ck_epoch_begin(&as_cluster_epoch, record);
+		
+		for (uint32_t i = 0; i < n_pending; i++) {
+			uint32_t offset = *(uint32_t*)as_vector_get(pending, i);
+			as_key* key = &task->keys[offset];
+			cf_digest* digest = (cf_digest*)key->digest.value;
+			as_node* node = NULL;
+			
+			if (as_retry_use_prole(&rt)) {
+				node = as_node_get_prole(task->cluster, key->ns, key->_ns_id, digest);
+			}
+			
+			if (! node) {
+				node = as_node_get(task->cluster, key->ns, key->_ns_id, digest, false, AS_POLICY_REPLICA_MASTER);
+			}
+			
+			if (! node) {
+				as_vector_append(&unrouted, &offset);
+				continue;
+			}
+			
+			as_batch_node* group = as_batch_node_find(groups, n_groups, node, key);
+			
+			if (! group) {
+				if (n_groups == groups_capacity) {
+					groups_capacity *= 2;
+					groups = cf_realloc(groups, sizeof(as_batch_node) * groups_capacity);
+				}
+				group = &groups[n_groups++];
+				as_node_reserve(node);
+				group->node = node;
+				group->ns = key->ns;
+				group->ns_id = key->_ns_id;
+				as_vector_init(&group->offsets, sizeof(uint32_t), 8);
+			}
+			as_vector_append(&group->offsets, &offset);
+		}
+		ck_epoch_end(&as_cluster_epoch, record);
+		
+		// Keys with no node are tried again next round.
+		as_vector_clear(pending);
+		
+		for (uint32_t i = 0; i < unrouted.size; i++) {
+			as_vector_append(pending, as_vector_get(&unrouted, i));
+		}
+		as_vector_destroy(&unrouted);
+		
+		if (pending->size > 0) {
+			status = as_error_set_message(err, AEROSPIKE_ERR_CLUSTER, "Batch keys have no node");
+		}
+		
+		bool aborted = false;
+		
+		for (uint32_t i = 0; i < n_groups; i++) {
+			as_batch_node* group = &groups[i];
+			
+			if (! aborted) {
+				as_batch_task sub = *task;
+				sub.node = group->node;
+				memcpy(&sub.offsets, &group->offsets, sizeof(as_vector));
+				sub.index = 0;
+				sub.timeout_ms = timeout_ms;
+				
+				as_error sub_err;
+				as_status sub_status = as_batch_command_send(&sub, &sub_err);
+				
+				if (sub_status == AEROSPIKE_ERR_CLIENT_ABORT) {
+					aborted = true;
+				}
+				else if (sub_status != AEROSPIKE_OK) {
+					as_batch_append_unanswered(&sub, pending);
+					memcpy(err, &sub_err, sizeof(as_error));
+					status = sub_status;
+				}
+			}
+			as_node_release(group->node);
+			as_vector_destroy(&group->offsets);
+		}
+		cf_free(groups);
+		
+		if (aborted) {
+			return AEROSPIKE_ERR_CLIENT_ABORT;
+		}
+	}
+	return pending->size > 0 ? status : AEROSPIKE_OK;
+}
+
+/**
+ *	Give each key which was not answered the command's status, so results from
+ *	other keys remain usable.
+ */
+static void
+as_batch_set_failed(as_batch_task* task, as_vector* pending, as_status status)
+{
+	for (uint32_t i = 0; i < pending->size; i++) {
+		uint32_t offset = *(uint32_t*)as_vector_get(pending, i);
+		
+		if (task->stream) {
+			as_batch_read result;
+			result.key = &task->keys[offset];
+			result.result = status;
+			as_record_init(&result.record, 0);
+			
+			if (! task->stream(&result, task->udata)) {
+				ck_pr_store_32(task->abort, 1);
+				break;
+			}
+		}
+		else {
+			task->results[offset].result = status;
+		}
+	}
+}
+
+static as_status
+as_batch_command_execute(as_batch_task* task)
+{
+	as_error err;
+	as_status status = as_batch_command_send(task, &err);
+	
+	if (status == AEROSPIKE_OK || status == AEROSPIKE_ERR_CLIENT_ABORT) {
+		return status;
+	}
+	
+	// Keys answered before the failure keep their results.
+	as_vector pending;
+	as_vector_init(&pending, sizeof(uint32_t), 8);
+	as_batch_append_unanswered(task, &pending);
 	
-	if (status) {
+	if (task->retry != AS_POLICY_RETRY_NONE) {
+		status = as_batch_retry(task, status, &err, &pending);
+	}
+	
+	if (status != AEROSPIKE_OK && status != AEROSPIKE_ERR_CLIENT_ABORT) {
+		as_batch_set_failed(task, &pending, status);
+		
 		// Copy error to main error only once.
 		if (ck_pr_fas_32(task->error_mutex, 1) == 0) {
 			memcpy(task->err, &err, sizeof(as_error));
 		}
 	}
+	as_vector_destroy(&pending);
 	return status;
 }
 
@@ -244,7 +595,18 @@ as_batch_worker_fn(void* data)
 		
 		as_batch_complete_task complete_task;
 		complete_task.node = task.node;
-		complete_task.result = as_batch_command_execute(&task);
+		
+		if (task.abort && ck_pr_load_32(task.abort)) {
+			// Batch was stopped before this node's turn.
+			complete_task.result = AEROSPIKE_ERR_CLIENT_ABORT;
+		}
+		else {
+			complete_task.result = as_batch_command_execute(&task);
+		}
+		
+		if (task.node_callback) {
+			task.node_callback(task.node->name, complete_task.result, task.offsets.size, task.udata);
+		}
 		
 		cf_queue_push(task.complete_q, &complete_task);
 	}
@@ -316,36 +678,42 @@ as_batch_threads_shutdown(as_cluster* cluster)
 	ck_pr_store_32(&cluster->batch_initialized, 0);
 }
 
-static as_batch_node*
-as_batch_node_find(as_batch_node* batch_nodes, uint32_t n_batch_nodes, as_node* node)
+static void
+as_batch_release_nodes(as_batch_node* batch_nodes, uint32_t n_batch_nodes)
 {
 	as_batch_node* batch_node = batch_nodes;
 	
 	for (uint32_t i = 0; i < n_batch_nodes; i++) {
-		if (batch_node->node == node) {
-			return batch_node;
+		as_node_release(batch_node->node);
+		as_vector_destroy(&batch_node->offsets);
+		
+		for (uint32_t j = 0; j < batch_node->buffers.size; j++) {
+			cf_free(*(uint8_t**)as_vector_get(&batch_node->buffers, j));
 		}
+		as_vector_destroy(&batch_node->buffers);
 		batch_node++;
 	}
-	return 0;
+	cf_free(batch_nodes);
 }
 
 static void
-as_batch_release_nodes(as_batch_node* batch_nodes, uint32_t n_batch_nodes)
+as_batch_destroy_results(as_batch_read* results, uint32_t n_results)
 {
-	as_batch_node* batch_node = batch_nodes;
+	if (! results) {
+		return;
+	}
 	
-	for (uint32_t i = 0; i < n_batch_nodes; i++) {
-		as_node_release(batch_node->node);
-		as_vector_destroy(&batch_node->offsets);
-		batch_node++;
+	for (uint32_t i = 0; i < n_results; i++) {
+		as_record_destroy(&results[i].record);
 	}
+	cf_free(results);
 }
 
 static as_status
 as_batch_execute(
 	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
-	aerospike_batch_read_callback callback, void* udata, int read_attr)
+	const char** bins, aerospike_batch_read_callback callback, aerospike_batch_stream_callback stream,
+	aerospike_batch_node_callback node_callback, void* udata, int read_attr)
 {
 	as_error_reset(err);
 	
@@ -356,10 +724,26 @@ as_batch_execute(
 	uint32_t n_keys = batch->keys.size;
 	
 	if (n_keys <= 0) {
-		callback(0, 0, udata);
+		if (callback) {
+			callback(0, 0, udata);
+		}
 		return AEROSPIKE_OK;
 	}
 	
+	// Size selected bin names once for all node commands.
+	uint32_t n_bins = 0;
+	size_t bins_size = 0;
+	
+	if (bins) {
+		for (n_bins = 0; bins[n_bins] != NULL && bins[n_bins][0] != '\0'; n_bins++) {
+			as_status status = as_command_bin_name_size(err, bins[n_bins], &bins_size);
+			
+			if (status != AEROSPIKE_OK) {
+				return status;
+			}
+		}
+	}
+	
 	as_cluster* cluster = as->cluster;
 	as_nodes* nodes = as_nodes_reserve(cluster);
 	uint32_t n_nodes = nodes->size;
@@ -369,12 +753,14 @@ as_batch_execute(
 		return as_error_set_message(err, AEROSPIKE_ERR_SERVER, "Batch command failed because cluster is empty.");
 	}
 	
-	// Allocate results array on stack.  May be an issue for huge batch.
-	size_t size = sizeof(as_batch_read) * n_keys;
-	as_batch_read* results = (as_batch_read*)alloca(size);
+	// Results and per node state are on the heap, so stack use does not depend
+	// on batch size.  Streamed records are handed to the callback one at a time.
+	as_batch_read* results = stream ? 0 : (as_batch_read*)cf_malloc(sizeof(as_batch_read) * n_keys);
 	
-	as_batch_node* batch_nodes = alloca(sizeof(as_batch_node) * n_nodes);
-	char* ns = batch->keys.entries[0].ns;
+	// Keys are grouped by node and namespace, so there are at least as many
+	// groups as nodes when all keys are in one namespace.
+	uint32_t batch_nodes_capacity = n_nodes;
+	as_batch_node* batch_nodes = cf_malloc(sizeof(as_batch_node) * batch_nodes_capacity);
 	uint32_t n_batch_nodes = 0;
 	as_status status = AEROSPIKE_OK;
 	
@@ -382,68 +768,92 @@ as_batch_execute(
 	uint32_t offsets_capacity = n_keys / n_nodes;
 	offsets_capacity += offsets_capacity >> 2;
 	
-	// Map keys to server nodes.
+	if (offsets_capacity < 8) {
+		offsets_capacity = 8;
+	}
+	
+	// Map keys to server nodes.  Only nodes that get a batch node are reserved.
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	
 	for (uint32_t i = 0; i < n_keys; i++) {
 		as_key* key = &batch->keys.entries[i];
-		as_batch_read* result = &results[i];
-		result->key = key;
-		result->result = AEROSPIKE_ERR_RECORD_NOT_FOUND;
 		
-		// Only support batch commands with all keys in the same namespace.
-		if (strcmp(ns, key->ns)) {
-			as_batch_release_nodes(batch_nodes, n_batch_nodes);
-			as_nodes_release(nodes);
-			return as_error_set_message(err, AEROSPIKE_ERR_PARAM, "Batch keys must all be in the same namespace.");
+		if (results) {
+			as_batch_read* result = &results[i];
+			result->key = key;
+			result->result = AEROSPIKE_ERR_RECORD_NOT_FOUND;
+			as_record_init(&result->record, 0);
 		}
 		
 		status = as_key_set_digest(err, key);
 		
 		if (status != AEROSPIKE_OK) {
+			ck_epoch_end(&as_cluster_epoch, record);
 			as_batch_release_nodes(batch_nodes, n_batch_nodes);
+			as_batch_destroy_results(results, i + 1);
 			as_nodes_release(nodes);
 			return status;
 		}
 		
-		as_node* node = as_node_get(cluster, key->ns, (cf_digest*)key->digest.value, false, AS_POLICY_REPLICA_MASTER);
-		as_batch_node* batch_node = as_batch_node_find(batch_nodes, n_batch_nodes, node);
+		as_node* node = as_node_get(cluster, key->ns, key->_ns_id, (cf_digest*)key->digest.value, false, AS_POLICY_REPLICA_MASTER);
+		as_batch_node* batch_node = as_batch_node_find(batch_nodes, n_batch_nodes, node, key);
 		
-		if (batch_node) {
-			// Release duplicate node
-			as_node_release(node);
-		}
-		else {
+		if (! batch_node) {
+			if (n_batch_nodes == batch_nodes_capacity) {
+				batch_nodes_capacity *= 2;
+				batch_nodes = cf_realloc(batch_nodes, sizeof(as_batch_node) * batch_nodes_capacity);
+			}
+			
 			// Add batch node.
+			as_node_reserve(node);
 			batch_node = &batch_nodes[n_batch_nodes++];
-			batch_node->node = node;  // Transfer node
-			as_vector_inita(&batch_node->offsets, sizeof(uint32_t), offsets_capacity);
+			batch_node->node = node;
+			batch_node->ns = key->ns;
+			batch_node->ns_id = key->_ns_id;
+			as_vector_init(&batch_node->offsets, sizeof(uint32_t), offsets_capacity);
+			as_vector_init(&batch_node->buffers, sizeof(uint8_t*), 4);
 		}
 		as_vector_append(&batch_node->offsets, &i);
 	}
+	ck_epoch_end(&as_cluster_epoch, record);
 	as_nodes_release(nodes);
 	
 	// Initialize batch worker threads.
 	as_batch_threads_init(cluster);
-	uint32_t error_mutex;
+	uint32_t error_mutex = 0;
+	uint32_t abort = 0;
 
 	// Initialize task.
 	as_batch_task task;
 	task.cluster = cluster;
-	task.ns = ns;
 	task.err = err;
 	task.complete_q = cf_queue_create(sizeof(as_batch_complete_task), true);
 	task.results = results;
+	task.stream = stream;
+	task.node_callback = node_callback;
+	task.udata = udata;
 	task.error_mutex = &error_mutex;
+	task.abort = stream ? &abort : 0;
 	task.n_keys = n_keys;
 	task.keys = batch->keys.entries;
-	task.timeout_ms = policy->timeout;
+	task.bins = bins;
+	task.n_bins = n_bins;
+	task.bins_size = (uint32_t)bins_size;
+	task.socket_timeout_ms = policy->socket_timeout;
+	task.timeout_ms = as_batch_attempt_timeout(&task, policy->timeout);
+	task.deadline_ms = as_socket_deadline(policy->timeout);
 	task.index = 0;
-	task.retry = AS_POLICY_RETRY_NONE;
+	task.retry = policy->retry;
 	task.read_attr = read_attr;
 	
-	// Run task for each node.
+	// Run task for each node and namespace.  Results are merged back in key
+	// order through each task's offsets.
 	for (uint32_t i = 0; i < n_batch_nodes; i++) {
 		as_batch_node* batch_node = &batch_nodes[i];
 		task.node = batch_node->node;
+		task.ns = batch_node->ns;
+		task.buffers = stream ? 0 : &batch_node->buffers;
 		memcpy(&task.offsets, &batch_node->offsets, sizeof(as_vector));
 		cf_queue_push(cluster->batch_q, &task);
 	}
@@ -453,7 +863,9 @@ as_batch_execute(
 		as_batch_complete_task complete;
 		cf_queue_pop(task.complete_q, &complete, CF_QUEUE_FOREVER);
 		
-		if (complete.result != AEROSPIKE_OK && status == AEROSPIKE_OK) {
+		// Stopping the stream early is not an error.
+		if (complete.result != AEROSPIKE_OK && complete.result != AEROSPIKE_ERR_CLIENT_ABORT &&
+			status == AEROSPIKE_OK) {
 			status = complete.result;
 		}
 	}
@@ -461,16 +873,16 @@ as_batch_execute(
 	// Release temporary queue.
 	cf_queue_destroy(task.complete_q);
 
-	// Release each node.
-	as_batch_release_nodes(batch_nodes, n_batch_nodes);
-
-	// Call user defined function with results.
-	callback(task.results, n_keys, udata);
-
-	// Destroy records. User is responsible for destroying keys with as_batch_destroy().
-	for (uint32_t i = 0; i < n_keys; i++) {
-		as_record_destroy(&task.results[i].record);
+	if (! stream) {
+		// Call user defined function with results.
+		callback(results, n_keys, udata);
+		
+		// Destroy records. User is responsible for destroying keys with as_batch_destroy().
+		as_batch_destroy_results(results, n_keys);
 	}
+	
+	// Release each node and the response buffers records referenced.
+	as_batch_release_nodes(batch_nodes, n_batch_nodes);
 	return status;
 }
 
@@ -483,7 +895,34 @@ aerospike_batch_get(
 	aerospike_batch_read_callback callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, callback, udata, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL);
+	return as_batch_execute(as, err, policy, batch, 0, callback, 0, 0, udata, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL);
+}
+
+/**
+ *	Look up multiple records by key, then return specified bins.
+ */
+as_status
+aerospike_batch_select(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	const char* bins[], aerospike_batch_read_callback callback, void* udata
+	)
+{
+	return as_batch_execute(as, err, policy, batch, bins, callback, 0, 0, udata, AS_MSG_INFO1_READ);
+}
+
+/**
+ *	Look up multiple records by key, then stream all bins of each record as it
+ *	is parsed.
+ */
+as_status
+aerospike_batch_get_stream(
+	aerospike* as, as_error* err, const as_policy_batch* policy, const as_batch* batch,
+	aerospike_batch_stream_callback callback, aerospike_batch_node_callback node_callback,
+	void* udata
+	)
+{
+	return as_batch_execute(as, err, policy, batch, 0, 0, callback, node_callback, udata,
+		AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL);
 }
 
 /**
@@ -495,5 +934,5 @@ aerospike_batch_exists(
 	aerospike_batch_read_callback callback, void* udata
 	)
 {
-	return as_batch_execute(as, err, policy, batch, callback, udata, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_NOBINDATA);
+	return as_batch_execute(as, err, policy, batch, 0, callback, 0, 0, udata, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_NOBINDATA);
 }
@@ -35,15 +35,17 @@
  *****************************************************************************/
 
 static inline void
-as_command_node_init(as_command_node* cn, as_cluster* cluster, const char* ns,
-	const cf_digest* digest, as_policy_replica replica, bool write)
+as_command_node_init(as_command_node* cn, as_cluster* cluster, const as_key* key,
+	as_policy_replica replica, bool write)
 {
 	cn->node = 0;
 	cn->cluster = cluster;
-	cn->ns = ns;
-	cn->digest = digest;
+	cn->ns = key->ns;
+	cn->ns_id = key->_ns_id;
+	cn->digest = (const cf_digest*)key->digest.value;
 	cn->replica = replica;
 	cn->write = write;
+	cn->hedge_delay_us = 0;
 }
 
 /**
@@ -82,9 +84,11 @@ as_status aerospike_key_get(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, policy->replica, false);
+	as_command_node_init(&cn, as->cluster, key, policy->replica, false);
+	cn.hedge_delay_us = policy->hedge_delay_us;
 	
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_result, rec);
+	as_parse_results_fn parse_fn = policy->zero_copy ? as_command_parse_result_zero_copy : as_command_parse_result;
+	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, parse_fn, rec);
 	
 	as_command_free(cmd, size);
 	return status;
@@ -140,9 +144,11 @@ as_status aerospike_key_select(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, policy->replica, false);
+	as_command_node_init(&cn, as->cluster, key, policy->replica, false);
+	cn.hedge_delay_us = policy->hedge_delay_us;
 	
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_result, rec);
+	as_parse_results_fn parse_fn = policy->zero_copy ? as_command_parse_result_zero_copy : as_command_parse_result;
+	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, parse_fn, rec);
 	
 	as_command_free(cmd, size);
 	return status;
@@ -184,10 +190,11 @@ as_status aerospike_key_exists(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, policy->replica, false);
+	as_command_node_init(&cn, as->cluster, key, policy->replica, false);
+	cn.hedge_delay_us = policy->hedge_delay_us;
 	
 	as_proto_msg msg;
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, AS_POLICY_RETRY_NONE, as_command_parse_header, &msg);
+	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
 	
 	as_command_free(cmd, size);
 
@@ -244,27 +251,33 @@ as_status aerospike_key_put(
 	uint32_t n_bins = rec->bins.size;
 	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_bins);
 	memset(buffers, 0, sizeof(as_buffer) * n_bins);
+	uint32_t n_refs = 0;
 
 	for (uint32_t i = 0; i < n_bins; i++) {
-		size += as_command_bin_size(&bins[i], &buffers[i]);
+		size += as_command_bin_size_iov(&bins[i], &buffers[i], &n_refs);
 	}
 	
+	// Large values are sent from the record itself, so the command buffer only
+	// holds headers and small values.
 	uint8_t* cmd = as_command_init(size);
+	as_command_iov iov;
+	as_command_iov_init(&iov, (struct iovec*)alloca(sizeof(struct iovec) * (n_refs * 2 + 1)), cmd);
+	
 	uint8_t* p = as_command_write_header(cmd, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, policy->exists, policy->gen, rec->gen, rec->ttl, policy->timeout, n_fields, n_bins);
 		
 	p = as_command_write_key(p, policy->key, key);
 
 	for (uint32_t i = 0; i < n_bins; i++) {
-		p = as_command_write_bin(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
+		p = as_command_write_bin_iov(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i], &iov);
 	}
 	
-	size = as_command_write_end(cmd, p);
+	as_command_iov_end(&iov, p);
 
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, as->cluster, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	as_proto_msg msg;
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
+	status = as_command_execute_iov(err, &cn, iov.list, iov.size, policy->timeout, policy->retry, as_command_parse_header, &msg);
 	
 	for (uint32_t i = 0; i < n_bins; i++) {
 		as_buffer* buffer = &buffers[i];
@@ -321,7 +334,7 @@ as_status aerospike_key_remove(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, as->cluster, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	as_proto_msg msg;
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_header, &msg);
@@ -381,6 +394,7 @@ as_status aerospike_key_operate(
 	size_t size = as_command_key_size(policy->key, key, &n_fields);
 	uint8_t read_attr = 0;
 	uint8_t write_attr = 0;
+	uint32_t n_refs = 0;
 	
 	for (int i = 0; i < n_operations; i++) {
 		as_binop* op = &ops->binops.entries[i];
@@ -395,26 +409,29 @@ as_status aerospike_key_operate(
 				write_attr |= AS_MSG_INFO2_WRITE;
 				break;
 		}
-		size += as_command_bin_size(&op->bin, &buffers[i]);
+		size += as_command_bin_size_iov(&op->bin, &buffers[i], &n_refs);
 	}
 
 	uint8_t* cmd = as_command_init(size);
 	memset(cmd,0,size);
+	as_command_iov iov;
+	as_command_iov_init(&iov, (struct iovec*)alloca(sizeof(struct iovec) * (n_refs * 2 + 1)), cmd);
+	
 	uint8_t* p = as_command_write_header(cmd, read_attr, write_attr, policy->commit_level, policy->consistency_level,
 				 AS_POLICY_EXISTS_IGNORE, policy->gen, ops->gen, ops->ttl, policy->timeout, n_fields, n_operations);
 	p = as_command_write_key(p, policy->key, key);
 	
 	for (uint32_t i = 0; i < n_operations; i++) {
 		as_binop* op = &ops->binops.entries[i];
-		p = as_command_write_bin(p, op->op, &op->bin, &buffers[i]);
+		p = as_command_write_bin_iov(p, op->op, &op->bin, &buffers[i], &iov);
 	}
 
-	size = as_command_write_end(cmd, p);
+	as_command_iov_end(&iov, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, policy->replica, write_attr != 0);
+	as_command_node_init(&cn, as->cluster, key, policy->replica, write_attr != 0);
 	
-	status = as_command_execute(err, &cn, cmd, size, policy->timeout, policy->retry, as_command_parse_result, rec);
+	status = as_command_execute_iov(err, &cn, iov.list, iov.size, policy->timeout, policy->retry, as_command_parse_result, rec);
 	
 	for (uint32_t i = 0; i < n_operations; i++) {
 		as_buffer* buffer = &buffers[i];
@@ -503,7 +520,7 @@ as_status aerospike_key_apply(
 	size = as_command_write_end(cmd, p);
 	
 	as_command_node cn;
-	as_command_node_init(&cn, as->cluster, key->ns, (const cf_digest*)&key->digest, AS_POLICY_REPLICA_MASTER, true);
+	as_command_node_init(&cn, as->cluster, key, AS_POLICY_REPLICA_MASTER, true);
 	
 	status = as_command_execute(err, &cn, cmd, size, policy->timeout, 0, as_command_parse_success_failure, result);
 	
@@ -512,3 +529,190 @@ as_status aerospike_key_apply(
 	as_serializer_destroy(&ser);
 	return status;
 }
+
+/******************************************************************************
+ * ASYNC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Asynchronously look up a record by key, then return all bins.
+ */
+as_status aerospike_key_get_async(
+	aerospike * as, as_error * err, const as_policy_read * policy, 
+	const as_key * key, as_async_record_listener listener, void * udata)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.read;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, size, policy->timeout);
+	uint8_t* p = as_command_write_header_read(cmd->buf, AS_MSG_INFO1_READ | AS_MSG_INFO1_GET_ALL, policy->consistency_level, policy->timeout, n_fields, 0);
+	p = as_command_write_key(p, policy->key, key);
+	cmd->len = as_command_write_end(cmd->buf, p);
+	cmd->type = AS_ASYNC_TYPE_RECORD;
+	cmd->listener.record = listener;
+	cmd->udata = udata;
+	
+	return as_event_command_execute(cmd, err, key->ns, key->_ns_id, (const cf_digest*)key->digest.value, policy->replica, false);
+}
+
+/**
+ *	Asynchronously store a record in the cluster.
+ */
+as_status aerospike_key_put_async(
+	aerospike * as, as_error * err, const as_policy_write * policy, 
+	const as_key * key, as_record * rec, as_async_write_listener listener, void * udata)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.write;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_bin* bins = rec->bins.entries;
+	uint32_t n_bins = rec->bins.size;
+	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_bins);
+	memset(buffers, 0, sizeof(as_buffer) * n_bins);
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		size += as_command_bin_size(&bins[i], &buffers[i]);
+	}
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, size, policy->timeout);
+	uint8_t* p = as_command_write_header(cmd->buf, 0, AS_MSG_INFO2_WRITE, policy->commit_level, 0, policy->exists, policy->gen, rec->gen, rec->ttl, policy->timeout, n_fields, n_bins);
+	p = as_command_write_key(p, policy->key, key);
+	
+	for (uint32_t i = 0; i < n_bins; i++) {
+		p = as_command_write_bin(p, AS_OPERATOR_WRITE, &bins[i], &buffers[i]);
+		
+		if (buffers[i].data) {
+			cf_free(buffers[i].data);
+		}
+	}
+	cmd->len = as_command_write_end(cmd->buf, p);
+	cmd->type = AS_ASYNC_TYPE_WRITE;
+	cmd->listener.write = listener;
+	cmd->udata = udata;
+	
+	return as_event_command_execute(cmd, err, key->ns, key->_ns_id, (const cf_digest*)key->digest.value, AS_POLICY_REPLICA_MASTER, true);
+}
+
+/**
+ *	Asynchronously remove a record from the cluster.
+ */
+as_status aerospike_key_remove_async(
+	aerospike * as, as_error * err, const as_policy_remove * policy, 
+	const as_key * key, as_async_write_listener listener, void * udata)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.remove;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, size, policy->timeout);
+	uint8_t* p = as_command_write_header(cmd->buf, 0, AS_MSG_INFO2_WRITE | AS_MSG_INFO2_DELETE, policy->commit_level, 0, AS_POLICY_EXISTS_IGNORE, policy->gen, 0, 0, policy->timeout, n_fields, 0);
+	p = as_command_write_key(p, policy->key, key);
+	cmd->len = as_command_write_end(cmd->buf, p);
+	cmd->type = AS_ASYNC_TYPE_WRITE;
+	cmd->not_found_ok = true;
+	cmd->listener.write = listener;
+	cmd->udata = udata;
+	
+	return as_event_command_execute(cmd, err, key->ns, key->_ns_id, (const cf_digest*)key->digest.value, AS_POLICY_REPLICA_MASTER, true);
+}
+
+/**
+ *	Asynchronously lookup a record by key, then perform specified operations.
+ */
+as_status aerospike_key_operate_async(
+	aerospike * as, as_error * err, const as_policy_operate * policy, 
+	const as_key * key, const as_operations * ops,
+	as_async_record_listener listener, void * udata)
+{
+	as_error_reset(err);
+	
+	if (! policy) {
+		policy = &as->config.policies.operate;
+	}
+	
+	as_status status = as_key_set_digest(err, (as_key*)key);
+	
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+	
+	uint32_t n_operations = ops->binops.size;
+	as_buffer* buffers = (as_buffer*)alloca(sizeof(as_buffer) * n_operations);
+	memset(buffers, 0, sizeof(as_buffer) * n_operations);
+	
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy->key, key, &n_fields);
+	uint8_t read_attr = 0;
+	uint8_t write_attr = 0;
+	
+	for (uint32_t i = 0; i < n_operations; i++) {
+		as_binop* op = &ops->binops.entries[i];
+		
+		switch (op->op)
+		{
+			case AS_OPERATOR_READ:
+				read_attr |= AS_MSG_INFO1_READ;
+				break;
+				
+			default:
+				write_attr |= AS_MSG_INFO2_WRITE;
+				break;
+		}
+		size += as_command_bin_size(&op->bin, &buffers[i]);
+	}
+	
+	as_event_command* cmd = as_event_command_create(as->cluster, size, policy->timeout);
+	uint8_t* p = as_command_write_header(cmd->buf, read_attr, write_attr, policy->commit_level, policy->consistency_level,
+				 AS_POLICY_EXISTS_IGNORE, policy->gen, ops->gen, ops->ttl, policy->timeout, n_fields, n_operations);
+	p = as_command_write_key(p, policy->key, key);
+	
+	for (uint32_t i = 0; i < n_operations; i++) {
+		as_binop* op = &ops->binops.entries[i];
+		p = as_command_write_bin(p, op->op, &op->bin, &buffers[i]);
+		
+		if (buffers[i].data) {
+			cf_free(buffers[i].data);
+		}
+	}
+	cmd->len = as_command_write_end(cmd->buf, p);
+	cmd->type = AS_ASYNC_TYPE_RECORD;
+	cmd->listener.record = listener;
+	cmd->udata = udata;
+	
+	return as_event_command_execute(cmd, err, key->ns, key->_ns_id, (const cf_digest*)key->digest.value, policy->replica, write_attr != 0);
+}
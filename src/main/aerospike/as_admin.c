@@ -169,8 +169,8 @@ as_admin_write_privileges(uint8_t** p, as_error* err, as_privilege** privileges,
 	return AEROSPIKE_OK;
 }
 
-static as_status
-as_admin_send(as_error* err, int fd, uint8_t* buffer, uint8_t* end, uint64_t deadline_ms)
+static uint32_t
+as_admin_write_proto(uint8_t* buffer, uint8_t* end)
 {
 	uint64_t len = end - buffer;
 	uint64_t proto = (len - 8) | (MSG_VERSION << 56) | (MSG_TYPE << 48);
@@ -180,7 +180,13 @@ as_admin_send(as_error* err, int fd, uint8_t* buffer, uint8_t* end, uint64_t dea
 	proto = cf_swap_to_be64(proto);
 	memcpy((uint64_t *)buffer, &proto, sizeof(uint64_t));
 #endif
-	
+	return (uint32_t)len;
+}
+
+static as_status
+as_admin_send(as_error* err, int fd, uint8_t* buffer, uint8_t* end, uint64_t deadline_ms)
+{
+	uint32_t len = as_admin_write_proto(buffer, end);
 	return as_socket_write_deadline(err, fd, buffer, len, deadline_ms);
 }
 
@@ -199,7 +205,8 @@ as_admin_execute(aerospike* as, as_error* err, const as_policy_admin* policy, ui
 	}
 	
 	int fd;
-	as_status status = as_node_get_connection(node, &fd);
+	bool reused;
+	as_status status = as_node_get_connection(node, &fd, &reused);
 	
 	if (status) {
 		as_node_release(node);
@@ -302,7 +309,8 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
 	}
 	
 	int fd;
-	as_status status = as_node_get_connection(node, &fd);
+	bool reused;
+	as_status status = as_node_get_connection(node, &fd, &reused);
 	
 	if (status) {
 		as_node_release(node);
@@ -334,34 +342,45 @@ as_admin_read_list(aerospike* as, as_error* err, const as_policy_admin* policy,
  *	FUNCTIONS
  *****************************************************************************/
 
-as_status
-as_authenticate(as_error* err, int fd, const char* user, const char* credential, uint64_t deadline_ms)
+uint32_t
+as_authenticate_set(const char* user, const char* credential, uint8_t* buffer)
 {
-	uint8_t buffer[AS_STACK_BUF_SIZE];
 	uint8_t* p = buffer + 8;
 
 	p = as_admin_write_header(p, AUTHENTICATE, 2);
 	p = as_admin_write_field_string(p, USER, user);
 	p = as_admin_write_field_string(p, CREDENTIAL, credential);
-	
-	as_status status = as_admin_send(err, fd, buffer, p, deadline_ms);
+	return as_admin_write_proto(buffer, p);
+}
+
+as_status
+as_authenticate_parse(as_error* err, uint8_t* buffer)
+{
+	as_status status = buffer[RESULT_CODE];
 	
 	if (status) {
-		return status;
+		as_error_set_message(err, status, as_error_string(status));
 	}
+	return status;
+}
 
-	status = as_socket_read_deadline(err, fd, buffer, HEADER_SIZE, deadline_ms);
+as_status
+as_authenticate(as_error* err, int fd, const char* user, const char* credential, uint64_t deadline_ms)
+{
+	uint8_t buffer[AS_STACK_BUF_SIZE];
+	uint32_t len = as_authenticate_set(user, credential, buffer);
+	as_status status = as_socket_write_deadline(err, fd, buffer, len, deadline_ms);
 	
 	if (status) {
 		return status;
 	}
-	
-	status = buffer[RESULT_CODE];
+
+	status = as_socket_read_deadline(err, fd, buffer, AS_AUTHENTICATE_RESPONSE_SIZE, deadline_ms);
 	
 	if (status) {
-		as_error_set_message(err, status, as_error_string(status));
+		return status;
 	}
-	return status;
+	return as_authenticate_parse(err, buffer);
 }
 
 as_status
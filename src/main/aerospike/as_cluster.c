@@ -16,6 +16,7 @@
  */
 #include <aerospike/as_cluster.h>
 #include <aerospike/as_admin.h>
+#include <aerospike/as_event.h>
 #include <aerospike/as_info.h>
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_lookup.h>
@@ -31,9 +32,6 @@
  *	Function declarations
  *****************************************************************************/
 
-bool
-as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */ friends);
-
 void
 as_batch_threads_shutdown(as_cluster* cluster);
 
@@ -43,10 +41,80 @@ as_scan_threads_shutdown(as_cluster* cluster);
 void
 as_query_threads_shutdown(as_cluster* cluster);
 
+/******************************************************************************
+ *	Globals
+ *****************************************************************************/
+
+ck_epoch_t as_cluster_epoch;
+static pthread_once_t as_cluster_epoch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t as_cluster_epoch_key;
+
 /******************************************************************************
  *	Functions
  *****************************************************************************/
 
+CK_EPOCH_CONTAINER(as_gc_item, entry, as_gc_item_container)
+
+static void
+as_cluster_epoch_record_release(void* record)
+{
+	// Record is recycled by the next thread that needs one.
+	ck_epoch_unregister(&as_cluster_epoch, record);
+}
+
+static void
+as_cluster_epoch_init()
+{
+	ck_epoch_init(&as_cluster_epoch);
+	pthread_key_create(&as_cluster_epoch_key, as_cluster_epoch_record_release);
+}
+
+static ck_epoch_record_t*
+as_cluster_epoch_register()
+{
+	pthread_once(&as_cluster_epoch_once, as_cluster_epoch_init);
+	
+	ck_epoch_record_t* record = ck_epoch_recycle(&as_cluster_epoch);
+	
+	if (! record) {
+		// Records stay on the epoch's list for the life of the process.
+		record = cf_malloc(sizeof(ck_epoch_record_t));
+		ck_epoch_register(&as_cluster_epoch, record);
+	}
+	return record;
+}
+
+ck_epoch_record_t*
+as_cluster_epoch_record()
+{
+	pthread_once(&as_cluster_epoch_once, as_cluster_epoch_init);
+	
+	ck_epoch_record_t* record = pthread_getspecific(as_cluster_epoch_key);
+	
+	if (! record) {
+		record = as_cluster_epoch_register();
+		pthread_setspecific(as_cluster_epoch_key, record);
+	}
+	return record;
+}
+
+static void
+as_cluster_gc_release(ck_epoch_entry_t* entry)
+{
+	as_gc_item* item = as_gc_item_container(entry);
+	item->release_fn(item->data);
+	cf_free(item);
+}
+
+void
+as_cluster_defer(as_cluster* cluster, void* data, as_release_fn release_fn)
+{
+	as_gc_item* item = cf_malloc(sizeof(as_gc_item));
+	item->data = data;
+	item->release_fn = release_fn;
+	ck_epoch_call(&as_cluster_epoch, cluster->gc, &item->entry, as_cluster_gc_release);
+}
+
 static inline void
 set_nodes(as_cluster* cluster, as_nodes* nodes)
 {
@@ -165,6 +233,14 @@ release_nodes(as_nodes* nodes)
 void
 as_cluster_add_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ nodes_to_add)
 {
+	// Fill connection pools before the nodes become visible to commands.
+	if (cluster->min_conns_per_node > 0) {
+		for (uint32_t i = 0; i < nodes_to_add->size; i++) {
+			as_node* node = as_vector_get_ptr(nodes_to_add, i);
+			as_node_warm_connections(node, cluster->min_conns_per_node);
+		}
+	}
+	
 	// Create temporary nodes array.
 	as_nodes* nodes_old = cluster->nodes;
 	as_nodes* nodes_new = as_nodes_create(nodes_old->size + nodes_to_add->size);
@@ -179,10 +255,7 @@ as_cluster_add_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ nodes
 	set_nodes(cluster, nodes_new);
 	
 	// Put old nodes on garbage collector stack.
-	as_gc_item item;
-	item.data = nodes_old;
-	item.release_fn = (as_release_fn)release_nodes;
-	as_vector_append(cluster->gc, &item);
+	as_cluster_defer(cluster, nodes_old, (as_release_fn)release_nodes);
 }
 
 static void
@@ -422,10 +495,7 @@ as_cluster_remove_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ no
 		if (as_cluster_find_node_by_reference(nodes_to_remove, node)) {
 			as_address* a = as_node_get_address_full(node);
 			as_log_info("Remove node %s %s:%d", node->name, a->name, (int)cf_swap_from_be16(a->addr.sin_port));
-			as_gc_item item;
-			item.data = node;
-			item.release_fn = (as_release_fn)release_node;
-			as_vector_append(cluster->gc, &item);
+			as_cluster_defer(cluster, node, (as_release_fn)release_node);
 		}
 		else {
 			if (count < nodes_new->size) {
@@ -447,10 +517,7 @@ as_cluster_remove_nodes_copy(as_cluster* cluster, as_vector* /* <as_node*> */ no
 	set_nodes(cluster, nodes_new);
 
 	// Put old nodes on garbage collector stack.
-	as_gc_item item;
-	item.data = nodes_old;
-	item.release_fn = (as_release_fn)release_nodes;
-	as_vector_append(cluster->gc, &item);
+	as_cluster_defer(cluster, nodes_old, (as_release_fn)release_nodes);
 }
 
 static void
@@ -519,17 +586,103 @@ as_cluster_set_partition_size(as_cluster* cluster)
 	return (first_error)? first_error : AEROSPIKE_ERR_CLIENT;
 }
 
-/**
- *	Release data structures schuleduled for removal in previous cluster tend.
- */
+static void*
+as_cluster_tend_worker(void* data)
+{
+	as_cluster* cluster = (as_cluster*)data;
+	as_node_info* info;
+	
+	while (cf_queue_pop(cluster->tend_q, &info, CF_QUEUE_FOREVER) == CF_QUEUE_OK) {
+		// This is how tend pool shutdown signals we're done.
+		if (! info) {
+			break;
+		}
+		
+		as_node_refresh_fetch(cluster, info);
+		cf_queue_push(cluster->tend_complete_q, &info);
+	}
+	return NULL;
+}
+
 static void
-as_cluster_gc(as_vector* /* <as_gc_item> */ vector)
+as_cluster_tend_threads_init(as_cluster* cluster, uint32_t size)
 {
-	for (uint32_t i = 0; i < vector->size; i++) {
-		as_gc_item* item = as_vector_get(vector, i);
-		item->release_fn(item->data);
+	if (size <= 1) {
+		return;
+	}
+	
+	cluster->tend_q = cf_queue_create(sizeof(as_node_info*), true);
+	cluster->tend_complete_q = cf_queue_create(sizeof(as_node_info*), true);
+	cluster->tend_threads = cf_malloc(sizeof(pthread_t) * size);
+	cluster->tend_threads_size = size;
+	
+	for (uint32_t i = 0; i < size; i++) {
+		pthread_create(&cluster->tend_threads[i], 0, as_cluster_tend_worker, cluster);
+	}
+}
+
+static void
+as_cluster_tend_threads_shutdown(as_cluster* cluster)
+{
+	if (cluster->tend_threads_size == 0) {
+		return;
+	}
+	
+	// The tend thread has stopped, so nothing else is queued after these.
+	as_node_info* info = NULL;
+	
+	for (uint32_t i = 0; i < cluster->tend_threads_size; i++) {
+		cf_queue_push(cluster->tend_q, &info);
+	}
+	
+	for (uint32_t i = 0; i < cluster->tend_threads_size; i++) {
+		pthread_join(cluster->tend_threads[i], NULL);
+	}
+	
+	cf_queue_destroy(cluster->tend_q);
+	cf_queue_destroy(cluster->tend_complete_q);
+	cf_free(cluster->tend_threads);
+	cluster->tend_q = NULL;
+	cluster->tend_complete_q = NULL;
+	cluster->tend_threads = NULL;
+	cluster->tend_threads_size = 0;
+}
+
+static void
+as_cluster_fetch_info(as_cluster* cluster, as_node_info* infos, uint32_t n_infos)
+{
+	if (cluster->tend_threads_size == 0 || n_infos <= 1) {
+		for (uint32_t i = 0; i < n_infos; i++) {
+			as_node_refresh_fetch(cluster, &infos[i]);
+		}
+		return;
+	}
+	
+	for (uint32_t i = 0; i < n_infos; i++) {
+		as_node_info* info = &infos[i];
+		cf_queue_push(cluster->tend_q, &info);
+	}
+	
+	// Wait for all fetches.  Each is bounded by the info request timeout.
+	for (uint32_t i = 0; i < n_infos; i++) {
+		as_node_info* info;
+		cf_queue_pop(cluster->tend_complete_q, &info, CF_QUEUE_FOREVER);
 	}
-	as_vector_clear(vector);
+}
+
+static void
+as_cluster_tend_stats_update(as_cluster* cluster, uint64_t elapsed_us)
+{
+	// Only the tend thread writes these.
+	uint32_t us = elapsed_us > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed_us;
+	
+	ck_pr_store_32(&cluster->tend_last_us, us);
+	
+	if (us > cluster->tend_max_us) {
+		ck_pr_store_32(&cluster->tend_max_us, us);
+	}
+	ck_pr_store_64(&cluster->tend_total_us, cluster->tend_total_us + elapsed_us);
+	ck_pr_store_32(&cluster->tend_count, cluster->tend_count + 1);
 }
 
 /**
@@ -538,12 +691,13 @@ as_cluster_gc(as_vector* /* <as_gc_item> */ vector)
 int
 as_cluster_tend(as_cluster* cluster, bool enable_seed_warnings)
 {
+	uint64_t begin = cf_getus();
+	
 	// All node additions/deletions are performed in tend thread.
-	// Garbage collect data structures released in previous tend.
-	// This tend interval delay substantially reduces the chance of
-	// deleting a ref counted data structure when other threads
-	// are stuck between assigment and incrementing the ref count.
-	as_cluster_gc(cluster->gc);
+	// Garbage collect data structures released in previous tends that
+	// no thread can still see.  Threads between loading a pointer and
+	// incrementing its ref count are inside an epoch section.
+	ck_epoch_poll(&as_cluster_epoch, cluster->gc);
 	
 	// If active nodes don't exist, seed cluster.
 	as_nodes* nodes = cluster->nodes;
@@ -572,24 +726,38 @@ as_cluster_tend(as_cluster* cluster, bool enable_seed_warnings)
 		node->friends = 0;
 	}
 	
-	// Refresh all known nodes.
-	as_vector friends;
-	as_vector_inita(&friends, sizeof(as_friend), 8);
-	uint32_t refresh_count = 0;
+	// Refresh all known nodes.  Info requests are sent first, concurrently when
+	// the tend pool is enabled, then the responses are applied in node order.
+	as_node_info* infos = cf_malloc(sizeof(as_node_info) * (nodes->size ? nodes->size : 1));
+	uint32_t n_infos = 0;
 	
 	for (uint32_t i = 0; i < nodes->size; i++) {
 		as_node* node = nodes->array[i];
 		
 		if (node->active) {
-			if (as_node_refresh(cluster, node, &friends)) {
-				node->failures = 0;
-				refresh_count++;
-			}
-			else {
-				node->failures++;
-			}
+			infos[n_infos++].node = node;
 		}
 	}
+	as_cluster_fetch_info(cluster, infos, n_infos);
+	
+	as_vector friends;
+	as_vector_inita(&friends, sizeof(as_friend), 8);
+	uint32_t refresh_count = 0;
+	
+	for (uint32_t i = 0; i < n_infos; i++) {
+		as_node* node = infos[i].node;
+		
+		if (as_node_refresh_apply(cluster, &infos[i], &friends)) {
+			node->failures = 0;
+			refresh_count++;
+		}
+		else {
+			node->failures++;
+		}
+		as_node_close_idle_connections(node);
+		as_node_breaker_roll(node);
+	}
+	cf_free(infos);
 	
 	// Handle nodes changes determined from refreshes.
 	as_vector nodes_to_add;
@@ -614,6 +782,8 @@ as_cluster_tend(as_cluster* cluster, bool enable_seed_warnings)
 	as_vector_destroy(&nodes_to_add);
 	as_vector_destroy(&nodes_to_remove);
 	as_vector_destroy(&friends);
+	
+	as_cluster_tend_stats_update(cluster, cf_getus() - begin);
 	return 0;
 }
 
@@ -667,6 +837,10 @@ as_cluster_tender(void* data)
 	while (cluster->valid) {
 		as_cluster_tend(cluster, false);
 		
+		if (cluster->snapshot_path) {
+			as_cluster_snapshot_save(cluster);
+		}
+		
 		// Convert tend interval into absolute timeout.
 		cf_clock_current_add(&delta, &abstime);
 		
@@ -721,9 +895,52 @@ as_cluster_add_seeds(as_cluster* cluster)
 	as_vector_destroy(&seeds_to_add);
 }
 
+/**
+ * Return true if a node loaded from the snapshot answers with its saved name.
+ */
+static bool
+as_cluster_snapshot_answers(as_cluster* cluster)
+{
+	as_nodes* nodes = cluster->nodes;
+	char name[AS_NODE_NAME_SIZE];
+	
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		
+		if (as_lookup_node_name(cluster, as_node_get_address(node), name, AS_NODE_NAME_SIZE) == 0 &&
+			strcmp(name, node->name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int
 as_cluster_init(as_cluster* cluster, bool fail_if_not_connected)
 {
+	if (cluster->snapshot_path) {
+		// Route with the saved partition map right away.  The tend thread checks
+		// each node's partition generation and refreshes stale maps.
+		as_vector nodes_to_add;
+		as_vector_inita(&nodes_to_add, sizeof(as_node*), 16);
+		
+		if (as_cluster_snapshot_load(cluster, &nodes_to_add)) {
+			as_cluster_add_nodes(cluster, &nodes_to_add);
+			
+			if (as_cluster_snapshot_answers(cluster)) {
+				as_vector_destroy(&nodes_to_add);
+				as_cluster_add_seeds(cluster);
+				cluster->valid = true;
+				return 0;
+			}
+			
+			// None of the saved nodes is up.  Discover the cluster from the seeds.
+			as_log_warn("No node in partition snapshot %s answered", cluster->snapshot_path);
+			as_cluster_remove_nodes(cluster, &nodes_to_add);
+		}
+		as_vector_destroy(&nodes_to_add);
+	}
+	
 	// Tend cluster until all nodes identified.
 	int status = as_wait_till_stabilized(cluster);
 	
@@ -782,9 +999,10 @@ ip_map_create(as_addr_map* source_map, uint32_t size)
 }
 
 as_node*
-as_node_get_random(as_cluster* cluster)
+as_node_choose_random(as_cluster* cluster)
 {
-	as_nodes* nodes = as_nodes_reserve(cluster);
+	// Replaced nodes arrays and removed nodes are released through the cluster epoch.
+	as_nodes* nodes = (as_nodes *)ck_pr_load_ptr(&cluster->nodes);
 	uint32_t size = nodes->size;
 	
 	for (uint32_t i = 0; i < size; i++) {
@@ -794,15 +1012,26 @@ as_node_get_random(as_cluster* cluster)
 		uint8_t active = ck_pr_load_8(&node->active);
 		
 		if (active) {
-			as_node_reserve(node);
-			as_nodes_release(nodes);
 			return node;
 		}
 	}
-	as_nodes_release(nodes);
 	return 0;
 }
 
+as_node*
+as_node_get_random(as_cluster* cluster)
+{
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_node* node = as_node_choose_random(cluster);
+	
+	if (node) {
+		as_node_reserve(node);
+	}
+	ck_epoch_end(&as_cluster_epoch, record);
+	return node;
+}
+
 as_node*
 as_node_get_by_name(as_cluster* cluster, const char* name)
 {
@@ -849,6 +1078,22 @@ as_cluster_get_node_names(as_cluster* cluster, int* n_nodes, char** node_names)
 	as_nodes_release(nodes);
 }
 
+void
+as_cluster_get_hedge_stats(as_cluster* cluster, as_hedge_stats* stats)
+{
+	stats->issued = ck_pr_load_32(&cluster->hedges_issued);
+	stats->won = ck_pr_load_32(&cluster->hedges_won);
+}
+
+void
+as_cluster_get_tend_stats(as_cluster* cluster, as_tend_stats* stats)
+{
+	stats->count = ck_pr_load_32(&cluster->tend_count);
+	stats->last_us = ck_pr_load_32(&cluster->tend_last_us);
+	stats->max_us = ck_pr_load_32(&cluster->tend_max_us);
+	stats->total_us = ck_pr_load_64(&cluster->tend_total_us);
+}
+
 bool
 as_cluster_is_connected(as_cluster* cluster)
 {
@@ -888,9 +1133,23 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 	
 	// Initialize cluster tend and node parameters
 	cluster->tend_interval = (config->tender_interval < 1000)? 1000 : config->tender_interval;
-	cluster->conn_queue_size = config->max_threads + 1;  // Add one connection for tend thread.
+	cluster->conn_queue_size = config->max_conns_per_node ? config->max_conns_per_node :
+		config->max_threads + 1;  // Add one connection for tend thread.
+	cluster->min_conns_per_node = config->min_conns_per_node < cluster->conn_queue_size ?
+		config->min_conns_per_node : cluster->conn_queue_size;
+	cluster->max_socket_idle = config->max_socket_idle_sec;
+	cluster->thread_conn_cache = config->thread_conn_cache;
+	cluster->max_commands_per_node = config->max_commands_per_node;
+	cluster->breaker_error_percent = config->breaker_error_percent;
+	cluster->breaker_min_commands = config->breaker_min_commands;
+	cluster->breaker_open_ms = config->breaker_open_ms;
 	cluster->conn_timeout_ms = (config->conn_timeout_ms == 0) ? 1000 : config->conn_timeout_ms;
 	
+	// Shared memory clusters already start with the map tended by another process.
+	if (config->snapshot_path[0] && ! config->use_shm) {
+		cluster->snapshot_path = cf_strdup(config->snapshot_path);
+	}
+	
 	// Initialize seed hosts.
 	cluster->seeds_size = seeds_size(config);
 	cluster->seeds = seeds_create(config, cluster->seeds_size);
@@ -907,16 +1166,24 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 	// Initialize empty partition tables.
 	cluster->partition_tables = as_partition_tables_create(0);
 	
-	// Initialize garbage collection array.
-	cluster->gc = as_vector_create(sizeof(as_gc_item), 8);
+	// Initialize garbage collection epoch record.
+	cluster->gc = as_cluster_epoch_register();
 
 	// Initialize tend lock and condition.
 	pthread_mutex_init(&cluster->tend_lock, NULL);
 	pthread_cond_init(&cluster->tend_cond, NULL);
 
+	// Initialize tend pool.  It must exist before the first tend below.
+	as_cluster_tend_threads_init(cluster, config->tend_threads);
+	
 	// Initialize batch.
 	pthread_mutex_init(&cluster->batch_init_lock, 0);
 	
+	// Initialize async event loops.  Loops are started on first async command.
+	cluster->event_loops_size = config->event_loops;
+	cluster->async_pipeline = config->async_pipeline;
+	pthread_mutex_init(&cluster->event_init_lock, 0);
+	
 	if (config->use_shm) {
 		// Create shared memory cluster.
 		int status = as_shm_create(cluster, config);
@@ -946,6 +1213,9 @@ as_cluster_create(as_config* config, as_cluster** cluster_out)
 void
 as_cluster_destroy(as_cluster* cluster)
 {
+	// Shutdown async event loops.
+	as_event_loops_shutdown(cluster);
+	
 	// Shutdown work queues.
 	as_batch_threads_shutdown(cluster);
 	as_scan_threads_shutdown(cluster);
@@ -967,10 +1237,13 @@ as_cluster_destroy(as_cluster* cluster)
 			as_shm_destroy(cluster);
 		}
 	}
+	
+	// Stop tend pool after the tend thread so no fetch is left waiting.
+	as_cluster_tend_threads_shutdown(cluster);
 
 	// Release everything in garbage collector.
-	as_cluster_gc(cluster->gc);
-	as_vector_destroy(cluster->gc);
+	ck_epoch_barrier(&as_cluster_epoch, cluster->gc);
+	ck_epoch_unregister(&as_cluster_epoch, cluster->gc);
 		
 	// Release partition tables.
 	as_partition_tables* tables = cluster->partition_tables;
@@ -979,9 +1252,11 @@ as_cluster_destroy(as_cluster* cluster)
 	}
 	as_partition_tables_release(tables);
 	
-	// Release nodes.
+	// Release nodes.  Deactivate them first so threads drop any cached
+	// connections to them.
 	as_nodes* nodes = cluster->nodes;
 	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node_deactivate(nodes->array[i]);
 		as_node_release(nodes->array[i]);
 	}
 	as_nodes_release(nodes);
@@ -1012,8 +1287,12 @@ as_cluster_destroy(as_cluster* cluster)
 	// Destroy batch lock.
 	pthread_mutex_destroy(&cluster->batch_init_lock);
 	
+	// Destroy async event loops lock.
+	pthread_mutex_destroy(&cluster->event_init_lock);
+	
 	cf_free(cluster->user);
 	cf_free(cluster->password);
+	cf_free(cluster->snapshot_path);
 	
 	// Destroy cluster.
 	cf_free(cluster);
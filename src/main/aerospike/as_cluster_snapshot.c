@@ -0,0 +1,400 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+#include <aerospike/as_string.h>
+#include <aerospike/as_vector.h>
+#include <citrusleaf/alloc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/******************************************************************************
+ *	Snapshot file layout, in host byte order:
+ *
+ *	as_snapshot_header
+ *	as_snapshot_node[n_nodes]
+ *	n_tables times:
+ *		char ns[AS_MAX_NAMESPACE_SIZE]
+ *		uint16_t master[n_partitions]
+ *		uint16_t prole[n_partitions]
+ *
+ *	Partition owners are indexes into the node array, or AS_SNAPSHOT_NO_NODE.
+ *****************************************************************************/
+
+#define AS_SNAPSHOT_MAGIC 0x41534D50
+#define AS_SNAPSHOT_VERSION 1
+#define AS_SNAPSHOT_NO_NODE 0xFFFF
+#define AS_SNAPSHOT_FNV_INIT 0xcbf29ce484222325ULL
+#define AS_SNAPSHOT_FNV_PRIME 0x100000001b3ULL
+
+/******************************************************************************
+ *	TYPES
+ *****************************************************************************/
+
+typedef struct as_snapshot_header_s {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t n_partitions;
+	uint32_t n_nodes;
+	uint32_t n_tables;
+	uint32_t reserved;
+	uint64_t size;
+	uint64_t checksum;
+} as_snapshot_header;
+
+typedef struct as_snapshot_node_s {
+	char name[AS_NODE_NAME_SIZE];
+	uint32_t partition_generation;
+	in_addr_t addr;
+	in_port_t port;
+	uint16_t reserved;
+} as_snapshot_node;
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint64_t
+as_snapshot_hash(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* end = p + size;
+
+	while (p < end) {
+		hash ^= *p++;
+		hash *= AS_SNAPSHOT_FNV_PRIME;
+	}
+	return hash;
+}
+
+static inline size_t
+as_snapshot_size(uint32_t n_nodes, uint32_t n_tables, uint32_t n_partitions)
+{
+	return sizeof(as_snapshot_header) + sizeof(as_snapshot_node) * n_nodes +
+		(AS_MAX_NAMESPACE_SIZE + sizeof(uint16_t) * 2 * n_partitions) * (size_t)n_tables;
+}
+
+static int
+as_snapshot_node_compare(const void* a, const void* b)
+{
+	const as_node* x = *(as_node* const*)a;
+	const as_node* y = *(as_node* const*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint16_t
+as_snapshot_node_index(as_node** sorted, uint16_t* indexes, uint32_t n_nodes, as_node* node)
+{
+	if (! node) {
+		return AS_SNAPSHOT_NO_NODE;
+	}
+
+	as_node** found = bsearch(&node, sorted, n_nodes, sizeof(as_node*), as_snapshot_node_compare);
+
+	// Partitions may still point at nodes that left the cluster.
+	return found ? indexes[found - sorted] : AS_SNAPSHOT_NO_NODE;
+}
+
+static bool
+as_snapshot_write_file(const char* path, const uint8_t* buf, size_t size)
+{
+	// Write a temporary file and rename it, so readers never see a partial snapshot.
+	char tmp[AS_CONFIG_PATH_MAX_SIZE + 8];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		as_log_warn("Failed to create partition snapshot %s: %d", tmp, errno);
+		return false;
+	}
+
+	const uint8_t* p = buf;
+	size_t remaining = size;
+
+	while (remaining > 0) {
+		ssize_t rv = write(fd, p, remaining);
+
+		if (rv < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			as_log_warn("Failed to write partition snapshot %s: %d", tmp, errno);
+			close(fd);
+			unlink(tmp);
+			return false;
+		}
+		p += rv;
+		remaining -= rv;
+	}
+	close(fd);
+
+	if (rename(tmp, path) != 0) {
+		as_log_warn("Failed to rename partition snapshot %s: %d", tmp, errno);
+		unlink(tmp);
+		return false;
+	}
+	return true;
+}
+
+static bool
+as_snapshot_valid(const uint8_t* buf, size_t size)
+{
+	if (size < sizeof(as_snapshot_header)) {
+		return false;
+	}
+
+	const as_snapshot_header* header = (const as_snapshot_header*)buf;
+
+	if (header->magic != AS_SNAPSHOT_MAGIC || header->version != AS_SNAPSHOT_VERSION ||
+		header->size != size || header->n_partitions == 0 || header->n_nodes == 0 ||
+		header->n_nodes >= AS_SNAPSHOT_NO_NODE || header->n_tables == 0 ||
+		header->n_tables >= AS_NAMESPACE_IDS) {
+		return false;
+	}
+
+	if (as_snapshot_size(header->n_nodes, header->n_tables, header->n_partitions) != size) {
+		return false;
+	}
+
+	const uint8_t* body = buf + sizeof(as_snapshot_header);
+	return as_snapshot_hash(AS_SNAPSHOT_FNV_INIT, body, size - sizeof(as_snapshot_header)) == header->checksum;
+}
+
+static as_node*
+as_snapshot_owner(as_node** nodes, uint32_t n_nodes, uint16_t index)
+{
+	if (index >= n_nodes) {
+		return 0;
+	}
+
+	as_node* node = nodes[index];
+	as_node_reserve(node);
+	return node;
+}
+
+static bool
+as_snapshot_apply(as_cluster* cluster, const uint8_t* buf, size_t size, as_vector* nodes_to_add)
+{
+	if (! as_snapshot_valid(buf, size)) {
+		as_log_info("Ignore invalid partition snapshot %s", cluster->snapshot_path);
+		return false;
+	}
+
+	const as_snapshot_header* header = (const as_snapshot_header*)buf;
+	const as_snapshot_node* records = (const as_snapshot_node*)(buf + sizeof(as_snapshot_header));
+	const uint8_t* p = (const uint8_t*)(records + header->n_nodes);
+	uint32_t n_partitions = header->n_partitions;
+
+	// Check names before creating anything, so a bad snapshot leaves no trace.
+	for (uint32_t i = 0; i < header->n_nodes; i++) {
+		if (memchr(records[i].name, 0, AS_NODE_NAME_SIZE) == 0 || records[i].name[0] == 0) {
+			return false;
+		}
+	}
+
+	const uint8_t* t = p;
+
+	for (uint32_t i = 0; i < header->n_tables; i++) {
+		if (memchr(t, 0, AS_MAX_NAMESPACE_SIZE) == 0 || *t == 0) {
+			return false;
+		}
+		t += AS_MAX_NAMESPACE_SIZE + sizeof(uint16_t) * 2 * n_partitions;
+	}
+
+	as_node** nodes = cf_malloc(sizeof(as_node*) * header->n_nodes);
+
+	for (uint32_t i = 0; i < header->n_nodes; i++) {
+		const as_snapshot_node* rec = &records[i];
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = rec->addr;
+		addr.sin_port = rec->port;
+
+		// The first tend compares this generation with the node's and fetches
+		// replica maps only if they differ.
+		nodes[i] = as_node_create(cluster, rec->name, &addr);
+		nodes[i]->partition_generation = rec->partition_generation;
+		as_vector_append(nodes_to_add, &nodes[i]);
+	}
+
+	as_partition_tables* tables = as_partition_tables_create(header->n_tables);
+
+	for (uint32_t i = 0; i < header->n_tables; i++) {
+		as_partition_table* table = as_partition_table_create((const char*)p, n_partitions);
+		p += AS_MAX_NAMESPACE_SIZE;
+
+		uint16_t owners[2];
+
+		for (uint32_t j = 0; j < n_partitions; j++) {
+			memcpy(owners, p + sizeof(uint16_t) * j, sizeof(uint16_t));
+			memcpy(owners + 1, p + sizeof(uint16_t) * (n_partitions + j), sizeof(uint16_t));
+			table->partitions[j].master = as_snapshot_owner(nodes, header->n_nodes, owners[0]);
+			table->partitions[j].prole = as_snapshot_owner(nodes, header->n_nodes, owners[1]);
+		}
+		p += sizeof(uint16_t) * 2 * n_partitions;
+
+		tables->array[i] = table;
+
+		if (table->ns_id) {
+			tables->index[table->ns_id] = table;
+		}
+	}
+	cf_free(nodes);
+
+	// Called before the cluster is visible to other threads.
+	as_partition_tables_release(cluster->partition_tables);
+	cluster->partition_tables = tables;
+	cluster->n_partitions = n_partitions;
+
+	as_log_info("Loaded partition snapshot %s: %u nodes, %u namespaces", cluster->snapshot_path,
+		header->n_nodes, header->n_tables);
+	return true;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+bool
+as_cluster_snapshot_load(as_cluster* cluster, as_vector* /* <as_node*> */ nodes_to_add)
+{
+	int fd = open(cluster->snapshot_path, O_RDONLY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(as_snapshot_header)) {
+		close(fd);
+		return false;
+	}
+
+	size_t size = (size_t)st.st_size;
+	void* map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		as_log_warn("Failed to map partition snapshot %s: %d", cluster->snapshot_path, errno);
+		return false;
+	}
+
+	bool status = as_snapshot_apply(cluster, (const uint8_t*)map, size, nodes_to_add);
+	munmap(map, size);
+	return status;
+}
+
+void
+as_cluster_snapshot_save(as_cluster* cluster)
+{
+	as_nodes* nodes = cluster->nodes;
+	as_partition_tables* tables = cluster->partition_tables;
+	uint32_t n_partitions = cluster->n_partitions;
+
+	if (nodes->size == 0 || nodes->size >= AS_SNAPSHOT_NO_NODE || tables->size == 0 ||
+		n_partitions == 0) {
+		return;
+	}
+
+	// Only write a settled map, and only when it changed.
+	uint64_t signature = as_snapshot_hash(AS_SNAPSHOT_FNV_INIT, &tables->size, sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+
+		if (! node->active || node->partition_generation == (uint32_t)-1) {
+			return;
+		}
+		signature = as_snapshot_hash(signature, node->name, strlen(node->name));
+		signature = as_snapshot_hash(signature, &node->partition_generation, sizeof(uint32_t));
+	}
+
+	if (signature == cluster->snapshot_signature) {
+		return;
+	}
+
+	size_t size = as_snapshot_size(nodes->size, tables->size, n_partitions);
+	uint8_t* buf = cf_malloc(size);
+	memset(buf, 0, size);
+
+	as_snapshot_header* header = (as_snapshot_header*)buf;
+	header->magic = AS_SNAPSHOT_MAGIC;
+	header->version = AS_SNAPSHOT_VERSION;
+	header->n_partitions = n_partitions;
+	header->n_nodes = nodes->size;
+	header->n_tables = tables->size;
+	header->size = size;
+
+	// Owners are looked up by pointer in a sorted copy of the node array.
+	as_node** sorted = cf_malloc(sizeof(as_node*) * nodes->size);
+	uint16_t* indexes = cf_malloc(sizeof(uint16_t) * nodes->size);
+	memcpy(sorted, nodes->array, sizeof(as_node*) * nodes->size);
+	qsort(sorted, nodes->size, sizeof(as_node*), as_snapshot_node_compare);
+
+	as_snapshot_node* records = (as_snapshot_node*)(buf + sizeof(as_snapshot_header));
+
+	for (uint32_t i = 0; i < nodes->size; i++) {
+		as_node* node = nodes->array[i];
+		struct sockaddr_in* addr = as_node_get_address(node);
+
+		as_strncpy(records[i].name, node->name, AS_NODE_NAME_SIZE);
+		records[i].partition_generation = node->partition_generation;
+		records[i].addr = addr->sin_addr.s_addr;
+		records[i].port = addr->sin_port;
+
+		as_node** found = bsearch(&node, sorted, nodes->size, sizeof(as_node*), as_snapshot_node_compare);
+		indexes[found - sorted] = (uint16_t)i;
+	}
+
+	uint8_t* p = (uint8_t*)(records + nodes->size);
+
+	for (uint32_t i = 0; i < tables->size; i++) {
+		as_partition_table* table = tables->array[i];
+		as_strncpy((char*)p, table->ns, AS_MAX_NAMESPACE_SIZE);
+		p += AS_MAX_NAMESPACE_SIZE;
+
+		for (uint32_t j = 0; j < n_partitions; j++) {
+			as_partition* part = j < table->size ? &table->partitions[j] : 0;
+			uint16_t master = as_snapshot_node_index(sorted, indexes, nodes->size, part ? part->master : 0);
+			uint16_t prole = as_snapshot_node_index(sorted, indexes, nodes->size, part ? part->prole : 0);
+			memcpy(p + sizeof(uint16_t) * j, &master, sizeof(uint16_t));
+			memcpy(p + sizeof(uint16_t) * (n_partitions + j), &prole, sizeof(uint16_t));
+		}
+		p += sizeof(uint16_t) * 2 * n_partitions;
+	}
+	cf_free(indexes);
+	cf_free(sorted);
+
+	uint8_t* body = buf + sizeof(as_snapshot_header);
+	header->checksum = as_snapshot_hash(AS_SNAPSHOT_FNV_INIT, body, size - sizeof(as_snapshot_header));
+
+	if (as_snapshot_write_file(cluster->snapshot_path, buf, size)) {
+		cluster->snapshot_signature = signature;
+	}
+	cf_free(buf);
+}
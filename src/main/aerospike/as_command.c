@@ -20,11 +20,47 @@
 #include <aerospike/as_log_macros.h>
 #include <aerospike/as_msgpack.h>
 #include <aerospike/as_record.h>
+#include <aerospike/as_retry.h>
 #include <aerospike/as_serializer.h>
 #include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
 #include <citrusleaf/cf_clock.h>
+#include <pthread.h>
 #include <string.h>
 
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Receive buffers that grew beyond this size are shrunk before the next read.
+#define AS_RECV_BUFFER_MAX (1024 * 1024)
+
+/**
+ *	@private
+ *	Initial size of the response buffer given to a record by a zero-copy read.
+ */
+#define AS_RECORD_BUFFER_INIT 1024
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+/**
+ *	@private
+ *	Per-thread buffer that single record responses are read into.
+ */
+typedef struct as_recv_buffer_s {
+	uint8_t* data;
+	size_t capacity;
+} as_recv_buffer;
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+static pthread_key_t as_recv_buffer_key;
+static pthread_once_t as_recv_buffer_once = PTHREAD_ONCE_INIT;
+
 /******************************************************************************
  * FUNCTIONS
  *****************************************************************************/
@@ -65,8 +101,16 @@ as_command_user_key_size(const as_key* key)
 size_t
 as_command_key_size(as_policy_key policy, const as_key* key, uint16_t* n_fields)
 {
+	if (key->_fields_size && key->_fields_policy == policy) {
+		*n_fields = key->_n_fields;
+		return AS_HEADER_SIZE + key->_fields_size;
+	}
+	
 	*n_fields = 3;
-	size_t size = strlen(key->ns) + strlen(key->set) + sizeof(cf_digest) + 45;
+	
+	// Namespace and set lengths are cached when the key is initialized.
+	size_t size = key->_ns_len ? (size_t)key->_ns_len + key->_set_len : strlen(key->ns) + strlen(key->set);
+	size += sizeof(cf_digest) + 45;
 	
 	if (policy == AS_POLICY_KEY_SEND) {
 		size += as_command_user_key_size(key);
@@ -254,6 +298,11 @@ as_command_write_user_key(uint8_t* begin, const as_key* key)
 uint8_t*
 as_command_write_key(uint8_t* p, as_policy_key policy, const as_key* key)
 {
+	if (key->_fields_size && key->_fields_policy == policy) {
+		memcpy(p, key->_fields, key->_fields_size);
+		return p + key->_fields_size;
+	}
+	
 	p = as_command_write_field_string(p, AS_FIELD_NAMESPACE, key->ns);
 	p = as_command_write_field_string(p, AS_FIELD_SETNAME, key->set);
 	p = as_command_write_field_digest(p, &key->digest);
@@ -264,6 +313,74 @@ as_command_write_key(uint8_t* p, as_policy_key policy, const as_key* key)
 	return p;
 }
 
+static inline void
+as_command_write_op_header(uint8_t* begin, uint8_t operation_type, uint8_t val_type, uint8_t name_len, uint32_t val_len)
+{
+#ifndef __hpux
+	*(uint32_t*)begin = cf_swap_to_be32(name_len + val_len + 4);
+#else
+	uint32_t my_begin = 0;
+	my_begin = cf_swap_to_be32(name_len + val_len + 4);
+	memcpy((uint32_t*)begin, &my_begin, sizeof(uint32_t));
+#endif
+	begin += 4;
+	*begin++ = operation_type;
+	*begin++ = val_type;
+	*begin++ = 0;
+	*begin++ = name_len;
+}
+
+/**
+ *	Get value bytes to send in place if the value is large enough to be worth
+ *	not copying.  Sizes must already have been computed by as_command_value_size().
+ */
+static inline bool
+as_command_value_ref(as_val* val, as_buffer* buffer, const uint8_t** data, uint32_t* len, uint8_t* type)
+{
+	switch (val->type) {
+		case AS_STRING: {
+			as_string* v = as_string_fromval(val);
+			*data = (const uint8_t*)v->value;
+			*len = (uint32_t)v->len;
+			*type = AS_BYTES_STRING;
+			break;
+		}
+		case AS_BYTES: {
+			as_bytes* v = as_bytes_fromval(val);
+			*data = v->value;
+			*len = v->size;
+			*type = v->type;
+			break;
+		}
+		case AS_LIST:
+		case AS_MAP: {
+			*data = buffer->data;
+			*len = buffer->size;
+			*type = val->type == AS_LIST ? AS_BYTES_LIST : AS_BYTES_MAP;
+			break;
+		}
+		default: {
+			return false;
+		}
+	}
+	return *len >= AS_COMMAND_ZERO_COPY_MIN;
+}
+
+size_t
+as_command_bin_size_iov(const as_bin* bin, as_buffer* buffer, uint32_t* n_refs)
+{
+	size_t size = as_command_bin_size(bin, buffer);
+	const uint8_t* data;
+	uint32_t len;
+	uint8_t type;
+	
+	if (as_command_value_ref((as_val*)bin->valuep, buffer, &data, &len, &type)) {
+		(*n_refs)++;
+		size -= len;
+	}
+	return size;
+}
+
 uint8_t*
 as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer)
 {
@@ -334,19 +451,213 @@ as_command_write_bin(uint8_t* begin, uint8_t operation_type, const as_bin* bin,
 			break;
 		}
 	}
+	as_command_write_op_header(begin, operation_type, val_type, name_len, val_len);
+	return p;
+}
+
+uint8_t*
+as_command_write_bin_iov(uint8_t* begin, uint8_t operation_type, const as_bin* bin, as_buffer* buffer,
+	as_command_iov* iov)
+{
+	const uint8_t* data;
+	uint32_t val_len;
+	uint8_t val_type;
+	
+	if (! as_command_value_ref((as_val*)bin->valuep, buffer, &data, &val_len, &val_type)) {
+		return as_command_write_bin(begin, operation_type, bin, buffer);
+	}
+	
+	uint8_t* p = begin + AS_OPERATION_HEADER_SIZE;
+	const char* name = bin->name;
+	
+	// Copy string, but do not transfer null byte.
+	while (*name) {
+		*p++ = *name++;
+	}
+	uint8_t name_len = p - begin - AS_OPERATION_HEADER_SIZE;
+	as_command_write_op_header(begin, operation_type, val_type, name_len, val_len);
+	
+	// Close command buffer fragment at the end of the bin name, then reference the
+	// value.  The next fragment starts where the value would have been copied.
+	struct iovec* frag = &iov->list[iov->size++];
+	frag->iov_base = iov->frag;
+	frag->iov_len = p - iov->frag;
+	iov->len += frag->iov_len;
+	
+	frag = &iov->list[iov->size++];
+	frag->iov_base = (void*)data;
+	frag->iov_len = val_len;
+	iov->len += val_len;
+	
+	iov->frag = p;
+	return p;
+}
+
+/**
+ *	@private
+ *	Only replica ANY routing and max_commands_per_node read a node's in-flight
+ *	count and latency average, so other commands leave them alone.
+ */
+static inline bool
+as_command_track_load(as_command_node* cn, as_cluster* cluster)
+{
+	return (cluster && cluster->max_commands_per_node) || (! cn->node && cn->replica == AS_POLICY_REPLICA_ANY);
+}
+
+/**
+ *	@private
+ *	End command on node, measuring its latency from begin_us when tracked.
+ */
+static inline void
+as_command_end(as_node* node, bool track, uint64_t begin_us, bool failed)
+{
+	as_node_command_end(node, track, track ? (uint32_t)(cf_getus() - begin_us) : 0, failed);
+}
+
+/**
+ *	If the node has not answered within the hedge delay, send the command to the
+ *	partition's prole as well and wait for whichever answers first.  When the prole
+ *	wins, node, fd, reused and begin_us are switched to it.  The losing socket may
+ *	still receive a response, so it is closed rather than put back in the pool.
+ */
+static void
+as_command_hedge(as_command_node* cn, struct iovec* iov, int iovcnt, uint64_t deadline_ms, bool track,
+	as_node** node, int* fd, bool* reused, uint64_t* begin_us)
+{
+	int fds[2];
+	fds[0] = *fd;
+	
+	if (as_socket_wait_readable(fds, 1, cn->hedge_delay_us) >= 0) {
+		return;
+	}
+	
+	as_node* prole = as_node_get_prole(cn->cluster, cn->ns, cn->ns_id, cn->digest);
+	
+	if (! prole) {
+		return;
+	}
+	
+	if (prole == *node) {
+		return;
+	}
+	
+	// The hedge is a command on the prole like any other, so the prole's
+	// breaker and max_commands_per_node apply.
+	if (as_node_command_admit(prole, track) != AEROSPIKE_OK) {
+		return;
+	}
+	
+	as_error err;
+	as_error_init(&err);
+	int prole_fd;
+	bool prole_reused = false;
+	uint64_t prole_begin_us = track ? cf_getus() : 0;
+	
+	if (as_node_get_connection(prole, &prole_fd, &prole_reused) != AEROSPIKE_OK) {
+		as_command_end(prole, track, prole_begin_us, true);
+		return;
+	}
+	
+	as_status status;
+	
+	if (iovcnt == 1) {
+		status = as_socket_write_deadline(&err, prole_fd, iov[0].iov_base, iov[0].iov_len, deadline_ms);
+	}
+	else {
+		status = as_socket_writev_deadline(&err, prole_fd, iov, iovcnt, deadline_ms);
+	}
+	
+	if (status) {
+		// A stale pooled socket says nothing about the node.
+		as_command_end(prole, track, prole_begin_us, ! (prole_reused && status == AEROSPIKE_ERR_CLIENT));
+		as_close(prole_fd);
+		return;
+	}
+	ck_pr_inc_32(&cn->cluster->hedges_issued);
+	
+	// Wait for either node.  Without a deadline, wait as long as as_socket_read_forever().
+	uint64_t wait_us = 60000 * 1000;
+	
+	if (deadline_ms) {
+		uint64_t now = cf_getms();
+		wait_us = (deadline_ms > now)? (deadline_ms - now) * 1000 : 0;
+	}
+	fds[1] = prole_fd;
+	
+	int ready = as_socket_wait_readable(fds, 2, wait_us);
+	
+	if (ready == 1) {
+		// The master's sample is how long it failed to answer.
+		as_command_end(*node, track, *begin_us, false);
+		as_close(*fd);
+		*node = prole;
+		*fd = prole_fd;
+		*reused = prole_reused;
+		*begin_us = prole_begin_us;
+		ck_pr_inc_32(&cn->cluster->hedges_won);
+	}
+	else {
+		// Master answered first or neither did.  Reading the master socket
+		// reports the outcome.  The prole failed only if neither answered.
+		as_command_end(prole, track, prole_begin_us, ready < 0);
+		as_close(prole_fd);
+	}
+}
+
+/**
+ *	@private
+ *	Find another replica for a read that node did not admit, and admit the read
+ *	there.  Return NULL if there is none or it does not admit the read either.
+ */
+static as_node*
+as_command_alternate(as_command_node* cn, as_node* node, bool track)
+{
+	as_node* alternate = as_node_get_prole(cn->cluster, cn->ns, cn->ns_id, cn->digest);
+	
+	if (alternate == node) {
+		alternate = as_node_get(cn->cluster, cn->ns, cn->ns_id, cn->digest, false, AS_POLICY_REPLICA_MASTER);
+	}
+	
+	if (! alternate) {
+		return NULL;
+	}
+	
+	if (alternate == node || as_node_command_admit(alternate, track) != AEROSPIKE_OK) {
+		return NULL;
+	}
+	return alternate;
+}
+
+/**
+ *	@private
+ *	Wait out a retry delay, then patch the command header with the time left
+ *	before the deadline so the server does not outlive the client.  Return
+ *	false if the deadline has passed.
+ */
+static bool
+as_command_retry_sleep(as_retry* rt, uint8_t* command, int delay_ms)
+{
+	if (delay_ms > 0) {
+		usleep(delay_ms * 1000);
+	}
+
+	if (rt->deadline_ms > 0) {
+		uint32_t remaining_ms = as_retry_remaining_ms(rt, cf_getms());
+
+		if (remaining_ms == 0) {
+			return false;
+		}
+
+		// Reset timeout in send buffer (destined for server).
 #ifndef __hpux
-	*(uint32_t*)begin = cf_swap_to_be32(name_len + val_len + 4);
+		*(uint32_t*)(command + 22) = cf_swap_to_be32(remaining_ms);
 #else
-	uint32_t my_begin = 0;
-	my_begin = cf_swap_to_be32(name_len + val_len + 4);
-	memcpy((uint32_t*)begin, &my_begin, sizeof(uint32_t));
+		uint32_t my_cmd = 0;
+		my_cmd = cf_swap_to_be32(remaining_ms);
+		memcpy((uint32_t*)(command + 22), &my_cmd, sizeof(uint32_t));
 #endif
-	begin += 4;
-	*begin++ = operation_type;
-	*begin++ = val_type;
-	*begin++ = 0;
-	*begin++ = name_len;
-	return p;
+	}
+	return true;
 }
 
 as_status
@@ -355,168 +666,357 @@ as_command_execute(as_error * err, as_command_node* cn, uint8_t* command, size_t
 	as_parse_results_fn parse_results_fn, void* parse_results_data
 )
 {
-	uint64_t deadline_ms = as_socket_deadline(timeout_ms);
-	uint32_t max_retries = retry + 1;
-	uint32_t sleep_between_retries_ms = 0;
-	uint32_t failed_nodes = 0;
-	uint32_t failed_conns = 0;
-	uint32_t iterations = 0;
-	bool release_node;
+	struct iovec iov;
+	iov.iov_base = command;
+	iov.iov_len = command_len;
+	return as_command_execute_iov(err, cn, &iov, 1, timeout_ms, retry, parse_results_fn, parse_results_data);
+}
+
+/**
+ *	@private
+ *	Send the command and parse the response, retrying as the policy allows.  Nodes
+ *	routed through the partition map are not reserved, so the caller must be inside
+ *	an as_cluster_epoch section unless cn->node is set.
+ */
+static as_status
+as_command_execute_attempts(as_error * err, as_command_node* cn, struct iovec* iov, int iovcnt,
+	uint32_t timeout_ms, as_policy_retry retry,
+	as_parse_results_fn parse_results_fn, void* parse_results_data
+)
+{
+	// First fragment holds the header, which is patched with the remaining timeout on retry.
+	uint8_t* command = iov[0].iov_base;
+	as_retry rt;
+	as_retry_init(&rt, NULL, as_socket_deadline(timeout_ms), retry + 1, 0);
+	uint64_t deadline_ms = rt.deadline_ms;
+	bool routed;
+	bool fresh_conn = false;
+	bool track = as_command_track_load(cn, cn->node ? cn->node->cluster : cn->cluster);
+	as_retry_class klass;
 
 	// Execute command until successful, timed out or maximum iterations have been reached.
 	while (true) {
-		as_node* node;
+		as_node* node = NULL;
 		
 		if (cn->node) {
 			node = cn->node;
-			release_node = false;
+			routed = false;
 		}
 		else {
-			node = as_node_get(cn->cluster, cn->ns, cn->digest, cn->write, cn->replica);
-			release_node = true;
+			// Reads alternate between master and prole on retry, so a node that
+			// keeps failing does not use up every attempt.
+			if (! cn->write && as_retry_use_prole(&rt)) {
+				node = as_node_get_prole(cn->cluster, cn->ns, cn->ns_id, cn->digest);
+			}
+			
+			if (! node) {
+				node = as_node_get(cn->cluster, cn->ns, cn->ns_id, cn->digest, cn->write, cn->replica);
+			}
+			routed = true;
 		}
 		
 		if (!node) {
-			failed_nodes++;
-			sleep_between_retries_ms = 10;
+			klass = AS_RETRY_CLASS_NO_NODE;
 			goto Retry;
 		}
 		
-		int fd;
-		as_status status = as_node_get_connection(node, &fd);
+		// Fail fast on a node whose breaker is open or that is at its command
+		// limit.  Reads routed through the partition map try another replica.
+		as_status status = as_node_command_admit(node, track);
 		
 		if (status) {
-			if (release_node) {
-				as_node_release(node);
+			as_node* alternate = (routed && ! cn->write)? as_command_alternate(cn, node, track) : NULL;
+			
+			if (! alternate) {
+				return as_error_set_message(err, status, as_error_string(status));
 			}
-			failed_conns++;
-			sleep_between_retries_ms = 1;
+			node = alternate;
+		}
+		
+		// Track latency and load for replica selection.
+		uint64_t begin_us = track ? cf_getus() : 0;
+		int fd;
+		bool reused = false;
+		
+		if (fresh_conn) {
+			fresh_conn = false;
+			status = as_node_create_connection(node, &fd);
+		}
+		else {
+			status = as_node_get_connection(node, &fd, &reused);
+		}
+		
+		if (status) {
+			as_command_end(node, track, begin_us, true);
+			klass = AS_RETRY_CLASS_CONNECTION;
 			goto Retry;
 		}
 		
 		// Send command.
-		status = as_socket_write_deadline(err, fd, command, command_len, deadline_ms);
+		if (iovcnt == 1) {
+			status = as_socket_write_deadline(err, fd, command, iov[0].iov_len, deadline_ms);
+		}
+		else {
+			status = as_socket_writev_deadline(err, fd, iov, iovcnt, deadline_ms);
+		}
 		
 		if (status) {
+			// A stale pooled socket says nothing about the node.
+			as_command_end(node, track, begin_us, ! (reused && status == AEROSPIKE_ERR_CLIENT));
+			
 			// Socket errors are considered temporary anomalies.  Retry.
 			// Close socket to flush out possible garbage.  Do not put back in pool.
 			as_close(fd);
-			if (release_node) {
-				as_node_release(node);
+			
+			// Commands sent to a node picked by the caller are parts of
+			// multi-record commands, which their callers retry.
+			if (reused && status == AEROSPIKE_ERR_CLIENT && ! cn->node) {
+				goto RetryFresh;
 			}
-			sleep_between_retries_ms = 0;
+			klass = (status == AEROSPIKE_ERR_TIMEOUT)? AS_RETRY_CLASS_TIMEOUT : AS_RETRY_CLASS_CONNECTION;
 			goto Retry;
 		}
 		
+		// Hedge reads that were routed through the partition map.
+		if (cn->hedge_delay_us && routed && ! cn->write) {
+			as_command_hedge(cn, iov, iovcnt, deadline_ms, track, &node, &fd, &reused, &begin_us);
+		}
+		
 		// Parse results returned by server.
 		status = parse_results_fn(err, fd, deadline_ms, parse_results_data);
 		
+		if (status == AEROSPIKE_ERR_NO_RESPONSE) {
+			// A pooled socket closed by the server while idle fails before the
+			// first response byte.  Only then is the command known not to have
+			// run, so it is resent.  Once any response byte has been read, errors
+			// are final.
+			if (reused && ! cn->node) {
+				as_command_end(node, track, begin_us, false);
+				as_close(fd);
+				goto RetryFresh;
+			}
+			status = err->code = AEROSPIKE_ERR_CLIENT;
+		}
+		as_command_end(node, track, begin_us, status && as_retry_classify(status) != AS_RETRY_CLASS_NONE);
+		
 		if (status) {
 			switch (status) {
 				// Retry on timeout.
 				case AEROSPIKE_ERR_TIMEOUT:
 					as_close(fd);
-					if (release_node) {
-						as_node_release(node);
-					}
-					sleep_between_retries_ms = 0;
+					klass = AS_RETRY_CLASS_TIMEOUT;
 					goto Retry;
 				
 				// Close socket on errors that can leave unread data in socket.
 				case AEROSPIKE_ERR_QUERY_ABORTED:
 				case AEROSPIKE_ERR_SCAN_ABORTED:
+				case AEROSPIKE_ERR_CLIENT_ABORT:
 				case AEROSPIKE_ERR_CLIENT:
 					as_close(fd);
-					if (release_node) {
-						as_node_release(node);
-					}
 					err->code = status;
 					return status;
 				
 				default:
 					err->code = status;
+					
+					// Retry single record commands rejected by a busy server.  The
+					// response has been read in full, so the connection is reusable.
+					// Multi-record commands may already have delivered results.
+					if (routed && as_retry_classify(status) == AS_RETRY_CLASS_BUSY) {
+						int delay_ms = as_retry_next(&rt, AS_RETRY_CLASS_BUSY, cf_getms());
+						
+						if (delay_ms >= 0) {
+							as_node_put_connection(node, fd);
+							as_error_reset(err);
+							
+							if (! as_command_retry_sleep(&rt, command, delay_ms)) {
+								goto Timeout;
+							}
+							continue;
+						}
+					}
 					break;
 			}
 		}
 		
 		// Put connection back in pool.
 		as_node_put_connection(node, fd);
-		
-		// Release resources.
-		if (release_node) {
-			as_node_release(node);
-		}
 		return status;
 
-Retry:
-		// Check if max retries reached.
-		if (++iterations > max_retries) {
+RetryFresh:
+		// Pooled sockets are not checked before use, so a socket error on one does
+		// not count as a retry.  Try once more on a new connection.
+		fresh_conn = true;
+		
+		if (deadline_ms > 0 && cf_getms() >= deadline_ms) {
 			break;
 		}
-		
-		// Check for client timeout.
-		if (deadline_ms > 0) {
-			int remaining_ms = (int)(deadline_ms - cf_getms() - sleep_between_retries_ms);
+		continue;
+
+Retry:
+		{
+			int delay_ms = as_retry_next(&rt, klass, cf_getms());
 			
-			if (remaining_ms <= 0) {
+			if (delay_ms < 0) {
 				break;
 			}
 			
-			// Reset timeout in send buffer (destined for server).
-#ifndef __hpux
-			*(uint32_t*)(command + 22) = cf_swap_to_be32(remaining_ms);
-#else
-			uint32_t my_cmd = 0;
-			my_cmd = cf_swap_to_be32(remaining_ms); 
-			memcpy((uint32_t*)(command + 22), &my_cmd, sizeof(uint32_t));
-#endif
-		}
-		
-		if (sleep_between_retries_ms > 0) {
-			// Sleep before trying again.
-			usleep(sleep_between_retries_ms * 1000);
+			if (! as_command_retry_sleep(&rt, command, delay_ms)) {
+				break;
+			}
 		}
 	}
 	
+Timeout:
 	return as_error_update(err, AEROSPIKE_ERR_TIMEOUT,
 		"Client timeout: timeout=%d iterations=%u failedNodes=%u failedConns=%u",
-		timeout_ms, iterations, failed_nodes, failed_conns);
+		timeout_ms, rt.attempt, rt.counts[AS_RETRY_CLASS_NO_NODE],
+		rt.counts[AS_RETRY_CLASS_CONNECTION]);
 }
 
 as_status
-as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+as_command_execute_iov(as_error * err, as_command_node* cn, struct iovec* iov, int iovcnt,
+	uint32_t timeout_ms, as_policy_retry retry,
+	as_parse_results_fn parse_results_fn, void* parse_results_data
+)
 {
-	// Read header
-	as_proto_msg* msg = user_data;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)msg, sizeof(as_proto_msg), deadline_ms);
+	if (cn->node) {
+		return as_command_execute_attempts(err, cn, iov, iovcnt, timeout_ms, retry, parse_results_fn, parse_results_data);
+	}
+	
+	// Nodes picked from the partition map stay valid until the section ends, so
+	// routing does not reserve and release them.
+	ck_epoch_record_t* record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_status status = as_command_execute_attempts(err, cn, iov, iovcnt, timeout_ms, retry, parse_results_fn, parse_results_data);
+	ck_epoch_end(&as_cluster_epoch, record);
+	return status;
+}
+
+static void
+as_recv_buffer_destroy(void* udata)
+{
+	as_recv_buffer* rb = udata;
+	cf_free(rb->data);
+	cf_free(rb);
+}
+
+static void
+as_recv_buffer_key_create()
+{
+	pthread_key_create(&as_recv_buffer_key, as_recv_buffer_destroy);
+}
+
+static as_recv_buffer*
+as_recv_buffer_get()
+{
+	pthread_once(&as_recv_buffer_once, as_recv_buffer_key_create);
+	as_recv_buffer* rb = pthread_getspecific(as_recv_buffer_key);
+	
+	if (! rb) {
+		rb = cf_malloc(sizeof(as_recv_buffer));
+		rb->capacity = AS_STACK_BUF_SIZE;
+		rb->data = cf_malloc(rb->capacity);
+		pthread_setspecific(as_recv_buffer_key, rb);
+	}
+	else if (rb->capacity > AS_RECV_BUFFER_MAX) {
+		// Do not let one huge record pin memory for the life of the thread.
+		rb->capacity = AS_STACK_BUF_SIZE;
+		rb->data = cf_realloc(rb->data, rb->capacity);
+	}
+	return rb;
+}
+
+/**
+ *	@private
+ *	Read a complete single message response into a growable buffer.  The header
+ *	and whatever part of the body has already arrived are pulled with one read.
+ *	At least one byte past the end of the message is always allocated, so the
+ *	last value can be terminated in place.  On success, msg holds a copy of the
+ *	header with the proto section swapped and body references the bytes after
+ *	the header.
+ */
+static as_status
+as_command_read_message_into(as_error* err, int fd, uint64_t deadline_ms, uint8_t** data, size_t* capacity,
+	as_proto_msg* msg, uint8_t** body, size_t* body_size)
+{
+	if (! *data) {
+		*capacity = AS_RECORD_BUFFER_INIT;
+		*data = cf_malloc(*capacity);
+	}
+	
+	size_t len;
+	as_status status = as_socket_read_atleast(err, fd, *data, sizeof(as_proto_msg), *capacity, deadline_ms, &len);
 	
 	if (status) {
 		return status;
 	}
 	
-	// Ensure that there is no data left to read.
+	memcpy(msg, *data, sizeof(as_proto_msg));
 	as_proto_swap_from_be(&msg->proto);
-	size_t size = msg->proto.sz  - msg->m.header_sz;
+	size_t total = sizeof(as_proto) + msg->proto.sz;
 	
-	if (size > 0) {
-		as_log_warn("Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
-		
-		// Verify size is not corrupted.
-		if (size > 100000) {
-			// The socket will be closed on this error, so we don't have to worry about emptying it.
-			return as_error_update(err, AEROSPIKE_ERR_CLIENT,
-				"Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
-		}
-		
-		// Empty socket.
-		uint8_t* buf = cf_malloc(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-		cf_free(buf);
+	// Verify header is not corrupted.  The socket is closed on this error, so
+	// the rest of the stream does not have to be read.
+	if (! as_command_valid_proto(&msg->proto)) {
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT,
+			"Invalid response header received from socket: fd=%d version=%u type=%u size=%zu",
+			fd, (uint32_t)msg->proto.version, (uint32_t)msg->proto.type, total);
+	}
+	
+	if (len > total) {
+		// Only one message is expected per request.
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT,
+			"Unexpected data received from socket: fd=%d size=%zu", fd, len - total);
+	}
+	
+	if (total >= *capacity) {
+		*capacity = total + 1;
+		*data = cf_realloc(*data, *capacity);
+	}
+	
+	if (total > len) {
+		// Read remaining message bytes.
+		status = as_socket_read_deadline(err, fd, *data + len, total - len, deadline_ms);
 		
 		if (status) {
 			return status;
 		}
 	}
+	*body = *data + sizeof(as_proto_msg);
+	*body_size = total - sizeof(as_proto_msg);
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	@private
+ *	Read a complete single message response into the calling thread's receive
+ *	buffer.  body is valid until the next read on the same thread.
+ */
+static as_status
+as_command_read_message(as_error* err, int fd, uint64_t deadline_ms, as_proto_msg* msg, uint8_t** body, size_t* body_size)
+{
+	as_recv_buffer* rb = as_recv_buffer_get();
+	return as_command_read_message_into(err, fd, deadline_ms, &rb->data, &rb->capacity, msg, body, body_size);
+}
+
+as_status
+as_command_parse_header(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+{
+	// Read header
+	as_proto_msg* msg = user_data;
+	uint8_t* buf;
+	size_t size;
+	as_status status = as_command_read_message(err, fd, deadline_ms, msg, &buf, &size);
+	
+	if (status) {
+		return status;
+	}
+	
+	// Extra data has already been read, so the socket is empty.
+	if (size > 0) {
+		as_log_warn("Unexpected data received from socket after a write: fd=%d size=%zu", fd, size);
+	}
 	
 	if (msg->m.result_code && msg->m.result_code != AEROSPIKE_ERR_RECORD_NOT_FOUND) {
 		return as_error_set_message(err, msg->m.result_code, as_error_string(msg->m.result_code));
@@ -605,6 +1105,11 @@ as_command_parse_key(uint8_t* p, uint32_t n_fields, as_key* key)
 	uint32_t len;
 	uint32_t size;
 	
+	// Cached namespace id, lengths and fields no longer describe the parsed fields.
+	key->_ns_id = 0;
+	key->_ns_len = 0;
+	key->_fields_size = 0;
+	
 	for (uint32_t i = 0; i < n_fields; i++) {
 #ifndef __hpux
 		len = cf_swap_from_be32(*(uint32_t*)p) - 1;
@@ -834,7 +1339,7 @@ as_command_parse_udf_failure(uint8_t* p, as_error* err, as_msg* msg, as_status s
 }
 
 uint8_t*
-as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize)
+as_command_parse_bins_borrow(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize, uint8_t* end)
 {
 	as_bin* bin = rec->bins.entries;
 	
@@ -873,10 +1378,19 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 				break;
 			}
 			case AS_BYTES_STRING: {
-				char* value = malloc(value_size + 1);
-				memcpy(value, p, value_size);
-				value[value_size] = 0;
-				as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, true);
+				// The byte after the value is either the spare byte past the end
+				// of the message or the high byte of the next bin's size, which
+				// is zero for any value the server can store.
+				if (end && (p + value_size == end || p[value_size] == 0)) {
+					p[value_size] = 0;
+					as_string_init_wlen((as_string*)&bin->value, (char*)p, value_size, false);
+				}
+				else {
+					char* value = malloc(value_size + 1);
+					memcpy(value, p, value_size);
+					value[value_size] = 0;
+					as_string_init_wlen((as_string*)&bin->value, (char*)value, value_size, true);
+				}
 				bin->valuep = &bin->value;
 				break;
 			}
@@ -906,9 +1420,14 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 				break;
 			}
 			default: {
-				void* value = malloc(value_size);
-				memcpy(value, p, value_size);
-				as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+				if (end) {
+					as_bytes_init_wrap((as_bytes*)&bin->value, p, value_size, false);
+				}
+				else {
+					void* value = malloc(value_size);
+					memcpy(value, p, value_size);
+					as_bytes_init_wrap((as_bytes*)&bin->value, value, value_size, true);
+				}
 				bin->value.bytes.type = (as_bytes_type)type;
 				bin->valuep = &bin->value;
 				break;
@@ -920,36 +1439,17 @@ as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserial
 	return p;
 }
 
-as_status
-as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+uint8_t*
+as_command_parse_bins(as_record* rec, uint8_t* p, uint32_t n_bins, bool deserialize)
+{
+	return as_command_parse_bins_borrow(rec, p, n_bins, deserialize, NULL);
+}
+
+static as_status
+as_command_parse_record_borrow(as_error* err, as_msg* msg, uint8_t* buf, as_record** record, uint8_t* end)
 {
-	// Read header
-	as_proto_msg msg;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
-	
-	if (status) {
-		return status;
-	}
-	
-	as_proto_swap_from_be(&msg.proto);
-	as_msg_swap_header_from_be(&msg.m);
-	size_t size = msg.proto.sz  - msg.m.header_sz;
-	uint8_t* buf = 0;
-	
-	if (size > 0) {
-		// Read remaining message bytes.
-		buf = as_command_init(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-		
-		if (status) {
-			as_command_free(buf, size);
-			return status;
-		}
-	}
-	
 	// Parse result code and record.
-	status = msg.m.result_code;
-	as_record** record = user_data;
+	as_status status = msg->result_code;
 	
 	switch (status) {
 		case AEROSPIKE_OK: {
@@ -957,31 +1457,31 @@ as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_
 				as_record* rec = *record;
 				
 				if (rec) {
-					if (msg.m.n_ops > rec->bins.capacity) {
+					if (msg->n_ops > rec->bins.capacity) {
 						if (rec->bins._free) {
 							free(rec->bins.entries);
 						}
-						rec->bins.capacity = msg.m.n_ops;
+						rec->bins.capacity = msg->n_ops;
 						rec->bins.size = 0;
-						rec->bins.entries = malloc(sizeof(as_bin) * msg.m.n_ops);
+						rec->bins.entries = malloc(sizeof(as_bin) * msg->n_ops);
 						rec->bins._free = true;
 					}
 				}
 				else {
-					rec = as_record_new(msg.m.n_ops);
+					rec = as_record_new(msg->n_ops);
 					*record = rec;
 				}
-				rec->gen = msg.m.generation;
-				rec->ttl = cf_server_void_time_to_ttl(msg.m.record_ttl);
+				rec->gen = msg->generation;
+				rec->ttl = cf_server_void_time_to_ttl(msg->record_ttl);
 				
-				uint8_t* p = as_command_ignore_fields(buf, msg.m.n_fields);
-				as_command_parse_bins(rec, p, msg.m.n_ops, true);
+				uint8_t* p = as_command_ignore_fields(buf, msg->n_fields);
+				as_command_parse_bins_borrow(rec, p, msg->n_ops, true, end);
 			}
 			break;
 		}
 			
 		case AEROSPIKE_ERR_UDF: {
-			status = as_command_parse_udf_failure(buf, err, &msg.m, status);
+			status = as_command_parse_udf_failure(buf, err, msg, status);
 			break;
 		}
 			
@@ -993,37 +1493,92 @@ as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_
 			as_error_set_message(err, status, as_error_string(status));
 			break;
 	}
-	as_command_free(buf, size);
 	return status;
 }
 
 as_status
-as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+as_command_parse_record(as_error* err, as_msg* msg, uint8_t* buf, as_record** record)
 {
-	// Read header
+	return as_command_parse_record_borrow(err, msg, buf, record, NULL);
+}
+
+as_status
+as_command_parse_result(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+{
+	// Read header and body.
 	as_proto_msg msg;
-	as_status status = as_socket_read_deadline(err, fd, (uint8_t*)&msg, sizeof(as_proto_msg), deadline_ms);
+	uint8_t* buf;
+	size_t size;
+	as_status status = as_command_read_message(err, fd, deadline_ms, &msg, &buf, &size);
 	
 	if (status) {
 		return status;
 	}
 	
-	as_proto_swap_from_be(&msg.proto);
 	as_msg_swap_header_from_be(&msg.m);
-	size_t size = msg.proto.sz  - msg.m.header_sz;
-	uint8_t* buf = 0;
+	return as_command_parse_record(err, &msg.m, buf, user_data);
+}
+
+as_status
+as_command_parse_result_zero_copy(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+{
+	as_record** record = user_data;
+	as_record* rec = *record;
+	uint8_t* data = NULL;
+	size_t capacity = 0;
 	
-	if (size > 0) {
-		// Read remaining message bytes.
-		buf = as_command_init(size);
-		status = as_socket_read_deadline(err, fd, buf, size, deadline_ms);
-		
-		if (status) {
-			as_command_free(buf, size);
-			return status;
+	if (rec) {
+		// Reuse the record's buffer.  Bins from a previous read reference it,
+		// so release them first.
+		for (uint16_t i = 0; i < rec->bins.size; i++) {
+			as_val_destroy((as_val*)rec->bins.entries[i].valuep);
+			rec->bins.entries[i].valuep = NULL;
 		}
+		rec->bins.size = 0;
+		data = rec->_buffer;
+		capacity = rec->_buffer_capacity;
+		rec->_buffer = NULL;
+		rec->_buffer_capacity = 0;
 	}
 	
+	// Read header and body straight into the buffer the record will own.
+	as_proto_msg msg;
+	uint8_t* buf;
+	size_t size;
+	as_status status = as_command_read_message_into(err, fd, deadline_ms, &data, &capacity, &msg, &buf, &size);
+	
+	if (status == AEROSPIKE_OK) {
+		as_msg_swap_header_from_be(&msg.m);
+		status = as_command_parse_record_borrow(err, &msg.m, buf, record, buf + size);
+	}
+	
+	rec = *record;
+	
+	if (rec) {
+		rec->_buffer = data;
+		rec->_buffer_capacity = capacity;
+	}
+	else {
+		cf_free(data);
+	}
+	return status;
+}
+
+as_status
+as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, void* user_data)
+{
+	// Read header and body.
+	as_proto_msg msg;
+	uint8_t* buf;
+	size_t size;
+	as_status status = as_command_read_message(err, fd, deadline_ms, &msg, &buf, &size);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_msg_swap_header_from_be(&msg.m);
+	
 	as_val** val = user_data;
 	
 	// Parse result code and record.
@@ -1051,6 +1606,5 @@ as_command_parse_success_failure(as_error* err, int fd, uint64_t deadline_ms, vo
 			*val = 0;
 			break;
 	}
-	as_command_free(buf, size);
 	return status;
 }
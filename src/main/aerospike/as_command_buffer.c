@@ -0,0 +1,247 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_command.h>
+#include <aerospike/as_command_buffer.h>
+#include <citrusleaf/alloc.h>
+#include <ck_pr.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Buffers per thread.  A command that is still held while another one is built
+// on the same thread (receive buffers of scans, queries and batches, commands
+// issued from callbacks) takes the next slot.
+#define AS_COMMAND_ARENA_SLOTS 4
+
+// Buffers are shrunk to the largest size used during this many releases.
+#define AS_COMMAND_ARENA_TRIM_INTERVAL 1000
+
+// Buffers that grew beyond this size are shrunk as soon as they are released.
+#define AS_COMMAND_ARENA_MAX (1024 * 1024)
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct as_command_slot_s {
+	uint8_t* data;
+	size_t capacity;
+	size_t high_water;
+	bool in_use;
+} as_command_slot;
+
+typedef struct as_command_arena_s {
+	struct as_command_arena_s* next;
+	struct as_command_arena_s* prev;
+	as_command_slot slots[AS_COMMAND_ARENA_SLOTS];
+	uint32_t releases;
+
+	// Written only by the owning thread, read by as_command_buffer_get_stats().
+	uint64_t reused;
+	uint64_t allocated;
+	uint64_t trimmed;
+} as_command_arena;
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+static pthread_key_t as_command_arena_key;
+static pthread_once_t as_command_arena_once = PTHREAD_ONCE_INIT;
+
+// Live arenas, and totals of arenas whose threads have exited.
+static pthread_mutex_t as_command_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static as_command_arena* as_command_arena_list = NULL;
+static as_command_buffer_stats as_command_arena_retired;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline void
+as_command_arena_add(uint64_t* counter, uint64_t bytes)
+{
+	ck_pr_store_64(counter, *counter + bytes);
+}
+
+static void
+as_command_arena_destroy(void* udata)
+{
+	as_command_arena* arena = udata;
+
+	pthread_mutex_lock(&as_command_arena_lock);
+
+	if (arena->prev) {
+		arena->prev->next = arena->next;
+	}
+	else {
+		as_command_arena_list = arena->next;
+	}
+
+	if (arena->next) {
+		arena->next->prev = arena->prev;
+	}
+	as_command_arena_retired.reused += arena->reused;
+	as_command_arena_retired.allocated += arena->allocated;
+	as_command_arena_retired.trimmed += arena->trimmed;
+	pthread_mutex_unlock(&as_command_arena_lock);
+
+	for (uint32_t i = 0; i < AS_COMMAND_ARENA_SLOTS; i++) {
+		cf_free(arena->slots[i].data);
+	}
+	cf_free(arena);
+}
+
+static void
+as_command_arena_key_create()
+{
+	pthread_key_create(&as_command_arena_key, as_command_arena_destroy);
+}
+
+static as_command_arena*
+as_command_arena_get()
+{
+	pthread_once(&as_command_arena_once, as_command_arena_key_create);
+	as_command_arena* arena = pthread_getspecific(as_command_arena_key);
+
+	if (! arena) {
+		arena = cf_malloc(sizeof(as_command_arena));
+		memset(arena, 0, sizeof(as_command_arena));
+
+		pthread_mutex_lock(&as_command_arena_lock);
+		arena->next = as_command_arena_list;
+
+		if (arena->next) {
+			arena->next->prev = arena;
+		}
+		as_command_arena_list = arena;
+		pthread_mutex_unlock(&as_command_arena_lock);
+
+		pthread_setspecific(as_command_arena_key, arena);
+	}
+	return arena;
+}
+
+static void
+as_command_slot_shrink(as_command_arena* arena, as_command_slot* slot, size_t capacity)
+{
+	if (slot->capacity > capacity) {
+		as_command_arena_add(&arena->trimmed, slot->capacity - capacity);
+		slot->data = cf_realloc(slot->data, capacity);
+		slot->capacity = capacity;
+	}
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+uint8_t*
+as_command_buffer_get(size_t size)
+{
+	as_command_arena* arena = as_command_arena_get();
+
+	for (uint32_t i = 0; i < AS_COMMAND_ARENA_SLOTS; i++) {
+		as_command_slot* slot = &arena->slots[i];
+
+		if (slot->in_use) {
+			continue;
+		}
+		slot->in_use = true;
+
+		if (size > slot->high_water) {
+			slot->high_water = size;
+		}
+
+		if (size <= slot->capacity) {
+			as_command_arena_add(&arena->reused, size);
+			return slot->data;
+		}
+
+		// Old contents are not needed, so free instead of realloc to avoid a copy.
+		size_t capacity = (size > AS_STACK_BUF_SIZE)? size : AS_STACK_BUF_SIZE;
+		cf_free(slot->data);
+		slot->data = cf_malloc(capacity);
+		slot->capacity = capacity;
+		as_command_arena_add(&arena->allocated, capacity);
+		return slot->data;
+	}
+
+	as_command_arena_add(&arena->allocated, size);
+	return cf_malloc(size);
+}
+
+void
+as_command_buffer_release(uint8_t* buf)
+{
+	if (! buf) {
+		return;
+	}
+
+	as_command_arena* arena = as_command_arena_get();
+
+	for (uint32_t i = 0; i < AS_COMMAND_ARENA_SLOTS; i++) {
+		as_command_slot* slot = &arena->slots[i];
+
+		if (slot->data != buf || ! slot->in_use) {
+			continue;
+		}
+		slot->in_use = false;
+
+		if (slot->capacity > AS_COMMAND_ARENA_MAX) {
+			// Do not let one huge command pin memory until the next trim.
+			as_command_slot_shrink(arena, slot, AS_STACK_BUF_SIZE);
+			slot->high_water = 0;
+		}
+
+		if (++arena->releases >= AS_COMMAND_ARENA_TRIM_INTERVAL) {
+			arena->releases = 0;
+
+			for (uint32_t j = 0; j < AS_COMMAND_ARENA_SLOTS; j++) {
+				as_command_slot* s = &arena->slots[j];
+
+				if (! s->in_use && s->data) {
+					size_t target = (s->high_water > AS_STACK_BUF_SIZE)? s->high_water : AS_STACK_BUF_SIZE;
+					as_command_slot_shrink(arena, s, target);
+				}
+				s->high_water = 0;
+			}
+		}
+		return;
+	}
+
+	// Overflow buffer from a request made while all slots were in use.
+	cf_free(buf);
+}
+
+void
+as_command_buffer_get_stats(as_command_buffer_stats* stats)
+{
+	pthread_mutex_lock(&as_command_arena_lock);
+	*stats = as_command_arena_retired;
+
+	for (as_command_arena* arena = as_command_arena_list; arena; arena = arena->next) {
+		stats->reused += ck_pr_load_64(&arena->reused);
+		stats->allocated += ck_pr_load_64(&arena->allocated);
+		stats->trimmed += ck_pr_load_64(&arena->trimmed);
+	}
+	pthread_mutex_unlock(&as_command_arena_lock);
+}
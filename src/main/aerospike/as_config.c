@@ -38,9 +38,19 @@ as_config * as_config_init(as_config * c)
 	c->ip_map = 0;
 	c->ip_map_size = 0;
 	c->max_threads = 300;
+	c->min_conns_per_node = 0;
+	c->max_conns_per_node = 0;
+	c->thread_conn_cache = false;
+	c->max_commands_per_node = 0;
+	c->breaker_error_percent = 0;
+	c->breaker_min_commands = 20;
+	c->breaker_open_ms = 1000;
 	c->max_socket_idle_sec = 14;
 	c->conn_timeout_ms = 1000;
 	c->tender_interval = 1000;
+	c->tend_threads = 4;
+	c->event_loops = 1;
+	c->async_pipeline = false;
 	c->hosts_size = 0;
 	memset(c->user, 0, sizeof(c->user));
 	memset(c->password, 0, sizeof(c->password));
@@ -50,6 +60,7 @@ as_config * as_config_init(as_config * c)
 	strcpy(c->lua.system_path, AS_CONFIG_LUA_SYSTEM_PATH);
 	strcpy(c->lua.user_path, AS_CONFIG_LUA_USER_PATH);
 	c->fail_if_not_connected = true;
+	c->snapshot_path[0] = 0;
 	
 	c->use_shm = false;
 	c->shm_key = 0xA5000000;
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_conn_pool.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <string.h>
+
+/******************************************************************************
+ *	STATIC FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Number of sockets trim may close.  At least one socket is always left, so
+ *	trimming never leaves borrowers to open new connections.
+ */
+static inline uint32_t
+as_conn_pool_excess(uint32_t size, uint32_t min_idle)
+{
+	uint32_t keep = min_idle > 0 ? min_idle : 1;
+	return size > keep ? size - keep : 0;
+}
+
+/******************************************************************************
+ *	FUNCTIONS
+ *****************************************************************************/
+
+#if defined(CK_F_STACK_POP_MPMC)
+
+void
+as_conn_pool_init(as_conn_pool* pool, uint32_t capacity)
+{
+	ck_stack_init(&pool->idle);
+	ck_stack_init(&pool->unused);
+	pool->size = 0;
+	pool->capacity = capacity;
+	pool->entries = cf_malloc(sizeof(as_conn_pool_entry) * capacity);
+
+	for (uint32_t i = 0; i < capacity; i++) {
+		as_conn_pool_entry* entry = &pool->entries[i];
+		entry->fd = -1;
+		ck_stack_push_spnc(&pool->unused, &entry->link);
+	}
+}
+
+void
+as_conn_pool_destroy(as_conn_pool* pool)
+{
+	int fd;
+
+	while (as_conn_pool_get(pool, 0, &fd)) {
+		as_close(fd);
+	}
+	cf_free(pool->entries);
+}
+
+bool
+as_conn_pool_get(as_conn_pool* pool, uint64_t max_idle_ms, int* fd)
+{
+	uint64_t now = max_idle_ms ? cf_getms() : 0;
+	
+	while (true) {
+		// Entries are never freed while the pool is live, and pop_mpmc guards the
+		// stack head with a generation count, so entries can be recycled safely.
+		as_conn_pool_entry* entry = (as_conn_pool_entry*)ck_stack_pop_mpmc(&pool->idle);
+
+		if (! entry) {
+			return false;
+		}
+		ck_pr_dec_32(&pool->size);
+
+		int entry_fd = entry->fd;
+		uint64_t last_used = entry->last_used;
+		entry->fd = -1;
+		ck_stack_push_mpmc(&pool->unused, &entry->link);
+
+		if (max_idle_ms == 0 || now - last_used <= max_idle_ms) {
+			*fd = entry_fd;
+			return true;
+		}
+		
+		// The server may already have closed a socket idle this long.
+		as_close(entry_fd);
+	}
+}
+
+bool
+as_conn_pool_put(as_conn_pool* pool, int fd)
+{
+	as_conn_pool_entry* entry = (as_conn_pool_entry*)ck_stack_pop_mpmc(&pool->unused);
+
+	if (! entry) {
+		// Pool is full.
+		return false;
+	}
+
+	entry->fd = fd;
+	entry->last_used = cf_getms();
+	
+	// Count before pushing so size never drops below the number of entries.
+	ck_pr_inc_32(&pool->size);
+	ck_stack_push_mpmc(&pool->idle, &entry->link);
+	return true;
+}
+
+uint32_t
+as_conn_pool_trim(as_conn_pool* pool, uint64_t max_idle_ms, uint32_t min_idle, uint32_t* idle)
+{
+	uint32_t excess = as_conn_pool_excess(ck_pr_load_32(&pool->size), min_idle);
+	
+	if (max_idle_ms == 0 || excess == 0) {
+		*idle = ck_pr_load_32(&pool->size);
+		return 0;
+	}
+	
+	// Sockets pop most recently used first, so stale sockets sit below any in
+	// recent use.  Take every idle socket off the stack, chaining them oldest
+	// first, so the stale ones can be reached.
+	uint64_t now = cf_getms();
+	ck_stack_entry_t* oldest = NULL;
+	ck_stack_entry_t* link;
+	
+	while ((link = ck_stack_pop_mpmc(&pool->idle))) {
+		link->next = oldest;
+		oldest = link;
+	}
+	
+	// Push fresh sockets back oldest first, so they keep their order, and close
+	// the stale ones after the stack is restored.
+	ck_stack_entry_t* stale = NULL;
+	uint32_t closed = 0;
+	
+	while (oldest) {
+		link = oldest;
+		oldest = link->next;
+		
+		as_conn_pool_entry* entry = (as_conn_pool_entry*)link;
+		
+		if (closed < excess && now - entry->last_used > max_idle_ms) {
+			ck_pr_dec_32(&pool->size);
+			link->next = stale;
+			stale = link;
+			closed++;
+		}
+		else {
+			ck_stack_push_mpmc(&pool->idle, link);
+		}
+	}
+	
+	while (stale) {
+		link = stale;
+		stale = link->next;
+		
+		as_conn_pool_entry* entry = (as_conn_pool_entry*)link;
+		as_close(entry->fd);
+		entry->fd = -1;
+		ck_stack_push_mpmc(&pool->unused, link);
+	}
+	*idle = ck_pr_load_32(&pool->size);
+	return closed;
+}
+
+#else // CK_F_STACK_POP_MPMC
+
+void
+as_conn_pool_init(as_conn_pool* pool, uint32_t capacity)
+{
+	pool->queue = cf_queue_create(sizeof(as_conn_pool_entry), true);
+	pool->capacity = capacity;
+}
+
+void
+as_conn_pool_destroy(as_conn_pool* pool)
+{
+	as_conn_pool_entry entry;
+	
+	while (cf_queue_pop(pool->queue, &entry, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		as_close(entry.fd);
+	}
+	cf_queue_destroy(pool->queue);
+}
+
+bool
+as_conn_pool_get(as_conn_pool* pool, uint64_t max_idle_ms, int* fd)
+{
+	uint64_t now = max_idle_ms ? cf_getms() : 0;
+	as_conn_pool_entry entry;
+	
+	while (cf_queue_pop(pool->queue, &entry, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		if (max_idle_ms == 0 || now - entry.last_used <= max_idle_ms) {
+			*fd = entry.fd;
+			return true;
+		}
+		
+		// The server may already have closed a socket idle this long.
+		as_close(entry.fd);
+	}
+	return false;
+}
+
+bool
+as_conn_pool_put(as_conn_pool* pool, int fd)
+{
+	as_conn_pool_entry entry;
+	entry.fd = fd;
+	entry.last_used = cf_getms();
+	return cf_queue_push_limit(pool->queue, &entry, pool->capacity);
+}
+
+uint32_t
+as_conn_pool_trim(as_conn_pool* pool, uint64_t max_idle_ms, uint32_t min_idle, uint32_t* idle)
+{
+	uint64_t now = cf_getms();
+	uint32_t excess = as_conn_pool_excess(cf_queue_sz(pool->queue), min_idle);
+	uint32_t closed = 0;
+	as_conn_pool_entry entry;
+	
+	// Queue is oldest first.  Stop at the first socket still in use recently and
+	// put it back at the head, so the queue keeps its order.
+	while (max_idle_ms > 0 && closed < excess) {
+		if (cf_queue_pop(pool->queue, &entry, CF_QUEUE_NOWAIT) != CF_QUEUE_OK) {
+			break;
+		}
+		
+		if (now - entry.last_used <= max_idle_ms) {
+			cf_queue_push_head(pool->queue, &entry);
+			break;
+		}
+		as_close(entry.fd);
+		closed++;
+	}
+	*idle = cf_queue_sz(pool->queue);
+	return closed;
+}
+
+#endif // CK_F_STACK_POP_MPMC
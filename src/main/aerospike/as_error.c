@@ -33,6 +33,10 @@ as_error_string(as_status status)
 		CASE_ASSIGN(AEROSPIKE_OK);
 		CASE_ASSIGN(AEROSPIKE_QUERY_END);
 			
+		CASE_ASSIGN(AEROSPIKE_ERR_NO_RESPONSE);
+		CASE_ASSIGN(AEROSPIKE_ERR_CLIENT_ABORT);
+		CASE_ASSIGN(AEROSPIKE_ERR_MAX_COMMANDS);
+		CASE_ASSIGN(AEROSPIKE_ERR_CIRCUIT_OPEN);
 		CASE_ASSIGN(AEROSPIKE_ERR_PARAM);
 		CASE_ASSIGN(AEROSPIKE_ERR_CLIENT);
 		CASE_ASSIGN(AEROSPIKE_ERR_SERVER);
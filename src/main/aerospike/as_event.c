@@ -0,0 +1,1270 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_event.h>
+#include <aerospike/as_admin.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_log_macros.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_proto.h>
+#include <aerospike/as_socket.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_clock.h>
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Maximum readiness events handled per loop iteration.
+#define AS_EVENT_MAX_EVENTS 256
+
+// How often in-flight commands are checked for timeouts.
+#define AS_EVENT_TIMER_MS 10
+
+// Pipes and connectors are registered for readiness events with a low bit of
+// their address set, so the loop can tell them apart from commands.
+#define AS_EVENT_PIPE_TAG ((uintptr_t)1)
+#define AS_EVENT_CONNECTOR_TAG ((uintptr_t)2)
+
+/******************************************************************************
+ * COMMON FUNCTIONS
+ *****************************************************************************/
+
+as_event_command*
+as_event_command_create(as_cluster* cluster, size_t size, uint32_t timeout_ms)
+{
+	as_event_command* cmd = cf_malloc(sizeof(as_event_command));
+	memset(cmd, 0, sizeof(as_event_command));
+	cmd->cluster = cluster;
+	cmd->buf = cf_malloc(size);
+	cmd->capacity = size;
+	cmd->deadline_ms = as_socket_deadline(timeout_ms);
+	cmd->fd = -1;
+	return cmd;
+}
+
+void
+as_event_command_destroy(as_event_command* cmd)
+{
+	cf_free(cmd->buf);
+	cf_free(cmd);
+}
+
+#if defined(__linux__)
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_event_notify(as_event_command* cmd, as_error* err)
+{
+	if (cmd->type == AS_ASYNC_TYPE_RECORD) {
+		cmd->listener.record(err, 0, cmd->udata);
+	}
+	else {
+		cmd->listener.write(err, cmd->udata);
+	}
+}
+
+static void
+as_event_link(as_event_loop* loop, as_event_command* cmd)
+{
+	cmd->event_loop = loop;
+	cmd->prev = 0;
+	cmd->next = loop->head;
+	
+	if (loop->head) {
+		loop->head->prev = cmd;
+	}
+	loop->head = cmd;
+}
+
+static void
+as_event_unlink(as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	
+	if (cmd->prev) {
+		cmd->prev->next = cmd->next;
+	}
+	else {
+		loop->head = cmd->next;
+	}
+	
+	if (cmd->next) {
+		cmd->next->prev = cmd->prev;
+	}
+}
+
+/**
+ *	Fail command, discard its socket and notify the listener.
+ */
+static void
+as_event_connector_free(as_event_connector* c);
+
+static void
+as_event_fail(as_event_command* cmd, as_error* err)
+{
+	as_event_unlink(cmd);
+	
+	if (cmd->connector) {
+		as_event_connector_free(cmd->connector);
+		cmd->connector = 0;
+	}
+	
+	// Socket may contain a partial request or response.  Do not put back in pool.
+	// Closing the socket also removes it from the epoll set.
+	if (cmd->fd >= 0) {
+		as_close(cmd->fd);
+	}
+	as_node_release(cmd->node);
+	as_event_notify(cmd, err);
+	as_event_command_destroy(cmd);
+}
+
+static void
+as_event_fail_status(as_event_command* cmd, as_status status, const char* message)
+{
+	as_error err;
+	as_error_set_message(&err, status, message);
+	as_event_fail(cmd, &err);
+}
+
+/**
+ *	Parse response, notify the listener and destroy the command.
+ */
+static void
+as_event_parse_response(as_event_command* cmd)
+{
+	// Response body starts with as_msg, which follows the 8 byte as_proto.
+	as_msg* msg = (as_msg*)(cmd->buf + sizeof(as_proto));
+	as_msg_swap_header_from_be(msg);
+	
+	as_error err;
+	as_error_init(&err);
+	
+	if (cmd->type == AS_ASYNC_TYPE_RECORD) {
+		as_record* rec = 0;
+		as_status status = as_command_parse_record(&err, msg, (uint8_t*)msg + sizeof(as_msg), &rec);
+		
+		if (status == AEROSPIKE_OK) {
+			cmd->listener.record(0, rec, cmd->udata);
+			as_record_destroy(rec);
+		}
+		else {
+			if (err.code != status) {
+				as_error_set_message(&err, status, as_error_string(status));
+			}
+			cmd->listener.record(&err, 0, cmd->udata);
+		}
+	}
+	else {
+		as_status status = msg->result_code;
+		
+		if (status == AEROSPIKE_OK || (status == AEROSPIKE_ERR_RECORD_NOT_FOUND && cmd->not_found_ok)) {
+			cmd->listener.write(0, cmd->udata);
+		}
+		else {
+			as_error_set_message(&err, status, as_error_string(status));
+			cmd->listener.write(&err, cmd->udata);
+		}
+	}
+	as_event_command_destroy(cmd);
+}
+
+/**
+ *	Return socket to pool, then parse response and notify the listener.
+ */
+static void
+as_event_complete(as_event_command* cmd)
+{
+	as_event_loop* loop = cmd->event_loop;
+	as_event_unlink(cmd);
+	epoll_ctl(loop->poll_fd, EPOLL_CTL_DEL, cmd->fd, NULL);
+	as_node_put_connection(cmd->node, cmd->fd);
+	as_node_release(cmd->node);
+	as_event_parse_response(cmd);
+}
+
+static inline bool
+as_event_would_block()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == EINTR;
+}
+
+/**
+ *	Write as much of buf as the socket accepts.
+ *	Returns 1 when fully written, 0 when the socket is full and -1 on error.
+ */
+static int
+as_event_write_buf(int fd, uint8_t* buf, size_t* pos, size_t len, as_error* err)
+{
+	while (*pos < len) {
+		ssize_t bytes = send(fd, buf + *pos, len - *pos, MSG_NOSIGNAL);
+		
+		if (bytes > 0) {
+			*pos += bytes;
+			continue;
+		}
+		
+		if (bytes < 0 && as_event_would_block()) {
+			return 0;
+		}
+		as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+		return -1;
+	}
+	return 1;
+}
+
+/**
+ *	Read as much of buf as is available.
+ *	Returns 1 when fully read, 0 when more data is needed and -1 on error.
+ */
+static int
+as_event_read_buf(int fd, uint8_t* buf, size_t* pos, size_t len, as_error* err)
+{
+	while (*pos < len) {
+		ssize_t bytes = read(fd, buf + *pos, len - *pos);
+		
+		if (bytes > 0) {
+			*pos += bytes;
+			continue;
+		}
+		
+		if (bytes < 0 && as_event_would_block()) {
+			return 0;
+		}
+		
+		if (bytes == 0) {
+			as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+		else {
+			as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+		return -1;
+	}
+	return 1;
+}
+
+/**
+ *	Write as much of the command as the socket accepts.
+ *	Returns 1 when fully written, 0 when the socket is full and -1 on error.
+ */
+static inline int
+as_event_write(as_event_command* cmd, as_error* err)
+{
+	return as_event_write_buf(cmd->fd, cmd->buf, &cmd->pos, cmd->len, err);
+}
+
+/**
+ *	Read as much of the response as is available.  The 8 byte proto header is
+ *	read first, then buf is grown to hold the full message.
+ *	Returns 1 when fully read, 0 when more data is needed and -1 on error.
+ */
+static int
+as_event_read(as_event_command* cmd, as_error* err)
+{
+	while (true) {
+		int rv = as_event_read_buf(cmd->fd, cmd->buf, &cmd->pos, cmd->len, err);
+		
+		if (rv <= 0 || cmd->len > sizeof(as_proto)) {
+			return rv;
+		}
+		
+		// Proto header complete.  Size buffer for the rest of the message.
+		as_proto* proto = (as_proto*)cmd->buf;
+		as_proto_swap_from_be(proto);
+		size_t total = sizeof(as_proto) + proto->sz;
+		
+		if (! as_command_valid_proto(proto)) {
+			as_error_update(err, AEROSPIKE_ERR_CLIENT,
+				"Invalid async response header: fd=%d version=%u type=%u size=%zu",
+				cmd->fd, (uint32_t)proto->version, (uint32_t)proto->type, total);
+			return -1;
+		}
+		
+		if (total > cmd->capacity) {
+			cmd->buf = cf_realloc(cmd->buf, total);
+			cmd->capacity = total;
+		}
+		cmd->len = total;
+	}
+}
+
+static void
+as_event_start_read(as_event_command* cmd)
+{
+	cmd->writing = false;
+	cmd->pos = 0;
+	cmd->len = sizeof(as_proto);
+}
+
+static void
+as_event_send(as_event_loop* loop, as_event_command* cmd);
+
+static void
+as_event_pipe_fail(as_event_pipe* pipe, as_error* err);
+
+static void
+as_event_pipe_process(as_event_pipe* pipe, bool readable);
+
+/******************************************************************************
+ * CONNECTOR FUNCTIONS
+ *****************************************************************************/
+
+static void
+as_event_connector_free(as_event_connector* c)
+{
+	as_vector* connectors = &c->event_loop->connectors;
+	
+	for (uint32_t i = 0; i < connectors->size; i++) {
+		if (as_vector_get_ptr(connectors, i) == c) {
+			as_vector_move(connectors, connectors->size - 1, i);
+			connectors->size--;
+			break;
+		}
+	}
+	cf_free(c->buf);
+	cf_free(c);
+}
+
+/**
+ *	Start login on the new socket of a command or pipe.  The socket is owned by
+ *	the command or pipe, which closes it on failure.  Returns false if the
+ *	socket could not be registered.
+ */
+static bool
+as_event_connector_start(as_event_loop* loop, as_cluster* cluster, int fd, as_event_command* cmd,
+	as_event_pipe* pipe, uint64_t deadline_ms, as_error* err)
+{
+	as_event_connector* c = cf_malloc(sizeof(as_event_connector));
+	c->event_loop = loop;
+	c->cmd = cmd;
+	c->pipe = pipe;
+	c->buf = cf_malloc(AS_STACK_BUF_SIZE);
+	c->len = as_authenticate_set(cluster->user, cluster->password, c->buf);
+	c->pos = 0;
+	c->fd = fd;
+	c->writing = true;
+	
+	// Login may not outlast the command it opens the connection for.
+	c->deadline_ms = as_socket_deadline(cluster->conn_timeout_ms);
+	
+	if (deadline_ms && (! c->deadline_ms || deadline_ms < c->deadline_ms)) {
+		c->deadline_ms = deadline_ms;
+	}
+	
+	// Socket becomes writable once connected.
+	struct epoll_event ev;
+	ev.events = EPOLLOUT;
+	ev.data.ptr = (void*)((uintptr_t)c | AS_EVENT_CONNECTOR_TAG);
+	
+	if (epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		as_error_update(err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+		cf_free(c->buf);
+		cf_free(c);
+		return false;
+	}
+	as_vector_append(&loop->connectors, &c);
+	
+	if (cmd) {
+		cmd->connector = c;
+	}
+	else {
+		pipe->connector = c;
+	}
+	return true;
+}
+
+/**
+ *	Fail login and its owner.
+ */
+static void
+as_event_connector_fail(as_event_connector* c, as_error* err)
+{
+	as_event_command* cmd = c->cmd;
+	as_event_pipe* pipe = c->pipe;
+	as_event_connector_free(c);
+	
+	if (cmd) {
+		cmd->connector = 0;
+		as_event_fail(cmd, err);
+	}
+	else {
+		pipe->connector = 0;
+		as_event_pipe_fail(pipe, err);
+	}
+}
+
+/**
+ *	Hand the logged in socket to its owner, which registers it for its own
+ *	events.
+ */
+static void
+as_event_connector_done(as_event_connector* c)
+{
+	as_event_loop* loop = c->event_loop;
+	as_event_command* cmd = c->cmd;
+	as_event_pipe* pipe = c->pipe;
+	epoll_ctl(loop->poll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+	as_event_connector_free(c);
+	
+	if (cmd) {
+		cmd->connector = 0;
+		as_event_send(loop, cmd);
+		return;
+	}
+	
+	pipe->connector = 0;
+	
+	struct epoll_event ev;
+	ev.events = 0;
+	ev.data.ptr = (void*)((uintptr_t)pipe | AS_EVENT_PIPE_TAG);
+	
+	if (epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, pipe->fd, &ev) < 0) {
+		as_error err;
+		as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+		as_event_pipe_fail(pipe, &err);
+		return;
+	}
+	pipe->events = 0;
+	as_event_pipe_process(pipe, false);
+}
+
+/**
+ *	Write login request, then read its response.
+ */
+static void
+as_event_connector_process(as_event_connector* c)
+{
+	as_error err;
+	as_error_init(&err);
+	
+	if (c->writing) {
+		int rv = as_event_write_buf(c->fd, c->buf, &c->pos, c->len, &err);
+		
+		if (rv < 0) {
+			as_event_connector_fail(c, &err);
+			return;
+		}
+		
+		if (rv == 0) {
+			return;
+		}
+		
+		c->writing = false;
+		c->pos = 0;
+		c->len = AS_AUTHENTICATE_RESPONSE_SIZE;
+		
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = (void*)((uintptr_t)c | AS_EVENT_CONNECTOR_TAG);
+		
+		if (epoll_ctl(c->event_loop->poll_fd, EPOLL_CTL_MOD, c->fd, &ev) < 0) {
+			as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+			as_event_connector_fail(c, &err);
+		}
+		return;
+	}
+	
+	int rv = as_event_read_buf(c->fd, c->buf, &c->pos, c->len, &err);
+	
+	if (rv < 0 || (rv > 0 && as_authenticate_parse(&err, c->buf))) {
+		as_event_connector_fail(c, &err);
+		return;
+	}
+	
+	if (rv > 0) {
+		as_event_connector_done(c);
+	}
+}
+
+/******************************************************************************
+ * COMMAND FUNCTIONS
+ *****************************************************************************/
+
+/**
+ *	Open a new connection for command and send the command once the connection
+ *	can be used.  The connect is not waited for, and login is driven by the
+ *	loop, so this never blocks.  Returns false if the connection could not be
+ *	started.
+ */
+static bool
+as_event_command_connect(as_event_loop* loop, as_event_command* cmd, as_error* err)
+{
+	as_cluster* cluster = cmd->cluster;
+	int status = as_node_connect(cmd->node, &cmd->fd);
+	
+	if (status) {
+		cmd->fd = -1;
+		as_error_update(err, status, "Failed to connect: %s", cmd->node->name);
+		return false;
+	}
+	cmd->reused = false;
+	
+	if (cluster->user) {
+		return as_event_connector_start(loop, cluster, cmd->fd, cmd, NULL, cmd->deadline_ms, err);
+	}
+	as_event_send(loop, cmd);
+	return true;
+}
+
+/**
+ *	Resend command on a new connection if its pooled socket failed before any
+ *	response bytes arrived.  Pooled sockets are not checked before use, so the
+ *	server may have closed the socket while it was idle.
+ *	Returns true if the command was resent.
+ */
+static bool
+as_event_retry_fresh(as_event_command* cmd)
+{
+	if (! cmd->reused || (! cmd->writing && cmd->pos > 0)) {
+		return false;
+	}
+	
+	// Closing the socket also removes it from the epoll set.
+	as_close(cmd->fd);
+	cmd->fd = -1;
+	cmd->writing = true;
+	cmd->pos = 0;
+	cmd->len = cmd->write_len;
+	
+	as_error err;
+	return as_event_command_connect(cmd->event_loop, cmd, &err);
+}
+
+static void
+as_event_process(as_event_command* cmd)
+{
+	as_error err;
+	as_error_init(&err);
+	
+	if (cmd->writing) {
+		int rv = as_event_write(cmd, &err);
+		
+		if (rv < 0) {
+			if (! as_event_retry_fresh(cmd)) {
+				as_event_fail(cmd, &err);
+			}
+			return;
+		}
+		
+		if (rv == 0) {
+			return;
+		}
+		
+		as_event_start_read(cmd);
+		
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = cmd;
+		
+		if (epoll_ctl(cmd->event_loop->poll_fd, EPOLL_CTL_MOD, cmd->fd, &ev) < 0) {
+			as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+			as_event_fail(cmd, &err);
+			return;
+		}
+		// Response is not likely to be available yet.  Wait for next event.
+		return;
+	}
+	
+	int rv = as_event_read(cmd, &err);
+	
+	if (rv < 0) {
+		if (! as_event_retry_fresh(cmd)) {
+			as_event_fail(cmd, &err);
+		}
+		return;
+	}
+	
+	if (rv > 0) {
+		as_event_complete(cmd);
+	}
+}
+
+/**
+ *	Write command and register its socket.
+ */
+static void
+as_event_send(as_event_loop* loop, as_event_command* cmd)
+{
+	as_error err;
+	as_error_init(&err);
+	
+	// Socket is usually writable right away, so try before registering.
+	int rv = as_event_write(cmd, &err);
+	
+	if (rv < 0) {
+		if (! as_event_retry_fresh(cmd)) {
+			as_event_fail(cmd, &err);
+		}
+		return;
+	}
+	
+	struct epoll_event ev;
+	ev.data.ptr = cmd;
+	
+	if (rv > 0) {
+		as_event_start_read(cmd);
+		ev.events = EPOLLIN;
+	}
+	else {
+		ev.events = EPOLLOUT;
+	}
+	
+	if (epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, cmd->fd, &ev) < 0) {
+		as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+		as_event_fail(cmd, &err);
+	}
+}
+
+/**
+ *	Link command into the in-flight list, pick its connection, write it and
+ *	register its socket.
+ */
+static void
+as_event_start(as_event_loop* loop, as_event_command* cmd)
+{
+	as_event_link(loop, cmd);
+	
+	if (as_node_get_idle_connection(cmd->node, &cmd->fd)) {
+		cmd->reused = true;
+		as_event_send(loop, cmd);
+		return;
+	}
+	
+	as_error err;
+	
+	if (! as_event_command_connect(loop, cmd, &err)) {
+		as_event_fail(cmd, &err);
+	}
+}
+
+/**
+ *	Remove pipe from its loop and free it.  The socket is returned to the pool
+ *	only if the pipe is idle, because otherwise it may hold a partial request or
+ *	response.
+ */
+static void
+as_event_pipe_release(as_event_pipe* pipe, bool put_back)
+{
+	as_event_loop* loop = pipe->event_loop;
+	as_vector* pipes = &loop->pipes;
+	
+	for (uint32_t i = 0; i < pipes->size; i++) {
+		if (as_vector_get_ptr(pipes, i) == pipe) {
+			as_vector_move(pipes, pipes->size - 1, i);
+			pipes->size--;
+			break;
+		}
+	}
+	
+	if (pipe->connector) {
+		as_event_connector_free(pipe->connector);
+		pipe->connector = 0;
+	}
+	
+	if (put_back) {
+		epoll_ctl(loop->poll_fd, EPOLL_CTL_DEL, pipe->fd, NULL);
+		as_node_put_connection(pipe->node, pipe->fd);
+	}
+	else {
+		as_close(pipe->fd);
+	}
+	as_node_release(pipe->node);
+	cf_free(pipe);
+}
+
+static void
+as_event_pipe_fail_queue(as_event_command* cmd, as_error* err)
+{
+	while (cmd) {
+		as_event_command* next = cmd->pipe_next;
+		
+		if (! cmd->timed_out) {
+			as_event_unlink(cmd);
+			as_event_notify(cmd, err);
+		}
+		as_node_release(cmd->node);
+		as_event_command_destroy(cmd);
+		cmd = next;
+	}
+}
+
+/**
+ *	Close pipe socket and fail every command queued on it, oldest first.
+ */
+static void
+as_event_pipe_fail(as_event_pipe* pipe, as_error* err)
+{
+	as_event_command* readers = pipe->reader_head;
+	as_event_command* writers = pipe->writer_head;
+	as_event_pipe_release(pipe, false);
+	as_event_pipe_fail_queue(readers, err);
+	as_event_pipe_fail_queue(writers, err);
+}
+
+/**
+ *	Write queued commands back-to-back.  Fully written commands move to the
+ *	reader queue.  Returns false on socket error.
+ */
+static bool
+as_event_pipe_write(as_event_pipe* pipe, as_error* err)
+{
+	as_event_command* cmd;
+	
+	while ((cmd = pipe->writer_head)) {
+		int rv = as_event_write(cmd, err);
+		
+		if (rv < 0) {
+			return false;
+		}
+		
+		if (rv == 0) {
+			return true;
+		}
+		
+		pipe->writer_head = cmd->pipe_next;
+		
+		if (! pipe->writer_head) {
+			pipe->writer_tail = 0;
+		}
+		
+		as_event_start_read(cmd);
+		cmd->pipe_next = 0;
+		
+		if (pipe->reader_tail) {
+			pipe->reader_tail->pipe_next = cmd;
+		}
+		else {
+			pipe->reader_head = cmd;
+		}
+		pipe->reader_tail = cmd;
+	}
+	return true;
+}
+
+/**
+ *	Read responses in the order commands were written.  Returns false on socket
+ *	error.
+ */
+static bool
+as_event_pipe_read(as_event_pipe* pipe, as_error* err)
+{
+	as_event_command* cmd;
+	
+	while ((cmd = pipe->reader_head)) {
+		int rv = as_event_read(cmd, err);
+		
+		if (rv < 0) {
+			return false;
+		}
+		
+		if (rv == 0) {
+			return true;
+		}
+		
+		pipe->reader_head = cmd->pipe_next;
+		
+		if (! pipe->reader_head) {
+			pipe->reader_tail = 0;
+		}
+		
+		as_node_release(cmd->node);
+		
+		if (cmd->timed_out) {
+			// Listener was already called.  Discard response.
+			as_event_command_destroy(cmd);
+		}
+		else {
+			as_event_unlink(cmd);
+			as_event_parse_response(cmd);
+		}
+	}
+	return true;
+}
+
+/**
+ *	Drive pipe socket I/O.  Then either return the socket to the pool when no
+ *	commands remain, or register for the events the pipe is waiting on.
+ */
+static void
+as_event_pipe_process(as_event_pipe* pipe, bool readable)
+{
+	as_error err;
+	as_error_init(&err);
+	
+	if (! as_event_pipe_write(pipe, &err) || (readable && ! as_event_pipe_read(pipe, &err))) {
+		as_event_pipe_fail(pipe, &err);
+		return;
+	}
+	
+	if (! pipe->writer_head && ! pipe->reader_head) {
+		as_event_pipe_release(pipe, true);
+		return;
+	}
+	
+	uint32_t events = 0;
+	
+	if (pipe->writer_head) {
+		events |= EPOLLOUT;
+	}
+	
+	if (pipe->reader_head) {
+		events |= EPOLLIN;
+	}
+	
+	if (events != pipe->events) {
+		struct epoll_event ev;
+		ev.events = events;
+		ev.data.ptr = (void*)((uintptr_t)pipe | AS_EVENT_PIPE_TAG);
+		
+		if (epoll_ctl(pipe->event_loop->poll_fd, EPOLL_CTL_MOD, pipe->fd, &ev) < 0) {
+			as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+			as_event_pipe_fail(pipe, &err);
+			return;
+		}
+		pipe->events = events;
+	}
+}
+
+/**
+ *	Queue command on its node's pipe, opening the pipe if the loop does not have
+ *	one for the node yet.
+ */
+static void
+as_event_pipe_start(as_event_loop* loop, as_event_command* cmd)
+{
+	as_event_link(loop, cmd);
+	
+	as_node* node = cmd->node;
+	as_vector* pipes = &loop->pipes;
+	as_event_pipe* pipe = 0;
+	
+	for (uint32_t i = 0; i < pipes->size; i++) {
+		as_event_pipe* p = as_vector_get_ptr(pipes, i);
+		
+		if (p->node == node) {
+			pipe = p;
+			break;
+		}
+	}
+	
+	if (! pipe) {
+		// A new connection is opened if the pool is empty.  This only happens
+		// once per burst of commands to the node.
+		int fd;
+		bool idle = as_node_get_idle_connection(node, &fd);
+		
+		if (! idle) {
+			as_status status = as_node_connect(node, &fd);
+			
+			if (status) {
+				as_error err;
+				as_error_update(&err, status, "Failed to connect: %s", node->name);
+				as_event_fail(cmd, &err);
+				return;
+			}
+		}
+		
+		pipe = cf_malloc(sizeof(as_event_pipe));
+		memset(pipe, 0, sizeof(as_event_pipe));
+		pipe->event_loop = loop;
+		pipe->node = node;
+		pipe->fd = fd;
+		as_node_reserve(node);
+		as_vector_append(pipes, &pipe);
+		
+		as_error err;
+		bool registered;
+		
+		if (! idle && cmd->cluster->user) {
+			// Commands queue on the pipe until the login completes.
+			registered = as_event_connector_start(loop, cmd->cluster, fd, NULL, pipe, 0, &err);
+		}
+		else {
+			struct epoll_event ev;
+			ev.events = 0;
+			ev.data.ptr = (void*)((uintptr_t)pipe | AS_EVENT_PIPE_TAG);
+			registered = epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+			
+			if (! registered) {
+				as_error_update(&err, AEROSPIKE_ERR_CLIENT, "epoll_ctl failed: %d", errno);
+			}
+		}
+		
+		if (! registered) {
+			as_event_pipe_release(pipe, false);
+			as_event_fail(cmd, &err);
+			return;
+		}
+	}
+	
+	cmd->pipe = pipe;
+	cmd->fd = pipe->fd;
+	cmd->pipe_next = 0;
+	
+	if (pipe->writer_tail) {
+		// Writer is waiting for the socket to drain.  Command is written after
+		// the ones ahead of it.
+		pipe->writer_tail->pipe_next = cmd;
+		pipe->writer_tail = cmd;
+		return;
+	}
+	
+	pipe->writer_head = cmd;
+	pipe->writer_tail = cmd;
+	
+	if (! pipe->connector) {
+		as_event_pipe_process(pipe, false);
+	}
+}
+
+/**
+ *	Time out pipelined command.  The listener is called right away, but the
+ *	command stays queued so its response can be skipped when it arrives.
+ *	Returns true if the pipe was closed.
+ */
+static bool
+as_event_pipe_timeout(as_event_command* cmd)
+{
+	as_error err;
+	as_error_set_message(&err, AEROSPIKE_ERR_TIMEOUT, "Async command timed out");
+	as_event_unlink(cmd);
+	as_event_notify(cmd, &err);
+	cmd->timed_out = true;
+	
+	as_event_pipe* pipe = cmd->pipe;
+	
+	if (pipe->reader_head != cmd) {
+		return false;
+	}
+	
+	// The oldest response on the socket is overdue, so every command queued
+	// behind it is stuck too.
+	as_error_set_message(&err, AEROSPIKE_ERR_TIMEOUT, "Async pipeline closed after earlier command timed out");
+	as_event_pipe_fail(pipe, &err);
+	return true;
+}
+
+static void
+as_event_check_timeouts(as_event_loop* loop)
+{
+	uint64_t now = cf_getms();
+	as_vector* connectors = &loop->connectors;
+	
+	// Failing a connector moves the last one into its slot, which was already
+	// checked.
+	for (uint32_t i = connectors->size; i > 0; i--) {
+		as_event_connector* c = as_vector_get_ptr(connectors, i - 1);
+		
+		if (c->deadline_ms && now > c->deadline_ms) {
+			as_error err;
+			as_error_set_message(&err, AEROSPIKE_ERR_TIMEOUT, "Async login timed out");
+			as_event_connector_fail(c, &err);
+		}
+	}
+	
+	as_event_command* cmd = loop->head;
+	
+	while (cmd) {
+		as_event_command* next = cmd->next;
+		
+		if (cmd->deadline_ms && now > cmd->deadline_ms) {
+			if (! cmd->pipe) {
+				as_event_fail_status(cmd, AEROSPIKE_ERR_TIMEOUT, "Async command timed out");
+			}
+			else if (as_event_pipe_timeout(cmd)) {
+				// Closing the pipe unlinked other commands.  Start over.
+				next = loop->head;
+			}
+		}
+		cmd = next;
+	}
+}
+
+static void
+as_event_abort_all(as_event_loop* loop, as_error* err)
+{
+	as_event_command* cmd;
+	
+	while (loop->pipes.size > 0) {
+		as_event_pipe_fail(as_vector_get_ptr(&loop->pipes, 0), err);
+	}
+	
+	while (cf_queue_pop(loop->queue, &cmd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		// Command was never started.  Link it so it can be failed like the others.
+		as_event_link(loop, cmd);
+	}
+	
+	while (loop->head) {
+		as_event_fail(loop->head, err);
+	}
+}
+
+/**
+ *	Fail commands queued to a loop that has exited.  Called by the threads that
+ *	queue commands, so the commands are never linked to the loop.
+ */
+static void
+as_event_abort_queue(as_event_loop* loop)
+{
+	as_event_command* cmd;
+	
+	as_error err;
+	as_error_set_message(&err, AEROSPIKE_ERR_CLIENT, "Async command aborted: event loop closed");
+	
+	while (cf_queue_pop(loop->queue, &cmd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		as_node_release(cmd->node);
+		as_event_notify(cmd, &err);
+		as_event_command_destroy(cmd);
+	}
+}
+
+static void*
+as_event_loop_run(void* udata)
+{
+	as_event_loop* loop = udata;
+	struct epoll_event events[AS_EVENT_MAX_EVENTS];
+	uint64_t next_timer = cf_getms() + AS_EVENT_TIMER_MS;
+	
+	as_error err;
+	as_error_set_message(&err, AEROSPIKE_ERR_CLIENT, "Async command aborted: cluster closing");
+	
+	while (! loop->closing) {
+		int timeout = (loop->head || loop->connectors.size) ? AS_EVENT_TIMER_MS : -1;
+		int n = epoll_wait(loop->poll_fd, events, AS_EVENT_MAX_EVENTS, timeout);
+		
+		if (n < 0 && errno != EINTR) {
+			// The loop can no longer run commands.  Close it before draining the
+			// queue, so commands queued from now on are failed by their callers.
+			int e = errno;
+			as_log_error("epoll_wait failed: %d", e);
+			as_error_update(&err, AEROSPIKE_ERR_CLIENT, "Async command aborted: event loop failed: %d", e);
+			loop->closing = true;
+			break;
+		}
+		
+		bool wakeup = false;
+		
+		for (int i = 0; i < n; i++) {
+			uintptr_t ptr = (uintptr_t)events[i].data.ptr;
+			
+			if (! ptr) {
+				wakeup = true;
+			}
+			else if (ptr & AS_EVENT_PIPE_TAG) {
+				as_event_pipe* pipe = (as_event_pipe*)(ptr & ~AS_EVENT_PIPE_TAG);
+				as_event_pipe_process(pipe, (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0);
+			}
+			else if (ptr & AS_EVENT_CONNECTOR_TAG) {
+				as_event_connector_process((as_event_connector*)(ptr & ~AS_EVENT_CONNECTOR_TAG));
+			}
+			else {
+				as_event_process((as_event_command*)ptr);
+			}
+		}
+		
+		if (wakeup) {
+			// Start queued commands.  This is done after the other events because
+			// starting a pipelined command can free a pipe that is referenced by
+			// a later event in the same batch.
+			uint64_t count;
+			
+			if (read(loop->wakeup_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+				as_log_warn("Event loop wakeup read failed: %d", errno);
+			}
+			
+			as_event_command* cmd;
+			
+			while (cf_queue_pop(loop->queue, &cmd, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+				if (cmd->cluster->async_pipeline) {
+					as_event_pipe_start(loop, cmd);
+				}
+				else {
+					as_event_start(loop, cmd);
+				}
+			}
+		}
+		
+		uint64_t now = cf_getms();
+		
+		if (now >= next_timer) {
+			as_event_check_timeouts(loop);
+			next_timer = now + AS_EVENT_TIMER_MS;
+		}
+	}
+	as_event_abort_all(loop, &err);
+	return NULL;
+}
+
+static void
+as_event_loops_init(as_cluster* cluster)
+{
+	// We do this lazily, during the first async request, so make sure it's only
+	// done once.
+	if (ck_pr_load_32(&cluster->event_initialized) == 1) {
+		return;
+	}
+	
+	pthread_mutex_lock(&cluster->event_init_lock);
+	
+	if (ck_pr_load_32(&cluster->event_initialized) == 1) {
+		// Lost race - another thread got here first.
+		pthread_mutex_unlock(&cluster->event_init_lock);
+		return;
+	}
+	
+	uint32_t size = cluster->event_loops_size;
+	as_event_loop* loops = cf_malloc(sizeof(as_event_loop) * size);
+	memset(loops, 0, sizeof(as_event_loop) * size);
+	
+	for (uint32_t i = 0; i < size; i++) {
+		as_event_loop* loop = &loops[i];
+		loop->queue = cf_queue_create(sizeof(as_event_command*), true);
+		as_vector_init(&loop->pipes, sizeof(as_event_pipe*), 8);
+		as_vector_init(&loop->connectors, sizeof(as_event_connector*), 8);
+		loop->poll_fd = epoll_create(AS_EVENT_MAX_EVENTS);
+		loop->wakeup_fd = eventfd(0, EFD_NONBLOCK);
+		
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = 0;
+		epoll_ctl(loop->poll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &ev);
+		pthread_create(&loop->thread, 0, as_event_loop_run, loop);
+	}
+	cluster->event_loops = loops;
+	
+	// It's now safe to submit commands.
+	ck_pr_store_32(&cluster->event_initialized, 1);
+	pthread_mutex_unlock(&cluster->event_init_lock);
+}
+
+static inline void
+as_event_wakeup(as_event_loop* loop)
+{
+	uint64_t count = 1;
+	
+	if (write(loop->wakeup_fd, &count, sizeof(count)) < 0) {
+		as_log_warn("Event loop wakeup write failed: %d", errno);
+	}
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_status
+as_event_command_execute(as_event_command* cmd, as_error* err, const char* ns,
+	uint32_t ns_id, const cf_digest* digest, as_policy_replica replica, bool write)
+{
+	as_cluster* cluster = cmd->cluster;
+	
+	if (cluster->event_loops_size == 0) {
+		as_event_command_destroy(cmd);
+		return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Async event loops are disabled");
+	}
+	
+	as_event_loops_init(cluster);
+	
+	// The command outlives this call, so it keeps its own reference to the node.
+	as_node* node = as_node_get_reserved(cluster, ns, ns_id, digest, write, replica);
+	
+	if (! node) {
+		as_event_command_destroy(cmd);
+		return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Failed to find node for namespace %s", ns);
+	}
+	
+	// The event loop picks the connection, so opening one never blocks the
+	// caller, which may be a listener running on an event loop.
+	cmd->node = node;
+	cmd->writing = true;
+	cmd->pos = 0;
+	cmd->write_len = cmd->len;
+	
+	uint32_t index = ck_pr_faa_32(&cluster->event_loop_index, 1) % cluster->event_loops_size;
+	as_event_loop* loop = &cluster->event_loops[index];
+	cf_queue_push(loop->queue, &cmd);
+	
+	// A loop that has exited never drains its queue, so fail the command here.
+	// The loop sets closing before its final drain, which takes the queue lock,
+	// so a command queued after that drain always sees it.
+	if (loop->closing) {
+		as_event_abort_queue(loop);
+		return AEROSPIKE_OK;
+	}
+	as_event_wakeup(loop);
+	return AEROSPIKE_OK;
+}
+
+void
+as_event_loops_shutdown(as_cluster* cluster)
+{
+	// Note - we assume no application threads are submitting async commands
+	// while we're shutting down the cluster.
+	if (ck_pr_load_32(&cluster->event_initialized) == 0) {
+		return;
+	}
+	
+	for (uint32_t i = 0; i < cluster->event_loops_size; i++) {
+		as_event_loop* loop = &cluster->event_loops[i];
+		loop->closing = true;
+		as_event_wakeup(loop);
+	}
+	
+	for (uint32_t i = 0; i < cluster->event_loops_size; i++) {
+		as_event_loop* loop = &cluster->event_loops[i];
+		pthread_join(loop->thread, NULL);
+		as_close(loop->wakeup_fd);
+		as_close(loop->poll_fd);
+		cf_queue_destroy(loop->queue);
+		as_vector_destroy(&loop->pipes);
+		as_vector_destroy(&loop->connectors);
+	}
+	cf_free(cluster->event_loops);
+	cluster->event_loops = 0;
+	ck_pr_store_32(&cluster->event_initialized, 0);
+}
+
+#else // __linux__
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+as_status
+as_event_command_execute(as_event_command* cmd, as_error* err, const char* ns,
+	uint32_t ns_id, const cf_digest* digest, as_policy_replica replica, bool write)
+{
+	as_event_command_destroy(cmd);
+	return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Async commands are not supported on this platform");
+}
+
+void
+as_event_loops_shutdown(as_cluster* cluster)
+{
+}
+
+#endif // __linux__
@@ -18,6 +18,7 @@
 #include <aerospike/as_integer.h>
 #include <aerospike/as_command.h>
 #include <aerospike/as_log_macros.h>
+#include <aerospike/as_partition.h>
 #include <aerospike/as_string.h>
 #include <aerospike/as_bytes.h>
 
@@ -46,13 +47,25 @@ static as_key * as_key_cons(as_key * key, bool free, const as_namespace ns, cons
 		set = "";
 	}
 
-	if ( ! (ns && *ns != '\0' && strlen(ns) < AS_NAMESPACE_MAX_SIZE && strlen(set) < AS_SET_MAX_SIZE) ) {
+	if ( ! ns ) {
+		return NULL;
+	}
+
+	size_t ns_len = strlen(ns);
+	size_t set_len = strlen(set);
+
+	if ( ! (ns_len > 0 && ns_len < AS_NAMESPACE_MAX_SIZE && set_len < AS_SET_MAX_SIZE) ) {
 		return NULL;
 	}
 
 	key->_free = free;
-	strcpy(key->ns, ns);
-	strcpy(key->set, set);
+	memcpy(key->ns, ns, ns_len + 1);
+	memcpy(key->set, set, set_len + 1);
+	key->_ns_id = (uint16_t)as_namespace_intern(ns, ns_len);
+	key->_ns_len = (uint8_t)ns_len;
+	key->_set_len = (uint8_t)set_len;
+	key->_fields_size = 0;
+	key->_n_fields = 0;
 	key->valuep = (as_key_value *) valuep;
 	
 	if ( digest == NULL ) {
@@ -204,6 +217,7 @@ as_key * as_key_new_value(const as_namespace ns, const as_set set, const as_key_
 void as_key_destroy(as_key * key)
 {
 	if ( !key ) return;
+
 	if ( !key->valuep ) return;
 
 	as_val_destroy((as_val *) key->valuep);
@@ -237,7 +251,7 @@ as_key_set_digest(as_error* err, as_key* key)
 		return AEROSPIKE_OK;
 	}
 	
-	size_t set_len = strlen(key->set);
+	size_t set_len = key->_ns_len ? key->_set_len : strlen(key->set);
 	size_t size;
 	
 	as_val* val = (as_val*)key->valuep;
@@ -287,3 +301,30 @@ as_key_set_digest(as_error* err, as_key* key)
 	key->digest.init = true;
 	return AEROSPIKE_OK;
 }
+
+as_status
+as_key_encode(as_error* err, as_key* key, as_policy_key policy)
+{
+	as_status status = as_key_set_digest(err, key);
+
+	if (status != AEROSPIKE_OK) {
+		return status;
+	}
+
+	key->_fields_size = 0;
+
+	uint16_t n_fields;
+	size_t size = as_command_key_size(policy, key, &n_fields) - AS_HEADER_SIZE;
+
+	if (size > sizeof(key->_fields)) {
+		// Too large to cache.  Commands encode the key themselves.
+		return AEROSPIKE_OK;
+	}
+
+	uint8_t* end = as_command_write_key(key->_fields, policy, key);
+
+	key->_n_fields = n_fields;
+	key->_fields_policy = (uint8_t)policy;
+	key->_fields_size = (uint32_t)(end - key->_fields);
+	return AEROSPIKE_OK;
+}
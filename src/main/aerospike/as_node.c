@@ -24,14 +24,47 @@
 #include <aerospike/as_string.h>
 #include <citrusleaf/cf_byte_order.h>
 #include <errno.h> //errno
-
-#if defined (__hpux)
-#define MSG_NOSIGNAL    0x4000
-#endif
+#include <pthread.h>
 
 // Replicas take ~2K per namespace, so this will cover most deployments:
 #define INFO_STACK_BUF_SIZE (16 * 1024)
 
+// Number of nodes a thread can cache a connection for.
+#define AS_CONN_CACHE_SIZE 8
+
+// One read in this many per thread and replica is sent regardless of load.
+#define AS_NODE_PROBE_INTERVAL 32
+
+/******************************************************************************
+ *	Types.
+ *****************************************************************************/
+
+/**
+ *	Connection cached by a thread for one node.  The slot holds a node
+ *	reservation for as long as it is assigned to the node, so the node pointer
+ *	stays valid even after the node leaves the cluster.
+ */
+typedef struct as_conn_cache_slot_s {
+	as_node* node;
+	uint64_t last_used;
+	int fd;
+} as_conn_cache_slot;
+
+typedef struct as_conn_cache_s {
+	as_conn_cache_slot slots[AS_CONN_CACHE_SIZE];
+} as_conn_cache;
+
+/******************************************************************************
+ *	Variables.
+ *****************************************************************************/
+
+static pthread_key_t as_conn_cache_key;
+static pthread_once_t as_conn_cache_once = PTHREAD_ONCE_INIT;
+
+// Per-thread replica counter, stored in the key's value itself.
+static pthread_key_t as_node_replica_key;
+static pthread_once_t as_node_replica_once = PTHREAD_ONCE_INIT;
+
 /******************************************************************************
  *	Function declarations.
  *****************************************************************************/
@@ -54,6 +87,7 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 	
 	node->ref_count = 1;
 	node->partition_generation = 0xFFFFFFFF;
+	node->partition_bitmaps = 0;
 	node->cluster = cluster;
 			
 	strcpy(node->name, name);
@@ -62,10 +96,22 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 	as_vector_init(&node->addresses, sizeof(as_address), 2);
 	as_node_add_address(node, addr);
 		
-	node->conn_q = cf_queue_create(sizeof(int), true);
+	as_conn_pool_init(&node->conn_pool, cluster->conn_queue_size);
 	// node->conn_q_asyncfd = cf_queue_create(sizeof(int), true);
 	// node->asyncwork_q = cf_queue_create(sizeof(cl_async_work*), true);
 	
+	node->conns_opened = 0;
+	node->conns_trimmed = 0;
+	node->conns_idle = 0;
+	node->latency_us = 0;
+	node->in_flight = 0;
+	node->breaker_state = AS_BREAKER_CLOSED;
+	node->breaker_commands = 0;
+	node->breaker_errors = 0;
+	node->breaker_opened = 0;
+	node->breaker_rejected = 0;
+	node->commands_throttled = 0;
+	node->breaker_open_until = 0;
 	node->info_fd = -1;
 	node->friends = 0;
 	node->failures = 0;
@@ -77,15 +123,6 @@ as_node_create(as_cluster* cluster, const char* name, struct sockaddr_in* addr)
 void
 as_node_destroy(as_node* node)
 {
-	// Drain out the queue and close the FDs
-	int rv;
-	do {
-		int	fd;
-		rv = cf_queue_pop(node->conn_q, &fd, CF_QUEUE_NOWAIT);
-		if (rv == CF_QUEUE_OK)
-			as_close(fd);
-	} while (rv == CF_QUEUE_OK);
-	
 	/*
 	 do {
 	 int	fd;
@@ -112,13 +149,17 @@ as_node_destroy(as_node* node)
 	 */
 	
 	as_vector_destroy(&node->addresses);
-	cf_queue_destroy(node->conn_q);
+	
+	// Drain out the pool and close the FDs
+	as_conn_pool_destroy(&node->conn_pool);
 	//cf_queue_destroy(node->conn_q_asyncfd);
 	//cf_queue_destroy(node->asyncwork_q);
 	
 	if (node->info_fd >= 0) {
 		as_close(node->info_fd);
 	}
+	
+	as_partition_bitmaps_destroy(node);
 
 	cf_free(node);
 }
@@ -132,49 +173,6 @@ as_node_add_address(as_node* node, struct sockaddr_in* addr)
 	as_vector_append(&node->addresses, &address);
 }
 
-// A quick non-blocking check to see if a server is connected. It may have
-// dropped a connection while it's queued, so don't use those connections. If
-// the fd is connected, we actually expect an error - ewouldblock or similar.
-#define CONNECTED		0
-#define CONNECTED_NOT	1
-#define CONNECTED_ERROR	2
-#define CONNECTED_BADFD	3
-
-static int
-is_connected(int fd)
-{
-	uint8_t buf[8];
-#if defined(__hpux) || defined(__PPC__)
-	fcntl(fd, F_SETFL, O_NONBLOCK);
-	ssize_t rv = recv(fd, (void*)buf, sizeof(buf), MSG_PEEK | MSG_NOSIGNAL);
-#else
-	ssize_t rv = recv(fd, (void*)buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT | MSG_NOSIGNAL);
-#endif
-	
-	if (rv == 0) {
-		as_log_debug("Connected check: Found disconnected fd %d", fd);
-		return CONNECTED_NOT;
-	}
-	
-	if (rv < 0) {
-		if (errno == EBADF) {
-			as_log_warn("Connected check: Bad fd %d", fd);
-			return CONNECTED_BADFD;
-		}
-		else if (errno == EWOULDBLOCK || errno == EAGAIN) {
-			// The normal case.
-			return CONNECTED;
-		}
-		else {
-			as_log_info("Connected check: fd %d error %d", fd, errno);
-			return CONNECTED_ERROR;
-		}
-	}
-	
-	as_log_info("Connected check: Peek got unexpected data for fd %d", fd);
-	return CONNECTED;
-}
-
 static as_status
 as_node_authenticate_connection(as_error* err, as_node* node, int* fd)
 {
@@ -193,8 +191,8 @@ as_node_authenticate_connection(as_error* err, as_node* node, int* fd)
 	return AEROSPIKE_OK;
 }
 
-static int
-as_node_create_connection(as_node* node, int* fd)
+int
+as_node_connect(as_node* node, int* fd)
 {
 	// Create a non-blocking socket.
 	as_error err;
@@ -211,7 +209,8 @@ as_node_create_connection(as_node* node, int* fd)
 	
 	if (as_socket_start_connect_nb(&err, *fd, &primary->addr) == AEROSPIKE_OK) {
 		// Connection started ok - we have our socket.
-		return as_node_authenticate_connection(&err, node, fd);
+		ck_pr_inc_32(&node->conns_opened);
+		return AEROSPIKE_OK;
 	}
 	
 	// Try other addresses.
@@ -227,7 +226,8 @@ as_node_create_connection(as_node* node, int* fd)
 				// It's just a hint, not a requirement to try this new address first.
 				as_log_debug("Change node address %s %s:%d", node->name, address->name, (int)cf_swap_from_be16(address->addr.sin_port));
 				ck_pr_store_32(&node->address_index, i);
-				return as_node_authenticate_connection(&err, node, fd);
+				ck_pr_inc_32(&node->conns_opened);
+				return AEROSPIKE_OK;
 			}
 		}
 	}
@@ -240,53 +240,145 @@ as_node_create_connection(as_node* node, int* fd)
 }
 
 int
-as_node_get_connection(as_node* node, int* fd)
+as_node_create_connection(as_node* node, int* fd)
+{
+	int status = as_node_connect(node, fd);
+	
+	if (status) {
+		return status;
+	}
+	
+	as_error err;
+	return as_node_authenticate_connection(&err, node, fd);
+}
+
+static void
+as_conn_cache_destroy(void* udata)
 {
-	//cf_queue* q = asyncfd ? node->conn_q_asyncfd : node->conn_q;
-	cf_queue* q = node->conn_q;
+	as_conn_cache* cache = udata;
 	
-	while (1) {
-		int rv = cf_queue_pop(q, fd, CF_QUEUE_NOWAIT);
+	for (uint32_t i = 0; i < AS_CONN_CACHE_SIZE; i++) {
+		as_conn_cache_slot* slot = &cache->slots[i];
 		
-		if (rv == CF_QUEUE_OK) {
-			int rv2 = is_connected(*fd);
-			
-			switch (rv2) {
-				case CONNECTED:
-					// It's still good.
-					return 0;
-					
-				case CONNECTED_BADFD:
-					// Local problem, don't try closing.
-					as_log_warn("Found bad file descriptor in queue: fd %d", *fd);
-					break;
-				
-				case CONNECTED_NOT:
-					// Can't use it - the remote end closed it.
-				case CONNECTED_ERROR:
-					// Some other problem, could have to do with remote end.
-				default:
-					as_close(*fd);
-					break;
+		if (slot->node) {
+			if (slot->fd >= 0 && ! as_conn_pool_put(&slot->node->conn_pool, slot->fd)) {
+				as_close(slot->fd);
+			}
+			as_node_release(slot->node);
+		}
+	}
+	cf_free(cache);
+}
+
+static void
+as_conn_cache_key_create()
+{
+	pthread_key_create(&as_conn_cache_key, as_conn_cache_destroy);
+}
+
+/**
+ *	Find the calling thread's cache slot for node.  Slots of nodes that have
+ *	left the cluster are emptied on the way.  If create is true and the node has
+ *	no slot yet, a free slot is assigned to it.  Return NULL if there is no slot.
+ */
+static as_conn_cache_slot*
+as_conn_cache_slot_get(as_node* node, bool create)
+{
+	pthread_once(&as_conn_cache_once, as_conn_cache_key_create);
+	as_conn_cache* cache = pthread_getspecific(as_conn_cache_key);
+	
+	if (! cache) {
+		if (! create) {
+			return 0;
+		}
+		cache = cf_malloc(sizeof(as_conn_cache));
+		memset(cache->slots, 0, sizeof(cache->slots));
+		pthread_setspecific(as_conn_cache_key, cache);
+	}
+	
+	as_conn_cache_slot* free_slot = 0;
+	
+	for (uint32_t i = 0; i < AS_CONN_CACHE_SIZE; i++) {
+		as_conn_cache_slot* slot = &cache->slots[i];
+		
+		if (slot->node == node) {
+			return slot;
+		}
+		
+		if (slot->node && ! ck_pr_load_8(&slot->node->active)) {
+			if (slot->fd >= 0) {
+				as_close(slot->fd);
 			}
+			as_node_release(slot->node);
+			slot->node = 0;
 		}
-		else if (rv == CF_QUEUE_EMPTY) {
-			// We exhausted the queue. Try creating a fresh socket.
-			return as_node_create_connection(node, fd);
+		
+		if (! slot->node && ! free_slot) {
+			free_slot = slot;
 		}
-		else {
-			as_log_error("Bad return value from cf_queue_pop");
-			*fd = -1;
-			return AEROSPIKE_ERR_CLIENT;
+	}
+	
+	if (create && free_slot) {
+		as_node_reserve(node);
+		free_slot->node = node;
+		free_slot->fd = -1;
+		return free_slot;
+	}
+	return 0;
+}
+
+bool
+as_node_get_idle_connection(as_node* node, int* fd)
+{
+	// Idle sockets are not probed here.  Sockets idle for too long are closed
+	// when borrowed, and callers retry on a new connection if a reused socket
+	// turns out to be dead.
+	uint64_t max_idle_ms = node->cluster->max_socket_idle * 1000ULL;
+	
+	if (node->cluster->thread_conn_cache) {
+		as_conn_cache_slot* slot = as_conn_cache_slot_get(node, false);
+		
+		if (slot && slot->fd >= 0) {
+			if (max_idle_ms == 0 || cf_getms() - slot->last_used <= max_idle_ms) {
+				*fd = slot->fd;
+				slot->fd = -1;
+				return true;
+			}
+			as_close(slot->fd);
+			slot->fd = -1;
 		}
 	}
+	
+	return as_conn_pool_get(&node->conn_pool, max_idle_ms, fd);
+}
+
+int
+as_node_get_connection(as_node* node, int* fd, bool* reused)
+{
+	if (as_node_get_idle_connection(node, fd)) {
+		*reused = true;
+		return 0;
+	}
+	
+	// We exhausted the pool. Try creating a fresh socket.
+	*reused = false;
+	return as_node_create_connection(node, fd);
 }
 
 void
 as_node_put_connection(as_node* node, int fd)
 {
-	cf_queue *q = node->conn_q;
-	if (! cf_queue_push_limit(q, &fd, 300)) {
+	if (node->cluster->thread_conn_cache) {
+		as_conn_cache_slot* slot = as_conn_cache_slot_get(node, true);
+		
+		if (slot && slot->fd < 0) {
+			slot->fd = fd;
+			slot->last_used = cf_getms();
+			return;
+		}
+	}
+	
+	if (! as_conn_pool_put(&node->conn_pool, fd)) {
 		as_close(fd);
 	}
 	
@@ -304,6 +396,166 @@ as_node_put_connection(as_node* node, int fd)
 	}*/
 }
 
+void
+as_node_close_idle_connections(as_node* node)
+{
+	as_cluster* cluster = node->cluster;
+	uint32_t idle;
+	uint32_t closed = as_conn_pool_trim(&node->conn_pool, cluster->max_socket_idle * 1000ULL,
+		cluster->min_conns_per_node, &idle);
+	
+	// Only the tend thread writes these counters.
+	ck_pr_store_32(&node->conns_idle, idle);
+	
+	if (closed > 0) {
+		ck_pr_store_32(&node->conns_trimmed, node->conns_trimmed + closed);
+		as_log_debug("Closed %u idle connections to %s", closed, node->name);
+	}
+}
+
+void
+as_node_warm_connections(as_node* node, uint32_t count)
+{
+	uint32_t opened = 0;
+	
+	for (uint32_t i = 0; i < count; i++) {
+		int fd;
+		
+		if (as_node_create_connection(node, &fd)) {
+			break;
+		}
+		
+		if (! as_conn_pool_put(&node->conn_pool, fd)) {
+			as_close(fd);
+			break;
+		}
+		opened++;
+	}
+	ck_pr_store_32(&node->conns_idle, opened);
+	as_log_debug("Opened %u connections to %s", opened, node->name);
+}
+
+void
+as_node_get_conn_stats(as_node* node, as_conn_stats* stats)
+{
+	stats->idle = ck_pr_load_32(&node->conns_idle);
+	stats->opened = ck_pr_load_32(&node->conns_opened);
+	stats->trimmed = ck_pr_load_32(&node->conns_trimmed);
+}
+
+void
+as_node_get_breaker_stats(as_node* node, as_breaker_stats* stats)
+{
+	stats->state = (as_breaker_state)ck_pr_load_32(&node->breaker_state);
+	stats->in_flight = ck_pr_load_32(&node->in_flight);
+	stats->latency_us = ck_pr_load_32(&node->latency_us);
+	stats->opened = ck_pr_load_32(&node->breaker_opened);
+	stats->rejected = ck_pr_load_32(&node->breaker_rejected);
+	stats->throttled = ck_pr_load_32(&node->commands_throttled);
+}
+
+as_status
+as_node_command_admit(as_node* node, bool track)
+{
+	as_cluster* cluster = node->cluster;
+	uint32_t state = ck_pr_load_32(&node->breaker_state);
+	
+	if (state != AS_BREAKER_CLOSED) {
+		// Once the open period is over, the first command to get here becomes
+		// the half-open probe.  All others fail fast.
+		if (state == AS_BREAKER_HALF_OPEN || cf_getms() < ck_pr_load_64(&node->breaker_open_until) ||
+			! ck_pr_cas_32(&node->breaker_state, AS_BREAKER_OPEN, AS_BREAKER_HALF_OPEN)) {
+			ck_pr_inc_32(&node->breaker_rejected);
+			return AEROSPIKE_ERR_CIRCUIT_OPEN;
+		}
+	}
+	
+	if (! track) {
+		return AEROSPIKE_OK;
+	}
+	
+	uint32_t max = cluster ? cluster->max_commands_per_node : 0;
+	uint32_t in_flight = ck_pr_faa_32(&node->in_flight, 1);
+	
+	if (max && in_flight >= max) {
+		ck_pr_dec_32(&node->in_flight);
+		ck_pr_inc_32(&node->commands_throttled);
+		
+		if (state != AS_BREAKER_CLOSED) {
+			// Give up the probe.  The open period is over, so the next command takes it.
+			ck_pr_store_32(&node->breaker_state, AS_BREAKER_OPEN);
+		}
+		return AEROSPIKE_ERR_MAX_COMMANDS;
+	}
+	return AEROSPIKE_OK;
+}
+
+static void
+as_node_breaker_open(as_node* node, uint32_t open_ms, uint32_t from_state)
+{
+	// Publish the end of the open period before the state that makes it visible.
+	ck_pr_store_64(&node->breaker_open_until, cf_getms() + open_ms);
+	ck_pr_fence_store();
+	
+	if (ck_pr_cas_32(&node->breaker_state, from_state, AS_BREAKER_OPEN)) {
+		as_node_breaker_roll(node);
+		ck_pr_inc_32(&node->breaker_opened);
+		as_log_warn("Circuit breaker opened for node %s", node->name);
+	}
+}
+
+void
+as_node_command_end(as_node* node, bool track, uint32_t latency_us, bool failed)
+{
+	if (track) {
+		ck_pr_dec_32(&node->in_flight);
+		
+		if (latency_us == 0) {
+			latency_us = 1;
+		}
+		
+		// Concurrent updates may overwrite each other, which only slows convergence.
+		uint32_t avg = ck_pr_load_32(&node->latency_us);
+		
+		if (! (failed && latency_us < avg)) {
+			avg = avg ? avg - (avg >> 3) + (latency_us >> 3) : latency_us;
+			ck_pr_store_32(&node->latency_us, avg ? avg : 1);
+		}
+	}
+	
+	as_cluster* cluster = node->cluster;
+	
+	if (! cluster || cluster->breaker_error_percent == 0) {
+		return;
+	}
+	
+	uint32_t state = ck_pr_load_32(&node->breaker_state);
+	
+	if (state == AS_BREAKER_HALF_OPEN) {
+		if (failed) {
+			as_node_breaker_open(node, cluster->breaker_open_ms, AS_BREAKER_HALF_OPEN);
+		}
+		else if (ck_pr_cas_32(&node->breaker_state, AS_BREAKER_HALF_OPEN, AS_BREAKER_CLOSED)) {
+			as_node_breaker_roll(node);
+			as_log_info("Circuit breaker closed for node %s", node->name);
+		}
+		return;
+	}
+	
+	uint32_t commands = ck_pr_faa_32(&node->breaker_commands, 1) + 1;
+	
+	if (! failed) {
+		return;
+	}
+	
+	uint32_t errors = ck_pr_faa_32(&node->breaker_errors, 1) + 1;
+	
+	if (state == AS_BREAKER_CLOSED && commands >= cluster->breaker_min_commands &&
+		(uint64_t)errors * 100 >= (uint64_t)commands * cluster->breaker_error_percent) {
+		as_node_breaker_open(node, cluster->breaker_open_ms, AS_BREAKER_CLOSED);
+	}
+}
+
 static int
 as_node_get_info_connection(as_node* node)
 {
@@ -568,63 +820,129 @@ as_node_process_partitions(as_cluster* cluster, as_node* node, as_vector* values
 const char INFO_STR_CHECK[] = "node\npartition-generation\nservices\n";
 const char INFO_STR_GET_REPLICAS[] = "partition-generation\nreplicas-master\nreplicas-prole\n";
 
-/**
- *	Request current status from server node.
- */
-bool
-as_node_refresh(as_cluster* cluster, as_node* node, as_vector* /* <as_friend> */ friends)
+static char*
+as_node_get_info_heap(as_error* err, as_node* node, const char* names, size_t names_len, int timeout_ms, uint8_t* stack_buf)
 {
-	int ret = as_node_get_info_connection(node);
+	uint8_t* buf = as_node_get_info(err, node, names, names_len, timeout_ms, stack_buf);
 	
-	if (ret) {
-		return false;
+	if (buf != stack_buf) {
+		return (char*)buf;
+	}
+	
+	// Responses are kept until the apply pass, so move them off the stack.
+	size_t len = strlen((char*)buf) + 1;
+	char* copy = cf_malloc(len);
+	memcpy(copy, buf, len);
+	return copy;
+}
+
+static bool
+as_node_partitions_changed(as_node* node, as_vector* values)
+{
+	bool same_node = false;
+	bool changed = false;
+	
+	for (uint32_t i = 0; i < values->size; i++) {
+		as_name_value* nv = as_vector_get(values, i);
+		
+		if (strcmp(nv->name, "node") == 0) {
+			same_node = strcmp(nv->value, node->name) == 0;
+		}
+		else if (strcmp(nv->name, "partition-generation") == 0) {
+			changed = node->partition_generation != (uint32_t)atoi(nv->value);
+		}
+	}
+	return same_node && changed;
+}
+
+void
+as_node_refresh_fetch(as_cluster* cluster, as_node_info* info)
+{
+	as_node* node = info->node;
+	info->check = 0;
+	info->replicas = 0;
+	info->ok = false;
+	as_vector_init(&info->values, sizeof(as_name_value), 4);
+	
+	if (as_node_get_info_connection(node)) {
+		return;
 	}
 	
 	as_error err;
 	
 	uint32_t info_timeout = cluster->conn_timeout_ms;
 	uint8_t stack_buf[INFO_STACK_BUF_SIZE];
-	uint8_t* buf = as_node_get_info(&err, node, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, info_timeout, stack_buf);
+	info->check = as_node_get_info_heap(&err, node, INFO_STR_CHECK, sizeof(INFO_STR_CHECK) - 1, info_timeout, stack_buf);
 	
-	if (! buf) {
+	if (! info->check) {
 		as_node_close_info_connection(node);
-		return false;
+		return;
 	}
 	
-	as_vector values;
-	as_vector_inita(&values, sizeof(as_name_value), 4);
-	
-	as_info_parse_multi_response((char*)buf, &values);
+	as_info_parse_multi_response(info->check, &info->values);
 	
-	bool update_partitions;
-	bool status = as_node_process_response(cluster, node, &values, friends, &update_partitions);
+	// Fetch the replica maps here too, so the apply pass never waits on the network.
+	// partition_generation is only written by the apply pass, which runs after all
+	// fetches of the cycle have completed.
+	if (as_node_partitions_changed(node, &info->values)) {
+		info->replicas = as_node_get_info_heap(&err, node, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, info_timeout, stack_buf);
 		
-	if (buf != stack_buf) {
-		cf_free(buf);
-	}
-	
-	if (status && update_partitions) {
-		buf = as_node_get_info(&err, node, INFO_STR_GET_REPLICAS, sizeof(INFO_STR_GET_REPLICAS) - 1, info_timeout, stack_buf);
-		
-		if (! buf) {
+		if (! info->replicas) {
 			as_node_close_info_connection(node);
-			as_vector_destroy(&values);
-			return false;
+			return;
 		}
-		
-		as_vector_clear(&values);
-		
-		as_info_parse_multi_response((char*)buf, &values);
+	}
+	info->ok = true;
+}
 
-		if (buf) {
-			as_node_process_partitions(cluster, node, &values);
+bool
+as_node_refresh_apply(as_cluster* cluster, as_node_info* info, as_vector* /* <as_friend> */ friends)
+{
+	bool status = false;
+	
+	if (info->ok) {
+		bool update_partitions;
+		status = as_node_process_response(cluster, info->node, &info->values, friends, &update_partitions);
+		
+		if (status && update_partitions && info->replicas) {
+			as_vector values;
+			as_vector_inita(&values, sizeof(as_name_value), 4);
 			
-			if (buf != stack_buf) {
-				cf_free(buf);
-			}
+			as_info_parse_multi_response(info->replicas, &values);
+			as_node_process_partitions(cluster, info->node, &values);
+			as_vector_destroy(&values);
 		}
 	}
 	
-	as_vector_destroy(&values);
+	as_vector_destroy(&info->values);
+	cf_free(info->check);
+	cf_free(info->replicas);
 	return status;
 }
+
+static void
+as_node_replica_key_create()
+{
+	pthread_key_create(&as_node_replica_key, NULL);
+}
+
+as_node*
+as_node_choose_replica(as_node* master, as_node* prole)
+{
+	pthread_once(&as_node_replica_once, as_node_replica_key_create);
+	uintptr_t r = (uintptr_t)pthread_getspecific(as_node_replica_key);
+	pthread_setspecific(as_node_replica_key, (void*)(r + 1));
+	
+	as_node* first = (r & 1)? master : prole;
+	as_node* second = (r & 1)? prole : master;
+	
+	if (r % AS_NODE_PROBE_INTERVAL < 2) {
+		return first;
+	}
+	
+	// Power of two choices over the partition's two replicas.  Adding one to
+	// each factor keeps idle and unmeasured nodes comparable.
+	uint64_t first_wait = ((uint64_t)ck_pr_load_32(&first->latency_us) + 1) * (ck_pr_load_32(&first->in_flight) + 1);
+	uint64_t second_wait = ((uint64_t)ck_pr_load_32(&second->latency_us) + 1) * (ck_pr_load_32(&second->in_flight) + 1);
+	return (second_wait < first_wait)? second : first;
+}
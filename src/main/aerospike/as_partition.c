@@ -21,8 +21,90 @@
 #include <aerospike/as_shm_cluster.h>
 #include <aerospike/as_string.h>
 #include <citrusleaf/cf_b64.h>
+#include <pthread.h>
 #include "ck_pr.h"
 
+/******************************************************************************
+ *	Namespace Registry
+ *****************************************************************************/
+
+// Open addressing slots.  Twice the id count keeps probe sequences short and
+// guarantees an empty slot ends every probe.
+#define AS_NAMESPACE_SLOTS (AS_NAMESPACE_IDS * 2)
+
+static char g_ns_names[AS_NAMESPACE_IDS][AS_MAX_NAMESPACE_SIZE];
+static uint32_t g_ns_slots[AS_NAMESPACE_SLOTS];
+static uint32_t g_ns_count = 1;
+static pthread_mutex_t g_ns_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t
+as_namespace_hash(const char* ns, size_t len)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint8_t)ns[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t
+as_namespace_find(uint32_t hash, const char* ns, size_t len, uint32_t* slot)
+{
+	uint32_t i = hash & (AS_NAMESPACE_SLOTS - 1);
+	
+	while (true) {
+		uint32_t id = ck_pr_load_32(&g_ns_slots[i]);
+		
+		if (id == 0) {
+			*slot = i;
+			return 0;
+		}
+		
+		// Name is written before its slot is published.
+		ck_pr_fence_load();
+		const char* name = g_ns_names[id];
+		
+		if (memcmp(name, ns, len) == 0 && name[len] == 0) {
+			return id;
+		}
+		i = (i + 1) & (AS_NAMESPACE_SLOTS - 1);
+	}
+}
+
+uint32_t
+as_namespace_intern(const char* ns, size_t len)
+{
+	if (len == 0 || len >= AS_MAX_NAMESPACE_SIZE) {
+		return 0;
+	}
+	
+	uint32_t hash = as_namespace_hash(ns, len);
+	uint32_t slot;
+	uint32_t id = as_namespace_find(hash, ns, len, &slot);
+	
+	if (id) {
+		return id;
+	}
+	
+	pthread_mutex_lock(&g_ns_lock);
+	
+	// Another thread may have registered the namespace first.
+	id = as_namespace_find(hash, ns, len, &slot);
+	
+	if (! id && g_ns_count < AS_NAMESPACE_IDS) {
+		id = g_ns_count++;
+		memcpy(g_ns_names[id], ns, len);
+		g_ns_names[id][len] = 0;
+		ck_pr_fence_store();
+		ck_pr_store_32(&g_ns_slots[slot], id);
+	}
+	pthread_mutex_unlock(&g_ns_lock);
+	return id;
+}
+
 /******************************************************************************
  *	Functions
  *****************************************************************************/
@@ -42,13 +124,14 @@ set_node(as_node** trg, as_node* src)
 	ck_pr_store_ptr(trg, src);
 }
 
-static as_partition_table*
+as_partition_table*
 as_partition_table_create(const char* ns, uint32_t capacity)
 {
 	size_t len = sizeof(as_partition_table) + (sizeof(as_partition) * capacity);
 	as_partition_table* table = cf_malloc(len);
 	memset(table, 0, len);
 	as_strncpy(table->ns, ns, AS_MAX_NAMESPACE_SIZE);
+	table->ns_id = as_namespace_intern(table->ns, strlen(table->ns));
 	table->size = capacity;
 	return table;
 }
@@ -82,32 +165,28 @@ as_partition_tables_create(uint32_t capacity)
 }
 
 static inline as_node*
-reserve_node(as_cluster* cluster, as_node* node)
+select_node(as_cluster* cluster, as_node* node)
 {
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (node && ck_pr_load_8(&node->active)) {
-		as_node_reserve(node);
 		return node;
 	}
 #ifdef DEBUG_VERBOSE
 	as_log_debug("Choose random node for unmapped namespace/partition");
 #endif
-	return as_node_get_random(cluster);
+	return as_node_choose_random(cluster);
 }
 
 static as_node*
-reserve_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
+select_node_alternate(as_cluster* cluster, as_node* chosen, as_node* alternate)
 {
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (ck_pr_load_8(&chosen->active)) {
-		as_node_reserve(chosen);
 		return chosen;
 	}
-	return reserve_node(cluster, alternate);
+	return select_node(cluster, alternate);
 }
 
-static uint32_t g_randomizer = 0;
-
 as_node*
 as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, const cf_digest* d, bool write, as_policy_replica replica)
 {
@@ -120,7 +199,7 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 
 		if (write) {
 			// Writes always go to master.
-			return reserve_node(cluster, master);
+			return select_node(cluster, master);
 		}
 
 		bool use_master_replica = true;
@@ -137,32 +216,44 @@ as_partition_table_get_node(as_cluster* cluster, as_partition_table* table, cons
 		}
 
 		if (use_master_replica) {
-			return reserve_node(cluster, master);
+			return select_node(cluster, master);
 		} else {
 			as_node* prole = ck_pr_load_ptr(&p->prole);
 
 			if (! prole) {
-				return reserve_node(cluster, master);
+				return select_node(cluster, master);
 			}
 
 			if (! master) {
-				return reserve_node(cluster, prole);
+				return select_node(cluster, prole);
 			}
 
-			// Alternate between master and prole for reads.
-			uint32_t r = ck_pr_faa_32(&g_randomizer, 1);
-				
-			if (r & 1) {
-				return reserve_node_alternate(cluster, master, prole);
+			// Read from the replica expected to answer first.
+			if (as_node_choose_replica(master, prole) == master) {
+				return select_node_alternate(cluster, master, prole);
 			}
-			return reserve_node_alternate(cluster, prole, master);
+			return select_node_alternate(cluster, prole, master);
 		}
 	}
 	
 #ifdef DEBUG_VERBOSE
 	as_log_debug("Choose random node for null partition table");
 #endif
-	return as_node_get_random(cluster);
+	return as_node_choose_random(cluster);
+}
+
+as_node*
+as_partition_table_get_prole(as_cluster* cluster, as_partition_table* table, const cf_digest* d)
+{
+	if (table) {
+		cl_partition_id partition_id = cl_partition_getid(cluster->n_partitions, d);
+		as_node* prole = ck_pr_load_ptr(&table->partitions[partition_id].prole);
+		
+		if (prole && ck_pr_load_8(&prole->active)) {
+			return prole;
+		}
+	}
+	return NULL;
 }
 
 as_partition_table*
@@ -180,6 +271,20 @@ as_partition_tables_get(as_partition_tables* tables, const char* ns)
 	return 0;
 }
 
+void
+as_partition_bitmaps_destroy(as_node* node)
+{
+	if (! node->partition_bitmaps) {
+		return;
+	}
+	
+	for (uint32_t i = 0; i < AS_NAMESPACE_IDS * 2; i++) {
+		cf_free(node->partition_bitmaps[i]);
+	}
+	cf_free(node->partition_bitmaps);
+	node->partition_bitmaps = 0;
+}
+
 bool
 as_partition_tables_find_node(as_partition_tables* tables, as_node* node)
 {
@@ -202,21 +307,57 @@ as_partition_tables_find_node(as_partition_tables* tables, as_node* node)
 }
 
 static inline void
-force_replicas_refresh(as_node* node)
+force_replicas_refresh(as_node* node, as_partition_table* table, uint32_t id, bool master)
 {
 	node->partition_generation = (uint32_t)-1;
+	
+	// Forget that the node owned the partition, so the next update from it
+	// reclaims the partition if the node still reports owning it.
+	if (node->partition_bitmaps && table->ns_id) {
+		as_partition_bitmap* bitmap = node->partition_bitmaps[table->ns_id * 2 + (master ? 1 : 0)];
+		
+		if (bitmap) {
+			bitmap->bits[id >> 3] &= ~(0x80 >> (id & 7));
+		}
+	}
 }
 
+/**
+ *	Use non-inline function for garbarge collector function pointer reference.
+ *	Forward to inlined release.
+ */
 static void
-as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
+release_node(as_node* node)
 {
+	as_node_release(node);
+}
+
+static inline void
+as_partition_release_node(as_cluster* cluster, as_node* node)
+{
+	// Commands read partition nodes without reserving them, so the last reference
+	// must be dropped through the cluster epoch.  Active nodes are still held by the
+	// cluster's node list.
+	if (ck_pr_load_8(&node->active)) {
+		as_node_release(node);
+	}
+	else {
+		as_cluster_defer(cluster, node, (as_release_fn)release_node);
+	}
+}
+
+static void
+as_partition_update(as_cluster* cluster, as_partition_table* table, uint32_t id, as_node* node, bool master, bool owns)
+{
+	as_partition* p = &table->partitions[id];
+	
 	// Volatile reads are not necessary because the tend thread exclusively modifies partition.
 	// Volatile writes are used so other threads can view change.
 	if (master) {
 		if (node == p->master) {
 			if (! owns) {
 				set_node(&p->master, 0);
-				as_node_release(node);
+				as_partition_release_node(cluster, node);
 			}
 		}
 		else {
@@ -226,8 +367,8 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 				set_node(&p->master, node);
 				
 				if (tmp) {
-					force_replicas_refresh(tmp);
-					as_node_release(tmp);
+					force_replicas_refresh(tmp, table, id, master);
+					as_partition_release_node(cluster, tmp);
 				}
 			}
 		}
@@ -236,7 +377,7 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 		if (node == p->prole) {
 			if (! owns) {
 				set_node(&p->prole, 0);
-				as_node_release(node);
+				as_partition_release_node(cluster, node);
 			}
 		}
 		else {
@@ -246,8 +387,8 @@ as_partition_update(as_partition* p, as_node* node, bool master, bool owns)
 				set_node(&p->prole, node);
 				
 				if (tmp) {
-					force_replicas_refresh(tmp);
-					as_node_release(tmp);
+					force_replicas_refresh(tmp, table, id, master);
+					as_partition_release_node(cluster, tmp);
 				}
 			}
 		}
@@ -269,24 +410,93 @@ as_partition_vector_get(as_vector* tables, const char* ns)
 	return 0;
 }
 
+static as_partition_bitmap*
+as_partition_bitmap_get(as_node* node, uint32_t ns_id, bool master, uint32_t size)
+{
+	// Namespaces that could not be interned are always applied in full.
+	if (ns_id == 0) {
+		return 0;
+	}
+	
+	if (! node->partition_bitmaps) {
+		size_t len = sizeof(as_partition_bitmap*) * AS_NAMESPACE_IDS * 2;
+		node->partition_bitmaps = cf_malloc(len);
+		memset(node->partition_bitmaps, 0, len);
+	}
+	
+	as_partition_bitmap** slot = &node->partition_bitmaps[ns_id * 2 + (master ? 1 : 0)];
+	as_partition_bitmap* bitmap = *slot;
+	
+	if (bitmap && bitmap->size != size) {
+		cf_free(bitmap);
+		bitmap = 0;
+	}
+	
+	if (! bitmap) {
+		bitmap = cf_malloc(sizeof(as_partition_bitmap) + size);
+		bitmap->size = size;
+		bitmap->applied = false;
+		*slot = bitmap;
+	}
+	return bitmap;
+}
+
 static void
-decode_and_update(char* bitmap_b64, long len, as_partition_table* table, as_node* node, bool master)
+decode_and_update(as_cluster* cluster, char* bitmap_b64, long len, as_partition_table* table, as_node* node, bool master)
 {
 	// Size allows for padding - is actual size rounded up to multiple of 3.
-	uint8_t* bitmap = (uint8_t*)alloca(cf_b64_decoded_buf_size((uint32_t)len));
+	uint32_t size = cf_b64_decoded_buf_size((uint32_t)len);
+	uint8_t* bitmap = (uint8_t*)alloca(size);
 
 	// For now - for speed - trust validity of encoded characters.
 	cf_b64_decode(bitmap_b64, (uint32_t)len, bitmap, NULL);
-
-	// Expand the bitmap.
-	for (uint32_t i = 0; i < table->size; i++) {
-		bool owns = ((bitmap[i >> 3] & (0x80 >> (i & 7))) != 0);
-		/*
-		if (owns) {
-			as_log_debug("Set partition %s:%s:%u:%s", master? "master" : "prole", table->ns, i, node->name);
+	
+	as_partition_bitmap* last = as_partition_bitmap_get(node, table->ns_id, master, size);
+
+	if (last && last->applied) {
+		// Only visit partitions whose bit changed since the last update.  Bits that
+		// did not change still match the table, because another node taking over
+		// one of this node's partitions clears the bit in this node's bitmap.
+		for (uint32_t i = 0; i < size; i += sizeof(uint64_t)) {
+			uint64_t a = 0;
+			uint64_t b = 0;
+			size_t n = size - i < sizeof(uint64_t) ? size - i : sizeof(uint64_t);
+			memcpy(&a, bitmap + i, n);
+			memcpy(&b, last->bits + i, n);
+			
+			if (a == b) {
+				continue;
+			}
+			
+			for (uint32_t j = i; j < i + n; j++) {
+				uint8_t diff = bitmap[j] ^ last->bits[j];
+				
+				for (uint32_t k = 0; diff; k++, diff <<= 1) {
+					uint32_t id = (j << 3) + k;
+					
+					if ((diff & 0x80) && id < table->size) {
+						as_partition_update(cluster, table, id, node, master, (bitmap[j] & (0x80 >> k)) != 0);
+					}
+				}
+			}
+		}
+	}
+	else {
+		// Expand the bitmap.
+		for (uint32_t i = 0; i < table->size; i++) {
+			bool owns = ((bitmap[i >> 3] & (0x80 >> (i & 7))) != 0);
+			/*
+			if (owns) {
+				as_log_debug("Set partition %s:%s:%u:%s", master? "master" : "prole", table->ns, i, node->name);
+			}
+			*/
+			as_partition_update(cluster, table, i, node, master, owns);
 		}
-		*/
-		as_partition_update(&table->partitions[i], node, master, owns);
+	}
+	
+	if (last) {
+		memcpy(last->bits, bitmap, size);
+		last->applied = true;
 	}
 }
 
@@ -308,14 +518,20 @@ as_partition_tables_copy_add(as_cluster* cluster, as_partition_tables* tables_ol
 	// Add new tables.
 	memcpy(&tables_new->array[tables_old->size], tables_to_add->list, sizeof(as_partition_table*) * tables_to_add->size);
 	
+	// Index tables by namespace id.
+	for (uint32_t i = 0; i < tables_new->size; i++) {
+		as_partition_table* table = tables_new->array[i];
+		
+		if (table->ns_id) {
+			tables_new->index[table->ns_id] = table;
+		}
+	}
+	
 	// Replace tables with copy.
 	set_partition_tables(cluster, tables_new);
 	
 	// Put old tables on garbage collector stack.
-	as_gc_item item;
-	item.data = tables_old;
-	item.release_fn = (as_release_fn)release_partition_tables;
-	as_vector_append(cluster->gc, &item);
+	as_cluster_defer(cluster, tables_old, (as_release_fn)release_partition_tables);
 }
 
 bool
@@ -382,7 +598,7 @@ as_partition_tables_update(as_cluster* cluster, as_node* node, char* buf, bool m
 				}
 
 				// Decode partition bitmap and update client's view.
-				decode_and_update(bitmap_b64, len, table, node, master);
+				decode_and_update(cluster, bitmap_b64, len, table, node, master);
 			}
 			ns = ++p;
 		}
@@ -47,9 +47,12 @@ as_policies_init(as_policies* p)
 	// Set local defaults to undefined.
 	// Undefined variables will be set to global defaults in as_policies_resolve().
 	p->read.timeout = -1;
+	p->read.retry = -1;
 	p->read.key = -1;
 	p->read.replica = -1;
 	p->read.consistency_level = -1;
+	p->read.zero_copy = false;
+	p->read.hedge_delay_us = 0;
 
 	p->write.timeout = -1;
 	p->write.retry = -1;
@@ -82,6 +85,8 @@ as_policies_init(as_policies* p)
 	p->info.check_bounds = true;
 
 	p->batch.timeout = -1;
+	p->batch.retry = -1;
+	p->batch.socket_timeout = 0;
 
 	p->admin.timeout = -1;
 
@@ -99,6 +104,7 @@ void
 as_policies_resolve(as_policies* p)
 {
 	as_policy_resolve(p->read.timeout, p->timeout);
+	as_policy_resolve(p->read.retry, p->retry);
 	as_policy_resolve(p->read.key, p->key);
 	as_policy_resolve(p->read.replica, p->replica);
 	as_policy_resolve(p->read.consistency_level, p->consistency_level);
@@ -130,6 +136,7 @@ as_policies_resolve(as_policies* p)
 	as_policy_resolve(p->info.timeout, p->timeout);
 
 	as_policy_resolve(p->batch.timeout, p->timeout);
+	as_policy_resolve(p->batch.retry, p->retry);
 
 	as_policy_resolve(p->admin.timeout, p->timeout);
 }
@@ -29,6 +29,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <citrusleaf/alloc.h>
+
 #include "_bin.h"
 
 /******************************************************************************
@@ -69,6 +71,9 @@ static as_record * as_record_defaults(as_record * rec, bool free, uint16_t nbins
 	rec->key.ns[0] = '\0';
 	rec->key.set[0] = '\0';
 	rec->key.valuep = NULL;
+	rec->key._ns_id = 0;
+	rec->key._ns_len = 0;
+	rec->key._fields_size = 0;
 
 	rec->key.digest.init = false;
 	memset(rec->key.digest.value, 0, AS_DIGEST_VALUE_SIZE);
@@ -76,6 +81,9 @@ static as_record * as_record_defaults(as_record * rec, bool free, uint16_t nbins
 	rec->gen = 0;
 	rec->ttl = 0;
 
+	rec->_buffer = NULL;
+	rec->_buffer_capacity = 0;
+
 	if ( nbins > 0 ) {
 		rec->bins._free = true;
 		rec->bins.capacity = nbins;
@@ -144,11 +152,20 @@ void as_record_release(as_record * rec)
 
 		rec->key.ns[0] = '\0';
 		rec->key.set[0] = '\0';
+		rec->key._ns_id = 0;
+		rec->key._ns_len = 0;
+
+		rec->key._fields_size = 0;
 
 		as_val_destroy((as_val *) rec->key.valuep);
 		rec->key.valuep = NULL;
 
 		rec->key.digest.init = false;
+
+		// Bins that referenced the buffer are gone, so it can be freed.
+		cf_free(rec->_buffer);
+		rec->_buffer = NULL;
+		rec->_buffer_capacity = 0;
 	}
 }
 
@@ -192,6 +209,55 @@ void as_record_destroy(as_record * rec)
 	as_rec_destroy((as_rec *) rec);
 }
 
+/**
+ *	Copy bin values that reference the record's zero-copy response buffer,
+ *	then free the buffer.
+ */
+void as_record_copy_borrowed(as_record * rec) 
+{
+	if ( !(rec && rec->_buffer) ) return;
+
+	uint8_t * begin = rec->_buffer;
+	uint8_t * end = begin + rec->_buffer_capacity;
+
+	for ( int i = 0; i < rec->bins.size; i++ ) {
+		as_val * val = (as_val *) rec->bins.entries[i].valuep;
+
+		if ( !val ) continue;
+
+		switch ( val->type ) {
+			case AS_STRING: {
+				as_string * s = (as_string *) val;
+				if ( !s->free && (uint8_t *) s->value >= begin && (uint8_t *) s->value < end ) {
+					size_t len = as_string_len(s);
+					char * copy = (char *) malloc(len + 1);
+					memcpy(copy, s->value, len + 1);
+					s->value = copy;
+					s->free = true;
+				}
+				break;
+			}
+			case AS_BYTES: {
+				as_bytes * b = (as_bytes *) val;
+				if ( !b->free && b->value >= begin && b->value < end ) {
+					uint8_t * copy = (uint8_t *) malloc(b->size);
+					memcpy(copy, b->value, b->size);
+					b->value = copy;
+					b->capacity = b->size;
+					b->free = true;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	cf_free(rec->_buffer);
+	rec->_buffer = NULL;
+	rec->_buffer_capacity = 0;
+}
+
 /******************************************************************************
  *	VALUE FUNCTIONS
  *****************************************************************************/
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/as_retry.h>
+#include <citrusleaf/cf_clock.h>
+#include <string.h>
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+// Doublings beyond this are always capped by max_ms.
+#define AS_RETRY_MAX_SHIFT 20
+
+/******************************************************************************
+ * GLOBAL VARIABLES
+ *****************************************************************************/
+
+const as_retry_schedule as_retry_schedule_default = {
+	.backoff = {
+		[AS_RETRY_CLASS_NONE] = {0, 0},
+		[AS_RETRY_CLASS_TIMEOUT] = {0, 0},
+		[AS_RETRY_CLASS_CONNECTION] = {1, 32},
+		[AS_RETRY_CLASS_BUSY] = {2, 64},
+		[AS_RETRY_CLASS_NO_NODE] = {10, 100}
+	}
+};
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static inline uint32_t
+as_retry_rand(as_retry* retry)
+{
+	uint32_t x = retry->seed;
+
+	if (x == 0) {
+		x = (uint32_t)cf_getus() | 1;
+	}
+
+	// xorshift32
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	retry->seed = x;
+	return x;
+}
+
+static uint32_t
+as_retry_backoff_ms(as_retry* retry, as_retry_class klass)
+{
+	const as_retry_backoff* b = &retry->schedule->backoff[klass];
+
+	if (b->base_ms == 0) {
+		return 0;
+	}
+
+	uint32_t shift = retry->counts[klass] - 1;
+
+	if (shift > AS_RETRY_MAX_SHIFT) {
+		shift = AS_RETRY_MAX_SHIFT;
+	}
+
+	uint64_t delay = (uint64_t)b->base_ms << shift;
+
+	if (delay > b->max_ms) {
+		delay = b->max_ms;
+	}
+
+	// Spread retries of commands that failed together over the upper half of
+	// the window so they do not hit the node again in lockstep.
+	uint32_t d = (uint32_t)delay;
+	return d - as_retry_rand(retry) % (d / 2 + 1);
+}
+
+/******************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+void
+as_retry_init(as_retry* retry, const as_retry_schedule* schedule, uint64_t deadline_ms,
+	uint32_t max_retries, uint32_t seed)
+{
+	retry->schedule = schedule ? schedule : &as_retry_schedule_default;
+	retry->deadline_ms = deadline_ms;
+	retry->max_retries = max_retries;
+	retry->attempt = 0;
+	retry->seed = seed;
+	memset(retry->counts, 0, sizeof(retry->counts));
+}
+
+as_retry_class
+as_retry_classify(as_status status)
+{
+	switch (status) {
+		case AEROSPIKE_ERR_TIMEOUT:
+			return AS_RETRY_CLASS_TIMEOUT;
+
+		case AEROSPIKE_ERR_CLIENT:
+			return AS_RETRY_CLASS_CONNECTION;
+
+		case AEROSPIKE_ERR_RECORD_BUSY:
+		case AEROSPIKE_ERR_DEVICE_OVERLOAD:
+			return AS_RETRY_CLASS_BUSY;
+
+		case AEROSPIKE_ERR_CLUSTER:
+			return AS_RETRY_CLASS_NO_NODE;
+
+		default:
+			return AS_RETRY_CLASS_NONE;
+	}
+}
+
+int
+as_retry_next(as_retry* retry, as_retry_class klass, uint64_t now_ms)
+{
+	if (klass == AS_RETRY_CLASS_NONE || klass >= AS_RETRY_CLASS_MAX) {
+		return -1;
+	}
+
+	if (++retry->attempt > retry->max_retries) {
+		return -1;
+	}
+	retry->counts[klass]++;
+
+	uint32_t delay = as_retry_backoff_ms(retry, klass);
+
+	if (retry->deadline_ms > 0) {
+		uint32_t remaining = as_retry_remaining_ms(retry, now_ms);
+
+		if (remaining == 0) {
+			return -1;
+		}
+
+		// Leave at least a millisecond for the attempt itself.
+		if (delay >= remaining) {
+			delay = remaining - 1;
+		}
+	}
+	return (int)delay;
+}
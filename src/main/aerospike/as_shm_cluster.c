@@ -286,6 +286,25 @@ as_shm_find_partition_table(as_cluster_shm* cluster_shm, const char* ns)
 	return 0;
 }
 
+static inline as_partition_table_shm*
+as_shm_get_partition_table_id(as_shm_info* shm_info, const char* ns, uint32_t ns_id)
+{
+	if (ns_id == 0) {
+		return as_shm_find_partition_table(shm_info->cluster_shm, ns);
+	}
+	
+	as_partition_table_shm* table = ck_pr_load_ptr(&shm_info->ns_tables[ns_id]);
+	
+	if (! table) {
+		table = as_shm_find_partition_table(shm_info->cluster_shm, ns);
+		
+		if (table) {
+			ck_pr_store_ptr(&shm_info->ns_tables[ns_id], table);
+		}
+	}
+	return table;
+}
+
 static as_partition_table_shm*
 as_shm_add_partition_table(as_cluster_shm* cluster_shm, const char* ns)
 {
@@ -386,44 +405,40 @@ as_shm_update_partitions(as_shm_info* shm_info, const char* ns, char* bitmap_b64
 }
 
 static inline as_node*
-as_shm_reserve_node(as_cluster* cluster, as_node** local_nodes, uint32_t node_index)
+as_shm_select_node(as_cluster* cluster, as_node** local_nodes, uint32_t node_index)
 {
 	// node_index starts at one (zero indicates unset).
 	if (node_index) {
 		as_node* node = ck_pr_load_ptr(&local_nodes[node_index-1]);
 		
 		if (node && ck_pr_load_8(&node->active)) {
-			as_node_reserve(node);
 			return node;
 		}
 	}
 	
 	// as_log_debug("Choose random node for unmapped namespace/partition");
-	return as_node_get_random(cluster);
+	return as_node_choose_random(cluster);
 }
 
 static as_node*
-as_shm_reserve_node_alternate(as_cluster* cluster, as_node** local_nodes, uint32_t chosen_index, uint32_t alternate_index)
+as_shm_select_node_alternate(as_cluster* cluster, as_node** local_nodes, uint32_t chosen_index, uint32_t alternate_index)
 {
 	// index values start at one (zero indicates unset).
 	as_node* chosen = ck_pr_load_ptr(&local_nodes[chosen_index-1]);
 	
 	// Make volatile reference so changes to tend thread will be reflected in this thread.
 	if (chosen && ck_pr_load_8(&chosen->active)) {
-		as_node_reserve(chosen);
 		return chosen;
 	}
-	return as_shm_reserve_node(cluster, local_nodes, alternate_index);
+	return as_shm_select_node(cluster, local_nodes, alternate_index);
 }
 
-static uint32_t g_shm_randomizer = 0;
-
 as_node*
-as_shm_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool write, as_policy_replica replica)
+as_shm_node_get(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d, bool write, as_policy_replica replica)
 {
 	as_shm_info* shm_info = cluster->shm_info;
 	as_cluster_shm* cluster_shm = shm_info->cluster_shm;
-	as_partition_table_shm* table = as_shm_find_partition_table(cluster_shm, ns);
+	as_partition_table_shm* table = as_shm_get_partition_table_id(shm_info, ns, ns_id);
 
 	if (table) {
 		cl_partition_id partition_id = cl_partition_getid(cluster_shm->n_partitions, d);
@@ -434,7 +449,7 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool wr
 
 		if (write) {
 			// Writes always go to master.
-			return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+			return as_shm_select_node(cluster, shm_info->local_nodes, master);
 		}
 
 		bool use_master_replica = true;
@@ -451,30 +466,55 @@ as_shm_node_get(as_cluster* cluster, const char* ns, const cf_digest* d, bool wr
 		}
 
 		if (use_master_replica) {
-			return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+			return as_shm_select_node(cluster, shm_info->local_nodes, master);
 		} else {
 			uint32_t prole = ck_pr_load_32(&p->prole);
 
 			if (! prole) {
-				return as_shm_reserve_node(cluster, shm_info->local_nodes, master);
+				return as_shm_select_node(cluster, shm_info->local_nodes, master);
 			}
 
 			if (! master) {
-				return as_shm_reserve_node(cluster, shm_info->local_nodes, prole);
+				return as_shm_select_node(cluster, shm_info->local_nodes, prole);
 			}
 
-			// Alternate between master and prole for reads.
-			uint32_t r = ck_pr_faa_32(&g_shm_randomizer, 1);
+			// Read from the replica expected to answer first.  Either may not
+			// have been created locally yet.
+			as_node* master_node = ck_pr_load_ptr(&shm_info->local_nodes[master-1]);
+			as_node* prole_node = ck_pr_load_ptr(&shm_info->local_nodes[prole-1]);
 
-			if (r & 1) {
-				return as_shm_reserve_node_alternate(cluster, shm_info->local_nodes, master, prole);
+			if (master_node && (! prole_node || as_node_choose_replica(master_node, prole_node) == master_node)) {
+				return as_shm_select_node_alternate(cluster, shm_info->local_nodes, master, prole);
 			}
-			return as_shm_reserve_node_alternate(cluster, shm_info->local_nodes, prole, master);
+			return as_shm_select_node_alternate(cluster, shm_info->local_nodes, prole, master);
 		}
 	}
 
 	// as_log_debug("Choose random node for null partition table");
-	return as_node_get_random(cluster);
+	return as_node_choose_random(cluster);
+}
+
+as_node*
+as_shm_node_get_prole(as_cluster* cluster, const char* ns, uint32_t ns_id, const cf_digest* d)
+{
+	as_shm_info* shm_info = cluster->shm_info;
+	as_cluster_shm* cluster_shm = shm_info->cluster_shm;
+	as_partition_table_shm* table = as_shm_get_partition_table_id(shm_info, ns, ns_id);
+	
+	if (table) {
+		cl_partition_id partition_id = cl_partition_getid(cluster_shm->n_partitions, d);
+		uint32_t prole = ck_pr_load_32(&table->partitions[partition_id].prole);
+		
+		// node index starts at one (zero indicates unset).
+		if (prole) {
+			as_node* node = ck_pr_load_ptr(&shm_info->local_nodes[prole-1]);
+			
+			if (node && ck_pr_load_8(&node->active)) {
+				return node;
+			}
+		}
+	}
+	return NULL;
 }
 
 static void
@@ -550,6 +590,13 @@ as_shm_tender(void* userdata)
 				nodes_gen = gen;
 				as_shm_reset_nodes(cluster);
 			}
+			
+			// Pools are local to this process, so idle connections are still closed here.
+			as_nodes* nodes = cluster->nodes;
+			
+			for (uint32_t i = 0; i < nodes->size; i++) {
+				as_node_close_idle_connections(nodes->array[i]);
+			}
 		}
 
 		// Convert tend interval into absolute timeout.
@@ -672,6 +719,7 @@ as_shm_create(as_cluster* cluster, as_config* config)
 
 	as_shm_info* shm_info = cf_malloc(sizeof(as_shm_info));
 	shm_info->local_nodes = cf_calloc(config->shm_max_nodes, sizeof(as_node*));
+	shm_info->ns_tables = cf_calloc(AS_NAMESPACE_IDS, sizeof(as_partition_table_shm*));
 	shm_info->cluster_shm = cluster_shm;
 	shm_info->shm_id = id;
 	shm_info->takeover_threshold_ms = config->shm_takeover_threshold_sec * 1000;
@@ -736,6 +784,7 @@ as_shm_destroy(as_cluster* cluster)
 
 	// Release memory.
 	cf_free(shm_info->local_nodes);
+	cf_free(shm_info->ns_tables);
 	cf_free(shm_info);
 	cluster->shm_info = 0;
 }
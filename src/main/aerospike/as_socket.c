@@ -19,6 +19,8 @@
 #include <citrusleaf/alloc.h>
 #include <citrusleaf/cf_byte_order.h>
 #include <citrusleaf/cf_clock.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -31,6 +33,9 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <errno.h>
+#if !defined(AS_SOCKET_USE_SELECT)
+#include <poll.h>
+#endif
 #define IS_CONNECTING() (errno == EINPROGRESS)
 #endif // __linux__ __APPLE__
 
@@ -67,7 +72,9 @@
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__hpux) || defined(__PPC__)
 
+#if defined(AS_SOCKET_USE_SELECT)
 #define STACK_LIMIT (16 * 1024)
+#endif
 
 /******************************************************************************
  * DEBUG FUNCTIONS
@@ -92,6 +99,8 @@ debug_time_printf(const char* desc, int try, int busy, uint64_t start, uint64_t
 }
 #endif
 
+#if defined(AS_SOCKET_USE_SELECT)
+
 /******************************************************************************
  * STATIC FUNCTIONS
  *****************************************************************************/
@@ -132,6 +141,8 @@ as_fd_isset(int fd, fd_set *fdset)
 	return FD_ISSET(fd%FD_SETSIZE, &fdset[fd/FD_SETSIZE]);
 }
 
+#endif // AS_SOCKET_USE_SELECT
+
 /******************************************************************************
  * FUNCTIONS
  *****************************************************************************/
@@ -203,12 +214,72 @@ as_status
 as_socket_write_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len)
 {
 	// MacOS will return "socket not connected" errors even when connection is
-	// blocking.  Therefore, select() is required before writing.  Since write
-	// timeout function also calls select(), use write timeout function with
+	// blocking.  Therefore, a readiness wait is required before writing.  Since
+	// write timeout function already waits, use write timeout function with
 	// 1 minute timeout.
 	return as_socket_write_timeout(err, fd, buf, buf_len, 60000);
 }
 
+#if !defined(IOV_MAX)
+#define IOV_MAX 16
+#endif
+
+as_status
+as_socket_writev_limit(as_error* err, int fd, const struct iovec* iov, int iovcnt, uint64_t deadline)
+{
+	// Send as many fragments as the socket accepts with one writev().  When the
+	// socket fills up mid fragment, finish that fragment with as_socket_write_limit(),
+	// which waits for the socket to drain, then go back to gathering.
+	int i = 0;
+	
+	while (i < iovcnt) {
+		int count = iovcnt - i;
+		
+		if (count > IOV_MAX) {
+			count = IOV_MAX;
+		}
+		
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = (struct iovec*)(iov + i);
+		msg.msg_iovlen = count;
+		
+		ssize_t w_bytes = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		
+		if (w_bytes == 0) {
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+		
+		if (w_bytes < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+			}
+			w_bytes = 0;
+		}
+		
+		// Skip fragments that were fully written.
+		size_t done = w_bytes;
+		
+		while (i < iovcnt && done >= iov[i].iov_len) {
+			done -= iov[i].iov_len;
+			i++;
+		}
+		
+		if (i < iovcnt && (done > 0 || w_bytes == 0)) {
+			as_status status = as_socket_write_limit(err, fd, (uint8_t*)iov[i].iov_base + done,
+				iov[i].iov_len - done, deadline);
+			
+			if (status) {
+				return status;
+			}
+			i++;
+		}
+	}
+	return AEROSPIKE_OK;
+}
+
+#if defined(AS_SOCKET_USE_SELECT)
+
 as_status
 as_socket_write_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
 {
@@ -266,7 +337,7 @@ as_socket_write_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint6
 		// we only have one fd, so we know it's ours, but select seems confused sometimes - do the safest thing
 		if ((rv > 0) && as_fd_isset(fd, wset)) {
             
-			int r_bytes = (int)write(fd, buf + pos, buf_len - pos );
+			int r_bytes = (int)send(fd, buf + pos, buf_len - pos, MSG_NOSIGNAL);
             
 			if (r_bytes > 0) {
 				pos += r_bytes;
@@ -350,6 +421,47 @@ as_socket_read_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len)
 	return AEROSPIKE_OK;
 }
 
+int
+as_socket_wait_readable(const int* fds, int n_fds, uint64_t timeout_us)
+{
+	int max_fd = 0;
+	
+	for (int i = 0; i < n_fds; i++) {
+		if (fds[i] > max_fd) {
+			max_fd = fds[i];
+		}
+	}
+	
+	size_t rset_size = as_fdset_size(max_fd);
+	fd_set* rset = (fd_set*)(rset_size > STACK_LIMIT ? cf_malloc(rset_size) : alloca(rset_size));
+	memset((void*)rset, 0, rset_size);
+	
+	for (int i = 0; i < n_fds; i++) {
+		as_fd_set(fds[i], rset);
+	}
+	
+	struct timeval tv;
+	tv.tv_sec = timeout_us / 1000000;
+	tv.tv_usec = timeout_us % 1000000;
+	
+	int ready = -1;
+	int rv = select(max_fd + 1, rset, 0, 0, &tv);
+	
+	if (rv > 0) {
+		for (int i = 0; i < n_fds; i++) {
+			if (as_fd_isset(fds[i], rset)) {
+				ready = i;
+				break;
+			}
+		}
+	}
+	
+	if (rset_size > STACK_LIMIT) {
+		cf_free(rset);
+	}
+	return ready;
+}
+
 as_status
 as_socket_read_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
 {
@@ -449,6 +561,253 @@ Out:
 	}
 	return status;
 }
+as_status
+as_socket_read_atleast(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t buf_len, uint64_t deadline, size_t* read_len)
+{
+	size_t pos = 0;
+
+	// Take whatever is available as soon as the first byte arrives.
+	while (true) {
+		ssize_t r_bytes = read(fd, buf, buf_len);
+
+		if (r_bytes > 0) {
+			pos = r_bytes;
+			break;
+		}
+
+		if (r_bytes == 0 || errno == ECONNRESET) {
+			return as_error_set_message(err, AEROSPIKE_ERR_NO_RESPONSE, "Connection closed before response");
+		}
+
+		if (errno != EWOULDBLOCK && errno != EINPROGRESS && errno != EAGAIN && errno != EINTR) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+
+		uint64_t timeout_us = 1000000;
+
+		if (deadline) {
+			uint64_t now = cf_getms();
+
+			if (now >= deadline) {
+				return err->code = AEROSPIKE_ERR_TIMEOUT;
+			}
+			timeout_us = (deadline - now) * 1000;
+		}
+
+		// Timeouts and interrupts loop around to recheck the socket and deadline.
+		as_socket_wait_readable(&fd, 1, timeout_us);
+	}
+
+	if (pos < min_len) {
+		// Wait for the remainder of the minimum.
+		as_status status = deadline ?
+			as_socket_read_limit(err, fd, buf + pos, min_len - pos, deadline) :
+			as_socket_read_forever(err, fd, buf + pos, min_len - pos);
+
+		if (status) {
+			return status;
+		}
+		pos = min_len;
+	}
+	*read_len = pos;
+	return AEROSPIKE_OK;
+}
+
+#else // AS_SOCKET_USE_SELECT
+
+//
+// Sockets are created non-blocking (see as_socket_create_nb()) and are never
+// switched back, so each transfer is attempted first and poll() is only called
+// when the kernel reports EAGAIN.  In the common request/response case the
+// data is already there and a chunk costs a single syscall.  poll() needs no
+// fd_set, so large fd numbers cost nothing extra.
+//
+
+/**
+ *	Wait until fd is ready for the given events or deadline is reached.
+ *	A zero deadline waits forever.
+ *	Returns 1 when ready, 0 on timeout and -1 on error.
+ */
+static inline int
+as_socket_poll(int fd, short events, uint64_t deadline)
+{
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = events;
+
+	while (true) {
+		int timeout_ms = -1;
+
+		if (deadline) {
+			uint64_t now = cf_getms();
+
+			// A zero poll timeout returns at once, so the deadline itself counts
+			// as reached rather than spinning until the clock ticks.
+			if (now >= deadline) {
+				return 0;
+			}
+			timeout_ms = (int)(deadline - now);
+		}
+
+		pfd.revents = 0;
+		int rv = poll(&pfd, 1, timeout_ms);
+
+		if (rv > 0) {
+			// Errors and hangups are reported by the following read()/write().
+			return 1;
+		}
+
+		if (rv < 0 && errno != EINTR) {
+			return -1;
+		}
+		// Timed out or interrupted. Loop around to recheck deadline.
+	}
+}
+
+static inline bool
+as_socket_would_block()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == EINTR;
+}
+
+as_status
+as_socket_write_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
+{
+	size_t pos = 0;
+
+	do {
+		ssize_t w_bytes = send(fd, buf + pos, buf_len - pos, MSG_NOSIGNAL);
+
+		if (w_bytes > 0) {
+			pos += w_bytes;
+			continue;
+		}
+
+		if (w_bytes == 0) {
+			// We shouldn't see 0 returned unless we try to write 0 bytes, which we don't.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+
+		if (! as_socket_would_block()) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+		}
+
+		int rv = as_socket_poll(fd, POLLOUT, deadline);
+
+		if (rv == 0) {
+			// Do not set error string to avoid affecting performance.
+			// Calling functions usually retry, so the error string is not used anyway.
+			return err->code = AEROSPIKE_ERR_TIMEOUT;
+		}
+
+		if (rv < 0) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket write error: %d", errno);
+		}
+	} while (pos < buf_len);
+
+	return AEROSPIKE_OK;
+}
+
+/**
+ *	Read at least min_len and at most buf_len bytes. A zero deadline waits forever.
+ *	If report_closed is set, a socket closed or reset before the first byte
+ *	returns AEROSPIKE_ERR_NO_RESPONSE.
+ */
+static as_status
+as_socket_read_wait(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t buf_len, uint64_t deadline,
+	bool report_closed, size_t* read_len)
+{
+	size_t pos = 0;
+
+	do {
+		ssize_t r_bytes = read(fd, buf + pos, buf_len - pos);
+
+		if (r_bytes > 0) {
+			pos += r_bytes;
+			continue;
+		}
+
+		if (report_closed && pos == 0 && (r_bytes == 0 || errno == ECONNRESET)) {
+			return as_error_set_message(err, AEROSPIKE_ERR_NO_RESPONSE, "Connection closed before response");
+		}
+
+		if (r_bytes == 0) {
+			// We believe this means that the server has closed this socket.
+			return as_error_set_message(err, AEROSPIKE_ERR_CLIENT, "Bad file descriptor");
+		}
+
+		if (! as_socket_would_block()) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+
+		int rv = as_socket_poll(fd, POLLIN, deadline);
+
+		if (rv == 0) {
+			// Do not set error string to avoid affecting performance.
+			// Calling functions usually retry, so the error string is not used anyway.
+			return err->code = AEROSPIKE_ERR_TIMEOUT;
+		}
+
+		if (rv < 0) {
+			return as_error_update(err, AEROSPIKE_ERR_CLIENT, "Socket read error: %d", errno);
+		}
+	} while (pos < min_len);
+
+	*read_len = pos;
+	return AEROSPIKE_OK;
+}
+
+//
+// These FOREVER calls are only called in the 'getmany' case, which is used
+// for application level highly variable queries.  The socket stays
+// non-blocking; poll() simply waits without a timeout.
+//
+as_status
+as_socket_read_forever(as_error* err, int fd, uint8_t *buf, size_t buf_len)
+{
+	size_t read_len;
+	return as_socket_read_wait(err, fd, buf, buf_len, buf_len, 0, false, &read_len);
+}
+
+as_status
+as_socket_read_limit(as_error* err, int fd, uint8_t *buf, size_t buf_len, uint64_t deadline)
+{
+	size_t read_len;
+	return as_socket_read_wait(err, fd, buf, buf_len, buf_len, deadline, false, &read_len);
+}
+
+as_status
+as_socket_read_atleast(as_error* err, int fd, uint8_t *buf, size_t min_len, size_t buf_len, uint64_t deadline, size_t* read_len)
+{
+	return as_socket_read_wait(err, fd, buf, min_len, buf_len, deadline, true, read_len);
+}
+
+int
+as_socket_wait_readable(const int* fds, int n_fds, uint64_t timeout_us)
+{
+	struct pollfd pfds[n_fds];
+	
+	for (int i = 0; i < n_fds; i++) {
+		pfds[i].fd = fds[i];
+		pfds[i].events = POLLIN;
+		pfds[i].revents = 0;
+	}
+	
+	// poll() works in milliseconds.  Round up so short delays still wait.
+	int rv = poll(pfds, n_fds, (int)((timeout_us + 999) / 1000));
+	
+	if (rv > 0) {
+		for (int i = 0; i < n_fds; i++) {
+			// Errors and hangups are reported by the following read().
+			if (pfds[i].revents) {
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+#endif // AS_SOCKET_USE_SELECT
 
 #else // CF_WINDOWS
 //====================================================================
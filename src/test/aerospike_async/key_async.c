@@ -0,0 +1,494 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_event.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include <citrusleaf/cf_clock.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+extern fake_server * g_fake_server;
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct async_result_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t expected;
+	uint32_t completed;
+	uint32_t failed;
+	as_status code;
+	uint32_t numbins;
+	int64_t a;
+	char b[16];
+} async_result;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void async_result_init(async_result * r, uint32_t expected)
+{
+	memset(r, 0, sizeof(async_result));
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	r->expected = expected;
+}
+
+static void async_result_wait(async_result * r)
+{
+	pthread_mutex_lock(&r->lock);
+	while (r->completed < r->expected) {
+		pthread_cond_wait(&r->cond, &r->lock);
+	}
+	pthread_mutex_unlock(&r->lock);
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+}
+
+static void async_result_complete(async_result * r, as_error * err, as_record * rec)
+{
+	pthread_mutex_lock(&r->lock);
+
+	if (err) {
+		r->code = err->code;
+		r->failed++;
+	}
+	else {
+		r->code = AEROSPIKE_OK;
+	}
+
+	if (rec) {
+		r->numbins = as_record_numbins(rec);
+		r->a = as_record_get_int64(rec, "a", 0);
+		char * b = as_record_get_str(rec, "b");
+
+		if (b) {
+			strncpy(r->b, b, sizeof(r->b) - 1);
+		}
+	}
+
+	r->completed++;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void key_async_record_listener(as_error * err, as_record * rec, void * udata)
+{
+	async_result_complete(udata, err, rec);
+}
+
+static void key_async_write_listener(as_error * err, void * udata)
+{
+	async_result_complete(udata, err, NULL);
+}
+
+/**
+ * Connect a client that logs in to two servers which split the partitions.
+ */
+static aerospike * key_async_login_connect(fake_server ** servers)
+{
+	as_config config;
+	fake_client_config(&config, servers, 2);
+	as_config_set_user(&config, "async", "secret");
+	return fake_client_connect(&config);
+}
+
+/**
+ * Find a key whose master is the node named `name`.
+ */
+static void key_async_key_on(aerospike * client, const char * name, as_key * key)
+{
+	for (int64_t i = 0; ; i++) {
+		as_key_init_int64(key, "test", "login", i);
+		as_key_digest(key);
+
+		as_node * node = as_node_get_reserved(client->cluster, key->ns, key->_ns_id, (const cf_digest*)key->digest.value,
+			false, AS_POLICY_REPLICA_MASTER);
+		bool match = node && strcmp(node->name, name) == 0;
+
+		if (node) {
+			as_node_release(node);
+		}
+
+		if (match) {
+			return;
+		}
+		as_key_destroy(key);
+	}
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_async_put , "put async: (test,test,foo) = {a: 123, b: 'abc'}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_record rec;
+	as_record_init(&rec, 2);
+	as_record_set_int64(&rec, "a", 123);
+	as_record_set_str(&rec, "b", "abc");
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	as_status rc = aerospike_key_put_async(as, &err, NULL, &key, &rec, key_async_write_listener, &r);
+
+	as_record_destroy(&rec);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_OK );
+}
+
+TEST( key_async_get , "get async: (test,test,foo) = {a: 123, b: 'abc'}" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	as_status rc = aerospike_key_get_async(as, &err, NULL, &key, key_async_record_listener, &r);
+
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_OK );
+	assert_int_eq( r.numbins, 2 );
+	assert_int_eq( r.a, 123 );
+	assert_string_eq( r.b, "abc" );
+}
+
+TEST( key_async_operate , "operate async: (test,test,foo) write c, read a" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	as_operations ops;
+	as_operations_inita(&ops, 2);
+	as_operations_add_write_int64(&ops, "c", 456);
+	as_operations_add_read(&ops, "a");
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	as_status rc = aerospike_key_operate_async(as, &err, NULL, &key, &ops, key_async_record_listener, &r);
+
+	as_operations_destroy(&ops);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_OK );
+	assert_int_eq( r.numbins, 1 );
+	assert_int_eq( r.a, 123 );
+}
+
+TEST( key_async_many , "put async: 200 concurrent commands" ) {
+
+	uint32_t n = 200;
+
+	async_result r;
+	async_result_init(&r, n);
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_error err;
+		as_key key;
+		as_key_init_int64(&key, "test", "test", i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i);
+
+		as_status rc = aerospike_key_put_async(as, &err, NULL, &key, &rec, key_async_write_listener, &r);
+
+		as_record_destroy(&rec);
+		as_key_destroy(&key);
+
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	async_result_wait(&r);
+	assert_int_eq( r.completed, n );
+	assert_int_eq( r.failed, 0 );
+}
+
+TEST( key_async_timeout , "get async: server slower than timeout" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 50;
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	fake_server_set_delay(g_fake_server, 300);
+	as_status rc = aerospike_key_get_async(as, &err, &policy, &key, key_async_record_listener, &r);
+
+	as_key_destroy(&key);
+
+	if (rc == AEROSPIKE_OK) {
+		async_result_wait(&r);
+	}
+	fake_server_set_delay(g_fake_server, 0);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( r.code, AEROSPIKE_ERR_TIMEOUT );
+}
+
+TEST( key_async_oversize , "get async: oversized response header fails the command" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	fake_server_inject(g_fake_server, FAKE_FAULT_OVERSIZE, 1);
+	as_status rc = aerospike_key_get_async(as, &err, NULL, &key, key_async_record_listener, &r);
+
+	if (rc == AEROSPIKE_OK) {
+		async_result_wait(&r);
+	}
+	fake_server_inject(g_fake_server, FAKE_FAULT_NONE, 0);
+
+	// The socket is closed, so the next command gets a clean stream.
+	async_result r2;
+	async_result_init(&r2, 1);
+	as_status rc2 = aerospike_key_get_async(as, &err, NULL, &key, key_async_record_listener, &r2);
+
+	if (rc2 == AEROSPIKE_OK) {
+		async_result_wait(&r2);
+	}
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( r.code, AEROSPIKE_ERR_CLIENT );
+	assert_int_eq( rc2, AEROSPIKE_OK );
+	assert_int_eq( r2.code, AEROSPIKE_OK );
+}
+
+TEST( key_async_remove , "remove async: (test,test,foo)" ) {
+
+	as_error err;
+	as_error_reset(&err);
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	async_result r;
+	async_result_init(&r, 1);
+
+	as_status rc = aerospike_key_remove_async(as, &err, NULL, &key, key_async_write_listener, &r);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_OK );
+
+	// Removing a missing record is not an error.
+	async_result_init(&r, 1);
+	rc = aerospike_key_remove_async(as, &err, NULL, &key, key_async_write_listener, &r);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_OK );
+
+	// Reading a missing record is.
+	async_result_init(&r, 1);
+	rc = aerospike_key_get_async(as, &err, NULL, &key, key_async_record_listener, &r);
+
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	async_result_wait(&r);
+	assert_int_eq( r.code, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+}
+
+TEST( key_async_login , "get async: slow login does not stall other nodes" ) {
+
+	fake_server * servers[2];
+	servers[0] = fake_server_start_range("test", "BB900000000000E", 0, 2048);
+	servers[1] = fake_server_start_range("test", "BB900000000000F", 2048, 4096);
+	assert_not_null( servers[0] );
+	assert_not_null( servers[1] );
+
+	aerospike * client = key_async_login_connect(servers);
+	assert_not_null( client );
+
+	as_key slow;
+	as_key fast;
+	key_async_key_on(client, "BB900000000000E", &slow);
+	key_async_key_on(client, "BB900000000000F", &fast);
+
+	as_error err;
+	async_result rs;
+	async_result rf;
+	async_result_init(&rs, 1);
+	async_result_init(&rf, 1);
+
+	// Logins on new async connections are driven by the event loop, so the
+	// command to the fast node is neither queued behind nor issued after the
+	// slow login.
+	fake_server_set_login_delay(servers[0], 500);
+	uint64_t begin = cf_getms();
+	as_status rc1 = aerospike_key_get_async(client, &err, NULL, &slow, key_async_record_listener, &rs);
+	as_status rc2 = aerospike_key_get_async(client, &err, NULL, &fast, key_async_record_listener, &rf);
+
+	if (rc2 == AEROSPIKE_OK) {
+		async_result_wait(&rf);
+	}
+	uint64_t elapsed = cf_getms() - begin;
+
+	if (rc1 == AEROSPIKE_OK) {
+		async_result_wait(&rs);
+	}
+
+	// A login slower than the command times the command out.
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.timeout = 100;
+
+	async_result rt;
+	async_result_init(&rt, 1);
+	fake_server_drop_connections(servers[0]);
+	fake_server_set_login_delay(servers[0], 400);
+	as_status rc3 = aerospike_key_get_async(client, &err, &policy, &slow, key_async_record_listener, &rt);
+
+	if (rc3 == AEROSPIKE_OK) {
+		async_result_wait(&rt);
+	}
+	fake_server_set_login_delay(servers[0], 0);
+
+	as_key_destroy(&slow);
+	as_key_destroy(&fast);
+	fake_client_close(client);
+	fake_server_stop(servers[0]);
+	fake_server_stop(servers[1]);
+
+	assert_int_eq( rc1, AEROSPIKE_OK );
+	assert_int_eq( rc2, AEROSPIKE_OK );
+	assert_int_eq( rc3, AEROSPIKE_OK );
+	assert_int_eq( rf.code, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_int_eq( rs.code, AEROSPIKE_ERR_RECORD_NOT_FOUND );
+	assert_int_eq( rt.code, AEROSPIKE_ERR_TIMEOUT );
+	assert_true( elapsed < 300 );
+}
+
+TEST( key_async_loop_failed , "get async: failed event loop fails in-flight and later commands" ) {
+
+	aerospike * client = fake_client_start(&g_fake_server, 1);
+	assert_not_null( client );
+
+	as_key key;
+	as_key_init(&key, "test", "test", "foo");
+
+	as_error err;
+	async_result r1;
+	async_result_init(&r1, 1);
+
+	fake_server_set_delay(g_fake_server, 300);
+	as_status rc1 = aerospike_key_get_async(client, &err, NULL, &key, key_async_record_listener, &r1);
+	usleep(50 * 1000);
+
+	// Replace the loop's epoll descriptor, so its next epoll_wait() fails.
+	as_event_loop * loop = &client->cluster->event_loops[0];
+	int fd = open("/dev/null", O_RDONLY);
+	dup2(fd, loop->poll_fd);
+	close(fd);
+
+	if (rc1 == AEROSPIKE_OK) {
+		async_result_wait(&r1);
+	}
+	fake_server_set_delay(g_fake_server, 0);
+
+	async_result r2;
+	async_result_init(&r2, 1);
+	as_status rc2 = aerospike_key_get_async(client, &err, NULL, &key, key_async_record_listener, &r2);
+
+	if (rc2 == AEROSPIKE_OK) {
+		async_result_wait(&r2);
+	}
+	bool closing = loop->closing;
+
+	as_key_destroy(&key);
+	fake_client_close(client);
+
+	assert_int_eq( rc1, AEROSPIKE_OK );
+	assert_int_eq( r1.code, AEROSPIKE_ERR_CLIENT );
+	assert_true( closing );
+	assert_int_eq( rc2, AEROSPIKE_OK );
+	assert_int_eq( r2.code, AEROSPIKE_ERR_CLIENT );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_async, "aerospike_key async tests" ) {
+	suite_add( key_async_put );
+	suite_add( key_async_get );
+	suite_add( key_async_operate );
+	suite_add( key_async_many );
+	suite_add( key_async_timeout );
+	suite_add( key_async_oversize );
+	suite_add( key_async_remove );
+	suite_add( key_async_login );
+	suite_add( key_async_loop_failed );
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <pthread.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define N_KEYS 200
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern fake_server * g_fake_server;
+
+static aerospike * pipe_as = NULL;
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct pipe_result_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t expected;
+	uint32_t completed;
+	uint32_t failed;
+	uint32_t mismatched;
+	as_status codes[N_KEYS];
+} pipe_result;
+
+typedef struct pipe_request_s {
+	pipe_result * result;
+	uint32_t index;
+} pipe_request;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void pipe_result_init(pipe_result * r, uint32_t expected)
+{
+	memset(r, 0, sizeof(pipe_result));
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	r->expected = expected;
+}
+
+static void pipe_result_wait(pipe_result * r)
+{
+	pthread_mutex_lock(&r->lock);
+	while (r->completed < r->expected) {
+		pthread_cond_wait(&r->cond, &r->lock);
+	}
+	pthread_mutex_unlock(&r->lock);
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+}
+
+static void pipe_complete(pipe_request * req, as_error * err, as_record * rec)
+{
+	pipe_result * r = req->result;
+	pthread_mutex_lock(&r->lock);
+
+	r->codes[req->index] = err ? err->code : AEROSPIKE_OK;
+
+	if (err) {
+		r->failed++;
+	}
+
+	// Responses are matched in order, so each record must hold its own key's value.
+	if (rec && as_record_get_int64(rec, "a", -1) != req->index) {
+		r->mismatched++;
+	}
+
+	r->completed++;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void pipe_record_listener(as_error * err, as_record * rec, void * udata)
+{
+	pipe_complete(udata, err, rec);
+}
+
+static void pipe_write_listener(as_error * err, void * udata)
+{
+	pipe_complete(udata, err, NULL);
+}
+
+static bool before(atf_suite * suite)
+{
+	as_config config;
+	fake_client_config(&config, &g_fake_server, 1);
+	config.async_pipeline = true;
+	pipe_as = fake_client_connect(&config);
+	return pipe_as != NULL;
+}
+
+static bool after(atf_suite * suite)
+{
+	fake_client_close(pipe_as);
+	pipe_as = NULL;
+	return true;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( key_async_pipeline_put_get , "pipelined put and get of 200 keys on one socket" ) {
+
+	static pipe_result r;
+	static pipe_request reqs[N_KEYS];
+
+	uint32_t conns = fake_server_connections(g_fake_server);
+
+	pipe_result_init(&r, N_KEYS);
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		reqs[i].result = &r;
+		reqs[i].index = i;
+
+		as_error err;
+		as_key key;
+		as_key_init_int64(&key, "test", "pipe", i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i);
+
+		as_status rc = aerospike_key_put_async(pipe_as, &err, NULL, &key, &rec, pipe_write_listener, &reqs[i]);
+
+		as_record_destroy(&rec);
+		as_key_destroy(&key);
+
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	pipe_result_wait(&r);
+	assert_int_eq( r.failed, 0 );
+
+	pipe_result_init(&r, N_KEYS);
+
+	for (uint32_t i = 0; i < N_KEYS; i++) {
+		as_error err;
+		as_key key;
+		as_key_init_int64(&key, "test", "pipe", i);
+
+		as_status rc = aerospike_key_get_async(pipe_as, &err, NULL, &key, pipe_record_listener, &reqs[i]);
+
+		as_key_destroy(&key);
+
+		assert_int_eq( rc, AEROSPIKE_OK );
+	}
+
+	pipe_result_wait(&r);
+	assert_int_eq( r.failed, 0 );
+	assert_int_eq( r.mismatched, 0 );
+
+	// One event loop and one node, so every burst shares a single socket.
+	assert_true( fake_server_connections(g_fake_server) - conns <= 1 );
+}
+
+TEST( key_async_pipeline_timeout , "pipelined get behind a timed out get" ) {
+
+	static pipe_result r;
+	static pipe_request reqs[2];
+
+	as_key key;
+	as_key_init_int64(&key, "test", "pipe", 1);
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+
+	pipe_result_init(&r, 2);
+	fake_server_set_delay(g_fake_server, 300);
+
+	as_error err;
+	as_status rc;
+
+	for (uint32_t i = 0; i < 2; i++) {
+		reqs[i].result = &r;
+		reqs[i].index = 1;
+		policy.timeout = i == 0 ? 50 : 5000;
+		rc = aerospike_key_get_async(pipe_as, &err, &policy, &key, pipe_record_listener, &reqs[i]);
+
+		if (rc != AEROSPIKE_OK) {
+			break;
+		}
+	}
+
+	if (rc == AEROSPIKE_OK) {
+		pipe_result_wait(&r);
+	}
+	fake_server_set_delay(g_fake_server, 0);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// The first command stalls the socket, so the second is failed with it.
+	assert_int_eq( r.failed, 2 );
+	assert_int_eq( r.codes[1], AEROSPIKE_ERR_TIMEOUT );
+
+	// A new pipe is opened for later commands.
+	pipe_result_init(&r, 1);
+	rc = aerospike_key_get_async(pipe_as, &err, NULL, &key, pipe_record_listener, &reqs[0]);
+
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	pipe_result_wait(&r);
+	assert_int_eq( r.failed, 0 );
+	assert_int_eq( r.mismatched, 0 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( key_async_pipeline, "aerospike_key async pipeline tests" ) {
+	suite_before( before );
+	suite_after( after );
+	suite_add( key_async_pipeline_put_get );
+	suite_add( key_async_pipeline_timeout );
+}
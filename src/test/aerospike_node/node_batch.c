@@ -0,0 +1,581 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_batch.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_batch.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+#include <citrusleaf/cf_atomic.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define BATCH_NODES 2
+#define BATCH_KEYS 20
+#define BATCH_DELAY_MS 300
+#define BATCH_LARGE_KEYS 5000
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct batch_status_s {
+	uint32_t ok;
+	uint32_t not_found;
+	uint32_t busy;
+	uint32_t sum;
+} batch_status;
+
+typedef struct batch_stream_s {
+	uint64_t begin_ms;
+	uint64_t first_ms;
+	uint32_t found;
+	uint32_t not_found;
+	uint32_t sum;
+	uint32_t limit;
+	uint32_t nodes;
+	uint32_t node_keys;
+	uint32_t node_ok;
+	uint32_t node_aborted;
+} batch_stream;
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+static fake_server * batch_servers[BATCH_NODES];
+static aerospike * batch_as = NULL;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+// Keys 1 to BATCH_KEYS exist, key BATCH_KEYS + 1 does not.
+static void batch_init_keys(as_batch * batch)
+{
+	as_batch_init(batch, BATCH_KEYS + 1);
+
+	for (uint32_t i = 0; i <= BATCH_KEYS; i++) {
+		as_key_init_int64(as_batch_keyat(batch, i), "test", "batch", i + 1);
+	}
+}
+
+static bool batch_stream_record(const as_batch_read * result, void * udata)
+{
+	batch_stream * s = udata;
+
+	if (cf_atomic32_incr((cf_atomic32*)&s->found) == 1) {
+		s->first_ms = cf_getms();
+	}
+
+	if (result->result == AEROSPIKE_OK) {
+		cf_atomic32_add((cf_atomic32*)&s->sum, (int32_t)as_record_get_int64(&result->record, "a", 0));
+	}
+	else {
+		cf_atomic32_incr((cf_atomic32*)&s->not_found);
+	}
+	return s->limit == 0 || s->found < s->limit;
+}
+
+static void batch_stream_node(const char * node_name, as_status status, uint32_t n_keys, void * udata)
+{
+	batch_stream * s = udata;
+	cf_atomic32_incr((cf_atomic32*)&s->nodes);
+	cf_atomic32_add((cf_atomic32*)&s->node_keys, n_keys);
+
+	if (status == AEROSPIKE_OK) {
+		cf_atomic32_incr((cf_atomic32*)&s->node_ok);
+	}
+	else if (status == AEROSPIKE_ERR_CLIENT_ABORT) {
+		cf_atomic32_incr((cf_atomic32*)&s->node_aborted);
+	}
+}
+
+static as_status batch_stream_run(batch_stream * s, uint32_t limit)
+{
+	memset(s, 0, sizeof(batch_stream));
+	s->limit = limit;
+
+	as_batch batch;
+	batch_init_keys(&batch);
+
+	as_error err;
+	s->begin_ms = cf_getms();
+	as_status rc = aerospike_batch_get_stream(batch_as, &err, NULL, &batch, batch_stream_record, batch_stream_node, s);
+	as_batch_destroy(&batch);
+	return rc;
+}
+
+static bool batch_get_sum(const as_batch_read * results, uint32_t n, void * udata)
+{
+	uint32_t * sum = udata;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (results[i].result == AEROSPIKE_OK) {
+			*sum += (uint32_t)as_record_get_int64(&results[i].record, "a", 0);
+		}
+	}
+	return true;
+}
+
+// Large batch records have an integer bin and a string bin which ends the record.
+static bool batch_large_check(const as_batch_read * result, uint32_t * errors)
+{
+	int64_t k = result->key->valuep->integer.value;
+	char expected[32];
+	sprintf(expected, "value-%lld", (long long)k);
+
+	as_string * s = as_record_get_string(&result->record, "s");
+
+	// Strings are not copied out of the response.
+	if (result->result != AEROSPIKE_OK || as_record_get_int64(&result->record, "a", -1) != k ||
+		! s || s->free || strcmp(as_string_get(s), expected) != 0) {
+		cf_atomic32_incr((cf_atomic32*)errors);
+		return false;
+	}
+	return true;
+}
+
+static bool batch_large_results(const as_batch_read * results, uint32_t n, void * udata)
+{
+	uint32_t * errors = udata;
+
+	if (n != BATCH_LARGE_KEYS) {
+		(*errors)++;
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		batch_large_check(&results[i], errors);
+	}
+	return true;
+}
+
+static bool batch_large_record(const as_batch_read * result, void * udata)
+{
+	batch_large_check(result, udata);
+	return true;
+}
+
+static bool batch_select_results(const as_batch_read * results, uint32_t n, void * udata)
+{
+	uint32_t * errors = udata;
+
+	for (uint32_t i = 0; i < n; i++) {
+		const as_record * rec = &results[i].record;
+		int64_t k = results[i].key->valuep->integer.value;
+		char expected[32];
+		sprintf(expected, "value-%lld", (long long)k);
+
+		char * s = as_record_get_str(rec, "s");
+
+		if (results[i].result != AEROSPIKE_OK || rec->bins.size != 1 || ! s || strcmp(s, expected) != 0) {
+			(*errors)++;
+		}
+	}
+	return true;
+}
+
+// Keys alternate between namespace "test", where bin "a" is k, and namespace
+// "bar", where it is k + 100.
+static bool batch_namespaces_results(const as_batch_read * results, uint32_t n, void * udata)
+{
+	uint32_t * errors = udata;
+
+	for (uint32_t i = 0; i < n; i++) {
+		int64_t k = results[i].key->valuep->integer.value;
+		int64_t expected = (i & 1) ? k + 100 : k;
+
+		if (results[i].result != AEROSPIKE_OK || as_record_get_int64(&results[i].record, "a", -1) != expected) {
+			(*errors)++;
+		}
+	}
+	return true;
+}
+
+static bool batch_status_results(const as_batch_read * results, uint32_t n, void * udata)
+{
+	batch_status * s = udata;
+
+	for (uint32_t i = 0; i < n; i++) {
+		switch (results[i].result) {
+			case AEROSPIKE_OK:
+				s->ok++;
+				s->sum += (uint32_t)as_record_get_int64(&results[i].record, "a", 0);
+				break;
+			case AEROSPIKE_ERR_RECORD_NOT_FOUND:
+				s->not_found++;
+				break;
+			case AEROSPIKE_ERR_DEVICE_OVERLOAD:
+				s->busy++;
+				break;
+			default:
+				break;
+		}
+	}
+	return true;
+}
+
+// Answer the next batch command sent to the first node with a busy error.
+static as_status batch_get_busy(as_policy_retry retry, batch_status * s)
+{
+	memset(s, 0, sizeof(batch_status));
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.retry = retry;
+
+	as_batch batch;
+	batch_init_keys(&batch);
+
+	as_error err;
+	fake_server_inject(batch_servers[0], FAKE_FAULT_BUSY, 1);
+	as_status rc = aerospike_batch_get(batch_as, &err, &policy, &batch, batch_status_results, s);
+	fake_server_inject(batch_servers[0], FAKE_FAULT_NONE, 0);
+	as_batch_destroy(&batch);
+	return rc;
+}
+
+static uint32_t batch_requests()
+{
+	uint32_t requests = 0;
+
+	for (int i = 0; i < BATCH_NODES; i++) {
+		requests += fake_server_requests(batch_servers[i]);
+	}
+	return requests;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_batch_connect , "connect to two nodes which split the partitions" ) {
+
+	batch_servers[0] = fake_server_start_range("test", "BB900000000000C", 0, 2048);
+	batch_servers[1] = fake_server_start_range("test", "BB900000000000D", 2048, 4096);
+
+	for (int i = 0; i < BATCH_NODES; i++) {
+		assert_not_null( batch_servers[i] );
+		fake_server_add_namespace(batch_servers[i], "bar");
+	}
+
+	batch_as = fake_client_start(batch_servers, BATCH_NODES);
+	assert_not_null( batch_as );
+
+	as_error err;
+	as_status rc = AEROSPIKE_OK;
+
+	for (int64_t i = 1; i <= BATCH_KEYS && rc == AEROSPIKE_OK; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "batch", i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i);
+
+		rc = aerospike_key_put(batch_as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+		as_key_destroy(&key);
+	}
+	assert_int_eq( rc, AEROSPIKE_OK );
+}
+
+TEST( node_batch_get , "batch get returns every record at once" ) {
+
+	assert_not_null( batch_as );
+
+	as_batch batch;
+	batch_init_keys(&batch);
+
+	as_error err;
+	uint32_t sum = 0;
+	as_status rc = aerospike_batch_get(batch_as, &err, NULL, &batch, batch_get_sum, &sum);
+	as_batch_destroy(&batch);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( sum, BATCH_KEYS * (BATCH_KEYS + 1) / 2 );
+}
+
+TEST( node_batch_stream , "each record and each node completion is streamed" ) {
+
+	assert_not_null( batch_as );
+
+	batch_stream s;
+	as_status rc = batch_stream_run(&s, 0);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( s.found, BATCH_KEYS + 1 );
+	assert_int_eq( s.not_found, 1 );
+	assert_int_eq( s.sum, BATCH_KEYS * (BATCH_KEYS + 1) / 2 );
+	assert_int_eq( s.nodes, BATCH_NODES );
+	assert_int_eq( s.node_ok, BATCH_NODES );
+	assert_int_eq( s.node_keys, BATCH_KEYS + 1 );
+}
+
+TEST( node_batch_stream_first , "records from a fast node do not wait for a slow one" ) {
+
+	assert_not_null( batch_as );
+
+	fake_server_set_delay(batch_servers[0], BATCH_DELAY_MS);
+	batch_stream s;
+	as_status rc = batch_stream_run(&s, 0);
+	uint64_t end_ms = cf_getms();
+	fake_server_set_delay(batch_servers[0], 0);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( s.found, BATCH_KEYS + 1 );
+	assert_true( s.first_ms - s.begin_ms < BATCH_DELAY_MS );
+	assert_true( end_ms - s.begin_ms >= BATCH_DELAY_MS );
+}
+
+TEST( node_batch_stream_abort , "returning false stops the batch on every node" ) {
+
+	assert_not_null( batch_as );
+
+	fake_server_set_delay(batch_servers[0], BATCH_DELAY_MS);
+	batch_stream s;
+	as_status rc = batch_stream_run(&s, 1);
+	fake_server_set_delay(batch_servers[0], 0);
+
+	// Aborted sockets are closed, so the next batch starts clean.
+	batch_stream after;
+	as_status rc_after = batch_stream_run(&after, 0);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( s.found, 1 );
+	assert_int_eq( s.nodes, BATCH_NODES );
+	assert_int_eq( s.node_aborted, BATCH_NODES );
+	assert_int_eq( rc_after, AEROSPIKE_OK );
+	assert_int_eq( after.found, BATCH_KEYS + 1 );
+	assert_int_eq( after.node_ok, BATCH_NODES );
+}
+
+TEST( node_batch_large , "large batches return bin values from the response buffers" ) {
+
+	assert_not_null( batch_as );
+
+	as_error err;
+	as_status rc = AEROSPIKE_OK;
+
+	for (int64_t i = 1; i <= BATCH_LARGE_KEYS && rc == AEROSPIKE_OK; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "large", i);
+
+		char value[32];
+		sprintf(value, "value-%lld", (long long)i);
+
+		as_record rec;
+		as_record_inita(&rec, 2);
+		as_record_set_int64(&rec, "a", i);
+		as_record_set_str(&rec, "s", value);
+
+		rc = aerospike_key_put(batch_as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+		as_key_destroy(&key);
+	}
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	as_batch batch;
+	as_batch_init(&batch, BATCH_LARGE_KEYS);
+
+	for (uint32_t i = 0; i < BATCH_LARGE_KEYS; i++) {
+		as_key_init_int64(as_batch_keyat(&batch, i), "test", "large", i + 1);
+	}
+
+	uint32_t errors = 0;
+	as_status get_rc = aerospike_batch_get(batch_as, &err, NULL, &batch, batch_large_results, &errors);
+	uint32_t stream_errors = 0;
+	as_status stream_rc = aerospike_batch_get_stream(batch_as, &err, NULL, &batch, batch_large_record, NULL, &stream_errors);
+	as_batch_destroy(&batch);
+
+	assert_int_eq( get_rc, AEROSPIKE_OK );
+	assert_int_eq( errors, 0 );
+	assert_int_eq( stream_rc, AEROSPIKE_OK );
+	assert_int_eq( stream_errors, 0 );
+}
+
+TEST( node_batch_select , "batch select returns only the selected bins" ) {
+
+	assert_not_null( batch_as );
+
+	// Records were written by node_batch_large with bins "a" and "s".
+	as_batch batch;
+	as_batch_inita(&batch, BATCH_KEYS);
+
+	for (uint32_t i = 0; i < BATCH_KEYS; i++) {
+		as_key_init_int64(as_batch_keyat(&batch, i), "test", "large", i + 1);
+	}
+
+	const char * select[] = {"s", NULL};
+	const char * bad[] = {"a_bin_name_which_is_too_long", NULL};
+
+	as_error err;
+	uint32_t errors = 0;
+	as_status rc = aerospike_batch_select(batch_as, &err, NULL, &batch, select, batch_select_results, &errors);
+	as_status bad_rc = aerospike_batch_select(batch_as, &err, NULL, &batch, bad, batch_select_results, &errors);
+	as_batch_destroy(&batch);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( errors, 0 );
+	assert_int_eq( bad_rc, AEROSPIKE_ERR_PARAM );
+}
+
+TEST( node_batch_namespaces , "keys in several namespaces are read in one batch" ) {
+
+	assert_not_null( batch_as );
+
+	as_error err;
+	as_status put_rc = AEROSPIKE_OK;
+
+	for (int64_t i = 1; i <= BATCH_KEYS && put_rc == AEROSPIKE_OK; i++) {
+		as_key key;
+		as_key_init_int64(&key, "bar", "other", i);
+
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i + 100);
+
+		put_rc = aerospike_key_put(batch_as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+		as_key_destroy(&key);
+	}
+
+	as_batch batch;
+	as_batch_inita(&batch, BATCH_KEYS * 2);
+
+	for (uint32_t i = 0; i < BATCH_KEYS; i++) {
+		as_key_init_int64(as_batch_keyat(&batch, i * 2), "test", "batch", i + 1);
+		as_key_init_int64(as_batch_keyat(&batch, i * 2 + 1), "bar", "other", i + 1);
+	}
+
+	uint32_t requests = batch_requests();
+	uint32_t errors = 0;
+	as_status rc = aerospike_batch_get(batch_as, &err, NULL, &batch, batch_namespaces_results, &errors);
+	uint32_t sent = batch_requests() - requests;
+	as_batch_destroy(&batch);
+
+	assert_int_eq( put_rc, AEROSPIKE_OK );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( errors, 0 );
+
+	// One command per node and namespace.
+	assert_int_eq( sent, BATCH_NODES * 2 );
+}
+
+TEST( node_batch_retry , "keys of a failed node command are resent" ) {
+
+	assert_not_null( batch_as );
+
+	uint32_t requests = batch_requests();
+	batch_status s;
+	as_status rc = batch_get_busy(AS_POLICY_RETRY_ONCE, &s);
+	uint32_t sent = batch_requests() - requests;
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( s.ok, BATCH_KEYS );
+	assert_int_eq( s.not_found, 1 );
+	assert_int_eq( s.sum, BATCH_KEYS * (BATCH_KEYS + 1) / 2 );
+	assert_int_eq( sent, BATCH_NODES + 1 );
+}
+
+TEST( node_batch_slow , "keys of a node slower than the socket timeout are retried in time" ) {
+
+	assert_not_null( batch_as );
+
+	batch_status s;
+	memset(&s, 0, sizeof(batch_status));
+
+	as_policy_batch policy;
+	as_policy_batch_init(&policy);
+	policy.timeout = FAKE_STALL_MS * 2;
+	policy.socket_timeout = 100;
+	policy.retry = AS_POLICY_RETRY_ONCE;
+
+	as_batch batch;
+	batch_init_keys(&batch);
+
+	as_error err;
+	uint32_t requests = batch_requests();
+	fake_server_inject(batch_servers[0], FAKE_FAULT_STALL, 1);
+	uint64_t begin_ms = cf_getms();
+	as_status rc = aerospike_batch_get(batch_as, &err, &policy, &batch, batch_status_results, &s);
+	uint64_t elapsed_ms = cf_getms() - begin_ms;
+	uint32_t sent = batch_requests() - requests;
+	as_batch_destroy(&batch);
+
+	// The stalled command is given up on, not waited out.
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( s.ok, BATCH_KEYS );
+	assert_int_eq( s.not_found, 1 );
+	assert_true( elapsed_ms < FAKE_STALL_MS );
+	assert_int_eq( sent, BATCH_NODES + 1 );
+}
+
+TEST( node_batch_partial , "keys of a failed node command get its error" ) {
+
+	assert_not_null( batch_as );
+
+	batch_status s;
+	as_status rc = batch_get_busy(AS_POLICY_RETRY_NONE, &s);
+
+	// The other node's keys are still read.
+	assert_int_eq( rc, AEROSPIKE_ERR_DEVICE_OVERLOAD );
+	assert_true( s.ok > 0 );
+	assert_true( s.busy > 0 );
+	assert_int_eq( s.ok + s.not_found + s.busy, BATCH_KEYS + 1 );
+}
+
+TEST( node_batch_close , "disconnect" ) {
+
+	fake_client_close(batch_as);
+	batch_as = NULL;
+
+	for (int i = 0; i < BATCH_NODES; i++) {
+		if (batch_servers[i]) {
+			fake_server_stop(batch_servers[i]);
+			batch_servers[i] = NULL;
+		}
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_batch, "batch command tests" ) {
+	suite_add( node_batch_connect );
+	suite_add( node_batch_get );
+	suite_add( node_batch_stream );
+	suite_add( node_batch_stream_first );
+	suite_add( node_batch_stream_abort );
+	suite_add( node_batch_large );
+	suite_add( node_batch_select );
+	suite_add( node_batch_namespaces );
+	suite_add( node_batch_retry );
+	suite_add( node_batch_slow );
+	suite_add( node_batch_partial );
+	suite_add( node_batch_close );
+}
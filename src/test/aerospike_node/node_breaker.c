@@ -0,0 +1,289 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <pthread.h>
+#include <unistd.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define BREAKER_OPEN_MS 200
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+static fake_server * breaker_server = NULL;
+static aerospike * breaker_as = NULL;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static aerospike * breaker_connect(fake_server ** servers, int n_servers, uint32_t max_commands)
+{
+	as_config config;
+	fake_client_config(&config, servers, n_servers);
+	config.max_commands_per_node = max_commands;
+	config.breaker_error_percent = 50;
+	config.breaker_min_commands = 4;
+	config.breaker_open_ms = BREAKER_OPEN_MS;
+	return fake_client_connect(&config);
+}
+
+static as_status breaker_put(aerospike * client, int64_t k, int64_t a)
+{
+	as_policy_write policy;
+	as_policy_write_init(&policy);
+	policy.retry = AS_POLICY_RETRY_NONE;
+
+	as_key key;
+	as_key_init_int64(&key, "test", "breaker", k);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", a);
+
+	as_error err;
+	as_status rc = aerospike_key_put(client, &err, &policy, &key, &rec);
+	as_record_destroy(&rec);
+	as_key_destroy(&key);
+	return rc;
+}
+
+static as_status breaker_get(aerospike * client, int64_t k, int64_t * a)
+{
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.retry = AS_POLICY_RETRY_NONE;
+
+	as_key key;
+	as_key_init_int64(&key, "test", "breaker", k);
+
+	as_error err;
+	as_record * rec = NULL;
+	as_status rc = aerospike_key_get(client, &err, &policy, &key, &rec);
+
+	if (rc == AEROSPIKE_OK) {
+		*a = as_record_get_int64(rec, "a", -1);
+	}
+	as_record_destroy(rec);
+	as_key_destroy(&key);
+	return rc;
+}
+
+static void breaker_stats(aerospike * client, as_breaker_stats * stats)
+{
+	as_node * node = as_node_get_random(client->cluster);
+	as_node_get_breaker_stats(node, stats);
+	as_node_release(node);
+}
+
+// Fail puts with busy responses until the breaker opens.
+static as_status breaker_trip(aerospike * client, fake_server * server)
+{
+	as_status rc = AEROSPIKE_OK;
+	fake_server_inject(server, FAKE_FAULT_BUSY, 100);
+
+	for (int i = 0; i < 20 && rc != AEROSPIKE_ERR_CIRCUIT_OPEN; i++) {
+		rc = breaker_put(client, 1, i);
+	}
+	fake_server_inject(server, FAKE_FAULT_NONE, 0);
+	return rc;
+}
+
+static void * breaker_slow_put(void * udata)
+{
+	*(as_status*)udata = breaker_put(breaker_as, 2, 1);
+	return NULL;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_breaker_connect , "connect with the circuit breaker enabled" ) {
+
+	breaker_server = fake_server_start("test");
+	assert_not_null( breaker_server );
+
+	breaker_as = breaker_connect(&breaker_server, 1, 1);
+	assert_not_null( breaker_as );
+	assert_int_eq( breaker_put(breaker_as, 1, 0), AEROSPIKE_OK );
+}
+
+TEST( node_breaker_open , "repeated failures open the breaker and commands fail fast" ) {
+
+	assert_not_null( breaker_as );
+
+	as_status rc = breaker_trip(breaker_as, breaker_server);
+
+	uint32_t requests = fake_server_requests(breaker_server);
+	as_status rejected = breaker_put(breaker_as, 1, 0);
+	uint32_t sent = fake_server_requests(breaker_server) - requests;
+
+	as_breaker_stats stats;
+	breaker_stats(breaker_as, &stats);
+
+	assert_int_eq( rc, AEROSPIKE_ERR_CIRCUIT_OPEN );
+	assert_int_eq( rejected, AEROSPIKE_ERR_CIRCUIT_OPEN );
+	assert_int_eq( sent, 0 );
+	assert_int_eq( stats.state, AS_BREAKER_OPEN );
+	assert_int_eq( stats.opened, 1 );
+	assert_true( stats.rejected >= 2 );
+}
+
+TEST( node_breaker_probe , "a failed probe reopens the breaker and a good one closes it" ) {
+
+	assert_not_null( breaker_as );
+
+	// The retry after the failed probe finds the breaker open again.
+	usleep((BREAKER_OPEN_MS + 50) * 1000);
+	uint32_t requests = fake_server_requests(breaker_server);
+	fake_server_inject(breaker_server, FAKE_FAULT_BUSY, 1);
+	as_status failed_probe = breaker_put(breaker_as, 1, 0);
+	fake_server_inject(breaker_server, FAKE_FAULT_NONE, 0);
+	uint32_t probes = fake_server_requests(breaker_server) - requests;
+
+	as_breaker_stats reopened;
+	breaker_stats(breaker_as, &reopened);
+
+	usleep((BREAKER_OPEN_MS + 50) * 1000);
+	as_status probe = breaker_put(breaker_as, 1, 7);
+	as_status after = breaker_put(breaker_as, 1, 8);
+
+	as_breaker_stats closed;
+	breaker_stats(breaker_as, &closed);
+
+	assert_int_eq( failed_probe, AEROSPIKE_ERR_CIRCUIT_OPEN );
+	assert_int_eq( probes, 1 );
+	assert_int_eq( reopened.state, AS_BREAKER_OPEN );
+	assert_int_eq( reopened.opened, 2 );
+	assert_int_eq( probe, AEROSPIKE_OK );
+	assert_int_eq( after, AEROSPIKE_OK );
+	assert_int_eq( closed.state, AS_BREAKER_CLOSED );
+}
+
+TEST( node_breaker_max_commands , "commands beyond the per-node limit fail fast" ) {
+
+	assert_not_null( breaker_as );
+
+	as_breaker_stats before;
+	breaker_stats(breaker_as, &before);
+
+	fake_server_set_delay(breaker_server, 200);
+	as_status slow = AEROSPIKE_ERR_CLIENT;
+	pthread_t thread;
+	pthread_create(&thread, NULL, breaker_slow_put, &slow);
+	usleep(50 * 1000);
+
+	as_status throttled = breaker_put(breaker_as, 3, 1);
+	pthread_join(thread, NULL);
+	fake_server_set_delay(breaker_server, 0);
+
+	as_breaker_stats after;
+	breaker_stats(breaker_as, &after);
+
+	assert_int_eq( slow, AEROSPIKE_OK );
+	assert_int_eq( throttled, AEROSPIKE_ERR_MAX_COMMANDS );
+	assert_int_eq( after.throttled - before.throttled, 1 );
+	assert_int_eq( after.in_flight, 0 );
+	assert_int_eq( after.state, AS_BREAKER_CLOSED );
+}
+
+TEST( node_breaker_divert , "reads from a node with an open breaker go to the prole" ) {
+
+	fake_server * master = fake_server_start_node("test", "BB9000000000006", true);
+	fake_server * prole = fake_server_start_node("test", "BB9000000000007", false);
+	assert_not_null( master );
+	assert_not_null( prole );
+
+	fake_server * both[2] = {master, prole};
+	aerospike * client = breaker_connect(both, 2, 0);
+	aerospike * prole_client = breaker_connect(&prole, 1, 0);
+
+	as_status rc = AEROSPIKE_ERR_CLIENT;
+	as_status tripped = AEROSPIKE_OK;
+	int64_t a = -1;
+
+	if (client && prole_client) {
+		// Servers do not replicate, so each copy has its own value.
+		rc = breaker_put(client, 4, 1);
+
+		if (rc == AEROSPIKE_OK) {
+			rc = breaker_put(prole_client, 4, 2);
+		}
+		tripped = breaker_trip(client, master);
+
+		if (rc == AEROSPIKE_OK) {
+			rc = breaker_get(client, 4, &a);
+		}
+	}
+
+	if (prole_client) {
+		fake_client_close(prole_client);
+	}
+
+	if (client) {
+		fake_client_close(client);
+	}
+	fake_server_stop(prole);
+	fake_server_stop(master);
+
+	assert_int_eq( tripped, AEROSPIKE_ERR_CIRCUIT_OPEN );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 2 );
+}
+
+TEST( node_breaker_close , "disconnect" ) {
+
+	if (breaker_as) {
+		fake_client_close(breaker_as);
+		breaker_as = NULL;
+	}
+
+	if (breaker_server) {
+		fake_server_stop(breaker_server);
+		breaker_server = NULL;
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_breaker, "circuit breaker and admission control tests" ) {
+	suite_add( node_breaker_connect );
+	suite_add( node_breaker_open );
+	suite_add( node_breaker_probe );
+	suite_add( node_breaker_max_commands );
+	suite_add( node_breaker_divert );
+	suite_add( node_breaker_close );
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <pthread.h>
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_command_buffer.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void * command_buffer_worker(void * udata)
+{
+	// Runs on a fresh thread, so the arena starts empty.
+	uint8_t * a = as_command_init(100);
+	memset(a, 1, 100);
+	as_command_free(a, 100);
+
+	uint8_t * b = as_command_init(200);
+	memset(b, 2, 200);
+	*(bool*)udata = a == b;
+	as_command_free(b, 200);
+	return NULL;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_command_buffer_reuse , "released command buffers are reused by the same thread" ) {
+
+	as_command_buffer_stats before;
+	as_command_buffer_get_stats(&before);
+
+	bool same = false;
+	pthread_t thread;
+	pthread_create(&thread, NULL, command_buffer_worker, &same);
+	pthread_join(thread, NULL);
+
+	as_command_buffer_stats after;
+	as_command_buffer_get_stats(&after);
+
+	// Stats of the exited thread are kept.  Other client threads may add to
+	// the totals concurrently.
+	assert_true( same );
+	assert_true( after.allocated - before.allocated >= AS_STACK_BUF_SIZE );
+	assert_true( after.reused - before.reused >= 200 );
+}
+
+TEST( node_command_buffer_nested , "nested command buffers do not overlap" ) {
+
+	uint8_t * bufs[6];
+
+	// More buffers than arena slots, so the last ones come from the heap.
+	for (int i = 0; i < 6; i++) {
+		bufs[i] = as_command_init(64);
+		memset(bufs[i], i, 64);
+	}
+
+	bool distinct = true;
+
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 64; j++) {
+			if (bufs[i][j] != i) {
+				distinct = false;
+			}
+		}
+	}
+
+	for (int i = 5; i >= 0; i--) {
+		as_command_free(bufs[i], 64);
+	}
+	assert_true( distinct );
+}
+
+TEST( node_command_buffer_shrink , "huge command buffers are shrunk on release" ) {
+
+	as_command_buffer_stats before;
+	as_command_buffer_get_stats(&before);
+
+	size_t size = 4 * 1024 * 1024;
+	uint8_t * buf = as_command_init(size);
+	memset(buf, 0, size);
+	as_command_free(buf, size);
+
+	as_command_buffer_stats after;
+	as_command_buffer_get_stats(&after);
+
+	assert_true( after.trimmed - before.trimmed >= size - AS_STACK_BUF_SIZE );
+}
+
+TEST( node_command_buffer_put , "puts and gets build commands in arena buffers" ) {
+
+	as_command_buffer_stats before;
+	as_command_buffer_get_stats(&before);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "arena", 1);
+
+	as_error err;
+	as_status rc = AEROSPIKE_OK;
+
+	for (int i = 0; i < 10 && rc == AEROSPIKE_OK; i++) {
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i);
+		rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+	}
+
+	as_record * rec = NULL;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	}
+	int64_t a = rec ? as_record_get_int64(rec, "a", -1) : -1;
+	as_record_destroy(rec);
+	as_key_destroy(&key);
+
+	as_command_buffer_stats after;
+	as_command_buffer_get_stats(&after);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 9 );
+	assert_true( after.reused > before.reused );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_command_buffer, "command buffer arena tests" ) {
+	suite_add( node_command_buffer_reuse );
+	suite_add( node_command_buffer_nested );
+	suite_add( node_command_buffer_shrink );
+	suite_add( node_command_buffer_put );
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <aerospike/as_cluster.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct epoch_reader_s {
+	ck_epoch_record_t* record;
+	volatile bool entered;
+	volatile bool leave;
+} epoch_reader;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void epoch_released(void * data)
+{
+	(*(int*)data)++;
+}
+
+static void * epoch_read(void * udata)
+{
+	epoch_reader * reader = udata;
+	reader->record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, reader->record);
+	reader->entered = true;
+
+	while (! reader->leave) {
+		usleep(1000);
+	}
+	ck_epoch_end(&as_cluster_epoch, reader->record);
+	return NULL;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_epoch_defer , "deferred releases wait for readers in epoch sections" ) {
+
+	// Stand-in cluster with its own tend record.
+	as_cluster cluster;
+	memset(&cluster, 0, sizeof(cluster));
+	as_cluster_epoch_record();
+	cluster.gc = cf_malloc(sizeof(ck_epoch_record_t));
+	ck_epoch_register(&as_cluster_epoch, cluster.gc);
+
+	epoch_reader reader = {NULL, false, false};
+	pthread_t thread;
+	pthread_create(&thread, NULL, epoch_read, &reader);
+
+	while (! reader.entered) {
+		usleep(1000);
+	}
+
+	int released = 0;
+	as_cluster_defer(&cluster, &released, epoch_released);
+
+	for (int i = 0; i < 10; i++) {
+		ck_epoch_poll(&as_cluster_epoch, cluster.gc);
+	}
+	int while_reading = released;
+
+	reader.leave = true;
+	pthread_join(thread, NULL);
+	ck_epoch_barrier(&as_cluster_epoch, cluster.gc);
+	ck_epoch_unregister(&as_cluster_epoch, cluster.gc);
+
+	assert_int_eq( while_reading, 0 );
+	assert_int_eq( released, 1 );
+}
+
+TEST( node_epoch_record , "each thread has its own epoch record" ) {
+
+	ck_epoch_record_t * first = as_cluster_epoch_record();
+	ck_epoch_record_t * again = as_cluster_epoch_record();
+
+	epoch_reader reader = {NULL, false, true};
+	pthread_t thread;
+	pthread_create(&thread, NULL, epoch_read, &reader);
+	pthread_join(thread, NULL);
+
+	assert_not_null( first );
+	assert_true( first == again );
+	assert_not_null( reader.record );
+	assert_true( reader.record != first );
+	assert_int_eq( first->active, 0 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_epoch, "epoch reclamation tests" ) {
+	suite_add( node_epoch_defer );
+	suite_add( node_epoch_record );
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+static fake_server * hedge_master = NULL;
+static fake_server * hedge_prole = NULL;
+static aerospike * hedge_as = NULL;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_status hedge_put(aerospike * as, as_key * key, int64_t a)
+{
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", a);
+
+	as_error err;
+	as_status rc = aerospike_key_put(as, &err, NULL, key, &rec);
+	as_record_destroy(&rec);
+	return rc;
+}
+
+static int64_t hedge_get(as_key * key, uint32_t hedge_delay_us)
+{
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.hedge_delay_us = hedge_delay_us;
+
+	as_error err;
+	as_record * rec = NULL;
+	int64_t a = -1;
+
+	if (aerospike_key_get(hedge_as, &err, &policy, key, &rec) == AEROSPIKE_OK) {
+		a = as_record_get_int64(rec, "a", -1);
+	}
+	as_record_destroy(rec);
+	return a;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_hedge_connect , "connect to a master and a prole node" ) {
+
+	hedge_master = fake_server_start_node("test", "BB9000000000002", true);
+	hedge_prole = fake_server_start_node("test", "BB9000000000003", false);
+	assert_not_null( hedge_master );
+	assert_not_null( hedge_prole );
+
+	fake_server * both[2] = {hedge_master, hedge_prole};
+	hedge_as = fake_client_start(both, 2);
+	assert_not_null( hedge_as );
+
+	// Servers do not replicate, so give each copy its own value to tell which
+	// node answered.  A client that only knows the prole sends writes to it.
+	as_key key;
+	as_key_init_int64(&key, "test", "hedge", 1);
+	as_status rc = hedge_put(hedge_as, &key, 1);
+
+	fake_server * prole_only[1] = {hedge_prole};
+	aerospike * prole_as = fake_client_start(prole_only, 1);
+
+	if (rc == AEROSPIKE_OK && prole_as) {
+		rc = hedge_put(prole_as, &key, 2);
+	}
+
+	if (prole_as) {
+		fake_client_close(prole_as);
+	}
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+}
+
+TEST( node_hedge_fast_master , "master answering within the hedge delay is not hedged" ) {
+
+	assert_not_null( hedge_as );
+
+	as_hedge_stats before;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &before);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "hedge", 1);
+	int64_t a = hedge_get(&key, 100 * 1000);
+	as_key_destroy(&key);
+
+	as_hedge_stats after;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &after);
+
+	assert_int_eq( a, 1 );
+	assert_int_eq( after.issued - before.issued, 0 );
+}
+
+TEST( node_hedge_slow_master , "slow master is hedged to the prole, which wins" ) {
+
+	assert_not_null( hedge_as );
+
+	as_hedge_stats before;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &before);
+	fake_server_set_delay(hedge_master, 300);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "hedge", 1);
+	uint64_t begin = cf_getms();
+	int64_t a = hedge_get(&key, 5 * 1000);
+	uint64_t elapsed = cf_getms() - begin;
+
+	// Without hedging, the master's answer is awaited.
+	int64_t unhedged = hedge_get(&key, 0);
+	fake_server_set_delay(hedge_master, 0);
+	as_key_destroy(&key);
+
+	as_hedge_stats after;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &after);
+
+	assert_int_eq( a, 2 );
+	assert_true( elapsed < 250 );
+	assert_int_eq( unhedged, 1 );
+	assert_int_eq( after.issued - before.issued, 1 );
+	assert_int_eq( after.won - before.won, 1 );
+}
+
+TEST( node_hedge_open_prole , "slow master is not hedged to a prole whose breaker is open" ) {
+
+	assert_not_null( hedge_as );
+
+	as_node * prole = as_node_get_by_name(hedge_as->cluster, "BB9000000000003");
+	assert_not_null( prole );
+
+	// Open the prole's breaker for longer than the test runs.
+	ck_pr_store_64(&prole->breaker_open_until, cf_getms() + 60 * 1000);
+	ck_pr_store_32(&prole->breaker_state, AS_BREAKER_OPEN);
+
+	as_hedge_stats before;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &before);
+	fake_server_set_delay(hedge_master, 100);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "hedge", 1);
+	int64_t a = hedge_get(&key, 5 * 1000);
+	fake_server_set_delay(hedge_master, 0);
+	as_key_destroy(&key);
+
+	as_breaker_stats stats;
+	as_node_get_breaker_stats(prole, &stats);
+	ck_pr_store_32(&prole->breaker_state, AS_BREAKER_CLOSED);
+	as_node_release(prole);
+
+	as_hedge_stats after;
+	as_cluster_get_hedge_stats(hedge_as->cluster, &after);
+
+	assert_int_eq( a, 1 );
+	assert_int_eq( after.issued - before.issued, 0 );
+	assert_true( stats.rejected >= 1 );
+}
+
+TEST( node_hedge_close , "disconnect from the master and prole nodes" ) {
+
+	if (hedge_as) {
+		fake_client_close(hedge_as);
+		hedge_as = NULL;
+	}
+
+	if (hedge_prole) {
+		fake_server_stop(hedge_prole);
+		hedge_prole = NULL;
+	}
+
+	if (hedge_master) {
+		fake_server_stop(hedge_master);
+		hedge_master = NULL;
+	}
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_hedge, "hedged read tests" ) {
+	suite_add( node_hedge_connect );
+	suite_add( node_hedge_fast_master );
+	suite_add( node_hedge_slow_master );
+	suite_add( node_hedge_open_prole );
+	suite_add( node_hedge_close );
+}
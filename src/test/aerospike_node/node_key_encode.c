@@ -0,0 +1,190 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_record.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+// Write key fields of both keys and compare.
+static bool key_encode_same(as_key * plain, as_key * encoded, as_policy_key policy)
+{
+	uint16_t n1, n2;
+	size_t s1 = as_command_key_size(policy, plain, &n1);
+	size_t s2 = as_command_key_size(policy, encoded, &n2);
+
+	if (s1 != s2 || n1 != n2) {
+		return false;
+	}
+
+	uint8_t b1[512];
+	uint8_t b2[512];
+	uint8_t * e1 = as_command_write_key(b1, policy, plain);
+	uint8_t * e2 = as_command_write_key(b2, policy, encoded);
+	return e1 - b1 == e2 - b2 && e1 - b1 == (ptrdiff_t)(s1 - AS_HEADER_SIZE) && memcmp(b1, b2, e1 - b1) == 0;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_key_encode_fields , "encoded keys write the same fields as plain keys" ) {
+
+	as_error err;
+	as_key plain;
+	as_key digest;
+	as_key send;
+	as_key_init_str(&plain, "test", "demo", "encoded-key");
+	as_key_init_str(&digest, "test", "demo", "encoded-key");
+	as_key_init_str(&send, "test", "demo", "encoded-key");
+	as_key_digest(&plain);
+
+	as_status rc1 = as_key_encode(&err, &digest, AS_POLICY_KEY_DIGEST);
+	as_status rc2 = as_key_encode(&err, &send, AS_POLICY_KEY_SEND);
+
+	bool digest_same = key_encode_same(&plain, &digest, AS_POLICY_KEY_DIGEST);
+	bool send_same = key_encode_same(&plain, &send, AS_POLICY_KEY_SEND);
+
+	// A command with another key policy encodes the key itself.
+	bool other_same = key_encode_same(&plain, &digest, AS_POLICY_KEY_SEND);
+
+	as_key_destroy(&plain);
+	as_key_destroy(&digest);
+	as_key_destroy(&send);
+
+	assert_int_eq( rc1, AEROSPIKE_OK );
+	assert_int_eq( rc2, AEROSPIKE_OK );
+	assert_true( digest_same );
+	assert_true( send_same );
+	assert_true( other_same );
+}
+
+TEST( node_key_encode_copy , "encoded keys copied by value are destroyed independently" ) {
+
+	as_error err;
+	as_key plain;
+	as_key key;
+	as_key_init_int64(&plain, "test", "demo", 161);
+	as_key_init_int64(&key, "test", "demo", 161);
+	as_key_digest(&plain);
+	as_status rc = as_key_encode(&err, &key, AS_POLICY_KEY_SEND);
+
+	as_key copy = key;
+	as_key_destroy(&key);
+
+	bool copy_encoded = copy._fields_size > 0;
+	bool copy_same = key_encode_same(&plain, &copy, AS_POLICY_KEY_SEND);
+
+	as_key_destroy(&copy);
+	as_key_destroy(&plain);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( copy_encoded );
+	assert_true( copy_same );
+}
+
+TEST( node_key_encode_large , "keys too large to cache are encoded per command" ) {
+
+	char value[AS_KEY_FIELDS_MAX_SIZE + 1];
+	memset(value, 'k', sizeof(value) - 1);
+	value[sizeof(value) - 1] = '\0';
+
+	as_error err;
+	as_key plain;
+	as_key key;
+	as_key_init_str(&plain, "test", "demo", value);
+	as_key_init_str(&key, "test", "demo", value);
+	as_key_digest(&plain);
+
+	as_status rc1 = as_key_encode(&err, &key, AS_POLICY_KEY_SEND);
+	bool send_encoded = key._fields_size > 0;
+	bool send_same = key_encode_same(&plain, &key, AS_POLICY_KEY_SEND);
+
+	// The same key still fits without the user key field.
+	as_status rc2 = as_key_encode(&err, &key, AS_POLICY_KEY_DIGEST);
+	bool digest_encoded = key._fields_size > 0;
+	bool digest_same = key_encode_same(&plain, &key, AS_POLICY_KEY_DIGEST);
+
+	as_key_destroy(&plain);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc1, AEROSPIKE_OK );
+	assert_false( send_encoded );
+	assert_true( send_same );
+	assert_int_eq( rc2, AEROSPIKE_OK );
+	assert_true( digest_encoded );
+	assert_true( digest_same );
+}
+
+TEST( node_key_encode_commands , "encoded keys read and write records" ) {
+
+	as_error err;
+	as_key key;
+	as_key_init_int64(&key, "test", "demo", 160);
+	as_status rc = as_key_encode(&err, &key, AS_POLICY_KEY_DIGEST);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", 16);
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+	}
+	as_record_destroy(&rec);
+
+	int64_t a = -1;
+
+	for (int i = 0; i < 3 && rc == AEROSPIKE_OK; i++) {
+		as_record * got = NULL;
+		rc = aerospike_key_get(as, &err, NULL, &key, &got);
+
+		if (rc == AEROSPIKE_OK) {
+			a = as_record_get_int64(got, "a", -1);
+		}
+		as_record_destroy(got);
+	}
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 16 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_key_encode, "encoded key tests" ) {
+	suite_add( node_key_encode_fields );
+	suite_add( node_key_encode_copy );
+	suite_add( node_key_encode_large );
+	suite_add( node_key_encode_commands );
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_key.h>
+#include <aerospike/as_partition.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_namespace_intern , "namespaces intern to stable ids" ) {
+
+	uint32_t test = as_namespace_intern("test", 4);
+	uint32_t again = as_namespace_intern("test", 4);
+	uint32_t prefix = as_namespace_intern("testing", 4);
+	uint32_t other = as_namespace_intern("namespace_intern", 16);
+
+	char longest[AS_MAX_NAMESPACE_SIZE];
+	memset(longest, 'n', sizeof(longest));
+
+	assert_true( test > 0 && test < AS_NAMESPACE_IDS );
+	assert_int_eq( again, test );
+	assert_int_eq( prefix, test );
+	assert_true( other > 0 && other != test );
+	assert_int_eq( as_namespace_intern("", 0), 0 );
+	assert_int_eq( as_namespace_intern(longest, sizeof(longest)), 0 );
+	assert_true( as_namespace_intern(longest, sizeof(longest) - 1) > 0 );
+}
+
+TEST( node_namespace_key , "key init caches namespace id and lengths" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "demo", 1);
+
+	uint16_t n_fields;
+	size_t cached = as_command_key_size(AS_POLICY_KEY_DIGEST, &key, &n_fields);
+
+	// Parsed keys carry no cached values and are sized by string.
+	as_key parsed = key;
+	parsed._ns_id = 0;
+	parsed._ns_len = 0;
+	size_t computed = as_command_key_size(AS_POLICY_KEY_DIGEST, &parsed, &n_fields);
+
+	assert_int_eq( key._ns_id, as_namespace_intern("test", 4) );
+	assert_int_eq( key._ns_len, 4 );
+	assert_int_eq( key._set_len, 4 );
+	assert_int_eq( cached, computed );
+	assert_null( as_key_init_int64(&key, "", "demo", 1) );
+}
+
+TEST( node_namespace_route , "keys route by namespace id as by namespace string" ) {
+
+	as_cluster * cluster = as->cluster;
+	as_partition_tables * tables = as_partition_tables_reserve(cluster);
+	as_partition_table * by_name = as_partition_tables_get(tables, "test");
+	as_partition_table * by_id = as_partition_tables_get_id(tables, "test", as_namespace_intern("test", 4));
+	as_partition_table * missing = as_partition_tables_get_id(tables, "namespace_intern",
+		as_namespace_intern("namespace_intern", 16));
+	as_partition_tables_release(tables);
+
+	bool same = true;
+
+	for (int64_t i = 0; i < 64; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "demo", i);
+		as_key_digest(&key);
+
+		as_node * n1 = as_node_get_reserved(cluster, key.ns, key._ns_id, (const cf_digest*)key.digest.value, true, AS_POLICY_REPLICA_MASTER);
+		as_node * n2 = as_node_get_reserved(cluster, key.ns, 0, (const cf_digest*)key.digest.value, true, AS_POLICY_REPLICA_MASTER);
+
+		if (n1 != n2) {
+			same = false;
+		}
+		as_node_release(n1);
+		as_node_release(n2);
+		as_key_destroy(&key);
+	}
+
+	assert_not_null( by_name );
+	assert_true( by_id == by_name );
+	assert_null( missing );
+	assert_true( same );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_namespace, "namespace interning tests" ) {
+	suite_add( node_namespace_intern );
+	suite_add( node_namespace_key );
+	suite_add( node_namespace_route );
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_partition.h>
+#include <citrusleaf/alloc.h>
+#include <citrusleaf/cf_b64.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define MAP_PARTITIONS 64
+#define MAP_BITMAP_SIZE (MAP_PARTITIONS / 8)
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct map_cluster_s {
+	as_cluster cluster;
+	as_node nodes[2];
+} map_cluster;
+
+/******************************************************************************
+ * FUNCTION DECLARATIONS
+ *****************************************************************************/
+
+bool
+as_partition_tables_update(as_cluster* cluster, as_node* node, char* buf, bool master);
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void map_init(map_cluster * mc)
+{
+	memset(mc, 0, sizeof(map_cluster));
+	mc->cluster.n_partitions = MAP_PARTITIONS;
+
+	for (int i = 0; i < 2; i++) {
+		mc->nodes[i].ref_count = 1u << 30;
+		mc->nodes[i].active = true;
+	}
+
+	as_partition_tables * tables = as_partition_tables_create(1);
+	size_t len = sizeof(as_partition_table) + sizeof(as_partition) * MAP_PARTITIONS;
+	as_partition_table * table = cf_malloc(len);
+	memset(table, 0, len);
+	strcpy(table->ns, "map");
+	table->ns_id = as_namespace_intern(table->ns, strlen(table->ns));
+	table->size = MAP_PARTITIONS;
+	tables->array[0] = table;
+	tables->index[table->ns_id] = table;
+	tables->size = 1;
+	mc->cluster.partition_tables = tables;
+}
+
+static void map_destroy(map_cluster * mc)
+{
+	for (int i = 0; i < 2; i++) {
+		as_partition_bitmaps_destroy(&mc->nodes[i]);
+	}
+	as_partition_tables * tables = mc->cluster.partition_tables;
+	cf_free(tables->array[0]);
+	cf_free(tables);
+}
+
+// Apply a master map owning partitions [begin, end) except skip.
+static void map_apply(map_cluster * mc, int node, int begin, int end, int skip)
+{
+	uint8_t bitmap[MAP_BITMAP_SIZE];
+	memset(bitmap, 0, sizeof(bitmap));
+
+	for (int i = begin; i < end; i++) {
+		if (i != skip) {
+			bitmap[i >> 3] |= 0x80 >> (i & 7);
+		}
+	}
+
+	char buf[64];
+	strcpy(buf, "map:");
+	cf_b64_encode(bitmap, MAP_BITMAP_SIZE, buf + 4);
+	buf[4 + cf_b64_encoded_len(MAP_BITMAP_SIZE)] = 0;
+	as_partition_tables_update(&mc->cluster, &mc->nodes[node], buf, true);
+}
+
+static as_node * map_master(map_cluster * mc, int id)
+{
+	return mc->cluster.partition_tables->array[0]->partitions[id].master;
+}
+
+static int map_count(map_cluster * mc, as_node * node)
+{
+	int count = 0;
+
+	for (int i = 0; i < MAP_PARTITIONS; i++) {
+		if (map_master(mc, i) == node) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_partition_map_b64 , "base64 decode round trips every tail length" ) {
+
+	bool same = true;
+	uint32_t sizes_ok = 0;
+
+	for (uint32_t n = 1; n <= 20; n++) {
+		uint8_t in[20];
+		uint8_t out[24];
+		char b64[32];
+
+		for (uint32_t i = 0; i < n; i++) {
+			in[i] = (uint8_t)(i * 37 + n);
+		}
+		cf_b64_encode(in, n, b64);
+
+		uint32_t size = 0;
+		cf_b64_decode(b64, cf_b64_encoded_len(n), out, &size);
+
+		if (size == n) {
+			sizes_ok++;
+		}
+
+		if (memcmp(in, out, n) != 0) {
+			same = false;
+		}
+	}
+
+	assert_int_eq( sizes_ok, 20 );
+	assert_true( same );
+}
+
+TEST( node_partition_map_diff , "unchanged bitmaps leave the table alone and changes apply" ) {
+
+	map_cluster mc;
+	map_init(&mc);
+	as_node * a = &mc.nodes[0];
+	as_node * b = &mc.nodes[1];
+
+	map_apply(&mc, 0, 0, MAP_PARTITIONS, -1);
+	int all = map_count(&mc, a);
+
+	map_apply(&mc, 0, 0, MAP_PARTITIONS, 3);
+	as_node * dropped = map_master(&mc, 3);
+	int rest = map_count(&mc, a);
+
+	map_apply(&mc, 1, 3, 4, -1);
+	as_node * moved = map_master(&mc, 3);
+
+	map_destroy(&mc);
+
+	assert_int_eq( all, MAP_PARTITIONS );
+	assert_null( dropped );
+	assert_int_eq( rest, MAP_PARTITIONS - 1 );
+	assert_true( moved == b );
+}
+
+TEST( node_partition_map_takeover , "a node whose partition was taken reclaims it on its next update" ) {
+
+	map_cluster mc;
+	map_init(&mc);
+	as_node * a = &mc.nodes[0];
+	as_node * b = &mc.nodes[1];
+
+	map_apply(&mc, 0, 0, MAP_PARTITIONS, -1);
+	a->partition_generation = 7;
+
+	// Both nodes claim partition 5 during a migration.
+	map_apply(&mc, 1, 5, 6, -1);
+	as_node * taken = map_master(&mc, 5);
+	uint32_t generation = a->partition_generation;
+
+	map_apply(&mc, 0, 0, MAP_PARTITIONS, -1);
+	as_node * reclaimed = map_master(&mc, 5);
+
+	map_apply(&mc, 1, 5, 6, -1);
+	as_node * again = map_master(&mc, 5);
+	int others = map_count(&mc, a);
+
+	map_destroy(&mc);
+
+	assert_true( taken == b );
+	assert_int_eq( generation, (uint32_t)-1 );
+	assert_true( reclaimed == a );
+	assert_true( again == b );
+	assert_int_eq( others, MAP_PARTITIONS - 1 );
+}
+
+TEST( node_partition_map_route , "routing inside an epoch section does not reserve the node" ) {
+
+	map_cluster mc;
+	map_init(&mc);
+	as_node * a = &mc.nodes[0];
+	map_apply(&mc, 0, 0, MAP_PARTITIONS, -1);
+
+	cf_digest digest;
+	memset(&digest, 0, sizeof(digest));
+	uint32_t before = a->ref_count;
+
+	ck_epoch_record_t * record = as_cluster_epoch_record();
+	ck_epoch_begin(&as_cluster_epoch, record);
+	as_node * routed = as_node_get(&mc.cluster, "map", 0, &digest, true, AS_POLICY_REPLICA_MASTER);
+	uint32_t during = a->ref_count;
+	ck_epoch_end(&as_cluster_epoch, record);
+
+	as_node * reserved = as_node_get_reserved(&mc.cluster, "map", 0, &digest, true, AS_POLICY_REPLICA_MASTER);
+	uint32_t held = a->ref_count;
+	as_node_release(reserved);
+
+	map_destroy(&mc);
+
+	assert_true( routed == a );
+	assert_int_eq( during, before );
+	assert_true( reserved == a );
+	assert_int_eq( held, before + 1 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_partition_map, "partition map update tests" ) {
+	suite_add( node_partition_map_b64 );
+	suite_add( node_partition_map_diff );
+	suite_add( node_partition_map_takeover );
+	suite_add( node_partition_map_route );
+}
@@ -0,0 +1,444 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_conn_pool.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_node.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+extern fake_server * g_fake_server;
+
+/******************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct node_pool_wait_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool done;
+	as_status status;
+	int64_t a;
+} node_pool_wait;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void * node_pool_worker(void * udata)
+{
+	as_conn_pool * pool = udata;
+
+	for (int i = 0; i < 100000; i++) {
+		int fd;
+
+		if (as_conn_pool_get(pool, 0, &fd)) {
+			as_conn_pool_put(pool, fd);
+		}
+	}
+	return NULL;
+}
+
+static void node_pool_listener(as_error * err, as_record * rec, void * udata)
+{
+	node_pool_wait * w = udata;
+	pthread_mutex_lock(&w->lock);
+	w->status = err ? err->code : AEROSPIKE_OK;
+	w->a = rec ? as_record_get_int64(rec, "a", -1) : -1;
+	w->done = true;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static aerospike * node_pool_connect(bool thread_conn_cache, uint32_t min_conns)
+{
+	as_config config;
+	fake_client_config(&config, &g_fake_server, 1);
+	config.thread_conn_cache = thread_conn_cache;
+	config.min_conns_per_node = min_conns;
+	return fake_client_connect(&config);
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_pool_bounds , "pool is LIFO and holds at most capacity sockets" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 3);
+
+	int fd = -1;
+	assert_false( as_conn_pool_get(&pool, 0, &fd) );
+
+	assert_true( as_conn_pool_put(&pool, 10) );
+	assert_true( as_conn_pool_put(&pool, 11) );
+	assert_true( as_conn_pool_put(&pool, 12) );
+	assert_false( as_conn_pool_put(&pool, 13) );
+
+	assert_true( as_conn_pool_get(&pool, 0, &fd) );
+	assert_int_eq( fd, 12 );
+	assert_true( as_conn_pool_put(&pool, 14) );
+
+	int sum = 0;
+
+	while (as_conn_pool_get(&pool, 0, &fd)) {
+		sum += fd;
+	}
+	assert_int_eq( sum, 10 + 11 + 14 );
+
+	as_conn_pool_destroy(&pool);
+}
+
+TEST( node_pool_threads , "concurrent get/put keeps every socket" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 16);
+
+	for (int i = 0; i < 8; i++) {
+		as_conn_pool_put(&pool, 100 + i);
+	}
+
+	pthread_t threads[8];
+
+	for (int i = 0; i < 8; i++) {
+		pthread_create(&threads[i], NULL, node_pool_worker, &pool);
+	}
+
+	for (int i = 0; i < 8; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	int fd;
+	int count = 0;
+	int sum = 0;
+
+	while (as_conn_pool_get(&pool, 0, &fd)) {
+		count++;
+		sum += fd;
+	}
+
+	// Pool holds integers, not sockets, so nothing is left to close.
+	as_conn_pool_destroy(&pool);
+
+	assert_int_eq( count, 8 );
+	assert_int_eq( sum, 8 * 100 + 28 );
+}
+
+TEST( node_pool_trim , "tend trim closes stale sockets but never empties the pool" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 4);
+
+	for (int i = 0; i < 3; i++) {
+		as_conn_pool_put(&pool, socket(AF_INET, SOCK_STREAM, 0));
+	}
+
+	usleep(30 * 1000);
+
+	uint32_t idle;
+	uint32_t closed = as_conn_pool_trim(&pool, 15, 0, &idle);
+
+	// Once a fresh socket is pooled, the last stale socket can go too.
+	int fresh = socket(AF_INET, SOCK_STREAM, 0);
+	as_conn_pool_put(&pool, fresh);
+
+	uint32_t idle2;
+	uint32_t closed2 = as_conn_pool_trim(&pool, 15, 0, &idle2);
+
+	int fd = -1;
+	as_conn_pool_get(&pool, 0, &fd);
+	close(fd);
+	as_conn_pool_destroy(&pool);
+
+	assert_int_eq( closed, 2 );
+	assert_int_eq( idle, 1 );
+	assert_int_eq( closed2, 1 );
+	assert_int_eq( idle2, 1 );
+	assert_int_eq( fd, fresh );
+}
+
+TEST( node_pool_trim_below , "tend trim closes stale sockets below fresh ones" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 8);
+
+	for (int i = 0; i < 3; i++) {
+		as_conn_pool_put(&pool, socket(AF_INET, SOCK_STREAM, 0));
+	}
+
+	usleep(30 * 1000);
+
+	// Steady load keeps the top of the pool fresh.
+	int fresh1 = socket(AF_INET, SOCK_STREAM, 0);
+	int fresh2 = socket(AF_INET, SOCK_STREAM, 0);
+	as_conn_pool_put(&pool, fresh1);
+	as_conn_pool_put(&pool, fresh2);
+
+	uint32_t idle;
+	uint32_t closed = as_conn_pool_trim(&pool, 15, 0, &idle);
+
+	int fd1 = -1;
+	int fd2 = -1;
+	int fd3 = -1;
+	as_conn_pool_get(&pool, 0, &fd1);
+	as_conn_pool_get(&pool, 0, &fd2);
+	bool empty = ! as_conn_pool_get(&pool, 0, &fd3);
+
+	close(fresh1);
+	close(fresh2);
+	as_conn_pool_destroy(&pool);
+
+	assert_int_eq( closed, 3 );
+	assert_int_eq( idle, 2 );
+	assert_int_eq( fd1, fresh2 );
+	assert_int_eq( fd2, fresh1 );
+	assert_true( empty );
+}
+
+TEST( node_pool_expire , "borrow closes sockets idle too long" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 4);
+
+	for (int i = 0; i < 3; i++) {
+		as_conn_pool_put(&pool, socket(AF_INET, SOCK_STREAM, 0));
+	}
+
+	usleep(30 * 1000);
+
+	int fresh = socket(AF_INET, SOCK_STREAM, 0);
+	as_conn_pool_put(&pool, fresh);
+
+	int fd = -1;
+	bool found = as_conn_pool_get(&pool, 15, &fd);
+	int stale = -1;
+	bool empty = ! as_conn_pool_get(&pool, 15, &stale);
+
+	close(fresh);
+	as_conn_pool_destroy(&pool);
+
+	assert_true( found );
+	assert_int_eq( fd, fresh );
+	assert_true( empty );
+	assert_int_eq( stale, -1 );
+}
+
+TEST( node_pool_trim_min , "tend trim keeps the minimum number of sockets" ) {
+
+	as_conn_pool pool;
+	as_conn_pool_init(&pool, 4);
+
+	for (int i = 0; i < 4; i++) {
+		as_conn_pool_put(&pool, socket(AF_INET, SOCK_STREAM, 0));
+	}
+
+	usleep(10 * 1000);
+
+	uint32_t idle;
+	uint32_t closed = as_conn_pool_trim(&pool, 1, 2, &idle);
+
+	// Idle timeout of zero disables trimming, but still counts idle sockets.
+	uint32_t idle2;
+	uint32_t closed2 = as_conn_pool_trim(&pool, 0, 0, &idle2);
+
+	as_conn_pool_destroy(&pool);
+
+	assert_int_eq( closed, 2 );
+	assert_int_eq( idle, 2 );
+	assert_int_eq( closed2, 0 );
+	assert_int_eq( idle2, 2 );
+}
+
+TEST( node_pool_warm_up , "pools are filled when nodes are added" ) {
+
+	uint32_t conns = fake_server_connections(g_fake_server);
+
+	aerospike * as = node_pool_connect(false, 4);
+	assert_not_null( as );
+
+	as_nodes * nodes = as_nodes_reserve(as->cluster);
+	as_conn_stats stats;
+	memset(&stats, 0, sizeof(stats));
+
+	if (nodes->size > 0) {
+		as_node_get_conn_stats(nodes->array[0], &stats);
+	}
+	uint32_t size = nodes->size;
+	as_nodes_release(nodes);
+
+	uint32_t opened = fake_server_connections(g_fake_server) - conns;
+
+	fake_client_close(as);
+
+	// Warm-up connections plus the tend thread's info connection.
+	assert_int_eq( size, 1 );
+	assert_int_eq( stats.opened, 5 );
+	assert_int_eq( stats.idle, 4 );
+	assert_int_eq( stats.trimmed, 0 );
+
+	// Server also sees the seed connection and other clients' connections.
+	assert_true( opened >= 5 );
+}
+
+TEST( node_pool_stale_retry , "commands on sockets closed by the server are retried on new sockets" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "stale", 1);
+
+	as_error err;
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", 7);
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// Server closes the pooled sockets while they are idle.
+	uint32_t conns = fake_server_connections(g_fake_server);
+	fake_server_drop_connections(g_fake_server);
+
+	as_record * out = NULL;
+	rc = aerospike_key_get(as, &err, NULL, &key, &out);
+	int64_t a = out ? as_record_get_int64(out, "a", -1) : -1;
+	as_record_destroy(out);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 7 );
+	assert_true( fake_server_connections(g_fake_server) > conns );
+
+	// Async commands are never retried by policy, so only the retry on a new
+	// socket can succeed.
+	fake_server_drop_connections(g_fake_server);
+
+	node_pool_wait w;
+	memset(&w, 0, sizeof(w));
+	pthread_mutex_init(&w.lock, NULL);
+	pthread_cond_init(&w.cond, NULL);
+
+	rc = aerospike_key_get_async(as, &err, NULL, &key, node_pool_listener, &w);
+
+	if (rc == AEROSPIKE_OK) {
+		pthread_mutex_lock(&w.lock);
+		while (! w.done) {
+			pthread_cond_wait(&w.cond, &w.lock);
+		}
+		pthread_mutex_unlock(&w.lock);
+	}
+	pthread_cond_destroy(&w.cond);
+	pthread_mutex_destroy(&w.lock);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( w.status, AEROSPIKE_OK );
+	assert_int_eq( w.a, 7 );
+}
+
+TEST( node_pool_no_resend , "commands are not resent once the server has answered" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "stale", 2);
+
+	as_error err;
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", 1);
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+	assert_int_eq( rc, AEROSPIKE_OK );
+
+	// The pooled socket breaks after the server applied the write, so the
+	// command fails instead of being written twice.
+	uint32_t requests = fake_server_requests(g_fake_server);
+	fake_server_inject(g_fake_server, FAKE_FAULT_TRUNCATE, 1);
+	rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+	fake_server_inject(g_fake_server, FAKE_FAULT_NONE, 0);
+
+	as_record_destroy(&rec);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_ERR_CLIENT );
+	assert_int_eq( fake_server_requests(g_fake_server) - requests, 1 );
+}
+
+TEST( node_pool_thread_cache , "thread connection cache reuses one socket" ) {
+
+	aerospike * as = node_pool_connect(true, 0);
+	assert_not_null( as );
+
+	uint32_t conns = fake_server_connections(g_fake_server);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "cache", 1);
+
+	as_error err;
+	as_status rc = AEROSPIKE_OK;
+
+	for (int i = 0; i < 20 && rc == AEROSPIKE_OK; i++) {
+		as_record rec;
+		as_record_inita(&rec, 1);
+		as_record_set_int64(&rec, "a", i);
+		rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+		as_record_destroy(&rec);
+	}
+
+	as_record * rec = NULL;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, NULL, &key, &rec);
+	}
+
+	int64_t a = rec ? as_record_get_int64(rec, "a", -1) : -1;
+	as_record_destroy(rec);
+	as_key_destroy(&key);
+	fake_client_close(as);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 19 );
+	assert_int_eq( fake_server_connections(g_fake_server) - conns, 1 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_pool, "connection pool tests" ) {
+	suite_add( node_pool_bounds );
+	suite_add( node_pool_threads );
+	suite_add( node_pool_trim );
+	suite_add( node_pool_trim_below );
+	suite_add( node_pool_expire );
+	suite_add( node_pool_trim_min );
+	suite_add( node_pool_warm_up );
+	suite_add( node_pool_stale_retry );
+	suite_add( node_pool_no_resend );
+	suite_add( node_pool_thread_cache );
+}
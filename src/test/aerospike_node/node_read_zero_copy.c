@@ -0,0 +1,196 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+
+#include "../test.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define BLOB_SIZE 5000
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_status read_zero_copy_put(as_key * key, int64_t a, const char * s, uint8_t seed)
+{
+	uint8_t blob[BLOB_SIZE];
+
+	for (uint32_t i = 0; i < BLOB_SIZE; i++) {
+		blob[i] = (uint8_t)(i + seed);
+	}
+
+	as_record rec;
+	as_record_inita(&rec, 3);
+	as_record_set_int64(&rec, "a", a);
+	as_record_set_str(&rec, "s", s);
+	as_record_set_raw(&rec, "b", blob, BLOB_SIZE);
+
+	as_error err;
+	as_status rc = aerospike_key_put(as, &err, NULL, key, &rec);
+	as_record_destroy(&rec);
+	return rc;
+}
+
+static bool read_zero_copy_blob_ok(as_record * rec, uint8_t seed)
+{
+	as_bytes * b = as_record_get_bytes(rec, "b");
+
+	if (! b || as_bytes_size(b) != BLOB_SIZE) {
+		return false;
+	}
+
+	uint8_t * v = as_bytes_get(b);
+
+	for (uint32_t i = 0; i < BLOB_SIZE; i++) {
+		if (v[i] != (uint8_t)(i + seed)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool read_zero_copy_borrowed(as_record * rec, void * value)
+{
+	uint8_t * p = value;
+	return rec->_buffer && p >= rec->_buffer && p < rec->_buffer + rec->_buffer_capacity;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_read_zero_copy_get , "zero-copy get references the record's buffer" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "zc", 1);
+	as_status rc = read_zero_copy_put(&key, 5, "hello", 3);
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.zero_copy = true;
+
+	as_error err;
+	as_record * rec = NULL;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, &policy, &key, &rec);
+	}
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_not_null( rec );
+
+	char * s = as_record_get_str(rec, "s");
+	as_bytes * b = as_record_get_bytes(rec, "b");
+	bool s_borrowed = s && read_zero_copy_borrowed(rec, s);
+	bool b_borrowed = b && read_zero_copy_borrowed(rec, b->value);
+	bool s_ok = s && strcmp(s, "hello") == 0;
+	bool b_ok = read_zero_copy_blob_ok(rec, 3);
+	int64_t a = as_record_get_int64(rec, "a", -1);
+
+	// Values must survive the buffer being released.
+	as_record_copy_borrowed(rec);
+	s = as_record_get_str(rec, "s");
+	bool copied = rec->_buffer == NULL && s && strcmp(s, "hello") == 0 && read_zero_copy_blob_ok(rec, 3);
+	as_record_destroy(rec);
+
+	assert_true( s_borrowed );
+	assert_true( b_borrowed );
+	assert_true( s_ok );
+	assert_true( b_ok );
+	assert_int_eq( a, 5 );
+	assert_true( copied );
+}
+
+TEST( node_read_zero_copy_reuse , "zero-copy get reuses the buffer of a passed in record" ) {
+
+	as_key key1;
+	as_key_init_int64(&key1, "test", "zc", 2);
+	as_key key2;
+	as_key_init_int64(&key2, "test", "zc", 3);
+
+	as_status rc = read_zero_copy_put(&key1, 1, "first", 1);
+
+	if (rc == AEROSPIKE_OK) {
+		rc = read_zero_copy_put(&key2, 2, "2nd", 2);
+	}
+
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.zero_copy = true;
+
+	as_error err;
+	as_record rec;
+	as_record_init(&rec, 3);
+	as_record * recp = &rec;
+	uint8_t * buffer = NULL;
+	bool first_ok = false;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, &policy, &key1, &recp);
+		char * s = as_record_get_str(&rec, "s");
+		first_ok = s && strcmp(s, "first") == 0 && read_zero_copy_blob_ok(&rec, 1);
+		buffer = rec._buffer;
+	}
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, &policy, &key2, &recp);
+	}
+
+	char * s = as_record_get_str(&rec, "s");
+	bool second_ok = rec.bins.size == 3 && s && strcmp(s, "2nd") == 0 &&
+		read_zero_copy_blob_ok(&rec, 2) && as_record_get_int64(&rec, "a", -1) == 2;
+	bool reused = rec._buffer == buffer;
+
+	as_record_destroy(&rec);
+	as_key_destroy(&key1);
+	as_key_destroy(&key2);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_true( first_ok );
+	assert_true( second_ok );
+	assert_true( reused );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_read_zero_copy, "zero-copy read tests" ) {
+	suite_add( node_read_zero_copy_get );
+	suite_add( node_read_zero_copy_reuse );
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_node.h>
+
+#include "../test.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static uint32_t replica_read(as_policy_replica replica, uint32_t n)
+{
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.replica = replica;
+
+	uint32_t ok = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		as_key key;
+		as_key_init_int64(&key, "test", "replica", i);
+
+		as_error err;
+		as_record * rec = NULL;
+		as_status rc = aerospike_key_get(as, &err, &policy, &key, &rec);
+
+		if (rc == AEROSPIKE_OK || rc == AEROSPIKE_ERR_RECORD_NOT_FOUND) {
+			ok++;
+		}
+		as_record_destroy(rec);
+		as_key_destroy(&key);
+	}
+	return ok;
+}
+
+static uint32_t replica_count_master(as_node * master, as_node * prole, uint32_t n)
+{
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (as_node_choose_replica(master, prole) == master) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_replica_latency , "moving average converges on the node's latency" ) {
+
+	as_node node;
+	memset(&node, 0, sizeof(node));
+
+	as_node_command_begin(&node);
+	as_node_command_begin(&node);
+	uint32_t in_flight = node.in_flight;
+	as_node_command_end(&node, true, 800, false);
+	uint32_t first = node.latency_us;
+
+	for (int i = 0; i < 100; i++) {
+		as_node_command_begin(&node);
+		as_node_command_end(&node, true, 100, false);
+	}
+
+	assert_int_eq( in_flight, 2 );
+	assert_int_eq( node.in_flight, 1 );
+	assert_int_eq( first, 800 );
+	assert_true( node.latency_us >= 90 && node.latency_us <= 110 );
+}
+
+TEST( node_replica_choose , "reads prefer the replica with the lower expected wait" ) {
+
+	as_node master;
+	as_node prole;
+	memset(&master, 0, sizeof(master));
+	memset(&prole, 0, sizeof(prole));
+
+	// Unmeasured replicas alternate.
+	uint32_t even = replica_count_master(&master, &prole, 1000);
+
+	// A slow master only gets the probe reads.
+	master.latency_us = 5000;
+	prole.latency_us = 500;
+	uint32_t slow = replica_count_master(&master, &prole, 1600);
+
+	// Equal latency, but the prole has a queue.
+	master.latency_us = 500;
+	prole.in_flight = 3;
+	uint32_t busy = replica_count_master(&master, &prole, 1600);
+
+	assert_int_eq( even, 500 );
+	assert_int_eq( slow, 50 );
+	assert_int_eq( busy, 1550 );
+}
+
+TEST( node_replica_track , "only replica any reads update the node's load" ) {
+
+	as_nodes * nodes = as_nodes_reserve(as->cluster);
+	as_node * node = nodes->array[0];
+
+	ck_pr_store_32(&node->latency_us, 0);
+	uint32_t master_ok = replica_read(AS_POLICY_REPLICA_MASTER, 10);
+	uint32_t master_latency = ck_pr_load_32(&node->latency_us);
+
+	uint32_t any_ok = replica_read(AS_POLICY_REPLICA_ANY, 10);
+	uint32_t any_latency = ck_pr_load_32(&node->latency_us);
+	uint32_t in_flight = ck_pr_load_32(&node->in_flight);
+
+	as_nodes_release(nodes);
+
+	assert_int_eq( master_ok, 10 );
+	assert_int_eq( any_ok, 10 );
+	assert_int_eq( master_latency, 0 );
+	assert_true( any_latency > 0 );
+	assert_int_eq( in_flight, 0 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_replica, "replica selection tests" ) {
+	suite_add( node_replica_latency );
+	suite_add( node_replica_choose );
+	suite_add( node_replica_track );
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_policy.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_retry.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+extern fake_server * g_fake_server;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static as_status retry_put(aerospike * client, as_key * key, int64_t a, as_policy_retry retry)
+{
+	as_policy_write policy;
+	as_policy_write_init(&policy);
+	policy.retry = retry;
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", a);
+
+	as_error err;
+	as_status rc = aerospike_key_put(client, &err, &policy, key, &rec);
+	as_record_destroy(&rec);
+	return rc;
+}
+
+static int64_t retry_get(aerospike * client, as_key * key, as_policy_retry retry)
+{
+	as_policy_read policy;
+	as_policy_read_init(&policy);
+	policy.retry = retry;
+
+	as_error err;
+	as_record * rec = NULL;
+	int64_t a = -1;
+
+	if (aerospike_key_get(client, &err, &policy, key, &rec) == AEROSPIKE_OK) {
+		a = as_record_get_int64(rec, "a", -1);
+	}
+	as_record_destroy(rec);
+	return a;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_retry_classify , "errors map to retry classes" ) {
+
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_TIMEOUT), AS_RETRY_CLASS_TIMEOUT );
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_CLIENT), AS_RETRY_CLASS_CONNECTION );
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_DEVICE_OVERLOAD), AS_RETRY_CLASS_BUSY );
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_RECORD_BUSY), AS_RETRY_CLASS_BUSY );
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_RECORD_NOT_FOUND), AS_RETRY_CLASS_NONE );
+	assert_int_eq( as_retry_classify(AEROSPIKE_ERR_RECORD_GENERATION), AS_RETRY_CLASS_NONE );
+}
+
+TEST( node_retry_backoff , "backoff doubles per class with deterministic jitter" ) {
+
+	as_retry r1;
+	as_retry r2;
+	as_retry_init(&r1, NULL, 0, 100, 42);
+	as_retry_init(&r2, NULL, 0, 100, 42);
+
+	bool in_window = true;
+	bool same = true;
+	uint32_t window = 2;
+
+	for (int i = 0; i < 10; i++) {
+		int d1 = as_retry_next(&r1, AS_RETRY_CLASS_BUSY, 1000);
+		int d2 = as_retry_next(&r2, AS_RETRY_CLASS_BUSY, 1000);
+
+		if (d1 < (int)(window - window / 2) || d1 > (int)window) {
+			in_window = false;
+		}
+
+		if (d1 != d2) {
+			same = false;
+		}
+		window = window * 2 > 64 ? 64 : window * 2;
+	}
+
+	// Each class keeps its own doubling, and timeouts do not back off.
+	int conn = as_retry_next(&r1, AS_RETRY_CLASS_CONNECTION, 1000);
+	int timeout = as_retry_next(&r1, AS_RETRY_CLASS_TIMEOUT, 1000);
+	int none = as_retry_next(&r1, AS_RETRY_CLASS_NONE, 1000);
+
+	assert_true( in_window );
+	assert_true( same );
+	assert_int_eq( conn, 1 );
+	assert_int_eq( timeout, 0 );
+	assert_int_eq( none, -1 );
+	assert_int_eq( r1.counts[AS_RETRY_CLASS_BUSY], 10 );
+}
+
+TEST( node_retry_budget , "retries are capped by count and remaining deadline" ) {
+
+	as_retry r;
+	as_retry_init(&r, NULL, 1000, 3, 7);
+
+	// Budget of 5ms caps a 10ms no-node backoff.
+	int d1 = as_retry_next(&r, AS_RETRY_CLASS_NO_NODE, 995);
+	bool prole = as_retry_use_prole(&r);
+	int d2 = as_retry_next(&r, AS_RETRY_CLASS_NO_NODE, 999);
+	bool master = ! as_retry_use_prole(&r);
+	int d3 = as_retry_next(&r, AS_RETRY_CLASS_CONNECTION, 1000);
+
+	as_retry_init(&r, NULL, 0, 1, 7);
+	int first = as_retry_next(&r, AS_RETRY_CLASS_TIMEOUT, 0);
+	int exhausted = as_retry_next(&r, AS_RETRY_CLASS_TIMEOUT, 0);
+
+	assert_int_eq( d1, 4 );
+	assert_int_eq( d2, 0 );
+	assert_int_eq( d3, -1 );
+	assert_true( prole );
+	assert_true( master );
+	assert_int_eq( first, 0 );
+	assert_int_eq( exhausted, -1 );
+}
+
+TEST( node_retry_busy , "busy server responses are retried until retries run out" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "retry", 1);
+
+	uint32_t begin = fake_server_requests(g_fake_server);
+	fake_server_inject(g_fake_server, FAKE_FAULT_BUSY, 2);
+	as_status rc1 = retry_put(as, &key, 1, AS_POLICY_RETRY_ONCE);
+	uint32_t n1 = fake_server_requests(g_fake_server) - begin;
+
+	begin = fake_server_requests(g_fake_server);
+	fake_server_inject(g_fake_server, FAKE_FAULT_BUSY, 5);
+	as_status rc2 = retry_put(as, &key, 2, AS_POLICY_RETRY_NONE);
+	uint32_t n2 = fake_server_requests(g_fake_server) - begin;
+	fake_server_inject(g_fake_server, FAKE_FAULT_NONE, 0);
+
+	int64_t a = retry_get(as, &key, AS_POLICY_RETRY_NONE);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc1, AEROSPIKE_OK );
+	assert_int_eq( n1, 3 );
+	assert_int_eq( rc2, AEROSPIKE_ERR_DEVICE_OVERLOAD );
+	assert_int_eq( n2, 2 );
+	assert_int_eq( a, 1 );
+}
+
+TEST( node_retry_faults , "dropped connections and server timeouts are retried" ) {
+
+	as_key key;
+	as_key_init_int64(&key, "test", "retry", 2);
+	as_status rc = retry_put(as, &key, 5, AS_POLICY_RETRY_NONE);
+
+	fake_server_inject(g_fake_server, FAKE_FAULT_DROP, 1);
+	int64_t dropped = retry_get(as, &key, AS_POLICY_RETRY_NONE);
+
+	fake_server_inject(g_fake_server, FAKE_FAULT_TIMEOUT, 1);
+	int64_t timed_out = retry_get(as, &key, AS_POLICY_RETRY_NONE);
+	fake_server_inject(g_fake_server, FAKE_FAULT_NONE, 0);
+	as_key_destroy(&key);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( dropped, 5 );
+	assert_int_eq( timed_out, 5 );
+}
+
+TEST( node_retry_replica , "read retries rotate from master to prole" ) {
+
+	fake_server * master = fake_server_start_node("test", "BB9000000000004", true);
+	fake_server * prole = fake_server_start_node("test", "BB9000000000005", false);
+	assert_not_null( master );
+	assert_not_null( prole );
+
+	fake_server * both[2] = {master, prole};
+	fake_server * prole_only[1] = {prole};
+	aerospike * client = fake_client_start(both, 2);
+	aerospike * prole_client = fake_client_start(prole_only, 1);
+
+	// Servers do not replicate, so each copy has its own value.
+	as_key key;
+	as_key_init_int64(&key, "test", "retry", 3);
+	as_status rc = AEROSPIKE_ERR_CLIENT;
+	int64_t a = -1;
+	uint32_t prole_requests = 0;
+
+	if (client && prole_client) {
+		rc = retry_put(client, &key, 1, AS_POLICY_RETRY_NONE);
+
+		if (rc == AEROSPIKE_OK) {
+			rc = retry_put(prole_client, &key, 2, AS_POLICY_RETRY_NONE);
+		}
+		uint32_t begin = fake_server_requests(prole);
+		fake_server_inject(master, FAKE_FAULT_BUSY, 1);
+		a = retry_get(client, &key, AS_POLICY_RETRY_NONE);
+		prole_requests = fake_server_requests(prole) - begin;
+	}
+
+	as_key_destroy(&key);
+
+	if (prole_client) {
+		fake_client_close(prole_client);
+	}
+
+	if (client) {
+		fake_client_close(client);
+	}
+	fake_server_stop(prole);
+	fake_server_stop(master);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 2 );
+	assert_int_eq( prole_requests, 1 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_retry, "retry engine tests" ) {
+	suite_add( node_retry_classify );
+	suite_add( node_retry_backoff );
+	suite_add( node_retry_budget );
+	suite_add( node_retry_busy );
+	suite_add( node_retry_faults );
+	suite_add( node_retry_replica );
+}
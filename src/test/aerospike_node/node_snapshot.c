@@ -0,0 +1,229 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_clock.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define SNAPSHOT_NODES 2
+#define SNAPSHOT_PATH "target/node_snapshot.map"
+#define SNAPSHOT_INFO_DELAY_MS 300
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+static fake_server * snapshot_servers[SNAPSHOT_NODES];
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static aerospike * snapshot_connect(const char * path)
+{
+	as_config config;
+	fake_client_config(&config, snapshot_servers, SNAPSHOT_NODES);
+	strcpy(config.snapshot_path, path);
+	return fake_client_connect(&config);
+}
+
+static void snapshot_set_info_delay(uint32_t ms)
+{
+	for (int i = 0; i < SNAPSHOT_NODES; i++) {
+		fake_server_set_info_delay(snapshot_servers[i], ms);
+	}
+}
+
+static as_status snapshot_put_get(aerospike * client, int64_t k, int64_t * a)
+{
+	as_key key;
+	as_key_init_int64(&key, "test", "snapshot", k);
+
+	as_record rec;
+	as_record_inita(&rec, 1);
+	as_record_set_int64(&rec, "a", k);
+
+	as_error err;
+	as_status rc = aerospike_key_put(client, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+
+	if (rc == AEROSPIKE_OK) {
+		as_record * out = NULL;
+		rc = aerospike_key_get(client, &err, NULL, &key, &out);
+
+		if (rc == AEROSPIKE_OK) {
+			*a = as_record_get_int64(out, "a", -1);
+		}
+		as_record_destroy(out);
+	}
+	as_key_destroy(&key);
+	return rc;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_snapshot_write , "the tend thread saves the partition map" ) {
+
+	unlink(SNAPSHOT_PATH);
+	snapshot_servers[0] = fake_server_start_node("test", "BB900000000000A", true);
+	snapshot_servers[1] = fake_server_start_node("test", "BB900000000000B", false);
+
+	for (int i = 0; i < SNAPSHOT_NODES; i++) {
+		assert_not_null( snapshot_servers[i] );
+	}
+
+	aerospike * client = snapshot_connect(SNAPSHOT_PATH);
+	assert_not_null( client );
+
+	struct stat st;
+	int rv = -1;
+
+	for (int i = 0; i < 100 && rv != 0; i++) {
+		usleep(50 * 1000);
+		rv = stat(SNAPSHOT_PATH, &st);
+	}
+	fake_client_close(client);
+
+	assert_int_eq( rv, 0 );
+	assert_true( st.st_size > 0 );
+}
+
+TEST( node_snapshot_warm , "connect routes from the snapshot without waiting for tend" ) {
+
+	// Every info request is now slow.  A warm connect asks one saved node for its
+	// name, while discovering the cluster takes several rounds of requests.
+	snapshot_set_info_delay(SNAPSHOT_INFO_DELAY_MS);
+
+	uint64_t begin = cf_getms();
+	aerospike * client = snapshot_connect(SNAPSHOT_PATH);
+	uint64_t elapsed = cf_getms() - begin;
+
+	snapshot_set_info_delay(0);
+
+	int64_t a = -1;
+	as_status rc = AEROSPIKE_ERR_CLIENT;
+	uint32_t nodes = 0;
+
+	if (client) {
+		nodes = client->cluster->nodes->size;
+		rc = snapshot_put_get(client, 1, &a);
+		fake_client_close(client);
+	}
+
+	assert_not_null( client );
+	assert_true( elapsed < SNAPSHOT_INFO_DELAY_MS * 2 );
+	assert_int_eq( nodes, SNAPSHOT_NODES );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 1 );
+}
+
+TEST( node_snapshot_stale , "a snapshot whose nodes are all down is not trusted" ) {
+
+	as_config config;
+	fake_client_config(&config, snapshot_servers, SNAPSHOT_NODES);
+	strcpy(config.snapshot_path, SNAPSHOT_PATH);
+
+	// The snapshot and the seeds name nodes which are gone.
+	for (int i = 0; i < SNAPSHOT_NODES; i++) {
+		fake_server_stop(snapshot_servers[i]);
+		snapshot_servers[i] = NULL;
+	}
+	aerospike * gone = fake_client_connect(&config);
+
+	// Nodes back on new ports are discovered from the seeds.
+	snapshot_servers[0] = fake_server_start_node("test", "BB900000000000A", true);
+	snapshot_servers[1] = fake_server_start_node("test", "BB900000000000B", false);
+	aerospike * client = snapshot_connect(SNAPSHOT_PATH);
+
+	int64_t a = -1;
+	as_status rc = AEROSPIKE_ERR_CLIENT;
+
+	if (client) {
+		rc = snapshot_put_get(client, 3, &a);
+		fake_client_close(client);
+	}
+	fake_client_close(gone);
+
+	assert_null( gone );
+	assert_not_null( client );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 3 );
+}
+
+TEST( node_snapshot_corrupt , "a damaged snapshot falls back to a normal connect" ) {
+
+	FILE * f = fopen(SNAPSHOT_PATH, "r+b");
+	assert_not_null( f );
+	fseek(f, 64, SEEK_SET);
+	fputc(0x5a, f);
+	fputc(0xa5, f);
+	fclose(f);
+
+	aerospike * client = snapshot_connect(SNAPSHOT_PATH);
+
+	int64_t a = -1;
+	as_status rc = AEROSPIKE_ERR_CLIENT;
+
+	if (client) {
+		rc = snapshot_put_get(client, 2, &a);
+		fake_client_close(client);
+	}
+
+	assert_not_null( client );
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 2 );
+}
+
+TEST( node_snapshot_close , "stop servers" ) {
+
+	for (int i = 0; i < SNAPSHOT_NODES; i++) {
+		if (snapshot_servers[i]) {
+			fake_server_stop(snapshot_servers[i]);
+			snapshot_servers[i] = NULL;
+		}
+	}
+	unlink(SNAPSHOT_PATH);
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_snapshot, "partition map snapshot tests" ) {
+	suite_add( node_snapshot_write );
+	suite_add( node_snapshot_warm );
+	suite_add( node_snapshot_stale );
+	suite_add( node_snapshot_corrupt );
+	suite_add( node_snapshot_close );
+}
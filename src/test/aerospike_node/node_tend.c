@@ -0,0 +1,132 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <unistd.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_cluster.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_status.h>
+
+#include "../test.h"
+#include "../util/fake_client.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define TEND_NODES 2
+#define TEND_INFO_DELAY_MS 300
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static aerospike * tend_connect(fake_server ** servers, int n_servers, uint32_t tend_threads)
+{
+	as_config config;
+	fake_client_config(&config, servers, n_servers);
+	config.tend_threads = tend_threads;
+	return fake_client_connect(&config);
+}
+
+// Slow down info responses on every node and return the duration of the first
+// tend cycle that ran entirely with the delay.
+static uint32_t tend_slow_cycle_us(fake_server ** servers, uint32_t tend_threads)
+{
+	aerospike * client = tend_connect(servers, TEND_NODES, tend_threads);
+
+	if (! client) {
+		return 0;
+	}
+
+	for (int i = 0; i < TEND_NODES; i++) {
+		fake_server_set_info_delay(servers[i], TEND_INFO_DELAY_MS);
+	}
+
+	as_tend_stats stats;
+	as_cluster_get_tend_stats(client->cluster, &stats);
+	uint32_t count = stats.count;
+
+	// The cycle running now may have started before the delay was set.
+	for (int i = 0; i < 100 && stats.count < count + 2; i++) {
+		usleep(50 * 1000);
+		as_cluster_get_tend_stats(client->cluster, &stats);
+	}
+
+	for (int i = 0; i < TEND_NODES; i++) {
+		fake_server_set_info_delay(servers[i], 0);
+	}
+	fake_client_close(client);
+	return stats.count >= count + 2 ? stats.last_us : 0;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_tend_stats , "tend cycles are counted and timed" ) {
+
+	fake_server * server = fake_server_start("test");
+	assert_not_null( server );
+
+	aerospike * client = tend_connect(&server, 1, 4);
+	as_tend_stats stats = {0};
+
+	if (client) {
+		as_cluster_get_tend_stats(client->cluster, &stats);
+		fake_client_close(client);
+	}
+	fake_server_stop(server);
+
+	assert_not_null( client );
+	assert_true( stats.count >= 1 );
+	assert_true( stats.max_us >= stats.last_us );
+	assert_true( stats.total_us >= stats.max_us );
+}
+
+TEST( node_tend_parallel , "slow nodes are tended concurrently" ) {
+
+	fake_server * servers[TEND_NODES];
+	servers[0] = fake_server_start_node("test", "BB9000000000008", true);
+	servers[1] = fake_server_start_node("test", "BB9000000000009", false);
+
+	for (int i = 0; i < TEND_NODES; i++) {
+		assert_not_null( servers[i] );
+	}
+
+	uint32_t parallel_us = tend_slow_cycle_us(servers, 4);
+	uint32_t serial_us = tend_slow_cycle_us(servers, 1);
+
+	for (int i = 0; i < TEND_NODES; i++) {
+		fake_server_stop(servers[i]);
+	}
+
+	// Concurrent cycles wait for the slowest node, serial ones for all of them.
+	assert_true( parallel_us >= TEND_INFO_DELAY_MS * 1000 );
+	assert_true( parallel_us < TEND_NODES * TEND_INFO_DELAY_MS * 1000 );
+	assert_true( serial_us >= TEND_NODES * TEND_INFO_DELAY_MS * 1000 );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_tend, "cluster tend tests" ) {
+	suite_add( node_tend_stats );
+	suite_add( node_tend_parallel );
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2008-2015 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <aerospike/aerospike.h>
+#include <aerospike/aerospike_key.h>
+#include <aerospike/as_bytes.h>
+#include <aerospike/as_command.h>
+#include <aerospike/as_error.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_record.h>
+#include <aerospike/as_status.h>
+#include <aerospike/as_string.h>
+
+#include "../test.h"
+#include "../util/fake_server.h"
+
+/******************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define BLOB_SIZE (1024 * 1024)
+#define STR_SIZE (AS_COMMAND_ZERO_COPY_MIN * 3)
+
+/******************************************************************************
+ * GLOBAL VARS
+ *****************************************************************************/
+
+extern aerospike * as;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static uint8_t * write_iov_blob(uint32_t size, uint8_t seed)
+{
+	uint8_t * blob = malloc(size);
+
+	for (uint32_t i = 0; i < size; i++) {
+		blob[i] = (uint8_t)(i * 31 + seed);
+	}
+	return blob;
+}
+
+static char * write_iov_str(uint32_t len)
+{
+	char * str = malloc(len + 1);
+
+	for (uint32_t i = 0; i < len; i++) {
+		str[i] = 'a' + (i % 26);
+	}
+	str[len] = 0;
+	return str;
+}
+
+/******************************************************************************
+ * TEST CASES
+ *****************************************************************************/
+
+TEST( node_write_iov_put , "large and small bins round trip through scatter-gather put" ) {
+
+	uint8_t * blob = write_iov_blob(BLOB_SIZE, 7);
+	char * str = write_iov_str(STR_SIZE);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "iov", 1);
+
+	as_record rec;
+	as_record_inita(&rec, 4);
+	as_record_set_int64(&rec, "a", 42);
+	as_record_set_raw(&rec, "blob", blob, BLOB_SIZE);
+	as_record_set_str(&rec, "str", str);
+	as_record_set_str(&rec, "small", "abc");
+
+	as_error err;
+	as_status rc = aerospike_key_put(as, &err, NULL, &key, &rec);
+	as_record_destroy(&rec);
+
+	as_record * out = NULL;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, NULL, &key, &out);
+	}
+
+	as_bytes * b = out ? as_record_get_bytes(out, "blob") : NULL;
+	char * s = out ? as_record_get_str(out, "str") : NULL;
+	char * small = out ? as_record_get_str(out, "small") : NULL;
+	int64_t a = out ? as_record_get_int64(out, "a", -1) : -1;
+
+	bool blob_ok = b && as_bytes_size(b) == BLOB_SIZE && memcmp(as_bytes_get(b), blob, BLOB_SIZE) == 0;
+	bool str_ok = s && strcmp(s, str) == 0;
+	bool small_ok = small && strcmp(small, "abc") == 0;
+
+	as_record_destroy(out);
+	as_key_destroy(&key);
+	free(str);
+	free(blob);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( a, 42 );
+	assert_true( blob_ok );
+	assert_true( str_ok );
+	assert_true( small_ok );
+}
+
+TEST( node_write_iov_operate , "large bins written by operate are not copied and round trip" ) {
+
+	uint8_t * blob1 = write_iov_blob(AS_COMMAND_ZERO_COPY_MIN, 1);
+	uint8_t * blob2 = write_iov_blob(BLOB_SIZE / 4, 2);
+
+	as_key key;
+	as_key_init_int64(&key, "test", "iov", 2);
+
+	as_operations ops;
+	as_operations_inita(&ops, 4);
+	as_operations_add_write_raw(&ops, "b1", blob1, AS_COMMAND_ZERO_COPY_MIN);
+	as_operations_add_write_int64(&ops, "n", 9);
+	as_operations_add_write_raw(&ops, "b2", blob2, BLOB_SIZE / 4);
+	as_operations_add_read(&ops, "b1");
+
+	as_error err;
+	as_record * out = NULL;
+	as_status rc = aerospike_key_operate(as, &err, NULL, &key, &ops, &out);
+	as_operations_destroy(&ops);
+	as_record_destroy(out);
+	out = NULL;
+
+	if (rc == AEROSPIKE_OK) {
+		rc = aerospike_key_get(as, &err, NULL, &key, &out);
+	}
+
+	as_bytes * b1 = out ? as_record_get_bytes(out, "b1") : NULL;
+	as_bytes * b2 = out ? as_record_get_bytes(out, "b2") : NULL;
+	int64_t n = out ? as_record_get_int64(out, "n", -1) : -1;
+
+	bool b1_ok = b1 && as_bytes_size(b1) == AS_COMMAND_ZERO_COPY_MIN &&
+		memcmp(as_bytes_get(b1), blob1, AS_COMMAND_ZERO_COPY_MIN) == 0;
+	bool b2_ok = b2 && as_bytes_size(b2) == BLOB_SIZE / 4 &&
+		memcmp(as_bytes_get(b2), blob2, BLOB_SIZE / 4) == 0;
+
+	as_record_destroy(out);
+	as_key_destroy(&key);
+	free(blob2);
+	free(blob1);
+
+	assert_int_eq( rc, AEROSPIKE_OK );
+	assert_int_eq( n, 9 );
+	assert_true( b1_ok );
+	assert_true( b2_ok );
+}
+
+/******************************************************************************
+ * TEST SUITE
+ *****************************************************************************/
+
+SUITE( node_write_iov, "scatter-gather command write tests" ) {
+	suite_add( node_write_iov_put );
+	suite_add( node_write_iov_operate );
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <aerospike/aerospike.h>
+
+#include "test.h"
+#include "util/fake_client.h"
+#include "util/fake_server.h"
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+aerospike * as = NULL;
+fake_server * g_fake_server = NULL;
+int g_argc = 0;
+char ** g_argv = NULL;
+
+/******************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static bool
+as_client_log_callback(as_log_level level, const char * func, const char * file, uint32_t line, const char * fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	atf_logv(stderr, as_log_level_tostring(level), ATF_LOG_PREFIX, NULL, 0, fmt, ap);
+	va_end(ap);
+	return true;
+}
+
+static bool before(atf_plan * plan) {
+
+	g_fake_server = fake_server_start("test");
+
+	if ( ! g_fake_server ) {
+		error("failed to start fake server");
+		return false;
+	}
+
+	as_log_set_level(AS_LOG_LEVEL_WARN);
+	as_log_set_callback(as_client_log_callback);
+
+	as = fake_client_start(&g_fake_server, 1);
+	return as != NULL;
+}
+
+static bool after(atf_plan * plan) {
+
+	fake_client_close(as);
+	as = NULL;
+
+	if ( g_fake_server ) {
+		fake_server_stop(g_fake_server);
+		g_fake_server = NULL;
+	}
+	return true;
+}
+
+/******************************************************************************
+ * TEST PLAN
+ *****************************************************************************/
+
+PLAN( offline_test ) {
+
+	plan_before( before );
+	plan_after( after );
+
+	// aerospike_key async api
+	plan_add( key_async );
+	plan_add( key_async_pipeline );
+
+	// node connection pool
+	plan_add( node_pool );
+	plan_add( node_write_iov );
+	plan_add( node_read_zero_copy );
+	plan_add( node_command_buffer );
+	plan_add( node_hedge );
+	plan_add( node_retry );
+	plan_add( node_replica );
+	plan_add( node_breaker );
+	plan_add( node_namespace );
+	plan_add( node_key_encode );
+	plan_add( node_epoch );
+	plan_add( node_tend );
+	plan_add( node_partition_map );
+	plan_add( node_snapshot );
+	plan_add( node_batch );
+}
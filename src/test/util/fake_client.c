@@ -0,0 +1,67 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <string.h>
+
+#include <aerospike/as_error.h>
+
+#include "../test.h"
+#include "fake_client.h"
+
+/*****************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+void fake_client_config(as_config * config, fake_server ** servers, int n_servers)
+{
+	as_config_init(config);
+
+	for (int i = 0; i < n_servers; i++) {
+		as_config_add_host(config, "127.0.0.1", fake_server_port(servers[i]));
+	}
+	config->lua.cache_enabled = false;
+	strcpy(config->lua.system_path, "modules/lua-core/src");
+	strcpy(config->lua.user_path, "src/test/lua");
+}
+
+aerospike * fake_client_connect(as_config * config)
+{
+	as_error err;
+	aerospike * client = aerospike_new(config);
+
+	if ( aerospike_connect(client, &err) != AEROSPIKE_OK ) {
+		error("%s @ %s[%s:%d]", err.message, err.func, err.file, err.line);
+		aerospike_destroy(client);
+		return NULL;
+	}
+	return client;
+}
+
+aerospike * fake_client_start(fake_server ** servers, int n_servers)
+{
+	as_config config;
+	fake_client_config(&config, servers, n_servers);
+	return fake_client_connect(&config);
+}
+
+void fake_client_close(aerospike * client)
+{
+	if (client) {
+		as_error err;
+		aerospike_close(client, &err);
+		aerospike_destroy(client);
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ * Clients for offline tests. A client is seeded with fake servers and loads
+ * its Lua modules from the source tree.
+ */
+
+#include <aerospike/aerospike.h>
+#include <aerospike/as_config.h>
+
+#include "fake_server.h"
+
+/*****************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * Initialize `config` with `n_servers` servers as seeds. Adjust it further
+ * before passing it to fake_client_connect().
+ */
+void fake_client_config(as_config * config, fake_server ** servers, int n_servers);
+
+/**
+ * Create a client with `config` and connect it. Returns NULL, after logging
+ * the error, if the client could not connect.
+ */
+aerospike * fake_client_connect(as_config * config);
+
+/**
+ * Connect a client with the default configuration seeded with `n_servers`
+ * servers.
+ */
+aerospike * fake_client_start(fake_server ** servers, int n_servers);
+
+/**
+ * Close and destroy a client. Does nothing if `client` is NULL.
+ */
+void fake_client_close(aerospike * client);
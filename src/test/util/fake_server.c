@@ -0,0 +1,868 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <aerospike/as_command.h>
+#include <aerospike/as_operations.h>
+#include <aerospike/as_status.h>
+#include <citrusleaf/cf_b64.h>
+
+#include "fake_server.h"
+
+/*****************************************************************************
+ * MACROS
+ *****************************************************************************/
+
+#define FAKE_NODE_NAME "BB9000000000001"
+#define FAKE_PARTITIONS 4096
+#define FAKE_BITMAP_SIZE (FAKE_PARTITIONS / 8)
+#define FAKE_MAX_CONNS 256
+#define FAKE_MAX_BINS 32
+#define FAKE_DIGEST_SIZE 20
+#define FAKE_MAX_NAMESPACES 4
+#define FAKE_ADMIN_MESSAGE_TYPE 2
+
+/*****************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct fake_bin_s {
+	char name[16];
+	uint8_t type;
+	uint8_t * value;
+	uint32_t len;
+} fake_bin;
+
+typedef struct fake_record_s {
+	struct fake_record_s * next;
+	uint8_t digest[FAKE_DIGEST_SIZE];
+	uint32_t gen;
+	uint32_t n_bins;
+	fake_bin bins[FAKE_MAX_BINS];
+} fake_record;
+
+typedef struct fake_buf_s {
+	uint8_t * data;
+	size_t len;
+	size_t capacity;
+} fake_buf;
+
+struct fake_server_s {
+	char ns[FAKE_MAX_NAMESPACES][32];
+	uint32_t n_ns;
+	char name[32];
+	bool master;
+	uint32_t begin;
+	uint32_t end;
+	int listen_fd;
+	uint16_t port;
+	pthread_t accept_thread;
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
+	fake_record * records;
+	int conns[FAKE_MAX_CONNS];
+	bool dropped[FAKE_MAX_CONNS];
+	uint32_t dropping;
+	uint32_t active;
+	volatile uint32_t delay_ms;
+	volatile uint32_t info_delay_ms;
+	volatile uint32_t login_delay_ms;
+	fake_fault fault;
+	uint32_t faults;
+	volatile uint32_t requests;
+	volatile uint32_t connections;
+	volatile uint32_t logins;
+	volatile bool closing;
+};
+
+typedef struct fake_conn_s {
+	fake_server * server;
+	int fd;
+	int slot;
+} fake_conn;
+
+/*****************************************************************************
+ * STATIC FUNCTIONS
+ *****************************************************************************/
+
+static void fake_buf_reserve(fake_buf * b, size_t extra)
+{
+	if (b->len + extra > b->capacity) {
+		b->capacity = (b->len + extra) * 2;
+		b->data = realloc(b->data, b->capacity);
+	}
+}
+
+static void fake_buf_append(fake_buf * b, const void * data, size_t len)
+{
+	fake_buf_reserve(b, len);
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void fake_buf_append_str(fake_buf * b, const char * s)
+{
+	fake_buf_append(b, s, strlen(s));
+}
+
+static void fake_buf_append_u8(fake_buf * b, uint8_t v)
+{
+	fake_buf_append(b, &v, 1);
+}
+
+static void fake_buf_append_u16(fake_buf * b, uint16_t v)
+{
+	uint8_t p[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+	fake_buf_append(b, p, 2);
+}
+
+static void fake_buf_append_u32(fake_buf * b, uint32_t v)
+{
+	uint8_t p[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+	fake_buf_append(b, p, 4);
+}
+
+static uint16_t fake_get_u16(const uint8_t * p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t fake_get_u32(const uint8_t * p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void fake_put_proto(uint8_t * p, uint8_t type, uint64_t sz)
+{
+	p[0] = AS_MESSAGE_VERSION;
+	p[1] = type;
+	for (int i = 7; i >= 2; i--) {
+		p[i] = (uint8_t)sz;
+		sz >>= 8;
+	}
+}
+
+static bool fake_read_full(int fd, uint8_t * buf, size_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len) {
+		ssize_t rv = read(fd, buf + pos, len - pos);
+
+		if (rv <= 0) {
+			if (rv < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		pos += rv;
+	}
+	return true;
+}
+
+static bool fake_write_full(int fd, const uint8_t * buf, size_t len)
+{
+	size_t pos = 0;
+
+	while (pos < len) {
+		ssize_t rv = send(fd, buf + pos, len - pos, MSG_NOSIGNAL);
+
+		if (rv <= 0) {
+			if (rv < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		pos += rv;
+	}
+	return true;
+}
+
+static void fake_info_value(fake_server * server, const char * name, fake_buf * out)
+{
+	if (strcmp(name, "node") == 0) {
+		fake_buf_append_str(out, server->name);
+	}
+	else if (strcmp(name, "partitions") == 0) {
+		char s[16];
+		sprintf(s, "%d", FAKE_PARTITIONS);
+		fake_buf_append_str(out, s);
+	}
+	else if (strcmp(name, "partition-generation") == 0) {
+		fake_buf_append_str(out, "1");
+	}
+	else if (strcmp(name, "replicas-master") == 0 || strcmp(name, "replicas-prole") == 0) {
+		uint8_t bitmap[FAKE_BITMAP_SIZE];
+		bool master_map = name[9] == 'm';
+		memset(bitmap, 0, sizeof(bitmap));
+
+		if (master_map == server->master) {
+			for (uint32_t i = server->begin; i < server->end; i++) {
+				bitmap[i >> 3] |= 0x80 >> (i & 7);
+			}
+		}
+
+		char b64[cf_b64_encoded_len(FAKE_BITMAP_SIZE) + 1];
+		cf_b64_encode(bitmap, FAKE_BITMAP_SIZE, b64);
+		b64[sizeof(b64) - 1] = 0;
+
+		for (uint32_t i = 0; i < server->n_ns; i++) {
+			fake_buf_append_str(out, server->ns[i]);
+			fake_buf_append_str(out, ":");
+			fake_buf_append_str(out, b64);
+			fake_buf_append_str(out, ";");
+		}
+	}
+	// "services" and unknown names get an empty value.
+}
+
+static void fake_handle_info(fake_server * server, char * names, fake_buf * out)
+{
+	char * name = names;
+	char * p = names;
+
+	while (*p) {
+		if (*p == '\n') {
+			*p = 0;
+			fake_buf_append_str(out, name);
+			fake_buf_append_str(out, "\t");
+			fake_info_value(server, name, out);
+			fake_buf_append_str(out, "\n");
+			name = p + 1;
+		}
+		p++;
+	}
+}
+
+static fake_record * fake_record_find(fake_server * server, const uint8_t * digest, fake_record *** prev_next)
+{
+	fake_record ** next = &server->records;
+
+	while (*next) {
+		if (memcmp((*next)->digest, digest, FAKE_DIGEST_SIZE) == 0) {
+			break;
+		}
+		next = &(*next)->next;
+	}
+
+	if (prev_next) {
+		*prev_next = next;
+	}
+	return *next;
+}
+
+static void fake_record_free(fake_record * rec)
+{
+	for (uint32_t i = 0; i < rec->n_bins; i++) {
+		free(rec->bins[i].value);
+	}
+	free(rec);
+}
+
+static fake_bin * fake_record_bin(fake_record * rec, const char * name, bool create)
+{
+	for (uint32_t i = 0; i < rec->n_bins; i++) {
+		if (strcmp(rec->bins[i].name, name) == 0) {
+			return &rec->bins[i];
+		}
+	}
+
+	if (! create || rec->n_bins == FAKE_MAX_BINS) {
+		return NULL;
+	}
+
+	fake_bin * bin = &rec->bins[rec->n_bins++];
+	memset(bin, 0, sizeof(fake_bin));
+	strcpy(bin->name, name);
+	return bin;
+}
+
+static void fake_append_op(fake_buf * out, fake_bin * bin)
+{
+	uint8_t name_len = (uint8_t)strlen(bin->name);
+	fake_buf_append_u32(out, 4 + name_len + bin->len);
+	fake_buf_append_u8(out, AS_OPERATOR_READ);
+	fake_buf_append_u8(out, bin->type);
+	fake_buf_append_u8(out, 0);
+	fake_buf_append_u8(out, name_len);
+	fake_buf_append(out, bin->name, name_len);
+	fake_buf_append(out, bin->value, bin->len);
+}
+
+static void fake_append_batch_header(fake_buf * out, uint8_t info3, uint8_t result, uint32_t gen,
+	uint16_t n_fields, uint16_t n_results)
+{
+	fake_buf_append_u8(out, 22);
+	fake_buf_append_u8(out, 0);
+	fake_buf_append_u8(out, 0);
+	fake_buf_append_u8(out, info3);
+	fake_buf_append_u8(out, 0);
+	fake_buf_append_u8(out, result);
+	fake_buf_append_u32(out, gen);
+	fake_buf_append_u32(out, 0);
+	fake_buf_append_u32(out, 0);
+	fake_buf_append_u16(out, n_fields);
+	fake_buf_append_u16(out, n_results);
+}
+
+static void fake_append_msg_header(fake_buf * out, uint8_t result, uint32_t gen, uint16_t n_results)
+{
+	fake_append_batch_header(out, 0, result, gen, 0, n_results);
+}
+
+static fake_fault fake_take_fault(fake_server * server)
+{
+	fake_fault fault = FAKE_FAULT_NONE;
+
+	pthread_mutex_lock(&server->lock);
+
+	if (server->faults) {
+		server->faults--;
+		fault = server->fault;
+	}
+	pthread_mutex_unlock(&server->lock);
+	return fault;
+}
+
+// Answer each digest with its record, keyed by a digest field, in request order.
+// Read operations in the request select bins, otherwise all bins are returned.
+static void fake_handle_batch(fake_server * server, uint8_t info1, const uint8_t * digests, uint32_t n_digests,
+	uint8_t * select, uint16_t n_ops, uint8_t * end, fake_buf * out)
+{
+	pthread_mutex_lock(&server->lock);
+
+	for (uint32_t i = 0; i < n_digests; i++) {
+		const uint8_t * digest = digests + i * FAKE_DIGEST_SIZE;
+		fake_record * rec = fake_record_find(server, digest, NULL);
+		uint16_t n_results = 0;
+		fake_buf ops = {0};
+
+		if (rec && (info1 & AS_MSG_INFO1_GET_ALL)) {
+			for (uint32_t j = 0; j < rec->n_bins; j++) {
+				fake_append_op(&ops, &rec->bins[j]);
+				n_results++;
+			}
+		}
+		else if (rec) {
+			uint8_t * p = select;
+
+			for (uint16_t j = 0; j < n_ops && p + 8 <= end; j++) {
+				uint32_t sz = fake_get_u32(p);
+				uint8_t name_len = p[7];
+				char name[16] = {0};
+				memcpy(name, p + 8, name_len < 15 ? name_len : 15);
+				fake_bin * bin = fake_record_bin(rec, name, false);
+
+				if (bin) {
+					fake_append_op(&ops, bin);
+					n_results++;
+				}
+				p += 4 + sz;
+			}
+		}
+
+		fake_append_batch_header(out, 0, rec ? AEROSPIKE_OK : AEROSPIKE_ERR_RECORD_NOT_FOUND,
+			rec ? rec->gen : 0, 1, n_results);
+		fake_buf_append_u32(out, 1 + FAKE_DIGEST_SIZE);
+		fake_buf_append_u8(out, AS_FIELD_DIGEST);
+		fake_buf_append(out, digest, FAKE_DIGEST_SIZE);
+
+		if (ops.len) {
+			fake_buf_append(out, ops.data, ops.len);
+		}
+		free(ops.data);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	fake_append_batch_header(out, AS_MSG_INFO3_LAST, AEROSPIKE_OK, 0, 0, 0);
+}
+
+static void fake_handle_record(fake_server * server, uint8_t * msg, size_t msg_len, fake_buf * out)
+{
+	uint8_t info1 = msg[1];
+	uint8_t info2 = msg[2];
+	uint16_t n_fields = fake_get_u16(msg + 18);
+	uint16_t n_ops = fake_get_u16(msg + 20);
+	uint8_t * p = msg + 22;
+	uint8_t * end = msg + msg_len;
+	uint8_t * digest = NULL;
+	uint8_t * digests = NULL;
+	uint32_t n_digests = 0;
+
+	for (uint16_t i = 0; i < n_fields && p + 5 <= end; i++) {
+		uint32_t sz = fake_get_u32(p);
+
+		if (p[4] == AS_FIELD_DIGEST) {
+			digest = p + 5;
+		}
+		else if (p[4] == AS_FIELD_DIGEST_ARRAY) {
+			digests = p + 5;
+			n_digests = (sz - 1) / FAKE_DIGEST_SIZE;
+		}
+		p += 4 + sz;
+	}
+
+	if (digests) {
+		fake_handle_batch(server, info1, digests, n_digests, p, n_ops, end, out);
+		return;
+	}
+
+	uint8_t result = AEROSPIKE_OK;
+	uint32_t gen = 0;
+	uint16_t n_results = 0;
+	fake_buf ops = {0};
+
+	pthread_mutex_lock(&server->lock);
+
+	fake_record ** prev_next;
+	fake_record * rec = digest ? fake_record_find(server, digest, &prev_next) : NULL;
+
+	if (! digest) {
+		result = AEROSPIKE_ERR_REQUEST_INVALID;
+	}
+	else if (info2 & AS_MSG_INFO2_DELETE) {
+		if (rec) {
+			*prev_next = rec->next;
+			fake_record_free(rec);
+		}
+		else {
+			result = AEROSPIKE_ERR_RECORD_NOT_FOUND;
+		}
+	}
+	else {
+		if (! rec && (info2 & AS_MSG_INFO2_WRITE)) {
+			rec = calloc(1, sizeof(fake_record));
+			memcpy(rec->digest, digest, FAKE_DIGEST_SIZE);
+			rec->next = server->records;
+			server->records = rec;
+		}
+
+		if (! rec) {
+			result = AEROSPIKE_ERR_RECORD_NOT_FOUND;
+		}
+		else {
+			if (info2 & AS_MSG_INFO2_WRITE) {
+				rec->gen++;
+			}
+
+			for (uint16_t i = 0; i < n_ops && p + 8 <= end; i++) {
+				uint32_t sz = fake_get_u32(p);
+				uint8_t op = p[4];
+				uint8_t type = p[5];
+				uint8_t name_len = p[7];
+				char name[16] = {0};
+				memcpy(name, p + 8, name_len < 15 ? name_len : 15);
+				uint8_t * value = p + 8 + name_len;
+				uint32_t value_len = sz - 4 - name_len;
+
+				if (op == AS_OPERATOR_WRITE) {
+					fake_bin * bin = fake_record_bin(rec, name, true);
+
+					if (bin) {
+						free(bin->value);
+						bin->type = type;
+						bin->len = value_len;
+						bin->value = malloc(value_len ? value_len : 1);
+						memcpy(bin->value, value, value_len);
+					}
+				}
+				else if (op == AS_OPERATOR_READ && name_len) {
+					fake_bin * bin = fake_record_bin(rec, name, false);
+
+					if (bin) {
+						fake_append_op(&ops, bin);
+						n_results++;
+					}
+				}
+				p += 4 + sz;
+			}
+
+			if (info1 & AS_MSG_INFO1_GET_ALL) {
+				for (uint32_t i = 0; i < rec->n_bins; i++) {
+					fake_append_op(&ops, &rec->bins[i]);
+					n_results++;
+				}
+			}
+			gen = rec->gen;
+		}
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	fake_append_msg_header(out, result, gen, n_results);
+
+	if (ops.len) {
+		fake_buf_append(out, ops.data, ops.len);
+	}
+	free(ops.data);
+}
+
+static void * fake_conn_run(void * udata)
+{
+	fake_conn * conn = udata;
+	fake_server * server = conn->server;
+	fake_buf in = {0};
+	fake_buf out = {0};
+
+	while (! server->closing) {
+		uint8_t header[8];
+
+		if (! fake_read_full(conn->fd, header, sizeof(header))) {
+			break;
+		}
+
+		uint8_t type = header[1];
+		uint64_t sz = 0;
+
+		for (int i = 2; i < 8; i++) {
+			sz = (sz << 8) | header[i];
+		}
+
+		in.len = 0;
+		fake_buf_reserve(&in, sz + 1);
+
+		if (! fake_read_full(conn->fd, in.data, sz)) {
+			break;
+		}
+		in.data[sz] = 0;
+
+		out.len = 0;
+		fake_buf_reserve(&out, 8);
+		out.len = 8;
+
+		if (type == AS_INFO_MESSAGE_TYPE) {
+			uint32_t info_delay_ms = server->info_delay_ms;
+
+			if (info_delay_ms) {
+				usleep(info_delay_ms * 1000);
+			}
+			fake_handle_info(server, (char*)in.data, &out);
+		}
+		else if (type == FAKE_ADMIN_MESSAGE_TYPE) {
+			// Accept every login.  The 16 byte admin header carries the result
+			// code, which is left zero.
+			uint32_t login_delay_ms = server->login_delay_ms;
+
+			if (login_delay_ms) {
+				usleep(login_delay_ms * 1000);
+			}
+			__sync_fetch_and_add(&server->logins, 1);
+			fake_buf_reserve(&out, 16);
+			memset(out.data + out.len, 0, 16);
+			out.len += 16;
+		}
+		else {
+			uint32_t delay_ms = server->delay_ms;
+
+			if (delay_ms) {
+				usleep(delay_ms * 1000);
+			}
+			fake_fault fault = fake_take_fault(server);
+			__sync_fetch_and_add(&server->requests, 1);
+
+			if (fault == FAKE_FAULT_STALL) {
+				usleep(FAKE_STALL_MS * 1000);
+			}
+
+			if (fault == FAKE_FAULT_DROP) {
+				break;
+			}
+			else if (fault == FAKE_FAULT_BUSY) {
+				fake_append_msg_header(&out, AEROSPIKE_ERR_DEVICE_OVERLOAD, 0, 0);
+			}
+			else if (fault == FAKE_FAULT_TIMEOUT) {
+				fake_append_msg_header(&out, AEROSPIKE_ERR_TIMEOUT, 0, 0);
+			}
+			else {
+				fake_handle_record(server, in.data, sz, &out);
+			}
+
+			if (fault == FAKE_FAULT_TRUNCATE) {
+				fake_put_proto(out.data, type, out.len - 8);
+				fake_write_full(conn->fd, out.data, out.len / 2);
+				break;
+			}
+
+			if (fault == FAKE_FAULT_OVERSIZE) {
+				fake_put_proto(out.data, type, ((uint64_t)1 << 48) - 1);
+				fake_write_full(conn->fd, out.data, 8);
+				continue;
+			}
+		}
+
+		fake_put_proto(out.data, type, out.len - 8);
+
+		if (! fake_write_full(conn->fd, out.data, out.len)) {
+			break;
+		}
+	}
+
+	free(in.data);
+	free(out.data);
+
+	pthread_mutex_lock(&server->lock);
+	server->conns[conn->slot] = -1;
+	close(conn->fd);
+
+	bool wake = --server->active == 0;
+
+	if (server->dropped[conn->slot]) {
+		server->dropped[conn->slot] = false;
+
+		if (--server->dropping == 0) {
+			wake = true;
+		}
+	}
+
+	if (wake) {
+		pthread_cond_broadcast(&server->idle);
+	}
+	pthread_mutex_unlock(&server->lock);
+	free(conn);
+	return NULL;
+}
+
+static void * fake_accept_run(void * udata)
+{
+	fake_server * server = udata;
+
+	while (! server->closing) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		int flag = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+		pthread_mutex_lock(&server->lock);
+
+		int slot = -1;
+
+		for (int i = 0; i < FAKE_MAX_CONNS; i++) {
+			if (server->conns[i] < 0) {
+				slot = i;
+				break;
+			}
+		}
+
+		if (slot < 0 || server->closing) {
+			pthread_mutex_unlock(&server->lock);
+			close(fd);
+			continue;
+		}
+
+		server->conns[slot] = fd;
+		server->active++;
+		server->connections++;
+		pthread_mutex_unlock(&server->lock);
+
+		fake_conn * conn = malloc(sizeof(fake_conn));
+		conn->server = server;
+		conn->fd = fd;
+		conn->slot = slot;
+
+		pthread_t thread;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		pthread_create(&thread, &attr, fake_conn_run, conn);
+		pthread_attr_destroy(&attr);
+	}
+	return NULL;
+}
+
+/*****************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+fake_server * fake_server_start(const char * ns)
+{
+	return fake_server_start_node(ns, FAKE_NODE_NAME, true);
+}
+
+fake_server * fake_server_start_node(const char * ns, const char * name, bool master)
+{
+	fake_server * server = fake_server_start_range(ns, name, 0, FAKE_PARTITIONS);
+
+	if (server) {
+		server->master = master;
+	}
+	return server;
+}
+
+fake_server * fake_server_start_range(const char * ns, const char * name, uint32_t begin, uint32_t end)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	socklen_t len = sizeof(addr);
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+		listen(fd, FAKE_MAX_CONNS) < 0 ||
+		getsockname(fd, (struct sockaddr*)&addr, &len) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	fake_server * server = calloc(1, sizeof(fake_server));
+	strncpy(server->ns[0], ns, sizeof(server->ns[0]) - 1);
+	server->n_ns = 1;
+	strncpy(server->name, name, sizeof(server->name) - 1);
+	server->master = true;
+	server->begin = begin;
+	server->end = end < FAKE_PARTITIONS ? end : FAKE_PARTITIONS;
+	server->listen_fd = fd;
+	server->port = ntohs(addr.sin_port);
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->idle, NULL);
+
+	for (int i = 0; i < FAKE_MAX_CONNS; i++) {
+		server->conns[i] = -1;
+	}
+
+	pthread_create(&server->accept_thread, NULL, fake_accept_run, server);
+	return server;
+}
+
+void fake_server_add_namespace(fake_server * server, const char * ns)
+{
+	pthread_mutex_lock(&server->lock);
+
+	if (server->n_ns < FAKE_MAX_NAMESPACES) {
+		strncpy(server->ns[server->n_ns++], ns, sizeof(server->ns[0]) - 1);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void fake_server_drop_connections(fake_server * server)
+{
+	pthread_mutex_lock(&server->lock);
+
+	for (int i = 0; i < FAKE_MAX_CONNS; i++) {
+		if (server->conns[i] >= 0 && ! server->dropped[i]) {
+			server->dropped[i] = true;
+			server->dropping++;
+			shutdown(server->conns[i], SHUT_RDWR);
+		}
+	}
+
+	// A connection thread that has not yet returned to read can still pick up
+	// a request queued after the shutdown.  Wait for every dropped connection
+	// to close so no request is handled after this returns.
+	while (server->dropping > 0) {
+		pthread_cond_wait(&server->idle, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void fake_server_stop(fake_server * server)
+{
+	server->closing = true;
+	shutdown(server->listen_fd, SHUT_RDWR);
+	pthread_join(server->accept_thread, NULL);
+	close(server->listen_fd);
+
+	pthread_mutex_lock(&server->lock);
+
+	for (int i = 0; i < FAKE_MAX_CONNS; i++) {
+		if (server->conns[i] >= 0) {
+			shutdown(server->conns[i], SHUT_RDWR);
+		}
+	}
+
+	while (server->active > 0) {
+		pthread_cond_wait(&server->idle, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	fake_record * rec = server->records;
+
+	while (rec) {
+		fake_record * next = rec->next;
+		fake_record_free(rec);
+		rec = next;
+	}
+
+	pthread_cond_destroy(&server->idle);
+	pthread_mutex_destroy(&server->lock);
+	free(server);
+}
+
+uint16_t fake_server_port(fake_server * server)
+{
+	return server->port;
+}
+
+void fake_server_set_delay(fake_server * server, uint32_t delay_ms)
+{
+	server->delay_ms = delay_ms;
+}
+
+void fake_server_set_info_delay(fake_server * server, uint32_t delay_ms)
+{
+	server->info_delay_ms = delay_ms;
+}
+
+void fake_server_set_login_delay(fake_server * server, uint32_t delay_ms)
+{
+	server->login_delay_ms = delay_ms;
+}
+
+void fake_server_inject(fake_server * server, fake_fault fault, uint32_t count)
+{
+	pthread_mutex_lock(&server->lock);
+	server->fault = fault;
+	server->faults = count;
+	pthread_mutex_unlock(&server->lock);
+}
+
+uint32_t fake_server_requests(fake_server * server)
+{
+	return server->requests;
+}
+
+uint32_t fake_server_connections(fake_server * server)
+{
+	return server->connections;
+}
+
+uint32_t fake_server_logins(fake_server * server)
+{
+	return server->logins;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2008-2014 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+#pragma once
+
+/**
+ * A single node, in-memory server for offline tests.
+ *
+ * The server listens on an ephemeral loopback port and speaks just enough of
+ * the wire protocol for the client to tend it and run record commands: the
+ * info names used by cluster tending ("node", "partitions",
+ * "partition-generation", "services", "replicas-master", "replicas-prole"),
+ * read, write, delete and operate messages keyed by digest, and batch reads
+ * keyed by a digest array. The node owns the same partitions of each of its
+ * namespaces, either as master or as prole. Records are keyed by digest alone,
+ * whatever their namespace. Servers do not replicate to each other.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************
+ * TYPES
+ *****************************************************************************/
+
+typedef struct fake_server_s fake_server;
+
+/**
+ * How long FAKE_FAULT_STALL holds a response, in milliseconds.
+ */
+#define FAKE_STALL_MS 1000
+
+/**
+ * Faults injected into record requests.
+ */
+typedef enum fake_fault_e {
+	FAKE_FAULT_NONE,
+
+	/**
+	 * Close the connection without answering.
+	 */
+	FAKE_FAULT_DROP,
+
+	/**
+	 * Answer with AEROSPIKE_ERR_DEVICE_OVERLOAD.
+	 */
+	FAKE_FAULT_BUSY,
+
+	/**
+	 * Answer with a server side AEROSPIKE_ERR_TIMEOUT.
+	 */
+	FAKE_FAULT_TIMEOUT,
+
+	/**
+	 * Process the request, then close the connection halfway through the
+	 * response.
+	 */
+	FAKE_FAULT_TRUNCATE,
+
+	/**
+	 * Answer normally after FAKE_STALL_MS.
+	 */
+	FAKE_FAULT_STALL,
+
+	/**
+	 * Answer with only a proto header claiming the largest possible size.
+	 */
+	FAKE_FAULT_OVERSIZE
+} fake_fault;
+
+/*****************************************************************************
+ * FUNCTIONS
+ *****************************************************************************/
+
+/**
+ * Start a server which owns all partitions of namespace `ns`.
+ * Returns NULL if the listening socket could not be created.
+ */
+fake_server * fake_server_start(const char * ns);
+
+/**
+ * Start a server named `name` which is master (or prole if `master` is false)
+ * for all partitions of namespace `ns`. Two servers with different names, one
+ * of each role, form a two node cluster when both are given as seeds.
+ */
+fake_server * fake_server_start_node(const char * ns, const char * name, bool master);
+
+/**
+ * Start a server named `name` which is master for partitions `begin` up to but
+ * not including `end` of namespace `ns`, and prole for none. Servers covering
+ * disjoint ranges split batch commands between them.
+ */
+fake_server * fake_server_start_range(const char * ns, const char * name, uint32_t begin, uint32_t end);
+
+/**
+ * Also own the server's partitions of namespace `ns`. Call before clients
+ * connect, since the partition generation does not change.
+ */
+void fake_server_add_namespace(fake_server * server, const char * ns);
+
+/**
+ * Stop the server, close all connections and free all records.
+ */
+void fake_server_stop(fake_server * server);
+
+/**
+ * Close every open connection from the server side, as a server does when
+ * client sockets have been idle too long. The server keeps listening.
+ * Returns once every dropped connection has closed.
+ */
+void fake_server_drop_connections(fake_server * server);
+
+/**
+ * Port the server is listening on.
+ */
+uint16_t fake_server_port(fake_server * server);
+
+/**
+ * Delay every subsequent record response by `delay_ms`.
+ */
+void fake_server_set_delay(fake_server * server, uint32_t delay_ms);
+
+/**
+ * Delay every subsequent info response by `delay_ms`.
+ */
+void fake_server_set_info_delay(fake_server * server, uint32_t delay_ms);
+
+/**
+ * Delay every subsequent login response by `delay_ms`.
+ */
+void fake_server_set_login_delay(fake_server * server, uint32_t delay_ms);
+
+/**
+ * Fail the next `count` record requests with `fault`, replacing any faults
+ * still pending. Faulted requests are counted by fake_server_requests().
+ */
+void fake_server_inject(fake_server * server, fake_fault fault, uint32_t count);
+
+/**
+ * Number of record (non-info) requests served so far.
+ */
+uint32_t fake_server_requests(fake_server * server);
+
+/**
+ * Number of connections accepted so far.
+ */
+uint32_t fake_server_connections(fake_server * server);
+
+/**
+ * Number of logins answered so far.
+ */
+uint32_t fake_server_logins(fake_server * server);